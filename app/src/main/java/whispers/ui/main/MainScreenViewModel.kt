@@ -172,6 +172,8 @@ class MainScreenViewModel(private val application: Application) : ViewModel() {
                 com.whispercpp.whisper.WhisperContext.createContextFromAsset(
                     application.assets, "models/$model"
                 ).also {
+                    // 話者分離はデコーダと並行して動くので常に有効にする
+                    it.setDiarization(true)
                     Log.d(LOG_TAG, "Model loaded: $model")
                 }
             }
@@ -188,7 +190,10 @@ class MainScreenViewModel(private val application: Application) : ViewModel() {
         try {
             val data = readAudioSamples(file)
             val start = System.currentTimeMillis()
-            val result = whisperContext?.transcribeData(data, selectedLanguage, translateToEnglish)
+            val result = whisperContext?.let {
+                val text = it.transcribeData(data, selectedLanguage, translateToEnglish)
+                speakerTranscript(it.getSegments()) ?: text
+            }
             val elapsedMs = System.currentTimeMillis() - start
             val seconds = elapsedMs / 1000
             val milliseconds = elapsedMs % 1000
@@ -209,6 +214,22 @@ class MainScreenViewModel(private val application: Application) : ViewModel() {
         }
     }
 
+    // 話者が二人以上いるときだけ "Speaker N: text" の行に分ける
+    private fun speakerTranscript(segments: List<com.whispercpp.whisper.WhisperSegment>): String? {
+        if (segments.map { it.speaker }.filter { it >= 0 }.distinct().size < 2) return null
+        return buildString {
+            var current = Int.MIN_VALUE
+            for (seg in segments) {
+                if (seg.speaker != current) {
+                    if (isNotEmpty()) appendLine()
+                    append(if (seg.speaker >= 0) "Speaker ${seg.speaker + 1}:" else "Speaker ?:")
+                    current = seg.speaker
+                }
+                append(seg.text)
+            }
+        }
+    }
+
     suspend fun readAudioSamples(file: File): FloatArray {
         stopPlayback()
         startPlayback(file)
@@ -0,0 +1,14 @@
+# JNIから名前で参照されるクラスとメソッドを残す(アプリ側でminifyEnabled trueの場合)
+
+# ネイティブメソッド
+-keepclasseswithmembernames,includedescriptorclasses class com.whispercpp.whisper.** {
+    native <methods>;
+}
+
+# jni.c の GetMethodID で取得するコールバック
+-keep interface com.whispercpp.whisper.NativeSegmentListener {
+    boolean onSegment(long, long, java.lang.String, int, float, float, int);
+}
+-keepclassmembers class * implements com.whispercpp.whisper.NativeSegmentListener {
+    boolean onSegment(long, long, java.lang.String, int, float, float, int);
+}
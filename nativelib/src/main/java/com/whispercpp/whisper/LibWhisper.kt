@@ -2,6 +2,7 @@ package com.whispercpp.whisper
 
 import android.content.res.AssetManager
 import android.os.Build
+import android.os.ParcelFileDescriptor
 import android.util.Log
 import kotlinx.coroutines.*
 import java.io.File
@@ -15,18 +16,303 @@ class WhisperContext private constructor(private var ptr: Long) {
     private val scope: CoroutineScope = CoroutineScope(
         Executors.newSingleThreadExecutor().asCoroutineDispatcher()
     )
+    // Threads of every call; lowered by applyPowerProfile on the executor and
+    // also read off it (createBatchDecoder)
+    @Volatile
+    private var numThreads = WhisperCpuConfig.preferredThreadCount
 
-    suspend fun transcribeData(data: FloatArray, lang: String, translate: Boolean, printTimestamp: Boolean = true): String = withContext(scope.coroutineContext) {
+    /** [lang] is a code of [WhisperLanguages] or "auto"; unknown codes throw before any native work. */
+    suspend fun transcribeData(data: FloatArray, lang: String, translate: Boolean, printTimestamp: Boolean = true, preprocess: Boolean = false): String =
+        transcribeData(data, WhisperLanguages.id(lang), translate, printTimestamp, preprocess)
+
+    /** [langId] is an id of [WhisperLanguages], [WhisperLanguages.AUTO] to detect the language. */
+    suspend fun transcribeData(data: FloatArray, langId: Int, translate: Boolean, printTimestamp: Boolean = true, preprocess: Boolean = false): String = withContext(scope.coroutineContext) {
         require(ptr != 0L)
-        val numThreads = WhisperCpuConfig.preferredThreadCount
+        WhisperLanguages.requireId(langId)
         Log.d(LOG_TAG, "Selecting $numThreads threads")
-        WhisperLib.fullTranscribe(ptr, lang, numThreads, translate, data)
-        val textCount = WhisperLib.getTextSegmentCount(ptr)
-        return@withContext buildString {
-            for (i in 0 until textCount) {
-                append(WhisperLib.getTextSegment(ptr, i))
+        val audio = if (preprocess) {
+            // Clean up a copy so the caller's samples stay untouched
+            val preprocessor = WhisperPreprocessor()
+            try {
+                data.copyOf().also { preprocessor.processClip(it) }
+            } finally {
+                preprocessor.release()
             }
+        } else {
+            data
+        }
+        if (audio.size <= FAST_PATH_MAX_SAMPLES) {
+            WhisperLib.fullTranscribeFast(ptr, langId, numThreads, translate, audio, audio.size)
+        } else {
+            // a second copy of long audio costs more than the marshalling saves,
+            // and the fast path's buffer stays at the size of a short clip
+            val lang = if (langId == WhisperLanguages.AUTO) "auto" else WhisperLanguages.codes[langId]
+            WhisperLib.fullTranscribe(ptr, lang, numThreads, translate, audio)
+        }
+        return@withContext WhisperLib.getText(ptr)
+    }
+
+    /**
+     * Transcribes an audio file of any length without loading it: WAV is parsed
+     * natively, compressed formats (M4A/AAC, MP3, Opus, FLAC, ...) go through
+     * the platform decoders, and the native side decodes, downmixes and
+     * resamples [chunkSeconds] (60 at least) of audio at a time, so memory does not grow with
+     * the duration and no intermediate WAV is written. [onSegment] gets every segment as
+     * it is decoded, times from the start of the file; returning false stops.
+     */
+    suspend fun transcribeFile(
+        path: String,
+        lang: String,
+        translate: Boolean = false,
+        chunkSeconds: Int = 600,
+        onSegment: (WhisperSegment) -> Boolean = { true },
+    ): WhisperFileStats = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        val langId = WhisperLanguages.id(lang)
+        val listener = NativeSegmentListener { t0, t1, text, fallbacks, fallbackMs, noSpeechProb, speaker ->
+            onSegment(WhisperSegment(t0, t1, text, fallbacks, fallbackMs, noSpeechProb, speaker))
+        }
+        val stats = WhisperLib.fullTranscribeFile(
+            ptr, path, langId, numThreads, translate, chunkSeconds, listener
+        ) ?: throw java.lang.RuntimeException("Couldn't transcribe $path")
+        return@withContext WhisperFileStats.fromArray(stats)
+    }
+
+    /**
+     * Decodes [data] as a command: only text [grammar] accepts can come out,
+     * as one segment without timestamps, so a short command takes a handful of
+     * decoder steps. [penalty] is subtracted from the logits of tokens the
+     * grammar rejects.
+     */
+    suspend fun transcribeCommand(data: FloatArray, grammar: WhisperGrammar, lang: String = "en", penalty: Float = 100.0f): String = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        val langId = WhisperLanguages.id(lang)
+        // the grammar's lock keeps release() from freeing its rules mid-decode
+        synchronized(grammar) {
+            WhisperLib.fullTranscribeGrammar(ptr, grammar.pointer, penalty, langId, numThreads, data)
+        }
+        return@withContext WhisperLib.getText(ptr).trim()
+    }
+
+    /**
+     * Creates a keyword spotter sharing this context's model. Feed it with
+     * [spotKeywords]; release it before the context. Keywords that cannot be
+     * tokenized are left out of [WhisperKeywordSpotter.keywords].
+     */
+    fun createKeywordSpotter(keywords: List<String>, params: WhisperKeywordParams = WhisperKeywordParams()): WhisperKeywordSpotter {
+        require(ptr != 0L)
+        require(WhisperLanguages.id(params.lang) != WhisperLanguages.AUTO) { "The keyword spotter does not detect languages" }
+        val spotterPtr = WhisperLib.initKeywordSpotter(
+            ptr, params.lang, numThreads, params.windowMs, params.hopMs,
+            params.dutyCycle, params.threshold,
+        )
+        if (spotterPtr == 0L) {
+            throw java.lang.RuntimeException("Couldn't create keyword spotter")
+        }
+        // native ids follow the accepted keywords
+        val accepted = keywords.filter { WhisperLib.keywordSpotterAdd(spotterPtr, it) >= 0 }
+        return WhisperKeywordSpotter(spotterPtr, accepted)
+    }
+
+    /**
+     * Pushes recorded samples to [spotter]; every window that became due is
+     * scored on this context's thread. Returns the keywords heard.
+     */
+    suspend fun spotKeywords(spotter: WhisperKeywordSpotter, data: FloatArray, offset: Int = 0, length: Int = data.size - offset): List<WhisperKeywordHit> = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        // the spotter's lock keeps release() and reset() off its ring mid-decode
+        val v = synchronized(spotter) {
+            WhisperLib.keywordSpotterAccept(spotter.pointer, data, offset, length)
+        } ?: return@withContext emptyList()
+        List(v.size / 4) { i ->
+            WhisperKeywordHit(
+                keyword = spotter.keywords[v[4 * i].toInt()],
+                score = v[4 * i + 1],
+                startMs = v[4 * i + 2].toLong(),
+                endMs = v[4 * i + 3].toLong(),
+            )
+        }
+    }
+
+    /**
+     * Creates a batch decoder sharing this context's model. It decodes
+     * [sequences] clips (or 30 s windows of longer clips) in lockstep; each
+     * sequence holds its own decoder state, so memory grows with [sequences].
+     * Release it before the context.
+     */
+    fun createBatchDecoder(sequences: Int = 4, lang: String = "en"): WhisperBatchDecoder {
+        require(ptr != 0L)
+        require(WhisperLanguages.id(lang) != WhisperLanguages.AUTO) { "The batch decoder does not detect languages" }
+        val batchPtr = WhisperLib.initBatchDecoder(ptr, lang, numThreads, sequences)
+        if (batchPtr == 0L) {
+            throw java.lang.RuntimeException("Couldn't create batch decoder")
+        }
+        return WhisperBatchDecoder(batchPtr)
+    }
+
+    /**
+     * Transcribes queued [clips] together with [decoder]: greedy, text only.
+     * Returns one text per clip, in order.
+     */
+    suspend fun transcribeBatch(decoder: WhisperBatchDecoder, clips: List<FloatArray>): List<String> = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        // the decoder's lock keeps release() from freeing its slots and workers mid-batch
+        val texts = synchronized(decoder) {
+            WhisperLib.batchDecoderTranscribe(decoder.pointer, clips.toTypedArray())
+        } ?: throw java.lang.RuntimeException("Batch decoding failed")
+        texts.toList()
+    }
+
+    /**
+     * Creates an incremental mel extractor matching this model's mel size.
+     * Feed it with [WhisperMelStream.accept] while recording and transcribe the
+     * last 30 s with [transcribeMelStream] without recomputing earlier frames.
+     */
+    fun createMelStream(): WhisperMelStream {
+        require(ptr != 0L)
+        val streamPtr = WhisperLib.initMelStream(ptr)
+        if (streamPtr == 0L) {
+            throw java.lang.RuntimeException("Couldn't create mel stream")
+        }
+        return WhisperMelStream(streamPtr)
+    }
+
+    suspend fun transcribeMelStream(stream: WhisperMelStream, lang: String, translate: Boolean): String =
+        transcribeMelStream(stream, WhisperLanguages.id(lang), translate)
+
+    suspend fun transcribeMelStream(stream: WhisperMelStream, langId: Int, translate: Boolean): String = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLanguages.requireId(langId)
+        // the stream's lock is held only while its window is copied, so
+        // accept() on the recording thread does not wait for the decode
+        val melPtr = synchronized(stream) { WhisperLib.melStreamWindow(stream.pointer) }
+        try {
+            WhisperLib.fullTranscribeMel(ptr, melPtr, langId, numThreads, translate)
+        } finally {
+            WhisperLib.freeMel(melPtr)
         }
+        return@withContext WhisperLib.getText(ptr)
+    }
+
+    /** Segments of the last transcription with their temperature-fallback cost. */
+    suspend fun getSegments(): List<WhisperSegment> = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        return@withContext (0 until WhisperLib.getTextSegmentCount(ptr)).map { i ->
+            WhisperSegment(
+                t0 = WhisperLib.getTextSegmentT0(ptr, i),
+                t1 = WhisperLib.getTextSegmentT1(ptr, i),
+                text = WhisperLib.getTextSegment(ptr, i),
+                fallbacks = WhisperLib.getTextSegmentFallbacks(ptr, i),
+                fallbackMs = WhisperLib.getTextSegmentFallbackMs(ptr, i),
+                noSpeechProb = WhisperLib.getTextSegmentNoSpeechProb(ptr, i),
+                speaker = WhisperLib.getTextSegmentSpeaker(ptr, i),
+            )
+        }
+    }
+
+    suspend fun getTranscriptionStats(): WhisperTranscriptionStats = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        return@withContext WhisperTranscriptionStats.fromArray(WhisperLib.getTranscriptionStats(ptr))
+    }
+
+    /**
+     * Hardware counters (cycles, instructions, cache and branch misses,
+     * task-clock, context switches) per stage of the following transcriptions,
+     * read with [getStageCounters]. Returns false when the kernel refuses
+     * perf_event_open, as Android does unless `security.perf_harden` is 0.
+     */
+    suspend fun setPerfCounters(enabled: Boolean): Boolean = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setPerfCounters(ptr, enabled)
+    }
+
+    /** Counters of the last transcription, null unless [setPerfCounters] is on. */
+    suspend fun getStageCounters(): WhisperStageCounters? = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.getPerfCounters(ptr)?.let { WhisperStageCounters.fromArray(it) }
+    }
+
+    /**
+     * Transcribes [probe] under [profile] and returns what it cost: latency,
+     * joules from the device's energy counters (see [WhisperPowerPlanner.source])
+     * and CPU time. The profile applies to this call only. Null on failure.
+     */
+    suspend fun measureEnergy(profile: WhisperPowerProfile, probe: FloatArray, lang: String = "en"): WhisperEnergySample? = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        val langId = WhisperLanguages.id(lang)
+        WhisperLib.measureEnergy(ptr, langId, profile.threads, profile.cpuMask, probe, probe.size)
+            ?.let { WhisperEnergySample.fromArray(profile, it) }
+    }
+
+    /**
+     * Runs the following transcriptions of this context with the thread count
+     * and on the CPUs of [profile]; null goes back to all CPUs and
+     * [WhisperCpuConfig.preferredThreadCount]. Contexts created later, like
+     * batch decoders, take the thread count at creation.
+     */
+    suspend fun applyPowerProfile(profile: WhisperPowerProfile?) = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        numThreads = profile?.threads ?: WhisperCpuConfig.preferredThreadCount
+        // ggml starts its workers from this thread, so they inherit the mask
+        if (!WhisperLib.setThreadAffinity(profile?.cpuMask ?: 0L)) {
+            Log.w(LOG_TAG, "Couldn't set the CPU affinity of $profile")
+        }
+    }
+
+    /** Applies to the following transcriptions of this context. */
+    suspend fun setFallbackPolicy(policy: WhisperFallbackPolicy) = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setFallbackPolicy(
+            ptr, policy.maxFallbacksPerWindow, policy.budgetPerMinute,
+            policy.minSpeechRatio, policy.fallbackSpeechRatio, policy.skipSilence, policy.fitShortClips,
+            policy.pipelinedEncode
+        )
+    }
+
+    /**
+     * Stops decoders that loop on silence, noise or music (n-gram repetition,
+     * compression ratio) and drops their repeated or no-speech segments. Off by default.
+     */
+    suspend fun setHallucinationFilter(enabled: Boolean) = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setHallucinationFilter(ptr, enabled)
+    }
+
+    /**
+     * Speaker diarization on a native thread next to the decoder; sets
+     * [WhisperSegment.speaker]. Off by default.
+     */
+    suspend fun setDiarization(enabled: Boolean) = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setDiarization(ptr, enabled)
+    }
+
+    /**
+     * Thermal governor for long recordings: between 30 s windows it lowers the
+     * thread count and then moves to slower cores while the device throttles
+     * (hot CPU zones, capped clocks, or the encoder slowing down), and goes
+     * back up once it cooled, keeping the real-time factor steady instead of
+     * collapsing halfway through. Off by default; see [getThermalReport].
+     */
+    suspend fun setThermalGovernor(enabled: Boolean) = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setThermalGovernor(ptr, enabled)
+    }
+
+    /** What the governor saw during the last transcription, null while it is off. */
+    suspend fun getThermalReport(): WhisperThermalReport? = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.getThermalReport(ptr)?.let { WhisperThermalReport.fromArray(it) }
+    }
+
+    /**
+     * Biases decoding towards [phrases] (names, product terms) by raising their
+     * tokens' logits by [boost]; replaces earlier phrases, an empty list clears
+     * them. Returns how many phrases were accepted.
+     */
+    suspend fun setVocabulary(phrases: List<String>, boost: Float = 3.0f): Int = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        WhisperLib.setBiasPhrases(ptr, phrases.toTypedArray(), boost)
     }
 
     suspend fun benchMemory(nthreads: Int): String = withContext(scope.coroutineContext) {
@@ -37,6 +323,38 @@ class WhisperContext private constructor(private var ptr: Long) {
         return@withContext WhisperLib.benchGgmlMulMat(nthreads)
     }
 
+    /**
+     * Per-call JNI cost of handing [samples] samples and a language to native
+     * code: the array/string marshalling of fullTranscribe against the id and
+     * critical copy of fullTranscribeFast. Nothing is transcribed.
+     */
+    suspend fun benchJniOverhead(samples: Int = 16000, calls: Int = 1000): String = withContext(scope.coroutineContext) {
+        require(ptr != 0L)
+        val data = FloatArray(samples)
+        val id = WhisperLanguages.id("en")
+        fun perCallUs(call: () -> Unit): Double {
+            repeat(calls / 10) { call() }
+            val t0 = System.nanoTime()
+            repeat(calls) { call() }
+            return (System.nanoTime() - t0) / 1000.0 / calls
+        }
+        val empty = perCallUs { WhisperLib.benchJniCritical(ptr, id, data, 0) }
+        val elements = perCallUs { WhisperLib.benchJniElements(ptr, "en", data) }
+        val critical = perCallUs { WhisperLib.benchJniCritical(ptr, id, data, samples) }
+        return@withContext String.format(
+            "JNI per call, %d samples: empty %.2f us, elements + string %.2f us, id + critical copy %.2f us",
+            samples, empty, elements, critical,
+        )
+    }
+
+    /**
+     * Decodes the audio file at [path] the way [transcribeFile] reads it,
+     * without transcribing: decode throughput and peak memory.
+     */
+    suspend fun benchDecodeFile(path: String): String = withContext(scope.coroutineContext) {
+        return@withContext WhisperLib.benchDecodeFile(path)
+    }
+
     suspend fun release() = withContext(scope.coroutineContext) {
         if (ptr != 0L) {
             WhisperLib.freeContext(ptr)
@@ -51,6 +369,9 @@ class WhisperContext private constructor(private var ptr: Long) {
     }
 
     companion object {
+        // clips up to one window take fullTranscribeFast, longer ones fullTranscribe
+        private const val FAST_PATH_MAX_SAMPLES = 30 * 16000
+
         fun createContextFromFile(filePath: String): WhisperContext {
             val ptr = WhisperLib.initContext(filePath)
             if (ptr == 0L) {
@@ -77,18 +398,815 @@ class WhisperContext private constructor(private var ptr: Long) {
             return WhisperContext(ptr)
         }
 
+        /**
+         * Context whose weights are mapped from a region made by [WhisperSharedModel]
+         * instead of loaded again. [model] may be closed once this returns.
+         */
+        fun createContextFromSharedModel(model: ParcelFileDescriptor): WhisperContext {
+            val ptr = WhisperLib.initContextFromSharedModel(model.fd)
+            if (ptr == 0L) {
+                throw java.lang.RuntimeException("Couldn't create context from the shared model")
+            }
+            return WhisperContext(ptr)
+        }
+
         fun getSystemInfo(): String {
             return WhisperLib.getSystemInfo()
         }
     }
 }
 
+/**
+ * whisper's language table, read from the native library once. The transcribe
+ * calls take these ids; codes are checked here, before any native work, instead
+ * of failing inside whisper.
+ */
+object WhisperLanguages {
+    /** detect the language from the audio */
+    const val AUTO = -1
+
+    /** language codes ("en", "ja", ...) indexed by id */
+    val codes: List<String> by lazy { WhisperLib.getLanguages().toList() }
+
+    /** English names indexed by id */
+    val names: List<String> by lazy { WhisperLib.getLanguageNames().toList() }
+
+    private val ids: Map<String, Int> by lazy { codes.withIndex().associate { it.value to it.index } }
+
+    /** id of [code], [AUTO] for "auto", null when whisper does not know it */
+    fun idOrNull(code: String): Int? = if (code == "auto") AUTO else ids[code]
+
+    /** id of [code]; throws [IllegalArgumentException] when whisper does not know it */
+    fun id(code: String): Int = requireNotNull(idOrNull(code)) { "Unknown language '$code'" }
+
+    internal fun requireId(id: Int) = require(id == AUTO || id in codes.indices) { "Unknown language id $id" }
+}
+
+/**
+ * Temperature-fallback policy of a [WhisperContext]. Audio is decoded one 30 s
+ * window at a time; each window may retry at up to [maxFallbacksPerWindow]
+ * higher temperatures while the call's budget of [budgetPerMinute] fallbacks
+ * per minute of audio lasts (negative = unlimited). Windows the energy VAD
+ * finds nearly silent can be skipped or decoded without fallbacks.
+ *
+ * The defaults decode like whisper itself; [ADAPTIVE] turns on the budget and
+ * the VAD skips.
+ */
+data class WhisperFallbackPolicy(
+    val maxFallbacksPerWindow: Int = 5,
+    val budgetPerMinute: Float = -1f,
+    val minSpeechRatio: Float = 0f,
+    val fallbackSpeechRatio: Float = 0f,
+    val skipSilence: Boolean = false,
+    /**
+     * Clips under 30 s encode only the positions they need, from a few fixed
+     * sizes, so repeated short clips skip the padding and reuse whisper's
+     * graph plan. Slightly less accurate than the full window.
+     */
+    val fitShortClips: Boolean = false,
+    /**
+     * Audio over 30 s encodes the next window on spare cores while the current
+     * one decodes. Greedy only: no fallbacks, hallucination filter or bias.
+     */
+    val pipelinedEncode: Boolean = false,
+) {
+    companion object {
+        val ADAPTIVE = WhisperFallbackPolicy(
+            budgetPerMinute = 4f,
+            minSpeechRatio = 0.02f,
+            fallbackSpeechRatio = 0.2f,
+            skipSilence = true,
+        )
+    }
+}
+
+/**
+ * Times are in centiseconds; fallbacks are those of the window the segment was decoded in.
+ * [speaker] is the 0-based diarization id, -1 when unknown or diarization is off.
+ */
+data class WhisperSegment(
+    val t0: Long,
+    val t1: Long,
+    val text: String,
+    val fallbacks: Int,
+    val fallbackMs: Float,
+    val noSpeechProb: Float,
+    val speaker: Int = -1,
+)
+
+/** Counters of one stage; -1 for events the CPU's PMU does not provide. */
+data class WhisperPerfCounters(
+    val cycles: Float,
+    val instructions: Float,
+    /** the PMU's generic cache miss event: last level on x86, often L1 data on ARM */
+    val cacheMisses: Float,
+    val branchMisses: Float,
+    val llcReadMisses: Float,
+    val contextSwitches: Float,
+    /** CPU time of all threads of the stage */
+    val taskClockMs: Float,
+    val wallMs: Float,
+) {
+    val ipc: Float get() = if (cycles > 0f && instructions >= 0f) instructions / cycles else -1f
+
+    /** effective clock: a drop at the same IPC points at the governor or thermal limits */
+    val ghz: Float get() = if (cycles >= 0f && taskClockMs > 0f) cycles / (taskClockMs * 1e6f) else -1f
+
+    /** memory read bandwidth estimated from LLC read misses of 64 bytes */
+    val bandwidthGBs: Float get() = if (llcReadMisses >= 0f && wallMs > 0f) llcReadMisses * 64f / (wallMs * 1e6f) else -1f
+
+    internal companion object {
+        fun fromArray(v: FloatArray, offset: Int) = WhisperPerfCounters(
+            cycles = v[offset],
+            instructions = v[offset + 1],
+            cacheMisses = v[offset + 2],
+            branchMisses = v[offset + 3],
+            llcReadMisses = v[offset + 4],
+            contextSwitches = v[offset + 5],
+            taskClockMs = v[offset + 6],
+            wallMs = v[offset + 7],
+        )
+    }
+}
+
+data class WhisperStageCounters(
+    val mel: WhisperPerfCounters,
+    /** encoder runs up to each window's first decoder step */
+    val encode: WhisperPerfCounters,
+    val decode: WhisperPerfCounters,
+    val total: WhisperPerfCounters,
+) {
+    internal companion object {
+        // Order matches getPerfCounters in jni.c
+        fun fromArray(v: FloatArray) = WhisperStageCounters(
+            mel = WhisperPerfCounters.fromArray(v, 0),
+            encode = WhisperPerfCounters.fromArray(v, 8),
+            decode = WhisperPerfCounters.fromArray(v, 16),
+            total = WhisperPerfCounters.fromArray(v, 24),
+        )
+    }
+}
+
+/** Where the joules of [WhisperEnergySample] come from. */
+enum class WhisperPowerSource {
+    /** no energy counter: only CPU time is compared */
+    NONE,
+    /** package energy of Linux hosts (/sys/class/powercap) */
+    RAPL,
+    /** on-device power monitors (Pixel ODPM), all rails */
+    RAILS,
+    /** battery current x voltage: the whole device, and meaningless while charging */
+    BATTERY,
+}
+
+/** Threads and CPUs of a transcription; [cpuMask] 0 allows every CPU. */
+data class WhisperPowerProfile(
+    val threads: Int,
+    val cpuMask: Long = 0L,
+)
+
+data class WhisperEnergySample(
+    val profile: WhisperPowerProfile,
+    val latencyMs: Float,
+    val audioSeconds: Float,
+    /** -1 without an energy source */
+    val joules: Float,
+    val cpuSeconds: Float,
+) {
+    val rtf: Float get() = if (audioSeconds > 0f) latencyMs / (audioSeconds * 1000f) else -1f
+    val joulesPerAudioMinute: Float get() = if (joules >= 0f && audioSeconds > 0f) joules * 60f / audioSeconds else -1f
+    val cpuSecondsPerAudioMinute: Float get() = if (audioSeconds > 0f) cpuSeconds * 60f / audioSeconds else -1f
+
+    internal companion object {
+        // Order matches measureEnergy in jni.c
+        fun fromArray(profile: WhisperPowerProfile, v: FloatArray) = WhisperEnergySample(
+            profile = profile,
+            latencyMs = v[0],
+            audioSeconds = v[1],
+            joules = v[2],
+            cpuSeconds = v[3],
+        )
+    }
+}
+
+/** The context and profile [WhisperPowerPlanner.choose] settled on, already applied. */
+data class WhisperPowerChoice(
+    val context: WhisperContext,
+    val sample: WhisperEnergySample,
+    /** false when no candidate met the latency bound and the fastest was taken */
+    val meetsLatency: Boolean,
+)
+
+/**
+ * Power-efficient scheduling: instead of [WhisperCpuConfig.preferredThreadCount]
+ * on the big cores, measure what each model, CPU cluster and thread count
+ * costs on a short probe clip and keep the one with the least energy per audio
+ * minute whose real-time factor stays within the bound. Without an energy
+ * counter CPU time decides, which still favours fewer threads but cannot see
+ * that a little core needs less energy for the same work.
+ */
+object WhisperPowerPlanner {
+    val source: WhisperPowerSource
+        get() = WhisperPowerSource.values().getOrElse(WhisperLib.getPowerSource()) { WhisperPowerSource.NONE }
+
+    /** CPU masks of the clusters, slowest first. */
+    val clusters: List<Long>
+        get() = WhisperLib.getCpuClusters().toList()
+
+    /** 1, 2, 4 and all threads on each cluster, and the default on every CPU. */
+    fun candidates(): List<WhisperPowerProfile> {
+        val profiles = clusters.flatMap { mask ->
+            val cpus = java.lang.Long.bitCount(mask)
+            listOf(1, 2, 4, cpus).filter { it <= cpus }.distinct().map { WhisperPowerProfile(it, mask) }
+        }
+        return (profiles + WhisperPowerProfile(WhisperCpuConfig.preferredThreadCount)).distinct()
+    }
+
+    /**
+     * Measures every candidate on each of [contexts] (models of different
+     * sizes, say) after one warm-up call, applies the cheapest one within
+     * [maxRtf] to its context and returns it. A few seconds of representative
+     * speech make a good [probe]; each candidate transcribes it once.
+     */
+    suspend fun choose(
+        contexts: List<WhisperContext>,
+        probe: FloatArray,
+        maxRtf: Float = 0.5f,
+        lang: String = "en",
+        candidates: List<WhisperPowerProfile> = candidates(),
+    ): WhisperPowerChoice {
+        require(contexts.isNotEmpty() && candidates.isNotEmpty())
+        val samples = contexts.flatMap { context ->
+            context.measureEnergy(WhisperPowerProfile(WhisperCpuConfig.preferredThreadCount), probe, lang)
+            candidates.mapNotNull { profile -> context.measureEnergy(profile, probe, lang)?.let { context to it } }
+        }
+        check(samples.isNotEmpty()) { "No candidate could be measured" }
+
+        // Joules only when every sample has them, like power_pick in power.c
+        val useJoules = samples.all { it.second.joules >= 0f }
+        val within = samples.filter { it.second.rtf in 0f..maxRtf }
+        val best = within.minByOrNull { (_, s) -> if (useJoules) s.joulesPerAudioMinute else s.cpuSecondsPerAudioMinute }
+            ?: samples.minBy { it.second.latencyMs }
+        Log.d(LOG_TAG, "Power-efficient choice from ${samples.size} samples (${source}): ${best.second}")
+        best.first.applyPowerProfile(best.second.profile)
+        return WhisperPowerChoice(best.first, best.second, best in within)
+    }
+}
+
+enum class WhisperThermalReason {
+    /** a CPU thermal zone reached the governor's limit */
+    HOT,
+    /** the kernel lowered a cluster's maximum clock */
+    FREQUENCY_CAP,
+    /** the encoder slowed down at the same configuration */
+    SLOWDOWN,
+    /** stepped back up after cooling down */
+    COOLED,
+}
+
+data class WhisperThermalEvent(
+    val window: Int,
+    val reason: WhisperThermalReason,
+    /** hottest CPU zone, -1 when the zones are unreadable */
+    val temperatureC: Float,
+    val encodeMs: Float,
+    val from: WhisperPowerProfile,
+    val to: WhisperPowerProfile,
+)
+
+data class WhisperThermalReport(
+    val throttledWindows: Int,
+    val maxTemperatureC: Float,
+    val events: List<WhisperThermalEvent>,
+) {
+    internal companion object {
+        // Order matches getThermalReport in jni.c
+        fun fromArray(v: FloatArray) = WhisperThermalReport(
+            throttledWindows = v[0].toInt(),
+            maxTemperatureC = v[1],
+            events = (0 until v[2].toInt()).map { i ->
+                val o = 3 + 8 * i
+                WhisperThermalEvent(
+                    window = v[o].toInt(),
+                    reason = WhisperThermalReason.values()[v[o + 1].toInt()],
+                    temperatureC = v[o + 2],
+                    encodeMs = v[o + 3],
+                    from = WhisperPowerProfile(v[o + 4].toInt(), v[o + 5].toLong()),
+                    to = WhisperPowerProfile(v[o + 6].toInt(), v[o + 7].toLong()),
+                )
+            },
+        )
+    }
+}
+
+data class WhisperTranscriptionStats(
+    val windows: Int,
+    val skippedWindows: Int,
+    val passes: Int,
+    val fallbacks: Int,
+    /** -1 when unlimited */
+    val fallbackBudget: Int,
+    val cappedWindows: Int,
+    val fallbackMs: Float,
+    val skippedSeconds: Float,
+    val melMs: Float,
+    val totalMs: Float,
+    /** decoders ended early by the hallucination filter */
+    val stoppedDecoders: Int,
+    /** upper bound of the decoder steps saved by stopping them */
+    val stepsSaved: Int,
+    val suppressedSegments: Int,
+    /** 0 when diarization is off */
+    val speakers: Int,
+    val diarizeMs: Float,
+    /** time the decoder waited for diarization to finish */
+    val diarizeWaitMs: Float,
+    /** decoder steps whose logits the vocabulary bias raised */
+    val biasedSteps: Int,
+    /** decoder steps over all passes and beams */
+    val decoderSteps: Int,
+    /** native heap allocations during the call, -1 unless built with WHISPER_COUNT_ALLOCS */
+    val heapAllocations: Int,
+    /** the part of [heapAllocations] made inside whisper_full */
+    val whisperHeapAllocations: Int,
+    /** per-call native data (segment text) held in the context's arena */
+    val arenaBytes: Int,
+    /** encoder positions of the last window, 0 for whisper's full window */
+    val audioCtx: Int,
+    /** windows whose graphs had the same shape as the window before them */
+    val shapeReuses: Int,
+    /** time before the first encoder run: mel, VAD and whisper's per-call setup */
+    val setupMs: Float,
+    val encodeMs: Float,
+    /** [WhisperFallbackPolicy.pipelinedEncode]: windows encoded ahead of the decoder */
+    val speculatedWindows: Int,
+    /** of those, windows the decoder used */
+    val speculationHits: Int,
+    /** encoder time that overlapped decoding */
+    val encodeHiddenMs: Float,
+) {
+    internal companion object {
+        // Order matches getTranscriptionStats in jni.c
+        fun fromArray(v: FloatArray) = WhisperTranscriptionStats(
+            windows = v[0].toInt(),
+            skippedWindows = v[1].toInt(),
+            passes = v[2].toInt(),
+            fallbacks = v[3].toInt(),
+            fallbackBudget = v[4].toInt(),
+            cappedWindows = v[5].toInt(),
+            fallbackMs = v[6],
+            skippedSeconds = v[7],
+            melMs = v[8],
+            totalMs = v[9],
+            stoppedDecoders = v[10].toInt(),
+            stepsSaved = v[11].toInt(),
+            suppressedSegments = v[12].toInt(),
+            speakers = v[13].toInt(),
+            diarizeMs = v[14],
+            diarizeWaitMs = v[15],
+            biasedSteps = v[16].toInt(),
+            decoderSteps = v[17].toInt(),
+            heapAllocations = v[18].toInt(),
+            whisperHeapAllocations = v[19].toInt(),
+            arenaBytes = v[20].toInt(),
+            audioCtx = v[21].toInt(),
+            shapeReuses = v[22].toInt(),
+            setupMs = v[23],
+            encodeMs = v[24],
+            speculatedWindows = v[25].toInt(),
+            speculationHits = v[26].toInt(),
+            encodeHiddenMs = v[27],
+        )
+    }
+}
+
+/**
+ * Stateful log-mel extractor for live audio. Only frames completed by new samples
+ * are computed; the last 30 s are kept in a native ring buffer.
+ * [accept] may be called from the recording thread while the context transcribes.
+ */
+class WhisperMelStream internal constructor(private var ptr: Long) {
+    internal val pointer: Long
+        get() {
+            require(ptr != 0L)
+            return ptr
+        }
+
+    /** Appends 16 kHz mono samples and returns the number of new mel frames. */
+    @Synchronized
+    fun accept(data: FloatArray, offset: Int = 0, length: Int = data.size - offset): Int {
+        require(ptr != 0L)
+        return WhisperLib.melStreamAccept(ptr, data, offset, length)
+    }
+
+    @Synchronized
+    fun reset() {
+        require(ptr != 0L)
+        WhisperLib.melStreamReset(ptr)
+    }
+
+    @Synchronized
+    fun release() {
+        if (ptr != 0L) {
+            WhisperLib.freeMelStream(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        release()
+    }
+}
+
+/**
+ * [dutyCycle] below 1 stretches the stride between scored windows to
+ * hopMs / dutyCycle, trading detection latency for CPU time. [threshold] is
+ * the mean log-probability of the keyword's tokens that counts as a hit.
+ */
+data class WhisperKeywordParams(
+    val lang: String = "en",
+    val windowMs: Int = 2000,
+    val hopMs: Int = 500,
+    val dutyCycle: Float = 1.0f,
+    val threshold: Float = -1.0f,
+)
+
+/** Times are in stream milliseconds since the spotter was created or reset. */
+data class WhisperKeywordHit(
+    val keyword: String,
+    val score: Float,
+    val startMs: Long,
+    val endMs: Long,
+)
+
+data class WhisperKeywordStats(
+    val audioSeconds: Float,
+    val windows: Int,
+    /** windows passed over by the duty cycle or too quiet to score */
+    val skippedWindows: Int,
+    val decoderSteps: Int,
+    val detections: Int,
+    /** process CPU time of the evaluations, all threads */
+    val cpuMs: Float,
+    val wallMs: Float,
+) {
+    val cpuMsPerAudioSecond: Float
+        get() = if (audioSeconds > 0f) cpuMs / audioSeconds else 0f
+
+    internal companion object {
+        fun fromArray(v: FloatArray) = WhisperKeywordStats(
+            audioSeconds = v[0],
+            windows = v[1].toInt(),
+            skippedWindows = v[2].toInt(),
+            decoderSteps = v[3].toInt(),
+            detections = v[4].toInt(),
+            cpuMs = v[5],
+            wallMs = v[6],
+        )
+    }
+}
+
+class WhisperKeywordSpotter internal constructor(private var ptr: Long, val keywords: List<String>) {
+    internal val pointer: Long
+        get() {
+            require(ptr != 0L)
+            return ptr
+        }
+
+    val stats: WhisperKeywordStats
+        @Synchronized get() {
+            require(ptr != 0L)
+            return WhisperKeywordStats.fromArray(WhisperLib.keywordSpotterStats(ptr))
+        }
+
+    @Synchronized
+    fun reset() {
+        require(ptr != 0L)
+        WhisperLib.keywordSpotterReset(ptr)
+    }
+
+    @Synchronized
+    fun release() {
+        if (ptr != 0L) {
+            WhisperLib.freeKeywordSpotter(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        release()
+    }
+}
+
+data class WhisperFileStats(
+    val durationSeconds: Float,
+    val chunks: Int,
+    val segments: Int,
+    val windows: Int,
+    /** audio decoded twice where chunks meet */
+    val carriedSeconds: Float,
+    /** native sample buffer, the same for any duration */
+    val bufferBytes: Int,
+    /** file reading, decoding, conversion and resampling */
+    val readMs: Float,
+    val totalMs: Float,
+) {
+    internal companion object {
+        // Order matches fullTranscribeFile in jni.c
+        fun fromArray(v: FloatArray) = WhisperFileStats(
+            durationSeconds = v[0],
+            chunks = v[1].toInt(),
+            segments = v[2].toInt(),
+            windows = v[3].toInt(),
+            carriedSeconds = v[4],
+            bufferBytes = v[5].toInt(),
+            readMs = v[6],
+            totalMs = v[7],
+        )
+    }
+}
+
+// Called from native code with the segments of WhisperContext.transcribeFile.
+// jni.c looks onSegment up by name, so consumer-rules.pro keeps it from R8.
+internal fun interface NativeSegmentListener {
+    fun onSegment(t0: Long, t1: Long, text: String, fallbacks: Int, fallbackMs: Float, noSpeechProb: Float, speaker: Int): Boolean
+}
+
+data class WhisperBatchStats(
+    val clips: Int,
+    val windows: Int,
+    /** sampled tokens, EOT included */
+    val tokens: Int,
+    /** lockstep decoder steps */
+    val steps: Int,
+    /** sequences advanced per step */
+    val meanActive: Float,
+    val encodeMs: Float,
+    val decodeMs: Float,
+    /**
+     * CPU time of the decoder steps on the per-sequence worker threads, not
+     * the whole process; ggml's extra compute threads are not counted.
+     */
+    val decodeCpuMs: Float,
+) {
+    val tokensPerCoreSecond: Float
+        get() = if (decodeCpuMs > 0f) tokens * 1000f / decodeCpuMs else 0f
+
+    internal companion object {
+        fun fromArray(v: FloatArray) = WhisperBatchStats(
+            clips = v[0].toInt(),
+            windows = v[1].toInt(),
+            tokens = v[2].toInt(),
+            steps = v[3].toInt(),
+            meanActive = v[4],
+            encodeMs = v[5],
+            decodeMs = v[6],
+            decodeCpuMs = v[7],
+        )
+    }
+}
+
+class WhisperBatchDecoder internal constructor(private var ptr: Long) {
+    internal val pointer: Long
+        get() {
+            require(ptr != 0L)
+            return ptr
+        }
+
+    /** statistics of the last [WhisperContext.transcribeBatch] */
+    val stats: WhisperBatchStats
+        @Synchronized get() {
+            require(ptr != 0L)
+            return WhisperBatchStats.fromArray(WhisperLib.batchDecoderStats(ptr))
+        }
+
+    @Synchronized
+    fun release() {
+        if (ptr != 0L) {
+            WhisperLib.freeBatchDecoder(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        release()
+    }
+}
+
+data class WhisperServerStats(
+    val jobs: Int,
+    val failed: Int,
+    /** refused connections and bad requests */
+    val rejected: Int,
+    val active: Int,
+    val waiting: Int,
+    val segments: Int,
+    val audioSeconds: Float,
+    /** time jobs spent queued for a worker, all jobs */
+    val waitMs: Float,
+    val maxWaitMs: Float,
+    val busyMs: Float,
+) {
+    internal companion object {
+        // Order matches serverStats in jni.c
+        fun fromArray(v: FloatArray) = WhisperServerStats(
+            jobs = v[0].toInt(),
+            failed = v[1].toInt(),
+            rejected = v[2].toInt(),
+            active = v[3].toInt(),
+            waiting = v[4].toInt(),
+            segments = v[5].toInt(),
+            audioSeconds = v[6],
+            waitMs = v[7],
+            maxWaitMs = v[8],
+            busyMs = v[9],
+        )
+    }
+}
+
+/**
+ * Local transcription server: other apps and test rigs send 16 kHz mono s16le
+ * PCM to `POST /transcribe?lang=en` over a Unix socket or loopback HTTP and get
+ * one JSON line per segment back as it is decoded, without loading a model of
+ * their own. Each of [workers] loads the model once and decodes one job at a
+ * time; further clients queue in arrival order.
+ *
+ * [socketName] starting with '@' is an abstract socket, reachable from other
+ * apps without file permissions; null disables it. Socket clients are checked
+ * by uid: this app and [allowedUids] are served, other apps get 403 unless
+ * [allowAnyApp] is set. [port] > 0 also listens on 127.0.0.1, which needs the
+ * INTERNET permission and serves any app on the device, as TCP carries no uid.
+ */
+class WhisperServer private constructor(private var ptr: Long) {
+    val stats: WhisperServerStats
+        @Synchronized get() {
+            require(ptr != 0L)
+            return WhisperServerStats.fromArray(WhisperLib.serverStats(ptr))
+        }
+
+    /** Closes the listeners and waits for the clients; running jobs end after their chunk. */
+    @Synchronized
+    fun stop() {
+        if (ptr != 0L) {
+            WhisperLib.stopServer(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        stop()
+    }
+
+    companion object {
+        fun start(
+            modelPath: String,
+            socketName: String? = "@whisper",
+            port: Int = 0,
+            workers: Int = 1,
+            allowedUids: IntArray = IntArray(0),
+            allowAnyApp: Boolean = false
+        ): WhisperServer {
+            val ptr = WhisperLib.startServer(
+                modelPath, socketName, allowedUids, allowAnyApp, port, workers, WhisperCpuConfig.preferredThreadCount
+            )
+            if (ptr == 0L) {
+                throw java.lang.RuntimeException("Couldn't start the server with $modelPath")
+            }
+            return WhisperServer(ptr)
+        }
+    }
+}
+
+/**
+ * Decoded model weights in a sealed, read-only shared memory region, so that
+ * several processes (the app and a `:transcriber` service, say) hold one copy
+ * of them. One process creates the region and hands the descriptor to the
+ * others, e.g. as a Binder parcel or an Intent extra; every process, the
+ * creating one included, then calls [WhisperContext.createContextFromSharedModel],
+ * which maps the weights rather than reading the model again.
+ */
+object WhisperSharedModel {
+    fun create(modelPath: String): ParcelFileDescriptor {
+        val fd = WhisperLib.createSharedModel(modelPath)
+        if (fd < 0) {
+            throw java.lang.RuntimeException("Couldn't share the model at $modelPath")
+        }
+        return ParcelFileDescriptor.adoptFd(fd)
+    }
+
+    fun createFromAsset(assetManager: AssetManager, assetPath: String): ParcelFileDescriptor {
+        val fd = WhisperLib.createSharedModelFromAsset(assetManager, assetPath)
+        if (fd < 0) {
+            throw java.lang.RuntimeException("Couldn't share the model from asset $assetPath")
+        }
+        return ParcelFileDescriptor.adoptFd(fd)
+    }
+}
+
+/**
+ * A GBNF grammar compiled once for [WhisperContext.transcribeCommand] and
+ * reused by every call until [release].
+ */
+class WhisperGrammar(gbnf: String, startRule: String = "root") {
+    private var ptr: Long = WhisperLib.compileGrammar(gbnf, startRule)
+
+    init {
+        if (ptr == 0L) {
+            throw java.lang.IllegalArgumentException("Couldn't compile grammar")
+        }
+    }
+
+    internal val pointer: Long
+        get() {
+            require(ptr != 0L)
+            return ptr
+        }
+
+    @Synchronized
+    fun release() {
+        if (ptr != 0L) {
+            WhisperLib.freeGrammar(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        release()
+    }
+
+    companion object {
+        /** Grammar matching exactly one of [commands], with or without a leading space. */
+        fun ofCommands(commands: List<String>): WhisperGrammar {
+            require(commands.isNotEmpty())
+            val alternatives = commands.joinToString(" | ") { command ->
+                "\"" + command.replace("\\", "\\\\").replace("\"", "\\\"") + "\""
+            }
+            return WhisperGrammar("root ::= \" \"? ($alternatives)\n")
+        }
+    }
+}
+
+/**
+ * Native clean-up stage for raw microphone audio: high-pass filter, spectral
+ * noise gate and AGC. Reduces temperature fallbacks on noisy or quiet input.
+ */
+class WhisperPreprocessor(highPass: Boolean = true, noiseSuppression: Boolean = true, agc: Boolean = true) {
+    private var ptr: Long = WhisperLib.initPreprocessor(highPass, noiseSuppression, agc)
+
+    init {
+        if (ptr == 0L) {
+            throw java.lang.RuntimeException("Couldn't create preprocessor")
+        }
+    }
+
+    /** Output delay of [process] in samples. */
+    val latency: Int
+        @Synchronized get() {
+            require(ptr != 0L)
+            return WhisperLib.preprocessorLatency(ptr)
+        }
+
+    /** Streaming, in place: the output lags the input by [latency] samples. */
+    @Synchronized
+    fun process(data: FloatArray, offset: Int = 0, length: Int = data.size - offset) {
+        require(ptr != 0L)
+        WhisperLib.preprocessorProcess(ptr, data, offset, length)
+    }
+
+    /** Whole clip, in place, with the latency compensated. */
+    @Synchronized
+    fun processClip(data: FloatArray) {
+        require(ptr != 0L)
+        WhisperLib.preprocessorClip(ptr, data)
+    }
+
+    @Synchronized
+    fun reset() {
+        require(ptr != 0L)
+        WhisperLib.preprocessorReset(ptr)
+    }
+
+    @Synchronized
+    fun release() {
+        if (ptr != 0L) {
+            WhisperLib.freePreprocessor(ptr)
+            ptr = 0
+        }
+    }
+
+    protected fun finalize() {
+        release()
+    }
+}
+
 private class WhisperLib {
     companion object {
         init {
             Log.d(LOG_TAG, "Primary ABI: ${Build.SUPPORTED_ABIS[0]}")
             var loadVfpv4 = false
             var loadV8fp16 = false
+            var loadV8dotprod = false
+            var loadV8i8mm = false
             if (isArmEabiV7a()) {
                 // armeabi-v7a needs runtime detection support
                 val cpuInfo = cpuInfo()
@@ -107,6 +1225,15 @@ private class WhisperLib {
                     if (cpuInfo.contains("fphp")) {
                         Log.d(LOG_TAG, "CPU supports fp16 arithmetic")
                         loadV8fp16 = true
+                        // int8 dot products for the q8_0 matmuls (ARMv8.2 dotprod, ARMv8.6 i8mm)
+                        if (cpuInfo.contains("asimddp")) {
+                            Log.d(LOG_TAG, "CPU supports int8 dot product")
+                            loadV8dotprod = true
+                            if (cpuInfo.contains("i8mm")) {
+                                Log.d(LOG_TAG, "CPU supports int8 matrix multiply")
+                                loadV8i8mm = true
+                            }
+                        }
                     }
                 }
             }
@@ -114,6 +1241,12 @@ private class WhisperLib {
             if (loadVfpv4) {
                 Log.d(LOG_TAG, "Loading libwhisper_vfpv4.so")
                 System.loadLibrary("whisper_vfpv4")
+            } else if (loadV8i8mm) {
+                Log.d(LOG_TAG, "Loading libwhisper_v8i8mm.so")
+                System.loadLibrary("whisper_v8i8mm")
+            } else if (loadV8dotprod) {
+                Log.d(LOG_TAG, "Loading libwhisper_v8dotprod.so")
+                System.loadLibrary("whisper_v8dotprod")
             } else if (loadV8fp16) {
                 Log.d(LOG_TAG, "Loading libwhisper_v8fp16_va.so")
                 System.loadLibrary("whisper_v8fp16_va")
@@ -127,15 +1260,72 @@ private class WhisperLib {
         @JvmStatic external fun initContextFromInputStream(inputStream: InputStream): Long
         @JvmStatic external fun initContextFromAsset(assetManager: AssetManager, assetPath: String): Long
         @JvmStatic external fun initContext(modelPath: String): Long
+        @JvmStatic external fun createSharedModel(modelPath: String): Int
+        @JvmStatic external fun createSharedModelFromAsset(assetManager: AssetManager, assetPath: String): Int
+        @JvmStatic external fun initContextFromSharedModel(fd: Int): Long
         @JvmStatic external fun freeContext(contextPtr: Long)
         @JvmStatic external fun fullTranscribe(contextPtr: Long, lang: String, numThreads: Int, translate: Boolean, audioData: FloatArray)
+        @JvmStatic external fun fullTranscribeFast(contextPtr: Long, langId: Int, numThreads: Int, translate: Boolean, audioData: FloatArray, length: Int)
+        @JvmStatic external fun fullTranscribeFile(contextPtr: Long, path: String, langId: Int, numThreads: Int, translate: Boolean, chunkSeconds: Int, listener: NativeSegmentListener): FloatArray?
+        @JvmStatic external fun getLanguages(): Array<String>
+        @JvmStatic external fun getLanguageNames(): Array<String>
+        @JvmStatic external fun initMelStream(contextPtr: Long): Long
+        @JvmStatic external fun freeMelStream(streamPtr: Long)
+        @JvmStatic external fun melStreamReset(streamPtr: Long)
+        @JvmStatic external fun melStreamAccept(streamPtr: Long, audioData: FloatArray, offset: Int, length: Int): Int
+        @JvmStatic external fun melStreamWindow(streamPtr: Long): Long
+        @JvmStatic external fun freeMel(melPtr: Long)
+        @JvmStatic external fun fullTranscribeMel(contextPtr: Long, melPtr: Long, langId: Int, numThreads: Int, translate: Boolean)
+        @JvmStatic external fun initPreprocessor(highPass: Boolean, denoise: Boolean, agc: Boolean): Long
+        @JvmStatic external fun freePreprocessor(preprocessorPtr: Long)
+        @JvmStatic external fun preprocessorReset(preprocessorPtr: Long)
+        @JvmStatic external fun preprocessorLatency(preprocessorPtr: Long): Int
+        @JvmStatic external fun preprocessorProcess(preprocessorPtr: Long, audioData: FloatArray, offset: Int, length: Int)
+        @JvmStatic external fun preprocessorClip(preprocessorPtr: Long, audioData: FloatArray)
         @JvmStatic external fun getTextSegmentCount(contextPtr: Long): Int
         @JvmStatic external fun getTextSegment(contextPtr: Long, index: Int): String
+        @JvmStatic external fun getText(contextPtr: Long): String
         @JvmStatic external fun getTextSegmentT0(contextPtr: Long, index: Int): Long
         @JvmStatic external fun getTextSegmentT1(contextPtr: Long, index: Int): Long
+        @JvmStatic external fun getTextSegmentFallbacks(contextPtr: Long, index: Int): Int
+        @JvmStatic external fun getTextSegmentFallbackMs(contextPtr: Long, index: Int): Float
+        @JvmStatic external fun getTextSegmentNoSpeechProb(contextPtr: Long, index: Int): Float
+        @JvmStatic external fun getTextSegmentSpeaker(contextPtr: Long, index: Int): Int
+        @JvmStatic external fun getTranscriptionStats(contextPtr: Long): FloatArray
+        @JvmStatic external fun setFallbackPolicy(contextPtr: Long, maxFallbacksPerWindow: Int, budgetPerMinute: Float, minSpeechRatio: Float, fallbackSpeechRatio: Float, skipSilence: Boolean, fitShortClips: Boolean, pipelinedEncode: Boolean)
+        @JvmStatic external fun setHallucinationFilter(contextPtr: Long, enabled: Boolean)
+        @JvmStatic external fun setDiarization(contextPtr: Long, enabled: Boolean)
+        @JvmStatic external fun setThermalGovernor(contextPtr: Long, enabled: Boolean)
+        @JvmStatic external fun getThermalReport(contextPtr: Long): FloatArray?
+        @JvmStatic external fun setPerfCounters(contextPtr: Long, enabled: Boolean): Boolean
+        @JvmStatic external fun getPerfCounters(contextPtr: Long): FloatArray?
+        @JvmStatic external fun getPowerSource(): Int
+        @JvmStatic external fun getCpuClusters(): LongArray
+        @JvmStatic external fun setThreadAffinity(mask: Long): Boolean
+        @JvmStatic external fun measureEnergy(contextPtr: Long, langId: Int, numThreads: Int, cpuMask: Long, audioData: FloatArray, length: Int): FloatArray?
+        @JvmStatic external fun setBiasPhrases(contextPtr: Long, phrases: Array<String>, boost: Float): Int
+        @JvmStatic external fun compileGrammar(grammar: String, startRule: String): Long
+        @JvmStatic external fun freeGrammar(grammarPtr: Long)
+        @JvmStatic external fun fullTranscribeGrammar(contextPtr: Long, grammarPtr: Long, penalty: Float, langId: Int, numThreads: Int, audioData: FloatArray)
+        @JvmStatic external fun initKeywordSpotter(contextPtr: Long, lang: String, numThreads: Int, windowMs: Int, hopMs: Int, dutyCycle: Float, threshold: Float): Long
+        @JvmStatic external fun freeKeywordSpotter(spotterPtr: Long)
+        @JvmStatic external fun keywordSpotterAdd(spotterPtr: Long, keyword: String): Int
+        @JvmStatic external fun keywordSpotterReset(spotterPtr: Long)
+        @JvmStatic external fun keywordSpotterAccept(spotterPtr: Long, audioData: FloatArray, offset: Int, length: Int): FloatArray?
+        @JvmStatic external fun keywordSpotterStats(spotterPtr: Long): FloatArray
+        @JvmStatic external fun initBatchDecoder(contextPtr: Long, lang: String, numThreads: Int, sequences: Int): Long
+        @JvmStatic external fun freeBatchDecoder(batchPtr: Long)
+        @JvmStatic external fun batchDecoderTranscribe(batchPtr: Long, clips: Array<FloatArray>): Array<String>?
+        @JvmStatic external fun batchDecoderStats(batchPtr: Long): FloatArray
         @JvmStatic external fun getSystemInfo(): String
         @JvmStatic external fun benchMemcpy(nthread: Int): String
         @JvmStatic external fun benchGgmlMulMat(nthread: Int): String
+        @JvmStatic external fun benchJniElements(contextPtr: Long, lang: String, audioData: FloatArray): Float
+        @JvmStatic external fun benchJniCritical(contextPtr: Long, langId: Int, audioData: FloatArray, length: Int): Float
+        @JvmStatic external fun benchDecodeFile(path: String): String
+        @JvmStatic external fun startServer(modelPath: String, socketPath: String?, allowedUids: IntArray?, anyUid: Boolean, port: Int, workers: Int, numThreads: Int): Long
+        @JvmStatic external fun stopServer(serverPtr: Long)
+        @JvmStatic external fun serverStats(serverPtr: Long): FloatArray
     }
 }
 
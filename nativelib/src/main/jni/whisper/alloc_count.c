@@ -0,0 +1,88 @@
+#include "alloc_count.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef WHISPER_COUNT_ALLOCS
+
+static uint64_t g_allocs;
+static uint64_t g_frees;
+static uint64_t g_bytes;
+
+static inline void count_alloc(size_t size) {
+    __atomic_fetch_add(&g_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_bytes, size, __ATOMIC_RELAXED);
+}
+
+// resolved by the linker to the C library's functions
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void * p, size_t size);
+void   __real_free(void * p);
+int    __real_posix_memalign(void ** p, size_t align, size_t size);
+
+void * __wrap_malloc(size_t size) {
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t n, size_t size) {
+    count_alloc(n*size);
+    return __real_calloc(n, size);
+}
+
+void * __wrap_realloc(void * p, size_t size) {
+    count_alloc(size);
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void * p) {
+    if (p) {
+        __atomic_fetch_add(&g_frees, 1, __ATOMIC_RELAXED);
+    }
+    __real_free(p);
+}
+
+int __wrap_posix_memalign(void ** p, size_t align, size_t size) {
+    count_alloc(size);
+    return __real_posix_memalign(p, align, size);
+}
+
+#ifdef WHISPER_COUNT_ALLOCS_NEW
+// host builds link a shared libstdc++, whose operator new calls malloc out of
+// reach of --wrap; the 64-bit Itanium ABI names are wrapped instead
+void * __real__Znwm(size_t size);
+void * __real__Znam(size_t size);
+
+void * __wrap__Znwm(size_t size) {
+    count_alloc(size);
+    return __real__Znwm(size);
+}
+
+void * __wrap__Znam(size_t size) {
+    count_alloc(size);
+    return __real__Znam(size);
+}
+#endif
+
+bool alloc_count_enabled(void) {
+    return true;
+}
+
+void alloc_count_get(struct alloc_counts * out) {
+    out->n_allocs = __atomic_load_n(&g_allocs, __ATOMIC_RELAXED);
+    out->n_frees = __atomic_load_n(&g_frees, __ATOMIC_RELAXED);
+    out->n_bytes = __atomic_load_n(&g_bytes, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool alloc_count_enabled(void) {
+    return false;
+}
+
+void alloc_count_get(struct alloc_counts * out) {
+    memset(out, 0, sizeof(*out));
+}
+
+#endif
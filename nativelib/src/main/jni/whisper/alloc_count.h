@@ -0,0 +1,32 @@
+#ifndef WHISPER_JNI_ALLOC_COUNT_H
+#define WHISPER_JNI_ALLOC_COUNT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Process-wide heap allocation counters. With WHISPER_COUNT_ALLOCS the library
+// is linked with -Wl,--wrap for the malloc family, so every allocation made by
+// code inside it (whisper, ggml, this bridge; operator new too on Android,
+// where libc++ is linked statically) goes through a counter. Allocations made
+// inside libc itself (strdup, stdio, pthread_create) are not seen.
+struct alloc_counts {
+    uint64_t n_allocs;  // malloc, calloc, realloc, posix_memalign
+    uint64_t n_frees;
+    uint64_t n_bytes;   // requested
+};
+
+// false when the library was built without the counters
+bool alloc_count_enabled(void);
+
+// all zero when disabled
+void alloc_count_get(struct alloc_counts * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_ALLOC_COUNT_H
@@ -0,0 +1,115 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+
+struct arena_block {
+    struct arena_block * next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+struct arena {
+    struct arena_block * head;  // block being filled, older ones follow
+    size_t block_size;
+    size_t used;
+    size_t capacity;
+};
+
+static struct arena_block * arena_block_new(size_t size) {
+    struct arena_block * block = malloc(sizeof(struct arena_block) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+struct arena * arena_init(size_t block_size) {
+    struct arena * a = calloc(1, sizeof(struct arena));
+    if (!a) {
+        return NULL;
+    }
+    a->block_size = block_size > 0 ? block_size : 4096;
+    a->head = arena_block_new(a->block_size);
+    if (!a->head) {
+        free(a);
+        return NULL;
+    }
+    a->capacity = a->block_size;
+    return a;
+}
+
+static void arena_release_blocks(struct arena * a) {
+    while (a->head) {
+        struct arena_block * next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+    a->capacity = 0;
+}
+
+void arena_free(struct arena * a) {
+    if (!a) {
+        return;
+    }
+    arena_release_blocks(a);
+    free(a);
+}
+
+void * arena_alloc(struct arena * a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    struct arena_block * block = a->head;
+    if (!block || block->size - block->used < size) {
+        size_t grow = block ? 2*block->size : a->block_size;
+        grow = grow > size ? grow : size;
+        block = arena_block_new(grow);
+        if (!block) {
+            return NULL;
+        }
+        block->next = a->head;
+        a->head = block;
+        a->capacity += grow;
+    }
+    void * p = block->data + block->used;
+    block->used += size;
+    a->used += size;
+    return p;
+}
+
+char * arena_strdup(struct arena * a, const char * s) {
+    const size_t len = strlen(s);
+    char * p = arena_alloc(a, len + 1);
+    if (p) {
+        memcpy(p, s, len + 1);
+    }
+    return p;
+}
+
+void arena_reset(struct arena * a) {
+    if (a->head && a->head->next) {
+        // the last call outgrew the first block: hold all of it in one block
+        const size_t size = a->capacity;
+        arena_release_blocks(a);
+        a->head = arena_block_new(size);
+        a->capacity = a->head ? size : 0;
+    }
+    if (a->head) {
+        a->head->used = 0;
+    }
+    a->used = 0;
+}
+
+size_t arena_used(const struct arena * a) {
+    return a->used;
+}
+
+size_t arena_capacity(const struct arena * a) {
+    return a->capacity;
+}
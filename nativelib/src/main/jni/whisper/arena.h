@@ -0,0 +1,34 @@
+#ifndef WHISPER_JNI_ARENA_H
+#define WHISPER_JNI_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bump allocator for data that lives exactly as long as one call (segment
+// text, strings handed to the JVM). Allocations are never freed one by one;
+// arena_reset drops them all. A reset also merges the blocks an unusually
+// large call needed into one, so once the arena has seen the largest call it
+// serves every later one without touching the heap.
+struct arena;
+
+// block_size: size of the first block, later ones grow as needed
+struct arena * arena_init(size_t block_size);
+void arena_free(struct arena * a);
+
+// 16-byte aligned, NULL when out of memory
+void * arena_alloc(struct arena * a, size_t size);
+char * arena_strdup(struct arena * a, const char * s);
+
+void arena_reset(struct arena * a);
+
+size_t arena_used(const struct arena * a);      // bytes handed out since the last reset
+size_t arena_capacity(const struct arena * a);  // bytes held
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_ARENA_H
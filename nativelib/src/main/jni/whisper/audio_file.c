@@ -0,0 +1,515 @@
+#include "audio_file.h"
+#include "resample.h"
+#include "vec.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ANDROID__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaExtractor.h>
+#endif
+
+// source frames converted per block
+#define AUDIO_FILE_BLOCK 4096
+
+// Headers outside these are rejected rather than trusted: a forged channel
+// count sizes the raw block, and an extreme rate the resampler's filter.
+#define AUDIO_FILE_MAX_CHANNELS 64
+#define AUDIO_FILE_MIN_RATE     1000
+#define AUDIO_FILE_MAX_RATE     768000
+
+#define WAVE_FORMAT_PCM        1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#ifdef __ANDROID__
+// decoder queue timeout, in microseconds
+#define AUDIO_FILE_MEDIA_TIMEOUT_US 10000
+// AudioFormat.ENCODING_PCM_FLOAT, for decoders that output floats
+#define AUDIO_FILE_PCM_FLOAT 4
+#endif
+
+struct audio_file {
+    struct audio_file_info info;
+    // decodes the next frames into mono at info.sample_rate; returns the
+    // frames, 0 at the end, -1 on error
+    int (*read_block)(struct audio_file * f);
+    bool eof;
+
+    // WAV
+    FILE * fp;
+    int format;
+    int block_align;
+    int64_t data_left;       // bytes of the data chunk not read yet, -1 = up to the end of the file
+    uint8_t * raw;           // [AUDIO_FILE_BLOCK*block_align]
+
+#ifdef __ANDROID__
+    // platform decoder
+    int fd;
+    AMediaExtractor * ex;
+    AMediaCodec * codec;
+    bool input_eos;
+    bool output_eos;
+    bool pcm_float;
+#endif
+
+    float * mono;            // [cap_mono]
+    int cap_mono;
+    struct resampler * rs;   // NULL while the source is at 16 kHz
+    int rs_rate;             // source rate rs was made for
+
+    float * pending;         // converted samples not returned yet
+    int n_pending;
+    int i_pending;
+    int cap_pending;
+};
+
+static uint32_t read_u32(const uint8_t * p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t read_u16(const uint8_t * p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static int audio_file_reserve(float ** buf, int * cap, int n) {
+    if (n <= *cap) {
+        return 0;
+    }
+    float * p = realloc(*buf, sizeof(float) * n);
+    if (!p) {
+        return -1;
+    }
+    *buf = p;
+    *cap = n;
+    return 0;
+}
+
+// Interleaved native-endian 16-bit frames to mono, channels averaged. Mono and
+// stereo, nearly all files, take the vectorized paths.
+static void audio_file_mix_s16(float * out, const int16_t * in, int n_frames, int channels) {
+    if (channels == 1) {
+        vec_s16_to_f32(n_frames, out, in, 1.0f/32768.0f);
+    } else if (channels == 2) {
+        vec_s16x2_sum_f32(n_frames, out, in, 1.0f/65536.0f);
+    } else {
+        const float scale = 1.0f/(32768.0f*channels);
+        for (int i = 0; i < n_frames; i++, in += channels) {
+            int32_t sum = 0;
+            for (int c = 0; c < channels; c++) {
+                sum += in[c];
+            }
+            out[i] = sum*scale;
+        }
+    }
+}
+
+// Skips n bytes; fseek takes a long, which is 32 bits on 32-bit targets.
+static int audio_file_skip(FILE * fp, uint64_t n) {
+    while (n > 0) {
+        const long step = n < LONG_MAX ? (long) n : LONG_MAX;
+        if (fseek(fp, step, SEEK_CUR) != 0) {
+            return -1;
+        }
+        n -= (uint64_t) step;
+    }
+    return 0;
+}
+
+// Walks the RIFF chunks up to "data"; fmt must come first.
+static int audio_file_parse_wav(struct audio_file * f) {
+    uint8_t hdr[12];
+    if (fread(hdr, 1, 12, f->fp) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        return -1;
+    }
+    bool have_fmt = false;
+    uint8_t ch[8];
+    while (fread(ch, 1, 8, f->fp) == 8) {
+        const uint32_t size = read_u32(ch + 4);
+        if (memcmp(ch, "fmt ", 4) == 0) {
+            uint8_t fmt[40] = {0};
+            const size_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, n, f->fp) != n || audio_file_skip(f->fp, (uint64_t) size - n + (size & 1)) != 0) {
+                return -1;
+            }
+            f->format = read_u16(fmt);
+            f->info.channels = read_u16(fmt + 2);
+            f->info.sample_rate = (int) read_u32(fmt + 4);
+            f->block_align = read_u16(fmt + 12);
+            f->info.bits = read_u16(fmt + 14);
+            if (f->format == WAVE_FORMAT_EXTENSIBLE && size >= 26) {
+                // the sub-format GUID starts with the plain format code
+                f->format = read_u16(fmt + 24);
+            }
+            have_fmt = true;
+        } else if (memcmp(ch, "data", 4) == 0) {
+            if (!have_fmt) {
+                return -1;
+            }
+            // streaming writers leave the size at 0 or all ones
+            f->data_left = size == 0 || size == 0xFFFFFFFFu ? -1 : (int64_t) size;
+            return 0;
+        } else if (audio_file_skip(f->fp, (uint64_t) size + (size & 1)) != 0) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// Converts frames of raw to mono floats, channels averaged.
+static void audio_file_convert(const struct audio_file * f, int n_frames) {
+    if (f->info.bits == 16) {
+        // RIFF is little-endian, like every target
+        audio_file_mix_s16(f->mono, (const int16_t *) f->raw, n_frames, f->info.channels);
+        return;
+    }
+    const int channels = f->info.channels;
+    const int bytes = f->info.bits/8;
+    const float scale = 1.0f/channels;
+    for (int i = 0; i < n_frames; i++) {
+        const uint8_t * p = f->raw + (size_t) i*f->block_align;
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++, p += bytes) {
+            switch (f->info.bits) {
+                case 8:  sum += (p[0] - 128)/128.0f; break;
+                case 24: sum += (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24)/2147483648.0f; break;
+                default:
+                    if (f->format == WAVE_FORMAT_IEEE_FLOAT) {
+                        const uint32_t u = read_u32(p);
+                        float v;
+                        memcpy(&v, &u, sizeof(v));
+                        // NaN and Inf would poison the resampler and the mel
+                        sum += isfinite(v) ? fminf(fmaxf(v, -1.0f), 1.0f) : 0.0f;
+                    } else {
+                        sum += (int32_t) read_u32(p)/2147483648.0f;
+                    }
+                    break;
+            }
+        }
+        f->mono[i] = sum*scale;
+    }
+}
+
+static int audio_file_read_wav(struct audio_file * f) {
+    int64_t n_frames = AUDIO_FILE_BLOCK;
+    if (f->data_left >= 0 && n_frames > f->data_left/f->block_align) {
+        n_frames = f->data_left/f->block_align;
+    }
+    const int n_read = (int) fread(f->raw, f->block_align, (size_t) n_frames, f->fp);
+    if (n_read < n_frames && ferror(f->fp)) {
+        return -1;
+    }
+    if (f->data_left >= 0) {
+        f->data_left -= (int64_t) n_read*f->block_align;
+    }
+    audio_file_convert(f, n_read);
+    return n_read;
+}
+
+static int audio_file_open_wav(struct audio_file * f, const char * path) {
+    f->fp = fopen(path, "rb");
+    if (!f->fp || audio_file_parse_wav(f) != 0) {
+        return -1;
+    }
+
+    const int bits = f->info.bits;
+    const bool pcm = f->format == WAVE_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    const bool flt = f->format == WAVE_FORMAT_IEEE_FLOAT && bits == 32;
+    if ((!pcm && !flt) || f->info.channels < 1 || f->info.channels > AUDIO_FILE_MAX_CHANNELS ||
+            f->info.sample_rate < AUDIO_FILE_MIN_RATE || f->info.sample_rate > AUDIO_FILE_MAX_RATE ||
+            f->block_align != f->info.channels*bits/8) {
+        return -1;
+    }
+
+    f->info.n_frames = f->data_left >= 0 ? f->data_left/f->block_align : -1;
+    f->info.duration_s = f->info.n_frames >= 0 ? (float) f->info.n_frames/f->info.sample_rate : -1.0f;
+    snprintf(f->info.codec, sizeof(f->info.codec), "%s", flt ? "float" : "pcm");
+
+    f->raw = malloc((size_t) AUDIO_FILE_BLOCK*f->block_align);
+    if (!f->raw || audio_file_reserve(&f->mono, &f->cap_mono, AUDIO_FILE_BLOCK) != 0) {
+        return -1;
+    }
+    f->read_block = audio_file_read_wav;
+    return 0;
+}
+
+#ifdef __ANDROID__
+static void audio_file_media_format(struct audio_file * f, AMediaFormat * fmt) {
+    int32_t v;
+    if (AMediaFormat_getInt32(fmt, AMEDIAFORMAT_KEY_SAMPLE_RATE, &v) && v >= AUDIO_FILE_MIN_RATE && v <= AUDIO_FILE_MAX_RATE) {
+        f->info.sample_rate = v;
+    }
+    if (AMediaFormat_getInt32(fmt, AMEDIAFORMAT_KEY_CHANNEL_COUNT, &v) && v > 0 && v <= AUDIO_FILE_MAX_CHANNELS) {
+        f->info.channels = v;
+    }
+    // the key is only reported by decoders that can output floats
+    f->pcm_float = AMediaFormat_getInt32(fmt, "pcm-encoding", &v) && v == AUDIO_FILE_PCM_FLOAT;
+    f->info.bits = f->pcm_float ? 32 : 16;
+}
+
+// Feeds compressed samples to the decoder until it hands out PCM: decoded
+// frames go to mono straight from the codec's output buffer.
+static int audio_file_read_media(struct audio_file * f) {
+    while (!f->output_eos) {
+        if (!f->input_eos) {
+            const ssize_t in = AMediaCodec_dequeueInputBuffer(f->codec, AUDIO_FILE_MEDIA_TIMEOUT_US);
+            if (in >= 0) {
+                size_t cap;
+                uint8_t * buf = AMediaCodec_getInputBuffer(f->codec, (size_t) in, &cap);
+                const ssize_t n = buf ? AMediaExtractor_readSampleData(f->ex, buf, cap) : -1;
+                if (n < 0) {
+                    AMediaCodec_queueInputBuffer(f->codec, (size_t) in, 0, 0, 0, AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+                    f->input_eos = true;
+                } else {
+                    AMediaCodec_queueInputBuffer(f->codec, (size_t) in, 0, (size_t) n, (uint64_t) AMediaExtractor_getSampleTime(f->ex), 0);
+                    AMediaExtractor_advance(f->ex);
+                }
+            }
+        }
+
+        AMediaCodecBufferInfo bi;
+        const ssize_t out = AMediaCodec_dequeueOutputBuffer(f->codec, &bi, AUDIO_FILE_MEDIA_TIMEOUT_US);
+        if (out >= 0) {
+            int n_frames = 0;
+            if (bi.size > 0) {
+                size_t cap;
+                const uint8_t * buf = AMediaCodec_getOutputBuffer(f->codec, (size_t) out, &cap);
+                const int channels = f->info.channels;
+                n_frames = bi.size/((f->pcm_float ? 4 : 2)*channels);
+                if (!buf || audio_file_reserve(&f->mono, &f->cap_mono, n_frames) != 0) {
+                    AMediaCodec_releaseOutputBuffer(f->codec, (size_t) out, false);
+                    return -1;
+                }
+                if (f->pcm_float) {
+                    const float * in = (const float *) (buf + bi.offset);
+                    for (int i = 0; i < n_frames; i++, in += channels) {
+                        float sum = 0.0f;
+                        for (int c = 0; c < channels; c++) {
+                            sum += in[c];
+                        }
+                        f->mono[i] = sum/channels;
+                    }
+                } else {
+                    audio_file_mix_s16(f->mono, (const int16_t *) (buf + bi.offset), n_frames, channels);
+                }
+            }
+            AMediaCodec_releaseOutputBuffer(f->codec, (size_t) out, false);
+            f->output_eos = (bi.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) != 0;
+            if (n_frames > 0) {
+                return n_frames;
+            }
+        } else if (out == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            // HE-AAC and friends report the real output rate only here
+            AMediaFormat * fmt = AMediaCodec_getOutputFormat(f->codec);
+            if (fmt) {
+                audio_file_media_format(f, fmt);
+                AMediaFormat_delete(fmt);
+            }
+        } else if (out != AMEDIACODEC_INFO_TRY_AGAIN_LATER && out != AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Decodes the first audio track with the platform codec.
+static int audio_file_open_media(struct audio_file * f, const char * path) {
+    struct stat st;
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0 || fstat(f->fd, &st) != 0) {
+        return -1;
+    }
+    f->ex = AMediaExtractor_new();
+    if (!f->ex || AMediaExtractor_setDataSourceFd(f->ex, f->fd, 0, st.st_size) != AMEDIA_OK) {
+        return -1;
+    }
+
+    const size_t n_tracks = AMediaExtractor_getTrackCount(f->ex);
+    for (size_t i = 0; i < n_tracks && !f->codec; i++) {
+        AMediaFormat * fmt = AMediaExtractor_getTrackFormat(f->ex, i);
+        const char * mime = NULL;
+        if (fmt && AMediaFormat_getString(fmt, AMEDIAFORMAT_KEY_MIME, &mime) && strncmp(mime, "audio/", 6) == 0) {
+            f->codec = AMediaCodec_createDecoderByType(mime);
+            if (f->codec && AMediaCodec_configure(f->codec, fmt, NULL, NULL, 0) == AMEDIA_OK &&
+                    AMediaCodec_start(f->codec) == AMEDIA_OK && AMediaExtractor_selectTrack(f->ex, i) == AMEDIA_OK) {
+                snprintf(f->info.codec, sizeof(f->info.codec), "%s", mime + 6);
+                audio_file_media_format(f, fmt);
+                int64_t us;
+                if (AMediaFormat_getInt64(fmt, AMEDIAFORMAT_KEY_DURATION, &us) && us > 0 && f->info.sample_rate > 0) {
+                    f->info.duration_s = us/1e6f;
+                    f->info.n_frames = us*f->info.sample_rate/1000000;
+                } else {
+                    f->info.duration_s = -1.0f;
+                    f->info.n_frames = -1;
+                }
+            } else if (f->codec) {
+                AMediaCodec_delete(f->codec);
+                f->codec = NULL;
+            }
+        }
+        if (fmt) {
+            AMediaFormat_delete(fmt);
+        }
+    }
+    if (!f->codec || f->info.sample_rate < AUDIO_FILE_MIN_RATE || f->info.sample_rate > AUDIO_FILE_MAX_RATE ||
+            f->info.channels < 1 || f->info.channels > AUDIO_FILE_MAX_CHANNELS) {
+        return -1;
+    }
+    f->read_block = audio_file_read_media;
+    return 0;
+}
+#endif
+
+// Releases whatever source was opened, keeping the conversion buffers.
+static void audio_file_close_source(struct audio_file * f) {
+    if (f->fp) {
+        fclose(f->fp);
+        f->fp = NULL;
+    }
+    free(f->raw);
+    f->raw = NULL;
+#ifdef __ANDROID__
+    if (f->codec) {
+        AMediaCodec_stop(f->codec);
+        AMediaCodec_delete(f->codec);
+        f->codec = NULL;
+    }
+    if (f->ex) {
+        AMediaExtractor_delete(f->ex);
+        f->ex = NULL;
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+        f->fd = -1;
+    }
+#endif
+}
+
+struct audio_file * audio_file_open(const char * path) {
+    struct audio_file * f = calloc(1, sizeof(struct audio_file));
+    if (!f) {
+        return NULL;
+    }
+    f->rs_rate = AUDIO_FILE_RATE;
+#ifdef __ANDROID__
+    f->fd = -1;
+#endif
+    if (audio_file_open_wav(f, path) == 0) {
+        return f;
+    }
+    audio_file_close_source(f);
+#ifdef __ANDROID__
+    memset(&f->info, 0, sizeof(f->info));
+    if (audio_file_open_media(f, path) == 0) {
+        return f;
+    }
+#endif
+    audio_file_close(f);
+    return NULL;
+}
+
+void audio_file_close(struct audio_file * f) {
+    if (!f) {
+        return;
+    }
+    audio_file_close_source(f);
+    free(f->mono);
+    free(f->pending);
+    resampler_free(f->rs);
+    free(f);
+}
+
+const struct audio_file_info * audio_file_get_info(const struct audio_file * f) {
+    return &f->info;
+}
+
+// Converts the next block into pending. Returns the samples it holds, 0 at
+// the end, -1 on error.
+static int audio_file_refill(struct audio_file * f) {
+    f->n_pending = 0;
+    f->i_pending = 0;
+    if (f->eof) {
+        return 0;
+    }
+
+    const int n_read = f->read_block(f);
+    if (n_read < 0) {
+        return -1;
+    }
+
+    // the resampler follows the source rate, which a decoder may only report
+    // with its first output; the old one's tail goes out first
+    if (n_read > 0 && f->info.sample_rate != f->rs_rate) {
+        if (f->rs) {
+            if (audio_file_reserve(&f->pending, &f->cap_pending, resampler_max_output(f->rs, 0)) != 0) {
+                return -1;
+            }
+            f->n_pending = resampler_flush(f->rs, f->pending, f->cap_pending);
+            resampler_free(f->rs);
+            f->rs = NULL;
+        }
+        if (f->info.sample_rate != AUDIO_FILE_RATE) {
+            f->rs = resampler_init(f->info.sample_rate, AUDIO_FILE_RATE);
+            if (!f->rs) {
+                return -1;
+            }
+        }
+        f->rs_rate = f->info.sample_rate;
+        if (f->n_pending < 0) {
+            return -1;
+        }
+    }
+
+    const int need = f->n_pending + (f->rs ? resampler_max_output(f->rs, n_read) : n_read);
+    if (audio_file_reserve(&f->pending, &f->cap_pending, need) != 0) {
+        return -1;
+    }
+
+    if (n_read == 0) {
+        f->eof = true;
+        f->n_pending = f->rs ? resampler_flush(f->rs, f->pending, f->cap_pending) : 0;
+        return f->n_pending;
+    }
+
+    if (f->rs) {
+        const int n = resampler_process(f->rs, f->mono, n_read, f->pending + f->n_pending, f->cap_pending - f->n_pending);
+        if (n < 0) {
+            return -1;
+        }
+        f->n_pending += n;
+    } else {
+        memcpy(f->pending + f->n_pending, f->mono, sizeof(float) * n_read);
+        f->n_pending += n_read;
+    }
+    return f->n_pending;
+}
+
+int audio_file_read(struct audio_file * f, float * out, int n) {
+    int n_out = 0;
+    while (n_out < n) {
+        if (f->i_pending == f->n_pending) {
+            const int rc = audio_file_refill(f);
+            if (rc < 0) {
+                return -1;
+            }
+            // the resampler may hold a whole block back
+            if (rc == 0 && f->eof) {
+                break;
+            }
+            continue;
+        }
+        const int k = f->n_pending - f->i_pending < n - n_out ? f->n_pending - f->i_pending : n - n_out;
+        memcpy(out + n_out, f->pending + f->i_pending, sizeof(float) * k);
+        f->i_pending += k;
+        n_out += k;
+    }
+    return n_out;
+}
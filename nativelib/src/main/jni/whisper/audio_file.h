@@ -0,0 +1,45 @@
+#ifndef WHISPER_JNI_AUDIO_FILE_H
+#define WHISPER_JNI_AUDIO_FILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming reader of audio files as 16 kHz mono float samples: the file is
+// read, decoded, downmixed and resampled one block at a time, so memory does
+// not grow with the duration and no intermediate WAV file is written.
+// RIFF/WAVE with 8/16/24/32-bit PCM or 32-bit float samples is parsed here on
+// every platform; on Android anything else goes through the platform decoders
+// (AMediaExtractor/AMediaCodec: AAC/M4A, MP3, Opus, Vorbis, FLAC, AMR, ...).
+// Rates from 1 to 768 kHz and up to 64 channels; float samples are clipped
+// to [-1, 1], with NaN and Inf read as silence.
+#define AUDIO_FILE_RATE 16000
+
+struct audio_file_info {
+    int sample_rate;
+    int channels;
+    int bits;
+    int64_t n_frames;   // source frames, -1 when the header does not say
+    float duration_s;   // -1 when unknown
+    char codec[32];     // "pcm" or "float" for WAV, the MIME subtype otherwise
+};
+
+struct audio_file;
+
+// NULL when the file cannot be read or its format is not supported.
+struct audio_file * audio_file_open(const char * path);
+void audio_file_close(struct audio_file * f);
+
+const struct audio_file_info * audio_file_get_info(const struct audio_file * f);
+
+// Reads up to n samples at AUDIO_FILE_RATE. Returns the number read, 0 at
+// the end of the file, -1 on error.
+int audio_file_read(struct audio_file * f, float * out, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_AUDIO_FILE_H
@@ -0,0 +1,444 @@
+#include "batch.h"
+#include "arena.h"
+#include "mel.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// samples per window: whisper's 30 s
+#define BATCH_WINDOW 480000
+
+struct batch_window {
+    int request;
+    const float * samples;
+    int n_samples;
+    const char * text;
+};
+
+struct batch_request {
+    int first_window;
+    int n_windows;
+    const char * text;
+};
+
+struct batch_slot {
+    struct batch_decoder * b;
+    struct whisper_state * state;
+    struct mel_spectrogram mel;
+    pthread_t thread;
+
+    int window;              // -1 when idle
+    whisper_token * tokens;  // prompt, then the sampled tokens
+    int n_tokens;
+    int n_past;
+    int n_threads;
+    int64_t cpu_us;          // worker thread CPU time of the steps since the last read
+    bool done;
+    bool failed;
+};
+
+struct batch_decoder {
+    struct whisper_context * ctx;
+    struct batch_params params;
+    char language[16];
+
+    whisper_token prompt[4];
+    int n_prompt;
+    int n_vocab;
+    whisper_token eot;
+
+    struct batch_slot * slots;
+    int n_slots;
+
+    // workers run one step per generation
+    pthread_mutex_t lock;
+    pthread_cond_t cond_step;
+    pthread_cond_t cond_done;
+    uint64_t generation;
+    int n_pending;
+    bool quit;
+
+    struct batch_window * windows;
+    int n_windows;
+    int cap_windows;
+
+    struct batch_request * requests;
+    int n_requests;
+    int cap_requests;
+
+    struct arena * arena;
+    struct batch_stats stats;
+};
+
+struct batch_params batch_default_params(void) {
+    struct batch_params params = {
+            .language   = "en",
+            .n_seq      = 4,
+            .n_threads  = 4,
+            .max_tokens = 0,
+    };
+    return params;
+}
+
+static int64_t time_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+// One decoder call: the prompt on the first step, the last token after that.
+static void batch_slot_step(struct batch_slot * s) {
+    const struct batch_decoder * b = s->b;
+    const int n_new = s->n_tokens - s->n_past;
+    if (whisper_decode_with_state(b->ctx, s->state, s->tokens + s->n_past, n_new, s->n_past, s->n_threads) != 0) {
+        s->failed = true;
+        s->done = true;
+        return;
+    }
+    s->n_past = s->n_tokens;
+
+    // greedy over the text tokens and EOT, which whisper's vocabulary puts
+    // before all other special tokens; no empty transcript
+    const float * logits = whisper_get_logits_from_state(s->state) + (size_t) (n_new - 1)*b->n_vocab;
+    const int n_sampled = s->n_tokens - b->n_prompt;
+    const whisper_token last = n_sampled == 0 ? b->eot - 1 : b->eot;
+    whisper_token best = 0;
+    for (whisper_token t = 1; t <= last; t++) {
+        if (logits[t] > logits[best]) {
+            best = t;
+        }
+    }
+
+    if (best == b->eot) {
+        s->done = true;
+        return;
+    }
+    s->tokens[s->n_tokens++] = best;
+    s->done = n_sampled + 1 >= b->params.max_tokens;
+}
+
+static void * batch_worker(void * arg) {
+    struct batch_slot * s = arg;
+    struct batch_decoder * b = s->b;
+    uint64_t seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        while (b->generation == seen && !b->quit) {
+            pthread_cond_wait(&b->cond_step, &b->lock);
+        }
+        seen = b->generation;
+        const bool quit = b->quit;
+        pthread_mutex_unlock(&b->lock);
+        if (quit) {
+            break;
+        }
+
+        if (s->window >= 0 && !s->done) {
+            const int64_t t0_cpu_us = time_us(CLOCK_THREAD_CPUTIME_ID);
+            batch_slot_step(s);
+            s->cpu_us += time_us(CLOCK_THREAD_CPUTIME_ID) - t0_cpu_us;
+        }
+
+        pthread_mutex_lock(&b->lock);
+        if (--b->n_pending == 0) {
+            pthread_cond_signal(&b->cond_done);
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+    return NULL;
+}
+
+static void batch_stop_workers(struct batch_decoder * b, int n_started) {
+    pthread_mutex_lock(&b->lock);
+    b->quit = true;
+    pthread_cond_broadcast(&b->cond_step);
+    pthread_mutex_unlock(&b->lock);
+    for (int i = 0; i < n_started; i++) {
+        pthread_join(b->slots[i].thread, NULL);
+    }
+}
+
+struct batch_decoder * batch_init(struct whisper_context * ctx, struct batch_params params) {
+    if (!ctx || params.n_seq < 1) {
+        return NULL;
+    }
+    struct batch_decoder * b = calloc(1, sizeof(struct batch_decoder));
+    if (!b) {
+        return NULL;
+    }
+    b->ctx = ctx;
+    b->params = params;
+    b->params.n_threads = params.n_threads > 0 ? params.n_threads : 1;
+    const int max_tokens = whisper_n_text_ctx(ctx)/2;
+    b->params.max_tokens = params.max_tokens > 0 && params.max_tokens < max_tokens ? params.max_tokens : max_tokens;
+    strncpy(b->language, params.language ? params.language : "en", sizeof(b->language) - 1);
+    b->params.language = b->language;
+
+    b->n_vocab = whisper_n_vocab(ctx);
+    b->eot = whisper_token_eot(ctx);
+    b->prompt[b->n_prompt++] = whisper_token_sot(ctx);
+    if (whisper_is_multilingual(ctx)) {
+        const int lang_id = whisper_lang_id(b->language);
+        b->prompt[b->n_prompt++] = whisper_token_lang(ctx, lang_id >= 0 ? lang_id : 0);
+        b->prompt[b->n_prompt++] = whisper_token_transcribe(ctx);
+    }
+    b->prompt[b->n_prompt++] = whisper_token_not(ctx);
+
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond_step, NULL);
+    pthread_cond_init(&b->cond_done, NULL);
+
+    b->arena = arena_init(4096);
+    b->slots = calloc(params.n_seq, sizeof(struct batch_slot));
+    if (!b->arena || !b->slots) {
+        batch_free(b);
+        return NULL;
+    }
+    b->n_slots = params.n_seq;
+
+    int n_started = 0;
+    for (int i = 0; i < b->n_slots; i++) {
+        struct batch_slot * s = &b->slots[i];
+        s->b = b;
+        s->window = -1;
+        s->state = whisper_init_state(ctx);
+        s->tokens = malloc(sizeof(whisper_token) * (b->n_prompt + b->params.max_tokens));
+        if (!s->state || !s->tokens || pthread_create(&s->thread, NULL, batch_worker, s) != 0) {
+            break;
+        }
+        n_started++;
+    }
+    if (n_started < b->n_slots) {
+        batch_stop_workers(b, n_started);
+        batch_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+void batch_free(struct batch_decoder * b) {
+    if (!b) {
+        return;
+    }
+    if (!b->quit && b->slots) {
+        batch_stop_workers(b, b->n_slots);
+    }
+    for (int i = 0; b->slots && i < b->params.n_seq; i++) {
+        if (b->slots[i].state) {
+            whisper_free_state(b->slots[i].state);
+        }
+        free(b->slots[i].tokens);
+        mel_spectrogram_free(&b->slots[i].mel);
+    }
+    free(b->slots);
+    free(b->windows);
+    free(b->requests);
+    arena_free(b->arena);
+    pthread_cond_destroy(&b->cond_done);
+    pthread_cond_destroy(&b->cond_step);
+    pthread_mutex_destroy(&b->lock);
+    free(b);
+}
+
+static int batch_add_window(struct batch_decoder * b, int request, const float * samples, int n_samples) {
+    if (b->n_windows == b->cap_windows) {
+        const int cap = b->cap_windows > 0 ? 2*b->cap_windows : 16;
+        struct batch_window * windows = realloc(b->windows, sizeof(struct batch_window) * cap);
+        if (!windows) {
+            return -1;
+        }
+        b->windows = windows;
+        b->cap_windows = cap;
+    }
+    b->windows[b->n_windows++] = (struct batch_window) {
+            .request = request,
+            .samples = samples,
+            .n_samples = n_samples,
+            .text = "",
+    };
+    return 0;
+}
+
+int batch_submit(struct batch_decoder * b, const float * samples, int n_samples) {
+    if (!samples || n_samples <= 0) {
+        return -1;
+    }
+    if (b->n_requests == b->cap_requests) {
+        const int cap = b->cap_requests > 0 ? 2*b->cap_requests : 8;
+        struct batch_request * requests = realloc(b->requests, sizeof(struct batch_request) * cap);
+        if (!requests) {
+            return -1;
+        }
+        b->requests = requests;
+        b->cap_requests = cap;
+    }
+
+    const int id = b->n_requests;
+    struct batch_request * req = &b->requests[id];
+    req->first_window = b->n_windows;
+    req->n_windows = 0;
+    req->text = "";
+    for (int i = 0; i < n_samples; i += BATCH_WINDOW) {
+        const int n = n_samples - i < BATCH_WINDOW ? n_samples - i : BATCH_WINDOW;
+        if (batch_add_window(b, id, samples + i, n) != 0) {
+            b->n_windows = req->first_window;
+            return -1;
+        }
+        req->n_windows++;
+    }
+    b->n_requests++;
+    return id;
+}
+
+// Computes the window's spectrogram and runs the encoder with every thread.
+static int batch_slot_start(struct batch_slot * s, int window) {
+    struct batch_decoder * b = s->b;
+    const struct batch_window * w = &b->windows[window];
+    const struct mel_frontend * fe = mel_frontend_get(whisper_model_n_mels(b->ctx));
+
+    s->window = window;
+    s->n_tokens = b->n_prompt;
+    s->n_past = 0;
+    s->done = false;
+    s->failed = false;
+    memcpy(s->tokens, b->prompt, sizeof(whisper_token) * b->n_prompt);
+
+    if (!fe || mel_frontend_compute(fe, w->samples, w->n_samples, b->params.n_threads, &s->mel) != 0 ||
+        whisper_set_mel_with_state(b->ctx, s->state, s->mel.data, s->mel.n_len, s->mel.n_mel) != 0 ||
+        whisper_encode_with_state(b->ctx, s->state, 0, b->params.n_threads) != 0) {
+        s->failed = true;
+        s->done = true;
+        return -1;
+    }
+    return 0;
+}
+
+static const char * batch_tokens_text(struct batch_decoder * b, const struct batch_slot * s) {
+    size_t len = 0;
+    for (int i = b->n_prompt; i < s->n_tokens; i++) {
+        len += strlen(whisper_token_to_str(b->ctx, s->tokens[i]));
+    }
+    char * text = arena_alloc(b->arena, len + 1);
+    if (!text) {
+        return "";
+    }
+    char * p = text;
+    for (int i = b->n_prompt; i < s->n_tokens; i++) {
+        const char * piece = whisper_token_to_str(b->ctx, s->tokens[i]);
+        const size_t n = strlen(piece);
+        memcpy(p, piece, n);
+        p += n;
+    }
+    *p = '\0';
+    return text;
+}
+
+static void batch_step_all(struct batch_decoder * b) {
+    pthread_mutex_lock(&b->lock);
+    b->n_pending = b->n_slots;
+    b->generation++;
+    pthread_cond_broadcast(&b->cond_step);
+    while (b->n_pending > 0) {
+        pthread_cond_wait(&b->cond_done, &b->lock);
+    }
+    pthread_mutex_unlock(&b->lock);
+}
+
+int batch_run(struct batch_decoder * b) {
+    struct batch_stats * stats = &b->stats;
+    int rc = 0;
+    int next = 0;
+    int64_t n_active_sum = 0;
+
+    for (;;) {
+        const int64_t t_encode_us = time_us(CLOCK_MONOTONIC);
+        int n_active = 0;
+        for (int i = 0; i < b->n_slots; i++) {
+            struct batch_slot * s = &b->slots[i];
+            if (s->window < 0 && next < b->n_windows && batch_slot_start(s, next++) != 0) {
+                rc = -1;
+            }
+            n_active += s->window >= 0 && !s->done;
+        }
+        stats->encode_ms += (time_us(CLOCK_MONOTONIC) - t_encode_us)/1000.0f;
+
+        if (n_active > 0) {
+            const int n_threads = b->params.n_threads/n_active > 0 ? b->params.n_threads/n_active : 1;
+            for (int i = 0; i < b->n_slots; i++) {
+                b->slots[i].n_threads = n_threads;
+            }
+
+            const int64_t t0_us = time_us(CLOCK_MONOTONIC);
+            batch_step_all(b);
+            stats->decode_ms += (time_us(CLOCK_MONOTONIC) - t0_us)/1000.0f;
+            // the workers are parked again, their counts are safe to read
+            for (int i = 0; i < b->n_slots; i++) {
+                stats->decode_cpu_ms += b->slots[i].cpu_us/1000.0f;
+                b->slots[i].cpu_us = 0;
+            }
+            stats->n_steps++;
+            stats->n_tokens += n_active;
+            n_active_sum += n_active;
+        }
+
+        // finished sequences free their slot for the next window
+        bool idle = true;
+        for (int i = 0; i < b->n_slots; i++) {
+            struct batch_slot * s = &b->slots[i];
+            if (s->window >= 0 && s->done) {
+                rc = s->failed ? -1 : rc;
+                b->windows[s->window].text = s->failed ? "" : batch_tokens_text(b, s);
+                s->window = -1;
+            }
+            idle = idle && s->window < 0;
+        }
+        if (idle && next >= b->n_windows) {
+            break;
+        }
+    }
+
+    for (int r = 0; r < b->n_requests; r++) {
+        struct batch_request * req = &b->requests[r];
+        size_t len = 0;
+        for (int w = 0; w < req->n_windows; w++) {
+            len += strlen(b->windows[req->first_window + w].text);
+        }
+        char * text = arena_alloc(b->arena, len + 1);
+        if (!text) {
+            return -1;
+        }
+        text[0] = '\0';
+        for (int w = 0; w < req->n_windows; w++) {
+            strcat(text, b->windows[req->first_window + w].text);
+        }
+        req->text = text;
+    }
+
+    stats->n_requests = b->n_requests;
+    stats->n_windows = b->n_windows;
+    stats->mean_active = stats->n_steps > 0 ? (float) n_active_sum/stats->n_steps : 0.0f;
+    return rc;
+}
+
+const char * batch_text(const struct batch_decoder * b, int id) {
+    return id >= 0 && id < b->n_requests ? b->requests[id].text : NULL;
+}
+
+int batch_n_requests(const struct batch_decoder * b) {
+    return b->n_requests;
+}
+
+void batch_clear(struct batch_decoder * b) {
+    b->n_windows = 0;
+    b->n_requests = 0;
+    arena_reset(b->arena);
+    memset(&b->stats, 0, sizeof(b->stats));
+}
+
+const struct batch_stats * batch_get_stats(const struct batch_decoder * b) {
+    return &b->stats;
+}
@@ -0,0 +1,71 @@
+#ifndef WHISPER_JNI_BATCH_H
+#define WHISPER_JNI_BATCH_H
+
+#include <stdint.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decodes several independent sequences in lockstep: queued clips, and the
+// 30 s windows of longer ones, are spread over n_seq whisper states that share
+// the context's model. Every step advances all active sequences at once on
+// persistent worker threads, so the decoder weights are streamed by all of
+// them together and stay hot in the shared cache instead of being read from
+// memory once per sequence. (whisper's own batched decoding shares a single
+// audio's cross-attention, so sequences over different audio need their own
+// states.) Greedy, text only: no timestamps, no temperature fallback.
+struct batch_params {
+    const char * language;  // never detected; copied
+    int n_seq;              // sequences decoded together, each costs a whisper state
+    int n_threads;          // total, split over the active sequences
+    int max_tokens;         // per window, 0 = half the text context
+};
+
+struct batch_params batch_default_params(void);
+
+struct batch_stats {
+    int   n_requests;
+    int   n_windows;
+    int   n_tokens;       // generated, prompts excluded
+    int   n_steps;        // lockstep steps
+    float mean_active;    // sequences advanced per step
+    float encode_ms;
+    float decode_ms;      // wall time of the steps
+    // CPU time of the steps, summed over the slots' worker threads
+    // (CLOCK_THREAD_CPUTIME_ID), so other work in the process is left out.
+    // Each slot decodes with n_threads/active threads; ggml's threads beyond
+    // the worker's own, used once few sequences are left, are not counted.
+    float decode_cpu_ms;
+};
+
+struct batch_decoder;
+
+// ctx is borrowed and must outlive the decoder. Returns NULL when the states
+// cannot be allocated.
+struct batch_decoder * batch_init(struct whisper_context * ctx, struct batch_params params);
+void batch_free(struct batch_decoder * b);
+
+// Queues 16 kHz mono samples, borrowed until batch_run returns. Returns the
+// request id or -1.
+int batch_submit(struct batch_decoder * b, const float * samples, int n_samples);
+
+// Decodes everything queued. Returns 0 on success.
+int batch_run(struct batch_decoder * b);
+
+// Text of a request after batch_run, valid until batch_clear.
+const char * batch_text(const struct batch_decoder * b, int id);
+int batch_n_requests(const struct batch_decoder * b);
+
+// drops requests, results and statistics
+void batch_clear(struct batch_decoder * b);
+
+const struct batch_stats * batch_get_stats(const struct batch_decoder * b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_BATCH_H
@@ -0,0 +1,105 @@
+// Host benchmark: heap allocations per transcription once the transcriber has
+// warmed up. Each run transcribes the clip and reads the joined text back the
+// way the JNI layer does, and reports how many allocations that took, inside
+// whisper_full and outside it.
+//
+//   bench_alloc -m model.bin [-r runs] [-w warmup] [-l lang] [-t threads] [-d seconds] [file.wav]
+//
+// Exits with 1 when a run after the warm-up allocated outside whisper_full.
+// Needs a build with WHISPER_COUNT_ALLOCS (on by default for the host).
+
+#include "common.h"
+#include "../alloc_count.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static uint64_t n_allocs(void) {
+    struct alloc_counts counts;
+    alloc_count_get(&counts);
+    return counts.n_allocs;
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    int runs = 10;
+    int warmup = 2;
+    float seconds = 10.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:r:w:l:t:d:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'r': runs = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-r runs] [-w warmup] [-l lang] [-t threads] [-d seconds] [file.wav]\n", argv[0]);
+        return 1;
+    }
+    if (!alloc_count_enabled()) {
+        fprintf(stderr, "built without WHISPER_COUNT_ALLOCS, nothing to count\n");
+        return 1;
+    }
+
+    int n = (int) (seconds*16000);
+    float * samples = optind < argc ? bench_read_wav(argv[optind], &n) : bench_synth_audio(n, 0.01f, 9);
+    if (!samples) {
+        fprintf(stderr, "failed to read audio\n");
+        return 1;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    printf("audio %.1f s, %d runs after %d warm-up runs\n", n/16000.0, runs, warmup);
+    printf("run  allocs  in-whisper  outside  arena-bytes  text-bytes  total-ms\n");
+
+    int failed = 0;
+    for (int r = 0; r < warmup + runs; r++) {
+        const uint64_t before = n_allocs();
+        if (transcriber_run_pcm(tr, params, samples, n) != 0) {
+            fprintf(stderr, "transcription failed\n");
+            break;
+        }
+        // what getText does after fullTranscribe
+        const size_t len = strlen(transcriber_text(tr));
+        const int total = (int) (n_allocs() - before);
+
+        const struct transcribe_stats * st = transcriber_stats(tr);
+        const int outside = total - st->n_allocs_whisper;
+        const bool steady = r >= warmup;
+        printf("%3d%s %7d  %10d  %7d  %11d  %10zu  %8.1f\n", r, steady ? " " : "w", total, st->n_allocs_whisper, outside,
+                st->arena_bytes, len, st->total_ms);
+        if (steady && outside != 0) {
+            failed++;
+        }
+    }
+
+    printf("%s: %d of %d steady-state runs allocated outside whisper_full\n", failed ? "FAIL" : "OK", failed, runs);
+
+    transcriber_free(tr);
+    free(samples);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+// Host benchmark: decoder throughput of the lockstep batch decoder as a
+// function of the batch size. Reports tokens/s and tokens per core-second (per
+// second of process CPU time) of the decoder steps, and whether the texts match
+// the batch size 1 run.
+//
+//   bench_batch -m model.bin [-b 1,2,4,8] [-t threads] [-l lang] [-n clips] [-d seconds] [file.wav ...]
+//
+// Every WAV file is one request (longer ones are split into 30 s windows).
+// Without files, -n synthetic clips of -d seconds are decoded.
+
+#include "common.h"
+#include "../batch.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+#define MAX_CLIPS 64
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * sizes = "1,2,4,8";
+    struct batch_params params = batch_default_params();
+    int n_synth = 8;
+    float seconds = 10.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:b:t:l:n:d:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'b': sizes = optarg; break;
+            case 't': params.n_threads = atoi(optarg); break;
+            case 'l': params.language = optarg; break;
+            case 'n': n_synth = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-b 1,2,4,8] [-t threads] [-l lang] [-n clips] [-d seconds] [file.wav ...]\n", argv[0]);
+        return 1;
+    }
+
+    float * clips[MAX_CLIPS];
+    int lens[MAX_CLIPS];
+    int n_clips = 0;
+    for (int i = optind; i < argc && n_clips < MAX_CLIPS; i++) {
+        clips[n_clips] = bench_read_wav(argv[i], &lens[n_clips]);
+        n_clips += clips[n_clips] != NULL;
+    }
+    for (int i = 0; optind >= argc && i < n_synth && n_clips < MAX_CLIPS; i++) {
+        lens[n_clips] = (int) (seconds*16000);
+        clips[n_clips] = bench_synth_audio(lens[n_clips], 0.01f, 9 + i);
+        n_clips += clips[n_clips] != NULL;
+    }
+    if (n_clips == 0) {
+        fprintf(stderr, "no audio\n");
+        return 1;
+    }
+
+    struct whisper_context * ctx = whisper_init_from_file_with_params(model, whisper_context_default_params());
+    if (!ctx) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        return 1;
+    }
+
+    char * reference[MAX_CLIPS] = { NULL };
+    printf("%d clips, %d threads\n", n_clips, params.n_threads);
+    printf("batch  windows  tokens  steps  active  encode-ms  decode-ms  tok/s   tok/core-s  same-text\n");
+    for (const char * p = sizes; *p; ) {
+        params.n_seq = atoi(p);
+        p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p);
+
+        struct batch_decoder * b = batch_init(ctx, params);
+        if (!b) {
+            fprintf(stderr, "batch %d: failed to allocate the states\n", params.n_seq);
+            continue;
+        }
+        for (int i = 0; i < n_clips; i++) {
+            batch_submit(b, clips[i], lens[i]);
+        }
+        if (batch_run(b) != 0) {
+            fprintf(stderr, "batch %d: decoding failed\n", params.n_seq);
+        }
+
+        int same = 0;
+        for (int i = 0; i < n_clips; i++) {
+            if (!reference[i]) {
+                reference[i] = strdup(batch_text(b, i));
+            }
+            same += strcmp(reference[i], batch_text(b, i)) == 0;
+        }
+
+        const struct batch_stats * st = batch_get_stats(b);
+        printf("%5d  %7d  %6d  %5d  %6.2f  %9.1f  %9.1f  %6.1f  %10.1f  %d/%d\n",
+                params.n_seq, st->n_windows, st->n_tokens, st->n_steps, st->mean_active, st->encode_ms, st->decode_ms,
+                st->decode_ms > 0.0f ? st->n_tokens*1000.0f/st->decode_ms : 0.0f,
+                st->decode_cpu_ms > 0.0f ? st->n_tokens*1000.0f/st->decode_cpu_ms : 0.0f,
+                same, n_clips);
+        batch_free(b);
+    }
+
+    for (int i = 0; i < n_clips; i++) {
+        free(reference[i]);
+        free(clips[i]);
+    }
+    whisper_free(ctx);
+    return 0;
+}
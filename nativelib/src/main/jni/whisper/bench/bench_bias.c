@@ -0,0 +1,155 @@
+// Host benchmark: per-step cost of vocabulary biasing for growing phrase
+// lists, on synthetic token phrases and decoded sequences (no model needed).
+// With a model, a WAV file and a phrase file (one per line) the transcript is
+// also printed without and with the bias.
+//
+//   bench_bias [-n steps] [-m model.bin -f file.wav -p phrases.txt] [-b boost] [-l lang] [-t threads]
+
+#include "common.h"
+#include "../bias.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+#define N_VOCAB 51864
+#define N_TEXT  50257
+
+static uint32_t next_rand(uint32_t * rng) {
+    *rng = *rng*1664525u + 1013904223u;
+    return *rng >> 8;
+}
+
+static void bench_steps(int n_phrases, int n_steps) {
+    struct bias_trie * b = bias_init();
+    uint32_t rng = 1234;
+
+    // phrases of 2-6 tokens from a 20k-token subset, like names split into BPE pieces
+    whisper_token * phrases = malloc(sizeof(whisper_token) * 6 * n_phrases);
+    int * lens = malloc(sizeof(int) * n_phrases);
+    for (int i = 0; i < n_phrases; i++) {
+        lens[i] = 2 + (int) (next_rand(&rng) % 5);
+        for (int k = 0; k < lens[i]; k++) {
+            phrases[6*i + k] = (whisper_token) (next_rand(&rng) % 20000);
+        }
+        bias_add_tokens(b, phrases + 6*i, lens[i], 3.0f);
+    }
+    const int64_t t_compile_us = bench_time_us();
+    bias_compile(b);
+    const int64_t compile_us = bench_time_us() - t_compile_us;
+
+    // decoded text alternates between phrases and other tokens, so prefixes are active half the time
+    whisper_token_data * tokens = calloc(224, sizeof(whisper_token_data));
+    float * logits = calloc(N_VOCAB, sizeof(float));
+    int64_t n_changed = 0;
+    int64_t apply_us = 0;
+    int cur = -1;
+    int pos = 0;
+    for (int step = 0; step < n_steps; step++) {
+        const int n = step % 224;
+        if (n == 0) {
+            memset(logits, 0, sizeof(float) * N_VOCAB);
+        }
+        if (cur < 0 && next_rand(&rng) % 4 == 0) {
+            cur = (int) (next_rand(&rng) % n_phrases);
+            pos = 0;
+        }
+        if (cur >= 0) {
+            tokens[n].id = phrases[6*cur + pos];
+            cur = ++pos < lens[cur] ? cur : -1;
+        } else {
+            tokens[n].id = (whisper_token) (next_rand(&rng) % 20000);
+        }
+        const int64_t t0_us = bench_time_us();
+        n_changed += bias_apply(b, tokens, n + 1, logits, N_TEXT);
+        apply_us += bench_time_us() - t0_us;
+    }
+
+    printf("phrases=%6d compile=%8.2f ms apply=%7.3f us/step logits changed=%.1f/step\n",
+            bias_n_phrases(b), compile_us/1000.0, (double) apply_us/n_steps, (double) n_changed/n_steps);
+
+    free(tokens);
+    free(logits);
+    free(phrases);
+    free(lens);
+    bias_free(b);
+}
+
+static void transcribe(struct transcriber * tr, const float * samples, int n, const char * lang, int n_threads) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+
+    const int rc = transcriber_run_pcm(tr, params, samples, n);
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+    printf("phrases=%d rc=%d biased steps=%d total=%.1f ms\n  ",
+            transcriber_n_bias_phrases(tr), rc, stats->n_biased_steps, stats->total_ms);
+    for (int i = 0; i < transcriber_n_segments(tr); i++) {
+        printf("%s", transcriber_segment(tr, i)->text);
+    }
+    printf("\n");
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * wav = NULL;
+    const char * phrases = NULL;
+    const char * lang = "en";
+    float boost = 3.0f;
+    int n_threads = 4;
+    int n_steps = 200000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:f:p:b:l:t:")) != -1) {
+        switch (opt) {
+            case 'n': n_steps = atoi(optarg); break;
+            case 'm': model = optarg; break;
+            case 'f': wav = optarg; break;
+            case 'p': phrases = optarg; break;
+            case 'b': boost = (float) atof(optarg); break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            default: break;
+        }
+    }
+    n_steps = n_steps < 1 ? 1 : n_steps;
+
+    static const int counts[] = { 10, 100, 1000, 10000, 100000 };
+    for (size_t i = 0; i < sizeof(counts)/sizeof(counts[0]); i++) {
+        bench_steps(counts[i], n_steps);
+    }
+
+    if (!model || !wav || !phrases) {
+        return 0;
+    }
+
+    int n_samples = 0;
+    float * samples = bench_read_wav(wav, &n_samples);
+    FILE * f = fopen(phrases, "r");
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!samples || !f || !tr) {
+        fprintf(stderr, "failed to load model, audio or phrases\n");
+        return 1;
+    }
+
+    printf("\n");
+    transcribe(tr, samples, n_samples, lang, n_threads);
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && transcriber_add_bias_phrase(tr, line, boost) != 0) {
+            fprintf(stderr, "phrase ignored: '%s'\n", line);
+        }
+    }
+    fclose(f);
+    transcribe(tr, samples, n_samples, lang, n_threads);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Host benchmark: end-to-end latency with speaker diarization off and on, and
+// the speaker assigned to each segment. Without a WAV file a synthetic
+// dialogue of two voices taking 5 s turns is used.
+//
+//   bench_diarize -m model.bin [-l lang] [-t threads] [-d seconds] [-r runs] [file.wav]
+
+#include "common.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+// harmonic voice with its own pitch, spectral tilt and formant
+static void synth_voice(float * out, int n, double f0_base, double tilt, double formant, uint32_t seed) {
+    double phase = 0.0;
+    uint32_t rng = seed;
+    for (int i = 0; i < n; i++) {
+        const double t = i/16000.0;
+        const double f0 = f0_base*(1.0 + 0.1*sin(2.0*M_PI*0.5*t + seed));
+        phase += 2.0*M_PI*f0/16000.0;
+        const double env = fmax(0.0, sin(2.0*M_PI*3.3*t));
+        double v = 0.0;
+        for (int h = 1; h*f0 < 7000.0; h++) {
+            const double f = h*f0;
+            v += pow(h, -tilt)*(1.0 + 2.0*exp(-pow((f - formant)/300.0, 2.0)))*sin(h*phase);
+        }
+        rng = rng*1664525u + 1013904223u;
+        out[i] = (float) (0.1*env*v + 0.001*(((rng >> 8)/16777216.0)*2.0 - 1.0));
+    }
+}
+
+static float * synth_dialogue(int n) {
+    float * out = calloc(n > 0 ? n : 1, sizeof(float));
+    const int turn = 5*16000;
+    const int gap = 16000/2;
+    for (int s = 0; out && s*turn < n; s++) {
+        const bool b = s % 2 == 1;
+        const int len = (n - s*turn < turn ? n - s*turn : turn) - gap;
+        if (len > 0) {
+            synth_voice(out + s*turn, len, b ? 210.0 : 115.0, b ? 1.6 : 1.0, b ? 2300.0 : 900.0, s + 1);
+        }
+    }
+    return out;
+}
+
+static float run(struct transcriber * tr, const float * samples, int n, bool enabled, bool print, const char * lang, int n_threads) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    transcriber_set_diarization(tr, enabled);
+    const int rc = transcriber_run_pcm(tr, params, samples, n);
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+
+    printf("%-3s rc=%d windows=%d segments=%d speakers=%d diarize=%.2f ms wait=%.2f ms total=%.1f ms\n",
+            enabled ? "on" : "off", rc, stats->n_windows, transcriber_n_segments(tr),
+            stats->n_speakers, stats->diarize_ms, stats->diarize_wait_ms, stats->total_ms);
+
+    for (int i = 0; print && i < transcriber_n_segments(tr); i++) {
+        const struct transcribe_segment * seg = transcriber_segment(tr, i);
+        printf("    [%7.2f - %7.2f] S%-2d %s\n", seg->t0/100.0, seg->t1/100.0, seg->speaker, seg->text);
+    }
+    return stats->total_ms;
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    float seconds = 60.0f;
+    int runs = 3;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:l:t:d:r:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-l lang] [-t threads] [-d seconds] [-r runs] [file.wav]\n", argv[0]);
+        return 1;
+    }
+    runs = runs < 1 ? 1 : runs;
+
+    int n = (int) (seconds*16000);
+    float * samples = optind < argc ? bench_read_wav(argv[optind], &n) : synth_dialogue(n);
+    if (!samples) {
+        fprintf(stderr, "failed to read audio\n");
+        return 1;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+
+    float ms_off = 0.0f;
+    float ms_on = 0.0f;
+    for (int r = 0; r < runs; r++) {
+        ms_off += run(tr, samples, n, false, false, lang, n_threads);
+        ms_on += run(tr, samples, n, true, r == runs - 1, lang, n_threads);
+    }
+    ms_off /= runs;
+    ms_on /= runs;
+
+    printf("\nmean total: off %.1f ms, on %.1f ms, overhead %+.1f ms (%+.2f%%)\n",
+            ms_off, ms_on, ms_on - ms_off, ms_off > 0.0f ? 100.0f*(ms_on - ms_off)/ms_off : 0.0f);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Host benchmark: energy per audio minute of each thread count and CPU
+// cluster, and the configuration the power-efficient mode would pick. Every
+// model given with -m is tried; the pick is the least energy per audio second
+// whose latency stays within -L times the audio duration.
+//
+//   bench_energy -m model.bin [-m other.bin ...] [-f audio.wav] [-s seconds] [-T max_threads] [-L max_rtf] [-l lang]
+//
+// RAPL needs read access to /sys/class/powercap/intel-rapl:*/energy_uj (root
+// on current kernels). Without an energy source the CPU time is compared
+// instead, which favours fewer threads in the same way but ignores the
+// difference between big and little cores.
+
+#include "common.h"
+#include "../power.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+#define BENCH_ENERGY_MAX_MODELS   4
+#define BENCH_ENERGY_MAX_CLUSTERS 8
+#define BENCH_ENERGY_MAX_RUNS     256
+
+int main(int argc, char ** argv) {
+    const char * models[BENCH_ENERGY_MAX_MODELS];
+    int n_models = 0;
+    const char * wav = NULL;
+    const char * lang = "en";
+    float seconds = 10.0f;
+    float max_rtf = 0.5f;
+    int max_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:s:T:L:l:")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (n_models < BENCH_ENERGY_MAX_MODELS) {
+                    models[n_models++] = optarg;
+                }
+                break;
+            case 'f': wav = optarg; break;
+            case 's': seconds = (float) atof(optarg); break;
+            case 'T': max_threads = atoi(optarg); break;
+            case 'L': max_rtf = (float) atof(optarg); break;
+            case 'l': lang = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s -m model.bin [-m other.bin ...] [-f audio.wav] [-s seconds] [-T max_threads] [-L max_rtf] [-l lang]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (n_models == 0) {
+        fprintf(stderr, "usage: %s -m model.bin [-m other.bin ...] [-f audio.wav] [-s seconds] [-T max_threads] [-L max_rtf] [-l lang]\n", argv[0]);
+        return 1;
+    }
+
+    int n_samples = 0;
+    float * samples = NULL;
+    if (wav) {
+        samples = bench_read_wav(wav, &n_samples);
+    } else {
+        n_samples = (int) (seconds*16000.0f);
+        samples = bench_synth_audio(n_samples, 0.01f, 1);
+    }
+    if (!samples) {
+        return 1;
+    }
+
+    struct power_meter * meter = power_meter_open();
+    if (!meter) {
+        free(samples);
+        return 1;
+    }
+    uint64_t clusters[BENCH_ENERGY_MAX_CLUSTERS + 1];
+    int n_clusters = power_cpu_clusters(clusters, BENCH_ENERGY_MAX_CLUSTERS);
+    if (n_clusters > 1) {
+        clusters[n_clusters++] = 0;   // all CPUs
+    }
+    printf("energy source: %s, %d cluster(s), audio %.1f s, SLA %.2fx realtime\n",
+            power_source_str(power_meter_source(meter)), n_clusters > 1 ? n_clusters - 1 : 1, n_samples/16000.0, max_rtf);
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+
+    static struct power_measurement runs[BENCH_ENERGY_MAX_RUNS];
+    static struct { int model; struct power_config config; } configs[BENCH_ENERGY_MAX_RUNS];
+    int n_runs = 0;
+
+    for (int mi = 0; mi < n_models; mi++) {
+        struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(models[mi], whisper_context_default_params()));
+        if (!tr) {
+            fprintf(stderr, "failed to load '%s'\n", models[mi]);
+            continue;
+        }
+        // warm-up: page in the weights and let the governor ramp up
+        params.n_threads = max_threads;
+        transcriber_run_pcm(tr, params, samples, n_samples);
+
+        for (int ci = 0; ci < n_clusters; ci++) {
+            const int n_cpus = clusters[ci] ? __builtin_popcountll(clusters[ci]) : max_threads;
+            for (int t = 1; t <= n_cpus && t <= max_threads && n_runs < BENCH_ENERGY_MAX_RUNS; t++) {
+                const struct power_config config = { t, clusters[ci] };
+                struct power_measurement * r = &runs[n_runs];
+                if (power_measure(tr, meter, params, samples, n_samples, config, r) != 0) {
+                    fprintf(stderr, "%s: %d threads on %#llx failed\n", models[mi], t, (unsigned long long) config.cpu_mask);
+                    continue;
+                }
+                configs[n_runs].model = mi;
+                configs[n_runs].config = config;
+                printf("%-24s %2d threads  cpus %#6llx  %8.1f ms  rtf %5.3f  cpu %7.2f s",
+                        models[mi], t, (unsigned long long) config.cpu_mask, r->latency_ms, r->latency_ms/(1000.0f*r->audio_s), r->cpu_s);
+                if (r->joules >= 0.0) {
+                    printf("  %8.2f J  %8.1f J/audio-min", r->joules, r->joules*60.0/r->audio_s);
+                }
+                printf("\n");
+                n_runs++;
+            }
+        }
+        transcriber_free(tr);
+    }
+
+    const int best = power_pick(runs, n_runs, max_rtf);
+    if (best >= 0) {
+        const struct power_measurement * r = &runs[best];
+        printf("pick: %s, %d threads on cpus %#llx: %.1f ms (rtf %.3f%s)",
+                models[configs[best].model], configs[best].config.n_threads, (unsigned long long) configs[best].config.cpu_mask,
+                r->latency_ms, r->latency_ms/(1000.0f*r->audio_s), r->latency_ms > max_rtf*1000.0f*r->audio_s ? ", misses the SLA" : "");
+        if (r->joules >= 0.0) {
+            printf(", %.1f J/audio-min", r->joules*60.0/r->audio_s);
+        } else {
+            printf(", %.2f CPU s/audio-min", r->cpu_s*60.0/r->audio_s);
+        }
+        printf("\n");
+    }
+
+    power_meter_close(meter);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Host benchmark: cost of temperature fallbacks under whisper's full schedule
+// and under the adaptive policy (per-call budget, VAD skip of non-speech).
+//
+//   bench_fallback -m model.bin -f audio.wav [-l lang] [-t threads] [-s snr_db] [-b budget_per_min] [-w max_per_window]
+//
+// -s mixes white noise at the given SNR to provoke fallbacks.
+
+#include "common.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static void run(struct transcriber * tr, const char * label, struct transcribe_policy policy, const float * samples, int n_samples, const char * lang, int n_threads) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    transcriber_set_policy(tr, policy);
+    const int rc = transcriber_run_pcm(tr, params, samples, n_samples);
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+
+    printf("%-9s rc=%d windows=%d skipped=%d (%.1f s) passes=%d fallbacks=%d/%d capped=%d\n",
+            label, rc, stats->n_windows, stats->n_windows_skipped, stats->skipped_s,
+            stats->n_passes, stats->n_fallbacks, stats->fallback_budget, stats->n_windows_capped);
+    printf("%-9s total=%.1f ms fallback=%.1f ms (%.0f%%) RTF=%.3f\n",
+            "", stats->total_ms, stats->fallback_ms, stats->total_ms > 0.0f ? 100.0f*stats->fallback_ms/stats->total_ms : 0.0f,
+            stats->total_ms/1000.0/(n_samples/16000.0));
+
+    for (int i = 0; i < transcriber_n_segments(tr); i++) {
+        const struct transcribe_segment * seg = transcriber_segment(tr, i);
+        printf("          [%6.2f - %6.2f] w%d fb=%d %.0f ms nsp=%.2f %s\n",
+                seg->t0/100.0, seg->t1/100.0, seg->window, seg->n_fallbacks, seg->fallback_ms,
+                seg->no_speech_prob, seg->text);
+    }
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * wav = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    float snr_db = INFINITY;
+
+    struct transcribe_policy adaptive = transcribe_adaptive_policy();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:l:t:s:b:w:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'f': wav = optarg; break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 's': snr_db = (float) atof(optarg); break;
+            case 'b': adaptive.fallback_budget_per_minute = (float) atof(optarg); break;
+            case 'w': adaptive.max_fallbacks_per_window = atoi(optarg); break;
+            default: break;
+        }
+    }
+    if (!model || !wav) {
+        fprintf(stderr, "usage: %s -m model.bin -f audio.wav [-l lang] [-t threads] [-s snr_db] [-b budget_per_min] [-w max_per_window]\n", argv[0]);
+        return 1;
+    }
+
+    int n_samples = 0;
+    float * samples = bench_read_wav(wav, &n_samples);
+    if (!samples) {
+        return 1;
+    }
+    if (isfinite(snr_db)) {
+        bench_add_noise(samples, n_samples, snr_db, 42);
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        return 1;
+    }
+
+    // whisper's behavior: every window decoded, 5 fallbacks each, no budget
+    struct transcribe_policy full = {
+            .max_fallbacks_per_window   = 5,
+            .fallback_budget_per_minute = -1.0f,
+            .min_speech_ratio           = 0.0f,
+            .fallback_speech_ratio      = 0.0f,
+            .skip_silence               = false,
+    };
+
+    run(tr, "full", full, samples, n_samples, lang, n_threads);
+    run(tr, "adaptive", adaptive, samples, n_samples, lang, n_threads);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,192 @@
+// Host benchmark: file transcription of very long recordings with bounded
+// memory. Writes synthetic WAV files of the given durations (at a rate other
+// than 16 kHz, so the resampler runs), then reads them through the streaming
+// reader alone, or transcribes them chunk by chunk with -m. The peak RSS of
+// each run (reset between runs) should not grow with the duration.
+//
+//   bench_file [-m model.bin] [-H 1,3,10] [-r rate] [-C channels] [-c chunk_s] [-t threads] [-o dir] [file]
+//
+// -H gives the durations in hours. A 10 h file at the default 8 kHz takes
+// 576 MB of disk; the files are deleted afterwards. -C 2 writes stereo, which
+// takes the vectorized downmix. With a file argument only that file is
+// processed.
+
+#include "common.h"
+#include "../audio_file.h"
+#include "../transcribe_file.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static void put_u32(FILE * f, uint32_t v) {
+    const uint8_t b[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24 };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_u16(FILE * f, uint16_t v) {
+    const uint8_t b[2] = { v & 0xff, v >> 8 };
+    fwrite(b, 1, 2, f);
+}
+
+// 16-bit WAV of a repeated minute of bench_synth_audio-like speech, the same
+// in every channel.
+static int write_wav(const char * path, double seconds, int rate, int channels) {
+    FILE * f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    const int64_t n = (int64_t) (seconds*rate);
+    const uint32_t bytes = (uint32_t) (n*2*channels);
+    fwrite("RIFF", 1, 4, f);
+    put_u32(f, 36 + bytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_u32(f, 16);
+    put_u16(f, 1);
+    put_u16(f, (uint16_t) channels);
+    put_u32(f, (uint32_t) rate);
+    put_u32(f, (uint32_t) (rate*2*channels));
+    put_u16(f, (uint16_t) (2*channels));
+    put_u16(f, 16);
+    fwrite("data", 1, 4, f);
+    put_u32(f, bytes);
+
+    const int n_block = 60*rate;
+    int16_t * block = malloc(sizeof(int16_t) * n_block*channels);
+    if (!block) {
+        fclose(f);
+        return -1;
+    }
+    uint32_t rng = 9;
+    double phase = 0.0;
+    for (int i = 0; i < n_block; i++) {
+        const double t = (double) i/rate;
+        phase += 2.0*M_PI*(120.0 + 40.0*sin(2.0*M_PI*0.7*t))/rate;
+        const double env = fmax(0.0, sin(2.0*M_PI*4.0*t))*(fmod(t, 5.0) < 4.0 ? 1.0 : 0.0);
+        double v = 0.0;
+        for (int h = 1; h <= 8; h++) {
+            v += sin(h*phase)/h;
+        }
+        rng = rng*1664525u + 1013904223u;
+        v = 0.2*env*v + 0.01*(((rng >> 8)/16777216.0)*2.0 - 1.0);
+        for (int c = 0; c < channels; c++) {
+            block[i*channels + c] = (int16_t) (v*32767.0);
+        }
+    }
+    for (int64_t done = 0; done < n; done += n_block) {
+        const size_t k = (size_t) (n - done < n_block ? n - done : n_block);
+        if (fwrite(block, sizeof(int16_t)*channels, k, f) != k) {
+            free(block);
+            fclose(f);
+            return -1;
+        }
+    }
+    free(block);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int count_segment(const struct transcribe_segment * seg, void * user_data) {
+    (void) seg;
+    (*(int *) user_data)++;
+    return 0;
+}
+
+static void run(const char * path, struct transcriber * tr, int chunk_s, int n_threads) {
+    struct audio_file * f = audio_file_open(path);
+    if (!f) {
+        fprintf(stderr, "'%s': not a supported audio file\n", path);
+        return;
+    }
+    const struct audio_file_info info = *audio_file_get_info(f);
+    bench_reset_peak_rss();
+
+    if (!tr) {
+        // reader only: decoding, conversion and resampling throughput
+        float buf[16384];
+        int64_t n_total = 0;
+        int n;
+        const int64_t t0 = bench_time_us();
+        while ((n = audio_file_read(f, buf, 16384)) > 0) {
+            n_total += n;
+        }
+        const double ms = (bench_time_us() - t0)/1000.0;
+        const double seconds = (double) n_total/AUDIO_FILE_RATE;
+        printf("%8.2f h  %-5s %6d Hz %d ch  read %9.1f ms  %8.0fx realtime  samples %lld  peak RSS %7.1f MB\n",
+                seconds/3600.0, info.codec, info.sample_rate, info.channels, ms, seconds*1000.0/ms, (long long) n_total, bench_peak_rss_mb());
+        audio_file_close(f);
+        return;
+    }
+    audio_file_close(f);
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = "en";
+    params.n_threads = n_threads;
+
+    int n_segments = 0;
+    struct transcribe_file_stats st;
+    if (transcribe_file(tr, params, path, chunk_s, count_segment, &n_segments, &st) != 0) {
+        fprintf(stderr, "'%s': transcription failed\n", path);
+    }
+    printf("%8.2f h  %6d Hz  %4d chunks  %6d segments  carried %7.1f s  read %8.1f ms  total %10.1f ms  %6.1fx realtime  buffer %5.1f MB  peak RSS %7.1f MB\n",
+            st.duration_s/3600.0, info.sample_rate, st.n_chunks, n_segments, st.carried_s, st.read_ms, st.total_ms,
+            st.duration_s*1000.0/st.total_ms, st.buffer_bytes/1048576.0, bench_peak_rss_mb());
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * hours = "1,3,10";
+    const char * dir = "/tmp";
+    int rate = 8000;
+    int channels = 1;
+    int chunk_s = TRANSCRIBE_FILE_DEFAULT_CHUNK_S;
+    int n_threads = 4;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:H:r:C:c:t:o:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'H': hours = optarg; break;
+            case 'r': rate = atoi(optarg); break;
+            case 'C': channels = atoi(optarg); break;
+            case 'c': chunk_s = atoi(optarg); break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'o': dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-m model.bin] [-H 1,3,10] [-r rate] [-C channels] [-c chunk_s] [-t threads] [-o dir] [file]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    struct transcriber * tr = NULL;
+    if (model) {
+        tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+        if (!tr) {
+            fprintf(stderr, "failed to load '%s'\n", model);
+            return 1;
+        }
+    }
+
+    if (optind < argc) {
+        run(argv[optind], tr, chunk_s, n_threads);
+    } else {
+        for (const char * p = hours; *p; ) {
+            const double h = atof(p);
+            p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p);
+
+            char path[512];
+            snprintf(path, sizeof(path), "%s/bench_file_%gh.wav", dir, h);
+            if (write_wav(path, h*3600.0, rate, channels) != 0) {
+                fprintf(stderr, "failed to write '%s'\n", path);
+                continue;
+            }
+            run(path, tr, chunk_s, n_threads);
+            remove(path);
+        }
+    }
+
+    transcriber_free(tr);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Host benchmark: ggml_mul_mat on q8_0 weights for the matmul shapes of the
+// encoder, to compare the int8 kernels ggml was built with (dotprod, i8mm,
+// AVX-VNNI) across builds and devices.
+//
+//   bench_gemm_q8 [-d n_state] [-m frames] [-t threads] [-r runs]
+//
+// Shapes per encoder layer (frames x k -> n): the q/k/v/out projections
+// (n_state -> n_state), the MLP up (n_state -> 4*n_state) and down
+// (4*n_state -> n_state). -d 512 is base, 384 tiny, 768 small. The weights
+// are q8_0 and the activations f32, as in the encoder.
+
+#include "common.h"
+#include "ggml.h"
+#include "ggml-cpu.h"
+
+#include <unistd.h>
+
+static int cmp_i64(const void * a, const void * b) {
+    const int64_t x = *(const int64_t *) a;
+    const int64_t y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int64_t median_us(int64_t * t, int n) {
+    qsort(t, n, sizeof(int64_t), cmp_i64);
+    return t[n/2];
+}
+
+static void fill_random(float * v, size_t n, float scale, uint32_t * seed) {
+    for (size_t i = 0; i < n; i++) {
+        *seed = *seed*1664525u + 1013904223u;
+        v[i] = scale*((float) (*seed >> 8)/(float) (1u << 24) - 0.5f);
+    }
+}
+
+static void bench_shape(const char * name, int m, int k, int n, int n_threads, int runs) {
+    uint32_t seed = 1234u + (uint32_t) (k*31 + n);
+    float * wf = malloc(sizeof(float) * (size_t) n*k);
+    float * x = malloc(sizeof(float) * (size_t) m*k);
+    int64_t * t = malloc(sizeof(int64_t) * runs);
+    fill_random(wf, (size_t) n*k, 0.2f, &seed);
+    fill_random(x, (size_t) m*k, 2.0f, &seed);
+
+    const size_t w_bytes = ggml_row_size(GGML_TYPE_Q8_0, k)*n;
+    const struct ggml_init_params params = {
+        // weights, activations, result, the activations requantized to q8_0
+        // in the work buffer, and the graph
+        .mem_size = w_bytes + sizeof(float) * ((size_t) m*k + (size_t) m*n) + ggml_row_size(GGML_TYPE_Q8_0, k)*m
+                + ggml_graph_overhead() + 16*ggml_tensor_overhead() + (1 << 20),
+        .mem_buffer = NULL,
+        .no_alloc = false,
+    };
+    struct ggml_context * ctx = ggml_init(params);
+    struct ggml_tensor * w = ggml_new_tensor_2d(ctx, GGML_TYPE_Q8_0, k, n);
+    struct ggml_tensor * xt = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, k, m);
+    ggml_quantize_chunk(GGML_TYPE_Q8_0, wf, w->data, 0, n, k, NULL);
+    memcpy(xt->data, x, sizeof(float) * (size_t) m*k);
+    struct ggml_tensor * yt = ggml_mul_mat(ctx, w, xt);
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, yt);
+
+    // warm up once before timing
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+    for (int r = 0; r < runs; r++) {
+        const int64_t t0 = bench_time_us();
+        ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+        t[r] = bench_time_us() - t0;
+    }
+    const int64_t t_ggml = median_us(t, runs);
+
+    const double flop = 2.0*m*k*n;
+    printf("%-8s %4dx%-4d -> %-4d  %8.2f ms  %6.1f GFLOP/s\n",
+            name, m, k, n, t_ggml/1000.0, flop/t_ggml/1e3);
+
+    ggml_free(ctx);
+    free(wf);
+    free(x);
+    free(t);
+}
+
+int main(int argc, char ** argv) {
+    int n_state = 512;
+    int frames = 1500;
+    int n_threads = 4;
+    int runs = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:m:t:r:")) != -1) {
+        switch (opt) {
+            case 'd': n_state = atoi(optarg); break;
+            case 'm': frames = atoi(optarg); break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-d n_state] [-m frames] [-t threads] [-r runs]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (n_state <= 0 || n_state % ggml_blck_size(GGML_TYPE_Q8_0) != 0 || frames <= 0 || runs <= 0) {
+        fprintf(stderr, "n_state must be a positive multiple of %d\n", (int) ggml_blck_size(GGML_TYPE_Q8_0));
+        return 1;
+    }
+
+    ggml_time_init();
+    printf("ggml q8_0: dotprod %d, i8mm %d, avx_vnni %d, avx512_vnni %d; n_state = %d, frames = %d, threads = %d, median of %d runs\n",
+            ggml_cpu_has_dotprod(), ggml_cpu_has_matmul_int8(), ggml_cpu_has_avx_vnni(), ggml_cpu_has_avx512_vnni(),
+            n_state, frames, n_threads, runs);
+    bench_shape("attn", frames, n_state, n_state, n_threads, runs);
+    bench_shape("mlp.up", frames, n_state, 4*n_state, n_threads, runs);
+    bench_shape("mlp.down", frames, 4*n_state, n_state, n_threads, runs);
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Host benchmark: free decoding against grammar-constrained decoding of short
+// voice commands. Reports decoder steps and latency for each; the grammar is
+// compiled once and reused, its compile time is printed separately.
+//
+//   bench_grammar -m model.bin [-g grammar.gbnf] [-p penalty] [-l lang] [-t threads] [-r runs] file.wav ...
+//
+// Without -g a small home-automation grammar is used.
+
+#include "common.h"
+#include "../grammar.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static const char * default_grammar =
+        "root   ::= \" \"? (action \" \" device | \"stop\" | \"cancel\") \".\"?\n"
+        "action ::= \"turn on\" | \"turn off\" | \"open\" | \"close\"\n"
+        "device ::= \"the \"? (\"light\" | \"fan\" | \"door\" | \"window\" | \"radio\")\n";
+
+static char * read_text(const char * path) {
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char * text = malloc(size + 1);
+    if (text && fread(text, 1, size, f) != (size_t) size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+static void run(struct transcriber * tr, const char * name, const float * samples, int n, const struct grammar * g, float penalty,
+        const char * lang, int n_threads, int runs) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+    if (g) {
+        grammar_apply(g, &params, penalty);
+        params.no_timestamps = true;
+        params.single_segment = true;
+        if (grammar_max_bytes(g) > 0) {
+            params.max_tokens = grammar_max_bytes(g) + 1;
+        }
+    }
+
+    struct transcribe_policy policy = transcribe_default_policy();
+    policy.max_fallbacks_per_window = g ? 0 : policy.max_fallbacks_per_window;
+    transcriber_set_policy(tr, policy);
+
+    float total_ms = 0.0f;
+    for (int r = 0; r < runs; r++) {
+        transcriber_run_pcm(tr, params, samples, n);
+        total_ms += transcriber_stats(tr)->total_ms;
+    }
+
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+    printf("%-20s %-7s steps=%4d passes=%d total=%8.1f ms  '", name, g ? "grammar" : "free", stats->n_steps, stats->n_passes, total_ms/runs);
+    for (int i = 0; i < transcriber_n_segments(tr); i++) {
+        printf("%s", transcriber_segment(tr, i)->text);
+    }
+    printf("'\n");
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * grammar_path = NULL;
+    const char * lang = "en";
+    float penalty = 100.0f;
+    int n_threads = 4;
+    int runs = 3;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:g:p:l:t:r:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'g': grammar_path = optarg; break;
+            case 'p': penalty = (float) atof(optarg); break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            default: break;
+        }
+    }
+    if (!model || optind >= argc) {
+        fprintf(stderr, "usage: %s -m model.bin [-g grammar.gbnf] [-p penalty] [-l lang] [-t threads] [-r runs] file.wav ...\n", argv[0]);
+        return 1;
+    }
+    runs = runs < 1 ? 1 : runs;
+
+    char * src = grammar_path ? read_text(grammar_path) : NULL;
+    if (grammar_path && !src) {
+        fprintf(stderr, "failed to read '%s'\n", grammar_path);
+        return 1;
+    }
+
+    char err[128] = "";
+    const int64_t t0_us = bench_time_us();
+    struct grammar * g = grammar_parse(src ? src : default_grammar, "root", err, sizeof(err));
+    const int64_t compile_us = bench_time_us() - t0_us;
+    if (!g) {
+        fprintf(stderr, "invalid grammar: %s\n", err);
+        return 1;
+    }
+    printf("grammar: %zu rules, longest match %d bytes, compiled in %.3f ms\n\n",
+            grammar_n_rules(g), grammar_max_bytes(g), compile_us/1000.0);
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        int n = 0;
+        float * samples = bench_read_wav(argv[i], &n);
+        if (!samples) {
+            continue;
+        }
+        const char * base = strrchr(argv[i], '/');
+        run(tr, base ? base + 1 : argv[i], samples, n, NULL, penalty, lang, n_threads, runs);
+        run(tr, base ? base + 1 : argv[i], samples, n, g, penalty, lang, n_threads, runs);
+        free(samples);
+    }
+
+    transcriber_free(tr);
+    grammar_free(g);
+    free(src);
+    return 0;
+}
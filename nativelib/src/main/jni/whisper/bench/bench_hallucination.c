@@ -0,0 +1,163 @@
+// Host benchmark: decoder time saved by the hallucination detector on a noisy
+// set (white noise, mains hum, synthetic music, speech-like audio in noise),
+// plus any WAV files given after the options.
+//
+//   bench_hallucination -m model.bin [-l lang] [-t threads] [-d seconds] [-v] [file.wav ...]
+//
+// Every clip is transcribed with the detector off and on; -v prints what the
+// detector stopped or dropped.
+
+#include "common.h"
+#include "../hallucination.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+struct clip {
+    char name[64];
+    float * samples;
+    int n_samples;
+};
+
+static float * synth_noise(int n, float amp, uint32_t seed) {
+    float * out = malloc(sizeof(float) * (n > 0 ? n : 1));
+    uint32_t rng = seed;
+    for (int i = 0; out && i < n; i++) {
+        rng = rng*1664525u + 1013904223u;
+        out[i] = amp*(float) (((rng >> 8)/16777216.0)*2.0 - 1.0);
+    }
+    return out;
+}
+
+static float * synth_hum(int n) {
+    float * out = synth_noise(n, 0.003f, 7);
+    for (int i = 0; out && i < n; i++) {
+        const double t = i/16000.0;
+        out[i] += (float) (0.05*sin(2.0*M_PI*50.0*t) + 0.02*sin(2.0*M_PI*150.0*t));
+    }
+    return out;
+}
+
+// chord progression with a beat, roughly what background music looks like to the encoder
+static float * synth_music(int n) {
+    static const double roots[4] = { 220.0, 174.61, 261.63, 196.0 };
+    float * out = synth_noise(n, 0.002f, 11);
+    for (int i = 0; out && i < n; i++) {
+        const double t = i/16000.0;
+        const double root = roots[(int) (t/2.0) % 4];
+        const double beat = exp(-8.0*fmod(t, 0.5));
+        double v = 0.0;
+        v += sin(2.0*M_PI*root*t);
+        v += sin(2.0*M_PI*root*1.26*t);
+        v += sin(2.0*M_PI*root*1.5*t);
+        out[i] += (float) (0.05*v*(0.5 + 0.5*beat));
+    }
+    return out;
+}
+
+static void run(struct transcriber * tr, const struct clip * c, bool enabled, bool verbose, const char * lang, int n_threads, float * total_ms, int * total_segments) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    transcriber_set_hallucination_filter(tr, enabled);
+    const int rc = transcriber_run_pcm(tr, params, c->samples, c->n_samples);
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+
+    printf("%-14s %-3s rc=%d windows=%d passes=%d segments=%d stopped=%d steps_saved<=%d dropped=%d total=%.1f ms\n",
+            c->name, enabled ? "on" : "off", rc, stats->n_windows, stats->n_passes, transcriber_n_segments(tr),
+            stats->n_stopped, stats->n_steps_saved, stats->n_suppressed, stats->total_ms);
+
+    const struct hallucination_detector * det = transcriber_hallucinations(tr);
+    if (verbose && enabled && det) {
+        for (int i = 0; i < hallucination_n_kept_events(det); i++) {
+            const struct hallucination_event * ev = hallucination_get_event(det, i);
+            printf("    w%d %-11s n=%3d period=%d x%d ratio=%.2f '%s'\n", ev->window, hallucination_reason_str(ev->reason),
+                    ev->n_tokens, ev->period, ev->repeats, ev->compression, ev->text);
+        }
+    }
+
+    *total_ms += stats->total_ms;
+    *total_segments += transcriber_n_segments(tr);
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    float seconds = 60.0f;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:l:t:d:v")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            case 'v': verbose = true; break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-l lang] [-t threads] [-d seconds] [-v] [file.wav ...]\n", argv[0]);
+        return 1;
+    }
+
+    const int n = (int) (seconds*16000);
+    struct clip clips[64];
+    int n_clips = 0;
+
+    snprintf(clips[n_clips].name, sizeof(clips[0].name), "white-noise");
+    clips[n_clips].samples = synth_noise(n, 0.05f, 3);
+    clips[n_clips++].n_samples = n;
+    snprintf(clips[n_clips].name, sizeof(clips[0].name), "hum");
+    clips[n_clips].samples = synth_hum(n);
+    clips[n_clips++].n_samples = n;
+    snprintf(clips[n_clips].name, sizeof(clips[0].name), "music");
+    clips[n_clips].samples = synth_music(n);
+    clips[n_clips++].n_samples = n;
+    snprintf(clips[n_clips].name, sizeof(clips[0].name), "voice-in-noise");
+    clips[n_clips].samples = bench_synth_audio(n, 0.05f, 5);
+    clips[n_clips++].n_samples = n;
+
+    for (int i = optind; i < argc && n_clips < 64; i++) {
+        const char * base = strrchr(argv[i], '/');
+        snprintf(clips[n_clips].name, sizeof(clips[0].name), "%s", base ? base + 1 : argv[i]);
+        clips[n_clips].samples = bench_read_wav(argv[i], &clips[n_clips].n_samples);
+        if (clips[n_clips].samples) {
+            n_clips++;
+        }
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        return 1;
+    }
+
+    float ms_off = 0.0f;
+    float ms_on = 0.0f;
+    int segments_off = 0;
+    int segments_on = 0;
+    for (int i = 0; i < n_clips; i++) {
+        run(tr, &clips[i], false, verbose, lang, n_threads, &ms_off, &segments_off);
+        run(tr, &clips[i], true, verbose, lang, n_threads, &ms_on, &segments_on);
+    }
+
+    printf("\ntotal: off %.1f ms (%d segments), on %.1f ms (%d segments), saved %.1f ms (%.1f%%)\n",
+            ms_off, segments_off, ms_on, segments_on, ms_off - ms_on,
+            ms_off > 0.0f ? 100.0f*(ms_off - ms_on)/ms_off : 0.0f);
+
+    transcriber_free(tr);
+    for (int i = 0; i < n_clips; i++) {
+        free(clips[i].samples);
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Host benchmark: CPU time per audio second of keyword spotting at several
+// duty cycles, against transcribing every window with the full transcriber.
+//
+//   bench_kws -m model.bin -k keyword [-k keyword ...] [-w window_ms] [-h hop_ms] [-c 1,0.5,0.25]
+//             [-s threshold] [-l lang] [-t threads] [-d seconds] [-b] [file.wav]
+//
+// The audio is pushed in 100 ms blocks as a recorder would deliver it. Without
+// a WAV file a speech-like synthetic signal is used (it contains no keyword,
+// so it measures the cost of listening). -b adds the transcription baseline.
+
+#include "common.h"
+#include "../kws.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_KEYWORDS 16
+
+static double cpu_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+static void run_kws(struct whisper_context * ctx, struct kws_params params, const char ** keywords, int n_keywords,
+        const float * samples, int n) {
+    struct kws * k = kws_init(ctx, params);
+    if (!k) {
+        fprintf(stderr, "failed to create the spotter\n");
+        return;
+    }
+    for (int i = 0; i < n_keywords; i++) {
+        if (kws_add_keyword(k, keywords[i]) < 0) {
+            fprintf(stderr, "keyword ignored: '%s'\n", keywords[i]);
+        }
+    }
+
+    struct kws_detection dets[8];
+    for (int i = 0; i < n; i += 1600) {
+        const int m = n - i < 1600 ? n - i : 1600;
+        const int n_dets = kws_push(k, samples + i, m, dets, 8);
+        for (int d = 0; d < n_dets; d++) {
+            printf("    %7.2f-%7.2f s '%s' score %.2f\n", dets[d].t0_ms/1000.0, dets[d].t1_ms/1000.0,
+                    keywords[dets[d].keyword], dets[d].score);
+        }
+    }
+
+    const struct kws_stats * st = kws_get_stats(k);
+    printf("kws  duty=%.2f windows=%4d skipped=%4d steps=%5d hits=%d cpu=%7.1f ms/audio-s wall=%6.1f ms/audio-s\n",
+            params.duty_cycle, st->n_windows, st->n_skipped, st->n_steps, st->n_detections,
+            st->cpu_ms/st->audio_s, st->wall_ms/st->audio_s);
+    kws_free(k);
+}
+
+// what repeatedly transcribing the last window would cost
+static void run_baseline(struct transcriber * tr, const struct kws_params * kp, const float * samples, int n) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = kp->language;
+    params.n_threads = kp->n_threads;
+    params.no_context = true;
+
+    const int window_n = kp->window_ms*16;
+    const int hop_n = kp->hop_ms*16;
+    int n_windows = 0;
+    const double t0 = cpu_ms();
+    for (int end = window_n; end <= n; end += hop_n) {
+        transcriber_run_pcm(tr, params, samples + end - window_n, window_n);
+        n_windows++;
+    }
+    const double ms = cpu_ms() - t0;
+    printf("full transcription   windows=%4d                        cpu=%7.1f ms/audio-s\n", n_windows, ms/(n/16000.0));
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * keywords[MAX_KEYWORDS];
+    int n_keywords = 0;
+    const char * duties = "1,0.5,0.25";
+    float seconds = 30.0f;
+    bool baseline = false;
+    struct kws_params params = kws_default_params();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:k:w:h:c:s:l:t:d:b")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'k': if (n_keywords < MAX_KEYWORDS) { keywords[n_keywords++] = optarg; } break;
+            case 'w': params.window_ms = atoi(optarg); break;
+            case 'h': params.hop_ms = atoi(optarg); break;
+            case 'c': duties = optarg; break;
+            case 's': params.threshold = (float) atof(optarg); break;
+            case 'l': params.language = optarg; break;
+            case 't': params.n_threads = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            case 'b': baseline = true; break;
+            default: break;
+        }
+    }
+    if (!model || n_keywords == 0) {
+        fprintf(stderr, "usage: %s -m model.bin -k keyword [-k keyword ...] [-w window_ms] [-h hop_ms] [-c 1,0.5,0.25] "
+                "[-s threshold] [-l lang] [-t threads] [-d seconds] [-b] [file.wav]\n", argv[0]);
+        return 1;
+    }
+
+    int n = (int) (seconds*16000);
+    float * samples = optind < argc ? bench_read_wav(argv[optind], &n) : bench_synth_audio(n, 0.01f, 9);
+    if (!samples) {
+        fprintf(stderr, "failed to read audio\n");
+        return 1;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+
+    printf("audio %.1f s, window %d ms, hop %d ms\n", n/16000.0, params.window_ms, params.hop_ms);
+    for (const char * p = duties; *p; ) {
+        params.duty_cycle = (float) atof(p);
+        run_kws(transcriber_context(tr), params, keywords, n_keywords, samples, n);
+        p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p);
+    }
+    if (baseline) {
+        run_baseline(tr, &params, samples, n);
+    }
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
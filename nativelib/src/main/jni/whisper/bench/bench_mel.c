@@ -0,0 +1,194 @@
+// Host benchmark: native log-mel front-end vs whisper_pcm_to_mel.
+//
+//   bench_mel [-m model.bin] [-f audio.wav] [-d seconds] [-t threads] [-r reps] [-n n_mel] [-c]
+//
+// Without -m only the native front-end is timed (n_mel from -n).
+// -c checks the output against a straightforward double precision
+// implementation of whisper's algorithm (dense DFT, materialized padding).
+
+#include "common.h"
+#include "../mel.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static double ref_hz_to_mel(double f) {
+    return f >= 1000.0 ? 15.0 + log(f/1000.0)/(log(6.4)/27.0) : 3.0*f/200.0;
+}
+
+static double ref_mel_to_hz(double m) {
+    return m >= 15.0 ? 1000.0*exp((log(6.4)/27.0)*(m - 15.0)) : 200.0*m/3.0;
+}
+
+static float * ref_log_mel(const float * samples, int n_samples, int n_mel, int * out_len) {
+    const int n_fft = MEL_N_BINS;
+    const int pad = MEL_N_FFT/2;
+    const int n_padded = n_samples + MEL_SAMPLE_RATE*30 + 2*pad;
+
+    float * padded = calloc(n_padded, sizeof(float));
+    memcpy(padded + pad, samples, sizeof(float) * n_samples);
+    for (int i = 0; i < pad; i++) {
+        padded[i] = pad - i < n_samples ? samples[pad - i] : 0.0f;
+    }
+
+    double * filters = calloc((size_t) n_mel*n_fft, sizeof(double));
+    double mel_f[256 + 2];
+    for (int i = 0; i < n_mel + 2; i++) {
+        mel_f[i] = ref_mel_to_hz(ref_hz_to_mel(8000.0)*i/(n_mel + 1));
+    }
+    for (int j = 0; j < n_mel; j++) {
+        for (int k = 0; k < n_fft; k++) {
+            const double f = 40.0*k;
+            const double lo = (f - mel_f[j])/(mel_f[j + 1] - mel_f[j]);
+            const double hi = (mel_f[j + 2] - f)/(mel_f[j + 2] - mel_f[j + 1]);
+            filters[j*n_fft + k] = fmax(0.0, fmin(lo, hi))*2.0/(mel_f[j + 2] - mel_f[j]);
+        }
+    }
+
+    const int n_len = (n_padded - MEL_N_FFT)/MEL_HOP_LENGTH;
+    float * mel = malloc(sizeof(float) * (size_t) n_mel*n_len);
+    double power[MEL_N_BINS];
+    double mmax = -1e20;
+
+    for (int i = 0; i < n_len; i++) {
+        const float * frame = padded + i*MEL_HOP_LENGTH;
+        for (int k = 0; k < n_fft; k++) {
+            double re = 0.0;
+            double im = 0.0;
+            for (int j = 0; j < MEL_N_FFT; j++) {
+                const double w = 0.5*(1.0 - cos(2.0*M_PI*j/MEL_N_FFT));
+                const double theta = 2.0*M_PI*((long) j*k % MEL_N_FFT)/MEL_N_FFT;
+                re += w*frame[j]*cos(theta);
+                im -= w*frame[j]*sin(theta);
+            }
+            power[k] = re*re + im*im;
+        }
+        for (int j = 0; j < n_mel; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n_fft; k++) {
+                sum += power[k]*filters[j*n_fft + k];
+            }
+            const double v = log10(fmax(sum, 1e-10));
+            mel[(size_t) j*n_len + i] = (float) v;
+            mmax = fmax(mmax, v);
+        }
+    }
+    for (size_t i = 0; i < (size_t) n_mel*n_len; i++) {
+        mel[i] = (float) ((fmax(mel[i], mmax - 8.0) + 4.0)/4.0);
+    }
+
+    free(padded);
+    free(filters);
+    *out_len = n_len;
+    return mel;
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * wav = NULL;
+    float seconds = 60.0f;
+    int n_threads = 4;
+    int reps = 5;
+    int n_mel = 80;
+    int check = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:d:t:r:n:c")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'f': wav = optarg; break;
+            case 'd': seconds = (float) atof(optarg); break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'r': reps = atoi(optarg); break;
+            case 'n': n_mel = atoi(optarg); break;
+            case 'c': check = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-m model.bin] [-f audio.wav] [-d seconds] [-t threads] [-r reps] [-n n_mel] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    int n_samples = 0;
+    float * samples = NULL;
+    if (wav) {
+        samples = bench_read_wav(wav, &n_samples);
+    } else {
+        n_samples = (int) (seconds*MEL_SAMPLE_RATE);
+        samples = bench_synth_audio(n_samples, 0.01f, 1234);
+    }
+    if (!samples) {
+        return 1;
+    }
+
+    struct whisper_context * ctx = NULL;
+    if (model) {
+        ctx = whisper_init_from_file_with_params(model, whisper_context_default_params());
+        if (!ctx) {
+            fprintf(stderr, "failed to load '%s'\n", model);
+            return 1;
+        }
+        n_mel = whisper_model_n_mels(ctx);
+    }
+
+    printf("audio: %.1f s, n_mel = %d, threads = %d, reps = %d\n", n_samples/(double) MEL_SAMPLE_RATE, n_mel, n_threads, reps);
+
+    int64_t t_init = bench_time_us();
+    const struct mel_frontend * fe = mel_frontend_get(n_mel);
+    t_init = bench_time_us() - t_init;
+    if (!fe) {
+        fprintf(stderr, "unsupported n_mel = %d\n", n_mel);
+        return 1;
+    }
+    printf("native  plan init          : %8.3f ms (once per process)\n", t_init/1000.0);
+
+    struct mel_spectrogram mel = {0};
+    int64_t best_native = INT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        const int64_t t0 = bench_time_us();
+        mel_frontend_compute(fe, samples, n_samples, n_threads, &mel);
+        const int64_t dt = bench_time_us() - t0;
+        best_native = dt < best_native ? dt : best_native;
+    }
+    printf("native  mel_frontend_compute: %8.3f ms (best of %d), %d frames\n", best_native/1000.0, reps, mel.n_len);
+
+    if (ctx) {
+        int64_t best_whisper = INT64_MAX;
+        for (int r = 0; r < reps; r++) {
+            const int64_t t0 = bench_time_us();
+            whisper_pcm_to_mel(ctx, samples, n_samples, n_threads);
+            const int64_t dt = bench_time_us() - t0;
+            best_whisper = dt < best_whisper ? dt : best_whisper;
+        }
+        printf("whisper whisper_pcm_to_mel  : %8.3f ms (best of %d)\n", best_whisper/1000.0, reps);
+        printf("speedup                     : %8.2fx\n", (double) best_whisper/best_native);
+
+        int64_t t0 = bench_time_us();
+        const int rc = whisper_set_mel(ctx, mel.data, mel.n_len, mel.n_mel);
+        printf("whisper_set_mel             : %8.3f ms (rc = %d)\n", (bench_time_us() - t0)/1000.0, rc);
+
+        whisper_free(ctx);
+    }
+
+    if (check) {
+        const int n_check = n_samples < 60*MEL_SAMPLE_RATE ? n_samples : 60*MEL_SAMPLE_RATE;
+        mel_frontend_compute(fe, samples, n_check, n_threads, &mel);
+
+        int n_len = 0;
+        float * ref = ref_log_mel(samples, n_check, n_mel, &n_len);
+
+        double max_err = 0.0;
+        for (int j = 0; j < n_mel; j++) {
+            for (int i = 0; i < n_len && i < mel.n_len; i++) {
+                max_err = fmax(max_err, fabs(ref[(size_t) j*n_len + i] - mel.data[(size_t) j*mel.n_len + i]));
+            }
+        }
+        printf("check: frames %d/%d, max abs error vs reference: %.2e %s\n",
+                mel.n_len, n_len, max_err, (n_len == mel.n_len && max_err < 1e-3) ? "OK" : "MISMATCH");
+        free(ref);
+    }
+
+    mel_spectrogram_free(&mel);
+    free(samples);
+
+    return 0;
+}
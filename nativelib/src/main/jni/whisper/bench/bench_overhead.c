@@ -0,0 +1,99 @@
+// Host benchmark: per-call overhead of transcribing short clips back to back,
+// with whisper's full 30 s window and with fit_short_clips. Each call is split
+// into setup (everything before the encoder runs), encode and decode; the first
+// call of each mode is reported apart as the cold one.
+//
+//   bench_overhead -m model.bin [-n calls] [-l lang] [-t threads] [-d seconds] [file.wav]
+//
+// The clip defaults to 1 s of synthetic speech (or the first -d seconds of the file).
+
+#include "common.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static void run(struct transcriber * tr, bool fit, const float * samples, int n, const char * lang, int n_threads, int calls) {
+    struct transcribe_policy policy = transcribe_default_policy();
+    policy.fit_short_clips = fit;
+    transcriber_set_policy(tr, policy);
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    double total = 0.0, setup = 0.0, encode = 0.0;
+    int reuses = 0;
+    for (int c = 0; c <= calls; c++) {
+        if (transcriber_run_pcm(tr, params, samples, n) != 0) {
+            fprintf(stderr, "transcription failed\n");
+            return;
+        }
+        const struct transcribe_stats * st = transcriber_stats(tr);
+        if (c == 0) {
+            printf("%-6s cold  total %8.2f ms  setup %7.2f  encode %8.2f  decode %8.2f  audio_ctx %4d\n",
+                    fit ? "fitted" : "full", st->total_ms, st->setup_ms, st->encode_ms,
+                    st->total_ms - st->setup_ms - st->encode_ms, st->audio_ctx);
+            continue;
+        }
+        total += st->total_ms;
+        setup += st->setup_ms;
+        encode += st->encode_ms;
+        reuses += st->n_shape_reuses;
+    }
+    printf("%-6s warm  total %8.2f ms  setup %7.2f  encode %8.2f  decode %8.2f  shape reused %d/%d\n",
+            fit ? "fitted" : "full", total/calls, setup/calls, encode/calls, (total - setup - encode)/calls, reuses, calls);
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    int calls = 20;
+    float seconds = 1.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:l:t:d:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'n': calls = atoi(optarg); break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-n calls] [-l lang] [-t threads] [-d seconds] [file.wav]\n", argv[0]);
+        return 1;
+    }
+    calls = calls < 1 ? 1 : calls;
+
+    int n = (int) (seconds*16000);
+    float * samples = optind < argc ? bench_read_wav(argv[optind], &n) : bench_synth_audio(n, 0.01f, 9);
+    if (!samples) {
+        fprintf(stderr, "failed to read audio\n");
+        return 1;
+    }
+    n = n < (int) (seconds*16000) ? n : (int) (seconds*16000);
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+
+    printf("clip %.2f s, %d warm calls per mode\n", n/16000.0, calls);
+    run(tr, false, samples, n, lang, n_threads, calls);
+    run(tr, true, samples, n, lang, n_threads, calls);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Host benchmark: wall time of long audio decoded window after window by
+// whisper_full, and with pipelined_encode, where the next window is encoded on
+// spare cores while the current one decodes. Reports the encoder time hidden
+// behind decoding, how many speculative windows were used and how long the
+// decoder waited for the encoder.
+//
+//   bench_pipeline -m model.bin [-t threads] [-l lang] [-d seconds] [file.wav]
+//
+// Without a file, -d seconds (default 600) of synthetic speech are decoded.
+
+#include "common.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static void run(struct transcriber * tr, bool pipelined, const float * samples, int n, const char * lang, int n_threads) {
+    struct transcribe_policy policy = transcribe_default_policy();
+    policy.pipelined_encode = pipelined;
+    transcriber_set_policy(tr, policy);
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+
+    if (transcriber_run_pcm(tr, params, samples, n) != 0) {
+        fprintf(stderr, "transcription failed\n");
+        return;
+    }
+    const struct transcribe_stats * st = transcriber_stats(tr);
+    printf("%-9s  %7d  %8d  %9.1f  %9.1f  %9.1f  %7d/%-7d  %8.2f  %s\n",
+            pipelined ? "pipelined" : "whisper", st->n_windows, transcriber_n_segments(tr), st->total_ms, st->encode_ms,
+            st->encode_hidden_ms, st->n_spec_hits, st->n_speculated, (n/16.0f)/st->total_ms,
+            pipelined && st->n_speculated == 0 ? "(no VAD or one window)" : "");
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    float seconds = 600.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:t:l:d:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'l': lang = optarg; break;
+            case 'd': seconds = (float) atof(optarg); break;
+            default: break;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-t threads] [-l lang] [-d seconds] [file.wav]\n", argv[0]);
+        return 1;
+    }
+
+    int n = (int) (seconds*16000);
+    float * samples = optind < argc ? bench_read_wav(argv[optind], &n) : bench_synth_audio(n, 0.01f, 9);
+    if (!samples) {
+        fprintf(stderr, "failed to read audio\n");
+        return 1;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+
+    printf("audio %.1f s, %d threads\n", n/16000.0, n_threads);
+    printf("mode       windows  segments  total-ms   encode-ms  hidden-ms  hits/speculated  x-realtime\n");
+    run(tr, false, samples, n, lang, n_threads);
+    run(tr, true, samples, n, lang, n_threads);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Host benchmark: temperature fallbacks and decode time with and without the
+// native pre-processing stage (high-pass, spectral noise gate, AGC).
+//
+//   bench_preprocess -m model.bin -f audio.wav [-l lang] [-t threads] [-s snr_db] [-g gain_db]
+//
+// -s mixes white noise at the given SNR and -g attenuates the clip, to mimic
+// a noisy or quiet AudioSource.MIC recording. Passes and fallbacks come from
+// the transcriber, with the fallback budget disabled so whisper's full
+// schedule is measured.
+
+#include "common.h"
+#include "../preprocess.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+static void run(struct transcriber * tr, const char * label, const float * samples, int n_samples, const char * lang, int n_threads) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.no_context = true;
+
+    const int rc = transcriber_run_pcm(tr, params, samples, n_samples);
+    const struct transcribe_stats * stats = transcriber_stats(tr);
+
+    printf("%-8s rc=%d windows=%d passes=%d fallbacks=%d (%.1f ms) total=%.1f ms RTF=%.3f\n",
+            label, rc, stats->n_windows, stats->n_passes, stats->n_fallbacks, stats->fallback_ms,
+            stats->total_ms, stats->total_ms/1000.0/(n_samples/16000.0));
+
+    for (int i = 0; i < transcriber_n_segments(tr); i++) {
+        const struct transcribe_segment * seg = transcriber_segment(tr, i);
+        printf("         [%6.2f - %6.2f] %s\n", seg->t0/100.0, seg->t1/100.0, seg->text);
+    }
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * wav = NULL;
+    const char * lang = "en";
+    int n_threads = 4;
+    float snr_db = INFINITY;
+    float gain_db = 0.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:l:t:s:g:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'f': wav = optarg; break;
+            case 'l': lang = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 's': snr_db = (float) atof(optarg); break;
+            case 'g': gain_db = (float) atof(optarg); break;
+            default: break;
+        }
+    }
+    if (!model || !wav) {
+        fprintf(stderr, "usage: %s -m model.bin -f audio.wav [-l lang] [-t threads] [-s snr_db] [-g gain_db]\n", argv[0]);
+        return 1;
+    }
+
+    int n_samples = 0;
+    float * samples = bench_read_wav(wav, &n_samples);
+    if (!samples) {
+        return 1;
+    }
+
+    if (isfinite(snr_db)) {
+        bench_add_noise(samples, n_samples, snr_db, 42);
+    }
+    const float gain = powf(10.0f, gain_db/20.0f);
+    for (int i = 0; i < n_samples; i++) {
+        samples[i] *= gain;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        return 1;
+    }
+    struct transcribe_policy policy = transcriber_get_policy(tr);
+    policy.fallback_budget_per_minute = -1.0f;
+    transcriber_set_policy(tr, policy);
+
+    run(tr, "raw", samples, n_samples, lang, n_threads);
+
+    struct preprocessor * pp = preprocess_init(preprocess_default_params());
+    const int64_t t0 = bench_time_us();
+    preprocess_clip(pp, samples, n_samples);
+    const int64_t t1 = bench_time_us();
+    preprocess_free(pp);
+    printf("preprocess: %.2f ms for %.1f s of audio\n", (t1 - t0)/1000.0, n_samples/16000.0);
+
+    run(tr, "cleaned", samples, n_samples, lang, n_threads);
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
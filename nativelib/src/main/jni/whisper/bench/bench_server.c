@@ -0,0 +1,292 @@
+// Host benchmark: load test of the transcription server. n clients each send
+// r requests of d seconds of audio at once, streamed as chunked PCM (at
+// realtime pace with -R, like a live microphone), and read the segments back.
+// Reports time to the first segment, latency from the end of the upload to the
+// final line, and the server's queueing, against an in-process server with -m
+// or a running whisper_server with -u/-p.
+//
+//   bench_server [-m model.bin -w workers -t threads] [-u socket | -p port] [-n 1,4,16] [-r requests] [-d seconds] [-R] [file.wav]
+
+#include "common.h"
+#include "../server.h"
+#include "whisper.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct target {
+    const char * socket_path;
+    int port;
+};
+
+struct client {
+    const struct target * target;
+    const int16_t * pcm;
+    int n_samples;
+    int n_requests;
+    bool realtime;
+    // results
+    double * latency_ms;     // [n_requests], end of upload to the final line
+    double * first_ms;       // [n_requests], start of upload to the first segment, -1 = none
+    int n_ok;
+    int n_segments;
+};
+
+static int connect_target(const struct target * t) {
+    if (t->socket_path) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        const bool abstract = t->socket_path[0] == '@';
+        const size_t n = strlen(t->socket_path);
+        if (n >= sizeof(addr.sun_path)) {
+            return -1;
+        }
+        memcpy(addr.sun_path + (abstract ? 1 : 0), t->socket_path + (abstract ? 1 : 0), n - (abstract ? 1 : 0));
+        const socklen_t len = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + n + (abstract ? 0 : 1));
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (const struct sockaddr *) &addr, len) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) t->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (const struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_all(int fd, const void * data, size_t n) {
+    const char * p = data;
+    while (n > 0) {
+        const ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k <= 0) {
+            return -1;
+        }
+        p += k;
+        n -= (size_t) k;
+    }
+    return 0;
+}
+
+// One request: chunked upload in 0.5 s pieces, then the response up to the
+// server closing the connection.
+static int run_request(struct client * c, double * latency_ms, double * first_ms, int * n_segments) {
+    const int fd = connect_target(c->target);
+    if (fd < 0) {
+        return -1;
+    }
+    static const char head[] = "POST /transcribe?lang=en HTTP/1.1\r\nHost: localhost\r\n"
+                               "Content-Type: audio/L16;rate=16000\r\nTransfer-Encoding: chunked\r\n\r\n";
+    int rc = send_all(fd, head, sizeof(head) - 1);
+    const int64_t t0 = bench_time_us();
+    const int piece = 8000;
+    for (int i = 0; rc == 0 && i < c->n_samples; i += piece) {
+        const int n = c->n_samples - i < piece ? c->n_samples - i : piece;
+        char len[16];
+        const int h = snprintf(len, sizeof(len), "%x\r\n", n*2);
+        rc = send_all(fd, len, (size_t) h) | send_all(fd, c->pcm + i, sizeof(int16_t) * n) | send_all(fd, "\r\n", 2);
+        if (c->realtime) {
+            const int64_t due = t0 + (int64_t) (i + n)*1000000/16000;
+            const int64_t now = bench_time_us();
+            if (due > now) {
+                usleep((useconds_t) (due - now));
+            }
+        }
+    }
+    if (rc == 0) {
+        rc = send_all(fd, "0\r\n\r\n", 5);
+    }
+    const int64_t t_sent = bench_time_us();
+
+    // segments are counted on the fly, the connection closes after the last line
+    char buf[8192];
+    bool done = false;
+    *first_ms = -1.0;
+    *n_segments = 0;
+    ssize_t k;
+    while (rc == 0 && (k = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        buf[k] = '\0';
+        for (const char * p = buf; (p = strstr(p, "{\"t0\"")) != NULL; p++) {
+            if (*first_ms < 0.0) {
+                *first_ms = (bench_time_us() - t0)/1000.0;
+            }
+            (*n_segments)++;
+        }
+        done = done || strstr(buf, "\"done\":true") != NULL;
+    }
+    *latency_ms = (bench_time_us() - t_sent)/1000.0;
+    close(fd);
+    return rc == 0 && done ? 0 : -1;
+}
+
+static void * client_main(void * arg) {
+    struct client * c = arg;
+    for (int i = 0; i < c->n_requests; i++) {
+        int n_segments = 0;
+        if (run_request(c, &c->latency_ms[c->n_ok], &c->first_ms[c->n_ok], &n_segments) == 0) {
+            c->n_segments += n_segments;
+            c->n_ok++;
+        }
+    }
+    return NULL;
+}
+
+static int cmp_double(const void * a, const void * b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void run(const struct target * t, const int16_t * pcm, int n_samples, int n_clients, int n_requests, bool realtime) {
+    struct client * clients = calloc((size_t) n_clients, sizeof(struct client));
+    pthread_t * threads = calloc((size_t) n_clients, sizeof(pthread_t));
+    double * latency = calloc((size_t) n_clients*n_requests, sizeof(double));
+    double * first = calloc((size_t) n_clients*n_requests, sizeof(double));
+    if (!clients || !threads || !latency || !first) {
+        free(clients);
+        free(threads);
+        free(latency);
+        free(first);
+        return;
+    }
+
+    const int64_t t0 = bench_time_us();
+    for (int i = 0; i < n_clients; i++) {
+        clients[i] = (struct client) {
+            .target = t, .pcm = pcm, .n_samples = n_samples, .n_requests = n_requests, .realtime = realtime,
+            .latency_ms = latency + (size_t) i*n_requests, .first_ms = first + (size_t) i*n_requests,
+        };
+        pthread_create(&threads[i], NULL, client_main, &clients[i]);
+    }
+    int n_ok = 0;
+    int n_segments = 0;
+    for (int i = 0; i < n_clients; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    const double wall_s = (bench_time_us() - t0)/1e6;
+
+    // compact the successful requests of every client
+    int n_first = 0;
+    for (int i = 0; i < n_clients; i++) {
+        for (int j = 0; j < clients[i].n_ok; j++) {
+            latency[n_ok++] = clients[i].latency_ms[j];
+            if (clients[i].first_ms[j] >= 0.0) {
+                first[n_first++] = clients[i].first_ms[j];
+            }
+        }
+        n_segments += clients[i].n_segments;
+    }
+    qsort(latency, (size_t) n_ok, sizeof(double), cmp_double);
+    qsort(first, (size_t) n_first, sizeof(double), cmp_double);
+    const double audio_s = (double) n_ok*n_samples/16000.0;
+    printf("%3d clients  %4d/%4d ok  %6d segments  latency p50 %8.1f  p95 %8.1f  max %8.1f ms  first segment p50 %8.1f ms  %7.2f audio s/s\n",
+            n_clients, n_ok, n_clients*n_requests, n_segments,
+            n_ok ? latency[n_ok/2] : 0.0, n_ok ? latency[(int) (n_ok*0.95)] : 0.0, n_ok ? latency[n_ok - 1] : 0.0,
+            n_first ? first[n_first/2] : -1.0, audio_s/wall_s);
+
+    free(clients);
+    free(threads);
+    free(latency);
+    free(first);
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * clients = "1,4,16";
+    struct target t = { NULL, 0 };
+    int n_workers = 1;
+    int n_threads = 4;
+    int n_requests = 4;
+    float seconds = 5.0f;
+    bool realtime = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:w:t:u:p:n:r:d:R")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'w': n_workers = atoi(optarg); break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'u': t.socket_path = optarg; break;
+            case 'p': t.port = atoi(optarg); break;
+            case 'n': clients = optarg; break;
+            case 'r': n_requests = atoi(optarg); break;
+            case 'd': seconds = (float) atof(optarg); break;
+            case 'R': realtime = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-m model.bin -w workers -t threads] [-u socket | -p port] [-n 1,4,16] [-r requests] [-d seconds] [-R] [file.wav]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!model && !t.socket_path && t.port == 0) {
+        fprintf(stderr, "either -m for an in-process server or -u/-p for a running one\n");
+        return 1;
+    }
+
+    int n_samples = 0;
+    float * audio = optind < argc ? bench_read_wav(argv[optind], &n_samples) : bench_synth_audio(n_samples = (int) (seconds*16000), 0.01f, 7);
+    int16_t * pcm = audio ? malloc(sizeof(int16_t) * (n_samples > 0 ? n_samples : 1)) : NULL;
+    if (!pcm) {
+        fprintf(stderr, "no audio\n");
+        return 1;
+    }
+    for (int i = 0; i < n_samples; i++) {
+        const float v = audio[i] < -1.0f ? -1.0f : audio[i] > 1.0f ? 1.0f : audio[i];
+        pcm[i] = (int16_t) (v*32767.0f);
+    }
+    free(audio);
+
+    struct server * s = NULL;
+    if (model) {
+        struct transcriber ** workers = calloc((size_t) n_workers, sizeof(struct transcriber *));
+        for (int i = 0; workers && i < n_workers; i++) {
+            workers[i] = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+        }
+        struct server_params params = server_default_params();
+        params.n_threads = n_threads;
+        params.max_clients = 256;
+        if (!t.socket_path && t.port == 0) {
+            t.socket_path = "/tmp/bench_server.sock";
+        }
+        params.socket_path = t.socket_path;
+        params.port = t.port;
+        s = workers ? server_start(workers, n_workers, params) : NULL;
+        free(workers);
+        if (!s) {
+            fprintf(stderr, "failed to start the server with '%s'\n", model);
+            free(pcm);
+            return 1;
+        }
+    }
+
+    printf("%.1f s per request, %d requests per client%s\n", n_samples/16000.0, n_requests, realtime ? ", streamed at realtime pace" : "");
+    for (const char * p = clients; *p; ) {
+        const int n = atoi(p);
+        p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p);
+        if (n > 0) {
+            run(&t, pcm, n_samples, n, n_requests, realtime);
+        }
+    }
+
+    if (s) {
+        const struct server_stats st = server_get_stats(s);
+        printf("server: %d jobs, %d failed, %d rejected, wait %.1f ms mean / %.1f ms max, busy %.1f ms\n",
+                st.n_jobs, st.n_failed, st.n_rejected, st.n_jobs ? st.wait_ms/st.n_jobs : 0.0f, st.max_wait_ms, st.busy_ms);
+        server_stop(s);
+    }
+    free(pcm);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Host benchmark: real-time factor over a long transcription with and without
+// the thermal governor. Runs the same recording back to back so the device
+// heats up, and prints every window's time, the real-time factor of each run
+// and the throttling events the governor saw.
+//
+//   bench_thermal -m model.bin [-f audio.wav] [-s seconds] [-t threads] [-r runs] [-G] [-v]
+//
+// -G turns the governor off for the baseline; -v prints every window. On a
+// host without thermal zones or clock caps only the encoder slowdown is seen.
+
+#include "common.h"
+#include "../thermal.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * wav = NULL;
+    float seconds = 600.0f;
+    int n_threads = 4;
+    int runs = 3;
+    bool governor = true;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:s:t:r:Gv")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'f': wav = optarg; break;
+            case 's': seconds = (float) atof(optarg); break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            case 'G': governor = false; break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "usage: %s -m model.bin [-f audio.wav] [-s seconds] [-t threads] [-r runs] [-G] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!model) {
+        fprintf(stderr, "usage: %s -m model.bin [-f audio.wav] [-s seconds] [-t threads] [-r runs] [-G] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    int n_samples = 0;
+    float * samples = NULL;
+    if (wav) {
+        samples = bench_read_wav(wav, &n_samples);
+    } else {
+        n_samples = (int) (seconds*16000.0f);
+        samples = bench_synth_audio(n_samples, 0.01f, 1);
+    }
+    if (!samples) {
+        return 1;
+    }
+
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        free(samples);
+        return 1;
+    }
+    transcriber_set_thermal_governor(tr, governor);
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = "en";
+    params.n_threads = n_threads;
+
+    const float audio_s = n_samples/16000.0f;
+    printf("%.1f s of audio, %d threads, governor %s\n", audio_s, n_threads, governor ? "on" : "off");
+    for (int r = 0; r < runs; r++) {
+        if (transcriber_run_pcm(tr, params, samples, n_samples) != 0) {
+            fprintf(stderr, "run %d failed\n", r);
+            break;
+        }
+        const struct transcribe_stats * st = transcriber_stats(tr);
+
+        // the slowest and fastest window: a collapsing RTF shows as a widening spread
+        float min_ms = 0.0f;
+        float max_ms = 0.0f;
+        int last_window = -1;
+        for (int i = 0; i < transcriber_n_segments(tr); i++) {
+            const struct transcribe_segment * seg = transcriber_segment(tr, i);
+            if (seg->window == last_window) {
+                continue;
+            }
+            last_window = seg->window;
+            min_ms = min_ms == 0.0f || seg->window_ms < min_ms ? seg->window_ms : min_ms;
+            max_ms = seg->window_ms > max_ms ? seg->window_ms : max_ms;
+            if (verbose) {
+                printf("  window %3d  %8.1f ms\n", seg->window, seg->window_ms);
+            }
+        }
+        printf("run %d: %8.1f ms  rtf %.3f  %d windows  window %.1f..%.1f ms  encode %.1f ms",
+                r, st->total_ms, st->total_ms/(1000.0f*audio_s), st->n_windows, min_ms, max_ms, st->encode_ms);
+
+        const struct thermal_governor * g = transcriber_thermal(tr);
+        if (g) {
+            printf("  throttled %d windows, up to %.1f C\n", thermal_n_throttled_windows(g), thermal_max_temp_c(g));
+            for (int i = 0; i < thermal_n_kept_events(g); i++) {
+                const struct thermal_event * ev = thermal_get_event(g, i);
+                printf("  window %3d: %-13s %5.1f C  encode %7.1f ms  %d threads on %#llx -> %d threads on %#llx\n",
+                        ev->window, thermal_reason_str(ev->reason), ev->temp_c, ev->encode_ms,
+                        ev->from.n_threads, (unsigned long long) ev->from.cpu_mask,
+                        ev->to.n_threads, (unsigned long long) ev->to.cpu_mask);
+            }
+        } else {
+            printf("\n");
+        }
+    }
+
+    transcriber_free(tr);
+    free(samples);
+    return 0;
+}
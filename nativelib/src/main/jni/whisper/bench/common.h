@@ -0,0 +1,146 @@
+#ifndef WHISPER_JNI_BENCH_COMMON_H
+#define WHISPER_JNI_BENCH_COMMON_H
+
+// Helpers shared by the host benchmarks (not part of the Android library).
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline int64_t bench_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+// Reads a 16 kHz 16-bit PCM WAV file and downmixes it to mono float samples.
+// Walks the RIFF chunks instead of assuming a 44 byte header.
+static inline float * bench_read_wav(const char * path, int * n_samples) {
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "failed to open '%s'\n", path);
+        return NULL;
+    }
+
+    uint8_t hdr[12];
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "'%s' is not a RIFF/WAVE file\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    int channels = 0;
+    int sample_rate = 0;
+    int bits = 0;
+    float * out = NULL;
+
+    uint8_t ch[8];
+    while (fread(ch, 1, 8, f) == 8) {
+        const uint32_t size = ch[4] | (ch[5] << 8) | (ch[6] << 16) | ((uint32_t) ch[7] << 24);
+        if (memcmp(ch, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, f) != 16) {
+                break;
+            }
+            channels    = fmt[2] | (fmt[3] << 8);
+            sample_rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+            bits        = fmt[14] | (fmt[15] << 8);
+            fseek(f, (long) (size - 16 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(ch, "data", 4) == 0) {
+            if (channels <= 0 || bits != 16 || sample_rate != 16000) {
+                fprintf(stderr, "'%s': need 16 kHz 16-bit PCM (got %d Hz, %d bit, %d ch)\n", path, sample_rate, bits, channels);
+                break;
+            }
+            const int n = (int) (size/(2*channels));
+            int16_t * pcm = malloc(sizeof(int16_t) * (size_t) n*channels);
+            out = malloc(sizeof(float) * (n > 0 ? n : 1));
+            const size_t got = pcm && out ? fread(pcm, sizeof(int16_t), (size_t) n*channels, f) : 0;
+            for (int i = 0; i < (int) (got/channels); i++) {
+                float s = 0.0f;
+                for (int c = 0; c < channels; c++) {
+                    s += pcm[i*channels + c];
+                }
+                out[i] = s/(32768.0f*channels);
+            }
+            *n_samples = (int) (got/channels);
+            free(pcm);
+            break;
+        } else {
+            fseek(f, (long) (size + (size & 1)), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    return out;
+}
+
+// Deterministic speech-like test signal: a gliding harmonic voice with a
+// syllable-rate envelope, pauses and a low noise floor.
+static inline float * bench_synth_audio(int n_samples, float noise, uint32_t seed) {
+    float * out = malloc(sizeof(float) * (n_samples > 0 ? n_samples : 1));
+    if (!out) {
+        return NULL;
+    }
+    uint32_t rng = seed ? seed : 1;
+    double phase = 0.0;
+    for (int i = 0; i < n_samples; i++) {
+        const double t = i/16000.0;
+        const double f0 = 120.0 + 40.0*sin(2.0*M_PI*0.7*t);
+        phase += 2.0*M_PI*f0/16000.0;
+        const double env = fmax(0.0, sin(2.0*M_PI*4.0*t))*(fmod(t, 5.0) < 4.0 ? 1.0 : 0.0);
+        double v = 0.0;
+        for (int h = 1; h <= 8; h++) {
+            v += sin(h*phase)/h;
+        }
+        rng = rng*1664525u + 1013904223u;
+        const double r = ((rng >> 8)/16777216.0)*2.0 - 1.0;
+        out[i] = (float) (0.2*env*v + noise*r);
+    }
+    return out;
+}
+
+// Mixes uniform white noise into samples at the given SNR (dB).
+static inline void bench_add_noise(float * samples, int n_samples, float snr_db, uint32_t seed) {
+    double power = 0.0;
+    for (int i = 0; i < n_samples; i++) {
+        power += samples[i]*samples[i];
+    }
+    const double noise_rms = sqrt(power/(n_samples > 0 ? n_samples : 1)/pow(10.0, snr_db/10.0));
+    uint32_t rng = seed ? seed : 1;
+    for (int i = 0; i < n_samples; i++) {
+        rng = rng*1664525u + 1013904223u;
+        samples[i] += (float) (noise_rms*sqrt(3.0)*(((rng >> 8)/16777216.0)*2.0 - 1.0));
+    }
+}
+
+// Peak resident set size in MB since the last bench_reset_peak_rss, -1 when
+// /proc is not available.
+static inline double bench_peak_rss_mb(void) {
+    FILE * f = fopen("/proc/self/status", "r");
+    if (!f) {
+        return -1.0;
+    }
+    char line[256];
+    double kb = -1.0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) {
+            kb = atof(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb/1024.0;
+}
+
+static inline void bench_reset_peak_rss(void) {
+    FILE * f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+#endif // WHISPER_JNI_BENCH_COMMON_H
@@ -0,0 +1,194 @@
+#ifndef WHISPER_JNI_BENCH_WER_H
+#define WHISPER_JNI_BENCH_WER_H
+
+// Word and character error rates for the evaluation tool (host only).
+//
+// Both texts are normalized first: ASCII case is folded, full-width ASCII
+// becomes half-width, the ideographic space is a space, and punctuation
+// (ASCII, CJK brackets and marks, curly quotes) separates words without
+// counting itself; apostrophes are dropped so "don't" and "dont" agree.
+//
+// Japanese and Chinese put no spaces between words and whisper's output does
+// not segment them the way a reference does, so every kana and ideograph is a
+// word of its own; runs of other characters are split at whitespace. Mixed text
+// like "今日はGoogleの会議" scores as 今 日 は google の 会 議. For Japanese
+// the WER is then close to the CER, which is the figure to compare across
+// builds; the WER mainly tells apart the English words in it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct wer_counts {
+    int n_ref;   // reference tokens
+    int n_sub;
+    int n_del;
+    int n_ins;
+};
+
+static inline int wer_errors(struct wer_counts c) {
+    return c.n_sub + c.n_del + c.n_ins;
+}
+
+// Next code point of a UTF-8 string; a malformed byte is returned as U+FFFD.
+static inline uint32_t wer_next_cp(const unsigned char ** s) {
+    const unsigned char * p = *s;
+    uint32_t c = p[0];
+    int n = c < 0x80 ? 0 : (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : (c & 0xf8) == 0xf0 ? 3 : -1;
+    if (n < 0) {
+        *s = p + 1;
+        return 0xfffd;
+    }
+    c = n == 0 ? c : n == 1 ? c & 0x1f : n == 2 ? c & 0x0f : c & 0x07;
+    for (int i = 1; i <= n; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            *s = p + i;
+            return 0xfffd;
+        }
+        c = (c << 6) | (p[i] & 0x3f);
+    }
+    *s = p + n + 1;
+    return c;
+}
+
+// Normalized code point: ' ' for separators, 0 for characters that are dropped.
+static inline uint32_t wer_fold(uint32_t c) {
+    if (c >= 0xff01 && c <= 0xff5e) {
+        c -= 0xfee0;   // full-width ASCII
+    }
+    if (c == '\'' || c == 0x2019) {
+        return 0;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c + ('a' - 'A');
+    }
+    if (c < 0x80) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ? c : ' ';
+    }
+    if (c == 0x3000 || (c >= 0x3001 && c <= 0x3003) || (c >= 0x3008 && c <= 0x3011) ||
+            (c >= 0x3014 && c <= 0x301f) || c == 0x30fb || (c >= 0xff61 && c <= 0xff65) ||
+            (c >= 0x2010 && c <= 0x2027) || c == 0x00a0 || c == 0x00b7 || c == 0x00bf || c == 0x00a1) {
+        return ' ';
+    }
+    return c;
+}
+
+// Kana, CJK ideographs and the long vowel mark: one token each.
+static inline bool wer_is_cjk(uint32_t c) {
+    return (c >= 0x3040 && c <= 0x30ff) || (c >= 0x31f0 && c <= 0x31ff) || (c >= 0x3400 && c <= 0x4dbf) ||
+           (c >= 0x4e00 && c <= 0x9fff) || (c >= 0xf900 && c <= 0xfaff) || (c >= 0xff66 && c <= 0xff9f) ||
+           (c >= 0x20000 && c <= 0x2ffff);
+}
+
+// Tokens of text as FNV-1a hashes of their normalized code points, words or
+// (chars) single characters without spaces. Returns the count, *tokens is
+// malloc'ed and owned by the caller; -1 when out of memory.
+static inline int wer_tokenize(const char * text, bool chars, uint64_t ** tokens) {
+    int cap = 64;
+    int n = 0;
+    uint64_t * t = malloc(sizeof(uint64_t) * cap);
+    uint64_t h = 0;
+    bool in_word = false;
+    const unsigned char * s = (const unsigned char *) text;
+    while (t) {
+        const uint32_t c = *s ? wer_fold(wer_next_cp(&s)) : ' ';
+        if (c == 0) {
+            continue;
+        }
+        const bool single = chars || wer_is_cjk(c);
+        // a word ends at a separator, a single-token character or the end
+        if (in_word && (c == ' ' || single)) {
+            t[n++] = h;
+            in_word = false;
+        }
+        if (n + 1 >= cap) {
+            uint64_t * grown = realloc(t, sizeof(uint64_t) * (cap *= 2));
+            if (!grown) {
+                free(t);
+                t = NULL;
+                break;
+            }
+            t = grown;
+        }
+        if (c != ' ') {
+            if (!in_word) {
+                h = 1469598103934665603ULL;
+            }
+            h = (h ^ c)*1099511628211ULL;
+            if (single) {
+                t[n++] = h;
+            } else {
+                in_word = true;
+            }
+        }
+        if (!*s && !in_word) {
+            break;
+        }
+    }
+    *tokens = t;
+    return t ? n : -1;
+}
+
+// Minimum edit alignment of hyp against ref. Among alignments of equal cost
+// substitutions are preferred, as in the usual WER tools.
+static inline struct wer_counts wer_align(const uint64_t * ref, int n_ref, const uint64_t * hyp, int n_hyp) {
+    struct wer_counts out = { n_ref, 0, 0, 0 };
+    struct cell { int cost, sub, del, ins; };
+    struct cell * prev = malloc(sizeof(struct cell) * (n_hyp + 1));
+    struct cell * cur = malloc(sizeof(struct cell) * (n_hyp + 1));
+    if (!prev || !cur) {
+        free(prev);
+        free(cur);
+        out.n_del = n_ref;
+        return out;
+    }
+    for (int j = 0; j <= n_hyp; j++) {
+        prev[j] = (struct cell) { j, 0, 0, j };
+    }
+    for (int i = 1; i <= n_ref; i++) {
+        cur[0] = (struct cell) { i, 0, i, 0 };
+        for (int j = 1; j <= n_hyp; j++) {
+            const bool same = ref[i - 1] == hyp[j - 1];
+            struct cell best = prev[j - 1];
+            best.cost += same ? 0 : 1;
+            best.sub += same ? 0 : 1;
+            if (prev[j].cost + 1 < best.cost) {
+                best = prev[j];
+                best.cost++;
+                best.del++;
+            }
+            if (cur[j - 1].cost + 1 < best.cost) {
+                best = cur[j - 1];
+                best.cost++;
+                best.ins++;
+            }
+            cur[j] = best;
+        }
+        struct cell * tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    out.n_sub = prev[n_hyp].sub;
+    out.n_del = prev[n_hyp].del;
+    out.n_ins = prev[n_hyp].ins;
+    free(prev);
+    free(cur);
+    return out;
+}
+
+// Word (chars = false) or character error counts of hyp against ref.
+static inline struct wer_counts wer_score(const char * ref, const char * hyp, bool chars) {
+    uint64_t * r = NULL;
+    uint64_t * h = NULL;
+    const int n_ref = wer_tokenize(ref, chars, &r);
+    const int n_hyp = wer_tokenize(hyp, chars, &h);
+    struct wer_counts c = { n_ref > 0 ? n_ref : 0, 0, 0, 0 };
+    if (n_ref >= 0 && n_hyp >= 0) {
+        c = wer_align(r, n_ref, h, n_hyp);
+    }
+    free(r);
+    free(h);
+    return c;
+}
+
+#endif // WHISPER_JNI_BENCH_WER_H
@@ -0,0 +1,477 @@
+// Host evaluation: did a build, quant level or parameter change trade accuracy
+// for speed? Runs every recording of a manifest through transcriber_run_pcm
+// with the parameters fullTranscribe uses and scores the text against its
+// reference: WER and CER (Japanese-aware, see wer.h), real-time factor,
+// per-stage times and peak RSS. -o stores the results as a baseline, -b
+// compares against one and exits with 2 when the corpus WER or CER rose by
+// more than -W points or the real-time factor by more than -S percent, and
+// with 1 when a recording failed or the baseline held no readable results.
+//
+//   whisper_eval -m model.bin -f manifest.tsv [-t threads] [-r runs] [-o results.tsv] [-b baseline.tsv] [-W points] [-S percent] [-v] [-P]
+//
+// The manifest has one recording per line, "file<TAB>lang<TAB>reference", lang
+// a whisper code or "auto"; relative paths start at the manifest's directory
+// and '#' starts a comment line. Any WAV the streaming reader accepts works
+// (any rate and channel count). With -r the times are the median of the runs;
+// the first recording is transcribed once before timing to warm up. -P adds
+// the hardware counters of each stage of the last run (see perf_counters.h).
+
+#include "common.h"
+#include "wer.h"
+#include "../audio_file.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+#define EVAL_MAX_RUNS 16
+
+struct eval_result {
+    char * name;            // manifest path, the key of the baseline
+    char lang[16];
+    float audio_s;
+    struct wer_counts words;
+    struct wer_counts chars;
+    float total_ms;
+    float mel_ms;
+    float setup_ms;         // mel, VAD and whisper's setup, up to the first encoder run
+    float encode_ms;
+    float decode_ms;        // the rest: decoder passes and fallbacks
+    float rss_mb;
+    char * text;
+};
+
+struct eval_set {
+    struct eval_result * r;
+    int n;
+    int cap;
+};
+
+static struct eval_result * eval_add(struct eval_set * set) {
+    if (set->n == set->cap) {
+        const int cap = set->cap ? 2*set->cap : 64;
+        struct eval_result * r = realloc(set->r, sizeof(struct eval_result) * cap);
+        if (!r) {
+            return NULL;
+        }
+        set->r = r;
+        set->cap = cap;
+    }
+    struct eval_result * r = &set->r[set->n++];
+    memset(r, 0, sizeof(*r));
+    return r;
+}
+
+static void eval_free(struct eval_set * set) {
+    for (int i = 0; i < set->n; i++) {
+        free(set->r[i].name);
+        free(set->r[i].text);
+    }
+    free(set->r);
+}
+
+// Tabs and line breaks would break the TSV.
+static char * eval_flatten(const char * text) {
+    char * s = strdup(text ? text : "");
+    for (char * p = s; p && *p; p++) {
+        if (*p == '\t' || *p == '\n' || *p == '\r') {
+            *p = ' ';
+        }
+    }
+    return s;
+}
+
+static float * eval_read_audio(const char * path, int * n_samples) {
+    struct audio_file * f = audio_file_open(path);
+    if (!f) {
+        return NULL;
+    }
+    int cap = 30*AUDIO_FILE_RATE;
+    int n = 0;
+    float * out = malloc(sizeof(float) * cap);
+    int k = 0;
+    while (out && (k = audio_file_read(f, out + n, cap - n)) > 0) {
+        n += k;
+        if (n == cap) {
+            float * grown = realloc(out, sizeof(float) * (cap *= 2));
+            if (!grown) {
+                free(out);
+            }
+            out = grown;
+        }
+    }
+    audio_file_close(f);
+    if (k < 0) {
+        free(out);
+        return NULL;
+    }
+    *n_samples = n;
+    return out;
+}
+
+// The parameters fullTranscribe passes (transcribe_params in jni.c).
+static struct whisper_full_params eval_params(const char * lang, int n_threads) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.translate = false;
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang;
+    params.n_threads = n_threads;
+    params.offset_ms = 0;
+    params.no_context = true;
+    params.single_segment = false;
+    return params;
+}
+
+static int cmp_float(const void * a, const void * b) {
+    const float x = *(const float *) a;
+    const float y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+static int eval_one(struct transcriber * tr, const char * path, struct eval_result * r, const char * ref, int n_threads, int n_runs) {
+    int n_samples = 0;
+    float * samples = eval_read_audio(path, &n_samples);
+    if (!samples) {
+        fprintf(stderr, "failed to read '%s'\n", path);
+        return -1;
+    }
+    r->audio_s = n_samples/(float) AUDIO_FILE_RATE;
+
+    // every run's stage times, the median of each is reported
+    float t[5][EVAL_MAX_RUNS];
+    bench_reset_peak_rss();
+    for (int i = 0; i < n_runs; i++) {
+        if (transcriber_run_pcm(tr, eval_params(r->lang, n_threads), samples, n_samples) != 0) {
+            fprintf(stderr, "failed to transcribe '%s'\n", path);
+            free(samples);
+            return -1;
+        }
+        const struct transcribe_stats * st = transcriber_stats(tr);
+        t[0][i] = st->total_ms;
+        t[1][i] = st->mel_ms;
+        t[2][i] = st->setup_ms;
+        t[3][i] = st->encode_ms;
+        t[4][i] = st->total_ms - st->setup_ms - st->encode_ms;
+    }
+    r->rss_mb = (float) bench_peak_rss_mb();
+    free(samples);
+    for (int k = 0; k < 5; k++) {
+        qsort(t[k], (size_t) n_runs, sizeof(float), cmp_float);
+    }
+    r->total_ms = t[0][n_runs/2];
+    r->mel_ms = t[1][n_runs/2];
+    r->setup_ms = t[2][n_runs/2];
+    r->encode_ms = t[3][n_runs/2];
+    r->decode_ms = t[4][n_runs/2];
+
+    r->text = eval_flatten(transcriber_text(tr));
+    r->words = wer_score(ref, r->text, false);
+    r->chars = wer_score(ref, r->text, true);
+    return r->text ? 0 : -1;
+}
+
+struct eval_total {
+    struct wer_counts words;
+    struct wer_counts chars;
+    double audio_s;
+    double total_ms;
+    double mel_ms;
+    double setup_ms;
+    double encode_ms;
+    double decode_ms;
+    float rss_mb;
+};
+
+static void eval_sum(struct eval_total * t, const struct eval_result * r) {
+    t->words.n_ref += r->words.n_ref;
+    t->words.n_sub += r->words.n_sub;
+    t->words.n_del += r->words.n_del;
+    t->words.n_ins += r->words.n_ins;
+    t->chars.n_ref += r->chars.n_ref;
+    t->chars.n_sub += r->chars.n_sub;
+    t->chars.n_del += r->chars.n_del;
+    t->chars.n_ins += r->chars.n_ins;
+    t->audio_s += r->audio_s;
+    t->total_ms += r->total_ms;
+    t->mel_ms += r->mel_ms;
+    t->setup_ms += r->setup_ms;
+    t->encode_ms += r->encode_ms;
+    t->decode_ms += r->decode_ms;
+    t->rss_mb = r->rss_mb > t->rss_mb ? r->rss_mb : t->rss_mb;
+}
+
+// error rate in percent
+static double eval_rate(struct wer_counts c) {
+    return c.n_ref > 0 ? 100.0*wer_errors(c)/c.n_ref : (wer_errors(c) > 0 ? 100.0 : 0.0);
+}
+
+static double eval_rtf(double total_ms, double audio_s) {
+    return audio_s > 0.0 ? total_ms/(1000.0*audio_s) : 0.0;
+}
+
+#define EVAL_HEADER "# name\tlang\taudio_s\twords\tword_sub\tword_del\tword_ins\tchars\tchar_sub\tchar_del\tchar_ins\t" \
+                    "total_ms\tmel_ms\tsetup_ms\tencode_ms\tdecode_ms\trss_mb\ttext"
+
+static int eval_write(const char * path, const struct eval_set * set) {
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "failed to write '%s'\n", path);
+        return -1;
+    }
+    fprintf(f, "%s\n", EVAL_HEADER);
+    for (int i = 0; i < set->n; i++) {
+        const struct eval_result * r = &set->r[i];
+        fprintf(f, "%s\t%s\t%.3f\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%s\n",
+                r->name, r->lang, r->audio_s,
+                r->words.n_ref, r->words.n_sub, r->words.n_del, r->words.n_ins,
+                r->chars.n_ref, r->chars.n_sub, r->chars.n_del, r->chars.n_ins,
+                r->total_ms, r->mel_ms, r->setup_ms, r->encode_ms, r->decode_ms, r->rss_mb, r->text);
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int eval_read(const char * path, struct eval_set * set) {
+    FILE * f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "failed to open the baseline '%s'\n", path);
+        return -1;
+    }
+    char * line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, f) > 0) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        char * name = line;
+        char * tab = strchr(name, '\t');
+        struct eval_result * r = tab ? eval_add(set) : NULL;
+        if (!r) {
+            continue;
+        }
+        *tab = '\0';
+        int n = 0;
+        const int k = sscanf(tab + 1, "%15s %f %d %d %d %d %d %d %d %d %f %f %f %f %f %f%n",
+                r->lang, &r->audio_s,
+                &r->words.n_ref, &r->words.n_sub, &r->words.n_del, &r->words.n_ins,
+                &r->chars.n_ref, &r->chars.n_sub, &r->chars.n_del, &r->chars.n_ins,
+                &r->total_ms, &r->mel_ms, &r->setup_ms, &r->encode_ms, &r->decode_ms, &r->rss_mb, &n);
+        if (k != 16) {
+            set->n--;
+            continue;
+        }
+        const char * text = tab + 1 + n;
+        r->name = strdup(name);
+        r->text = strdup(*text == '\t' ? text + 1 : text);
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+static const struct eval_result * eval_find(const struct eval_set * set, const char * name) {
+    for (int i = 0; i < set->n; i++) {
+        if (strcmp(set->r[i].name, name) == 0) {
+            return &set->r[i];
+        }
+    }
+    return NULL;
+}
+
+// Per-recording deltas and corpus totals of cur against base, over the
+// recordings both have. Returns true when the totals regressed.
+static bool eval_diff(const struct eval_set * base, const struct eval_set * cur, float max_points, float max_slowdown, bool verbose) {
+    struct eval_total tb = {0};
+    struct eval_total tc = {0};
+    printf("\n%-32s %15s %15s %17s  text\n", "vs baseline", "WER %", "CER %", "RTF");
+    for (int i = 0; i < cur->n; i++) {
+        const struct eval_result * c = &cur->r[i];
+        const struct eval_result * b = eval_find(base, c->name);
+        if (!b) {
+            printf("%-32.32s new\n", c->name);
+            continue;
+        }
+        eval_sum(&tb, b);
+        eval_sum(&tc, c);
+        const bool same = strcmp(b->text, c->text) == 0;
+        printf("%-32.32s %6.1f -> %6.1f %6.1f -> %6.1f %7.3f -> %7.3f  %s\n", c->name,
+                eval_rate(b->words), eval_rate(c->words), eval_rate(b->chars), eval_rate(c->chars),
+                eval_rtf(b->total_ms, b->audio_s), eval_rtf(c->total_ms, c->audio_s), same ? "same" : "changed");
+        if (verbose && !same) {
+            printf("    was: %s\n    now: %s\n", b->text, c->text);
+        }
+    }
+    for (int i = 0; i < base->n; i++) {
+        if (!eval_find(cur, base->r[i].name)) {
+            printf("%-32.32s missing\n", base->r[i].name);
+        }
+    }
+
+    const double d_wer = eval_rate(tc.words) - eval_rate(tb.words);
+    const double d_cer = eval_rate(tc.chars) - eval_rate(tb.chars);
+    const double rtf_b = eval_rtf(tb.total_ms, tb.audio_s);
+    const double rtf_c = eval_rtf(tc.total_ms, tc.audio_s);
+    const double slowdown = rtf_b > 0.0 ? 100.0*(rtf_c - rtf_b)/rtf_b : 0.0;
+    printf("%-32s %6.2f -> %6.2f %6.2f -> %6.2f %7.3f -> %7.3f  (%+.1f%%)\n", "total",
+            eval_rate(tb.words), eval_rate(tc.words), eval_rate(tb.chars), eval_rate(tc.chars), rtf_b, rtf_c, slowdown);
+    printf("stages ms: mel %.0f -> %.0f, setup %.0f -> %.0f, encode %.0f -> %.0f, decode %.0f -> %.0f; peak RSS %.0f -> %.0f MB\n",
+            tb.mel_ms, tc.mel_ms, tb.setup_ms, tc.setup_ms, tb.encode_ms, tc.encode_ms, tb.decode_ms, tc.decode_ms, tb.rss_mb, tc.rss_mb);
+
+    const bool worse = d_wer > max_points || d_cer > max_points || slowdown > max_slowdown;
+    if (worse) {
+        printf("REGRESSION:%s%s%s\n", d_wer > max_points ? " WER" : "", d_cer > max_points ? " CER" : "",
+                slowdown > max_slowdown ? " speed" : "");
+    }
+    return worse;
+}
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    const char * manifest = NULL;
+    const char * out_path = NULL;
+    const char * base_path = NULL;
+    int n_threads = 4;
+    int n_runs = 1;
+    float max_points = 0.5f;
+    float max_slowdown = 10.0f;
+    bool verbose = false;
+    bool counters = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:t:r:o:b:W:S:vP")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'f': manifest = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'r': n_runs = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'b': base_path = optarg; break;
+            case 'W': max_points = (float) atof(optarg); break;
+            case 'S': max_slowdown = (float) atof(optarg); break;
+            case 'v': verbose = true; break;
+            case 'P': counters = true; break;
+            default:
+                fprintf(stderr, "usage: %s -m model.bin -f manifest.tsv [-t threads] [-r runs] [-o results.tsv] [-b baseline.tsv] [-W points] [-S percent] [-v] [-P]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!model || !manifest) {
+        fprintf(stderr, "-m model.bin and -f manifest.tsv are required\n");
+        return 1;
+    }
+    n_runs = n_runs < 1 ? 1 : n_runs > EVAL_MAX_RUNS ? EVAL_MAX_RUNS : n_runs;
+
+    FILE * mf = fopen(manifest, "r");
+    if (!mf) {
+        fprintf(stderr, "failed to open '%s'\n", manifest);
+        return 1;
+    }
+    const char * slash = strrchr(manifest, '/');
+    const int dir_len = slash ? (int) (slash - manifest) + 1 : 0;
+
+    const int64_t t_load = bench_time_us();
+    struct transcriber * tr = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+    if (!tr) {
+        fprintf(stderr, "failed to load '%s'\n", model);
+        fclose(mf);
+        return 1;
+    }
+    if (counters && transcriber_set_perf_counters(tr, true) != 0) {
+        fprintf(stderr, "perf_event_open is not allowed (kernel.perf_event_paranoid), running without counters\n");
+        counters = false;
+    }
+    printf("model %s loaded in %.0f ms, %d threads, %d run%s per recording\n",
+            model, (bench_time_us() - t_load)/1000.0, n_threads, n_runs, n_runs > 1 ? "s" : "");
+    printf("%-32s %5s %7s %6s %6s %7s %8s %8s %8s %8s %7s\n",
+            "recording", "lang", "audio s", "WER %", "CER %", "RTF", "mel ms", "setup ms", "enc ms", "dec ms", "RSS MB");
+
+    struct eval_set cur = {0};
+    struct eval_total total = {0};
+    int n_failed = 0;
+    bool warm = false;
+    char * line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, mf) > 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char * lang = strchr(line, '\t');
+        char * ref = lang ? strchr(lang + 1, '\t') : NULL;
+        if (line[0] == '#' || !ref) {
+            if (line[0] != '#' && line[0] != '\0') {
+                fprintf(stderr, "skipping manifest line without file, lang and reference: %s\n", line);
+            }
+            continue;
+        }
+        *lang++ = '\0';
+        *ref++ = '\0';
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%.*s%s", line[0] == '/' ? 0 : dir_len, manifest, line);
+        struct eval_result * r = eval_add(&cur);
+        if (!r) {
+            break;
+        }
+        r->name = strdup(line);
+        snprintf(r->lang, sizeof(r->lang), "%s", lang);
+        if (!warm) {
+            struct eval_result scratch = *r;
+            eval_one(tr, path, &scratch, ref, n_threads, 1);
+            free(scratch.text);
+            warm = true;
+        }
+        if (eval_one(tr, path, r, ref, n_threads, n_runs) != 0) {
+            free(r->name);
+            free(r->text);
+            cur.n--;
+            n_failed++;
+            continue;
+        }
+        eval_sum(&total, r);
+        printf("%-32.32s %5s %7.1f %6.1f %6.1f %7.3f %8.0f %8.0f %8.0f %8.0f %7.0f\n",
+                r->name, r->lang, r->audio_s, eval_rate(r->words), eval_rate(r->chars), eval_rtf(r->total_ms, r->audio_s),
+                r->mel_ms, r->setup_ms, r->encode_ms, r->decode_ms, r->rss_mb);
+        if (counters) {
+            const struct transcribe_perf * perf = transcriber_perf(tr);
+            const struct perf_sample * stages[] = { &perf->mel, &perf->encode, &perf->decode, &perf->total };
+            const char * names[] = { "mel", "encode", "decode", "total" };
+            for (int i = 0; i < 4; i++) {
+                char buf[512];
+                perf_sample_format(stages[i], buf, sizeof(buf));
+                printf("    %-6s %s\n", names[i], buf);
+            }
+        }
+    }
+    free(line);
+    fclose(mf);
+    transcriber_free(tr);
+
+    printf("%-32s %5s %7.1f %6.2f %6.2f %7.3f %8.0f %8.0f %8.0f %8.0f %7.0f\n", "total", "",
+            total.audio_s, eval_rate(total.words), eval_rate(total.chars), eval_rtf(total.total_ms, total.audio_s),
+            total.mel_ms, total.setup_ms, total.encode_ms, total.decode_ms, total.rss_mb);
+    printf("words: %d, %d substituted, %d deleted, %d inserted; chars: %d, %d substituted, %d deleted, %d inserted%s\n",
+            total.words.n_ref, total.words.n_sub, total.words.n_del, total.words.n_ins,
+            total.chars.n_ref, total.chars.n_sub, total.chars.n_del, total.chars.n_ins,
+            n_failed ? "; some recordings failed" : "");
+
+    bool worse = false;
+    bool no_base = false;
+    if (base_path) {
+        struct eval_set base = {0};
+        if (eval_read(base_path, &base) != 0) {
+            no_base = true;
+        } else if (base.n == 0) {
+            fprintf(stderr, "no results in the baseline '%s'\n", base_path);
+            no_base = true;
+        } else {
+            worse = eval_diff(&base, &cur, max_points, max_slowdown, verbose);
+        }
+        eval_free(&base);
+    }
+    if (out_path && eval_write(out_path, &cur) == 0) {
+        printf("results written to %s\n", out_path);
+    }
+    eval_free(&cur);
+    return worse ? 2 : n_failed || no_base ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Standalone transcription server for load tests and other processes on the
+// host: loads the model once per worker and serves until SIGINT/SIGTERM, then
+// prints the server statistics.
+//
+//   whisper_server -m model.bin [-u socket | -u @abstract] [-U uid ...] [-A] [-p port] [-w workers] [-t threads] [-c clients]
+//
+// Socket clients of other uids need -U, or -A to serve every uid.
+//
+//   curl --unix-socket /tmp/whisper.sock --data-binary @audio.s16 'http://x/transcribe?lang=en'
+//   curl --data-binary @audio.s16 'http://127.0.0.1:8178/transcribe?lang=en'
+
+#include "common.h"
+#include "../server.h"
+#include "whisper.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+int main(int argc, char ** argv) {
+    const char * model = NULL;
+    int n_workers = 1;
+    struct server_params params = server_default_params();
+    uid_t uids[16];
+    int n_uids = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:u:U:Ap:w:t:c:")) != -1) {
+        switch (opt) {
+            case 'm': model = optarg; break;
+            case 'u': params.socket_path = optarg; break;
+            case 'U':
+                if (n_uids < (int) (sizeof(uids)/sizeof(uids[0]))) {
+                    uids[n_uids++] = (uid_t) atoi(optarg);
+                }
+                break;
+            case 'A': params.any_uid = true; break;
+            case 'p': params.port = atoi(optarg); break;
+            case 'w': n_workers = atoi(optarg); break;
+            case 't': params.n_threads = atoi(optarg); break;
+            case 'c': params.max_clients = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s -m model.bin [-u socket] [-U uid ...] [-A] [-p port] [-w workers] [-t threads] [-c clients]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!model || n_workers < 1) {
+        fprintf(stderr, "usage: %s -m model.bin [-u socket] [-U uid ...] [-A] [-p port] [-w workers] [-t threads] [-c clients]\n", argv[0]);
+        return 1;
+    }
+    params.allowed_uids = uids;
+    params.n_allowed_uids = n_uids;
+    if (!params.socket_path && params.port == 0) {
+        params.socket_path = "/tmp/whisper.sock";
+    }
+
+    // the server threads inherit the mask, so only sigwait sees the signals
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    struct transcriber ** workers = calloc((size_t) n_workers, sizeof(struct transcriber *));
+    for (int i = 0; workers && i < n_workers; i++) {
+        workers[i] = transcriber_init(whisper_init_from_file_with_params(model, whisper_context_default_params()));
+        if (!workers[i]) {
+            fprintf(stderr, "failed to load '%s'\n", model);
+            for (int j = 0; j < i; j++) {
+                transcriber_free(workers[j]);
+            }
+            free(workers);
+            return 1;
+        }
+    }
+    struct server * s = workers ? server_start(workers, n_workers, params) : NULL;
+    free(workers);
+    if (!s) {
+        fprintf(stderr, "failed to listen\n");
+        return 1;
+    }
+    printf("serving %d workers on%s%s%s", n_workers, params.socket_path ? " unix:" : "",
+            params.socket_path ? params.socket_path : "", params.port > 0 ? "" : "\n");
+    if (params.port > 0) {
+        printf(" http://127.0.0.1:%d\n", params.port);
+    }
+    fflush(stdout);
+
+    int sig;
+    sigwait(&stop, &sig);
+    const struct server_stats st = server_get_stats(s);
+    server_stop(s);
+    printf("%d jobs (%d failed, %d rejected), %d segments, %.1f s of audio, wait %.1f ms total / %.1f ms max, busy %.1f ms\n",
+            st.n_jobs, st.n_failed, st.n_rejected, st.n_segments, st.audio_s, st.wait_ms, st.max_wait_ms, st.busy_ms);
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include "bias.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// longest phrase in tokens; longer ones are cut
+#define BIAS_MAX_TOKENS 32
+
+struct bias_node {
+    whisper_token token;
+    float boost;         // added to the logit of token after the parent prefix
+    int first_child;     // build-time child list, -1 terminated
+    int next_sibling;
+    int fail;            // longest proper suffix that is also a prefix
+    int edge_begin;      // children in edges[], sorted by token
+    int n_edges;
+};
+
+struct bias_trie {
+    struct bias_node * nodes;  // nodes[0] is the root
+    int n_nodes;
+    int cap_nodes;
+
+    whisper_token * edge_token;
+    int * edge_node;
+
+    int n_phrases;
+    int max_depth;
+    bool compiled;
+
+    // tokens raised in the current step, so a shorter prefix cannot raise one again
+    unsigned * stamp;
+    int n_stamp;
+    unsigned step;
+};
+
+static int bias_new_node(struct bias_trie * b, whisper_token token, float boost) {
+    if (b->n_nodes == b->cap_nodes) {
+        const int cap = b->cap_nodes > 0 ? 2*b->cap_nodes : 256;
+        struct bias_node * nodes = realloc(b->nodes, sizeof(struct bias_node) * cap);
+        if (!nodes) {
+            return -1;
+        }
+        b->nodes = nodes;
+        b->cap_nodes = cap;
+    }
+    struct bias_node * node = &b->nodes[b->n_nodes];
+    memset(node, 0, sizeof(*node));
+    node->token = token;
+    node->boost = boost;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    return b->n_nodes++;
+}
+
+struct bias_trie * bias_init(void) {
+    struct bias_trie * b = calloc(1, sizeof(struct bias_trie));
+    if (!b) {
+        return NULL;
+    }
+    if (bias_new_node(b, -1, 0.0f) != 0) {
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+void bias_free(struct bias_trie * b) {
+    if (!b) {
+        return;
+    }
+    free(b->nodes);
+    free(b->edge_token);
+    free(b->edge_node);
+    free(b->stamp);
+    free(b);
+}
+
+void bias_clear(struct bias_trie * b) {
+    b->n_nodes = 1;
+    b->nodes[0].first_child = -1;
+    b->n_phrases = 0;
+    b->max_depth = 0;
+    b->compiled = false;
+}
+
+static int bias_insert(struct bias_trie * b, const whisper_token * tokens, int n_tokens, float boost) {
+    if (n_tokens < 2 || boost <= 0.0f) {
+        return -1;
+    }
+    n_tokens = n_tokens > BIAS_MAX_TOKENS ? BIAS_MAX_TOKENS : n_tokens;
+
+    int cur = 0;
+    for (int i = 0; i < n_tokens; i++) {
+        int child = b->nodes[cur].first_child;
+        while (child >= 0 && b->nodes[child].token != tokens[i]) {
+            child = b->nodes[child].next_sibling;
+        }
+        if (child < 0) {
+            child = bias_new_node(b, tokens[i], boost);
+            if (child < 0) {
+                return -1;
+            }
+            b->nodes[child].next_sibling = b->nodes[cur].first_child;
+            b->nodes[cur].first_child = child;
+        } else if (b->nodes[child].boost < boost) {
+            b->nodes[child].boost = boost;
+        }
+        cur = child;
+    }
+
+    b->max_depth = n_tokens > b->max_depth ? n_tokens : b->max_depth;
+    b->compiled = false;
+    return 0;
+}
+
+int bias_add_tokens(struct bias_trie * b, const whisper_token * tokens, int n_tokens, float boost) {
+    if (bias_insert(b, tokens, n_tokens, boost) != 0) {
+        return -1;
+    }
+    b->n_phrases++;
+    return 0;
+}
+
+int bias_add_phrase(struct bias_trie * b, struct whisper_context * ctx, const char * text, float boost) {
+    while (*text == ' ') {
+        text++;
+    }
+    if (*text == '\0') {
+        return -1;
+    }
+
+    char spaced[256];
+    const size_t len = strlen(text);
+    if (len + 2 > sizeof(spaced)) {
+        return -1;
+    }
+    spaced[0] = ' ';
+    memcpy(spaced + 1, text, len + 1);
+
+    // either form may be a single token, the phrase counts if one can be biased
+    whisper_token tokens[BIAS_MAX_TOKENS];
+    int n_added = 0;
+    for (int k = 0; k < 2; k++) {
+        const int n = whisper_tokenize(ctx, k == 0 ? spaced : text, tokens, BIAS_MAX_TOKENS);
+        if (n > 0 && bias_insert(b, tokens, n, boost) == 0) {
+            n_added++;
+        }
+    }
+    if (n_added == 0) {
+        return -1;
+    }
+    b->n_phrases++;
+    return 0;
+}
+
+int bias_n_phrases(const struct bias_trie * b) {
+    return b->n_phrases;
+}
+
+static int bias_cmp_edge(const void * a, const void * b) {
+    const whisper_token ta = *(const whisper_token *) a;
+    const whisper_token tb = *(const whisper_token *) b;
+    return (ta > tb) - (ta < tb);
+}
+
+static int bias_child(const struct bias_trie * b, int node, whisper_token token) {
+    const whisper_token * edges = b->edge_token + b->nodes[node].edge_begin;
+    int lo = 0;
+    int hi = b->nodes[node].n_edges;
+    while (lo < hi) {
+        const int mid = (lo + hi)/2;
+        if (edges[mid] < token) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < b->nodes[node].n_edges && edges[lo] == token ? b->edge_node[b->nodes[node].edge_begin + lo] : -1;
+}
+
+// Aho-Corasick transition
+static int bias_next(const struct bias_trie * b, int node, whisper_token token) {
+    while (true) {
+        const int child = bias_child(b, node, token);
+        if (child >= 0) {
+            return child;
+        }
+        if (node == 0) {
+            return 0;
+        }
+        node = b->nodes[node].fail;
+    }
+}
+
+int bias_compile(struct bias_trie * b) {
+    if (b->compiled) {
+        return 0;
+    }
+    const int n_edges = b->n_nodes - 1;
+    whisper_token * edge_token = realloc(b->edge_token, sizeof(whisper_token) * (n_edges > 0 ? n_edges : 1));
+    if (edge_token) {
+        b->edge_token = edge_token;
+    }
+    int * edge_node = realloc(b->edge_node, sizeof(int) * (n_edges > 0 ? n_edges : 1));
+    if (edge_node) {
+        b->edge_node = edge_node;
+    }
+    if (!edge_token || !edge_node) {
+        return -1;
+    }
+
+    // sorted child arrays; (token, node) pairs are sorted together through a
+    // temporary array of both
+    struct { whisper_token token; int node; } * pairs = malloc(sizeof(*pairs) * (n_edges > 0 ? n_edges : 1));
+    if (!pairs) {
+        return -1;
+    }
+    int pos = 0;
+    for (int i = 0; i < b->n_nodes; i++) {
+        struct bias_node * node = &b->nodes[i];
+        node->edge_begin = pos;
+        for (int c = node->first_child; c >= 0; c = b->nodes[c].next_sibling) {
+            pairs[pos].token = b->nodes[c].token;
+            pairs[pos].node = c;
+            pos++;
+        }
+        node->n_edges = pos - node->edge_begin;
+        qsort(pairs + node->edge_begin, node->n_edges, sizeof(*pairs), bias_cmp_edge);
+    }
+    for (int i = 0; i < pos; i++) {
+        b->edge_token[i] = pairs[i].token;
+        b->edge_node[i] = pairs[i].node;
+    }
+    free(pairs);
+
+    // failure links in breadth-first order
+    int * queue = malloc(sizeof(int) * b->n_nodes);
+    if (!queue) {
+        return -1;
+    }
+    int head = 0;
+    int tail = 0;
+    b->nodes[0].fail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        const int parent = queue[head++];
+        const struct bias_node * p = &b->nodes[parent];
+        for (int e = p->edge_begin; e < p->edge_begin + p->n_edges; e++) {
+            const int child = b->edge_node[e];
+            b->nodes[child].fail = parent == 0 ? 0 : bias_next(b, p->fail, b->edge_token[e]);
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+
+    b->compiled = true;
+    return 0;
+}
+
+int bias_apply(struct bias_trie * b, const whisper_token_data * tokens, int n_tokens, float * logits, whisper_token eot) {
+    if (b->n_phrases == 0 || bias_compile(b) != 0) {
+        return 0;
+    }
+    if (b->n_stamp < eot) {
+        unsigned * stamp = realloc(b->stamp, sizeof(unsigned) * eot);
+        if (!stamp) {
+            return 0;
+        }
+        memset(stamp, 0, sizeof(unsigned) * eot);
+        b->stamp = stamp;
+        b->n_stamp = eot;
+        b->step = 0;
+    }
+    if (++b->step == 0) {
+        memset(b->stamp, 0, sizeof(unsigned) * b->n_stamp);
+        b->step = 1;
+    }
+
+    // the automaton state only depends on the last max_depth text tokens
+    int first = n_tokens;
+    for (int k = 0; first > 0 && k < b->max_depth; first--) {
+        if (tokens[first - 1].id < eot) {
+            k++;
+        }
+    }
+    int state = 0;
+    for (int i = first; i < n_tokens; i++) {
+        if (tokens[i].id < eot) {
+            state = bias_next(b, state, tokens[i].id);
+        }
+    }
+
+    // every prefix the sequence ends in, longest first; phrase starts at the
+    // root are not raised, that would cost every phrase on every step
+    int n_changed = 0;
+    for (int s = state; s != 0; s = b->nodes[s].fail) {
+        const struct bias_node * node = &b->nodes[s];
+        for (int e = node->edge_begin; e < node->edge_begin + node->n_edges; e++) {
+            const whisper_token token = b->edge_token[e];
+            if (token < eot && b->stamp[token] != b->step) {
+                b->stamp[token] = b->step;
+                logits[token] += b->nodes[b->edge_node[e]].boost;
+                n_changed++;
+            }
+        }
+    }
+    return n_changed;
+}
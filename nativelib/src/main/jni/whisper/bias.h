@@ -0,0 +1,52 @@
+#ifndef WHISPER_JNI_BIAS_H
+#define WHISPER_JNI_BIAS_H
+
+#include <stdbool.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Contextual biasing towards user phrases (product names, people, ...). The
+// phrases' token sequences form a trie with Aho-Corasick failure links; at
+// every decoder step the tokens that continue a phrase prefix ending the
+// sequence get their logits raised. The state is found by walking at most the
+// longest phrase's length of trailing tokens, and only the prefixes active in
+// that state are visited, so the cost does not grow with the number of
+// phrases. The first token of a phrase is left to the audio: a name the model
+// splits into pieces is completed once it has started.
+struct bias_trie;
+
+struct bias_trie * bias_init(void);
+void bias_free(struct bias_trie * b);
+
+// removes all phrases
+void bias_clear(struct bias_trie * b);
+
+// Adds text with and without a leading space, as whisper tokenizes a word
+// differently at the start of a segment. boost is added to the logit of every
+// token of the phrase after the first. Returns 0 on success; a phrase that is
+// a single token in both forms cannot be biased.
+int bias_add_phrase(struct bias_trie * b, struct whisper_context * ctx, const char * text, float boost);
+
+// same with a token sequence of at least two tokens
+int bias_add_tokens(struct bias_trie * b, const whisper_token * tokens, int n_tokens, float boost);
+
+int bias_n_phrases(const struct bias_trie * b);
+
+// Builds the failure links after phrases were added; bias_apply calls it when
+// needed, but it can be done ahead of the first decode. Returns 0 on success.
+int bias_compile(struct bias_trie * b);
+
+// Raises logits[] for the continuations of the phrases the decoded tokens end
+// in. Tokens at or above eot (timestamps, specials) are skipped. Returns the
+// number of logits changed.
+int bias_apply(struct bias_trie * b, const whisper_token_data * tokens, int n_tokens, float * logits, whisper_token eot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_BIAS_H
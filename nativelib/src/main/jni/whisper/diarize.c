@@ -0,0 +1,306 @@
+#include "diarize.h"
+#include "mel.h"
+#include "vad.h"
+#include "vec.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DIARIZE_N_CEPS       20
+#define DIARIZE_DIM          (2*DIARIZE_N_CEPS)
+#define DIARIZE_MAX_SPEAKERS 16
+#define DIARIZE_MAX_MEL      128
+
+struct diarizer {
+    struct diarize_params params;
+
+    pthread_t thread;
+    bool running;
+    int rc;
+    float time_ms;
+
+    const struct mel_spectrogram * mel;
+    const struct vad_frames * vad;
+
+    // DCT-II rows for cepstra 1..N_CEPS (c0 is loudness, not speaker)
+    float dct[DIARIZE_N_CEPS*DIARIZE_MAX_MEL];
+    int dct_n_mel;
+
+    // one turn and one embedding per chunk, merged after clustering
+    struct diarize_turn * turns;
+    float * emb;
+    int n_turns;
+    int cap_turns;
+
+    float centroid[DIARIZE_MAX_SPEAKERS*DIARIZE_DIM];
+    int count[DIARIZE_MAX_SPEAKERS];
+    int n_speakers;
+};
+
+struct diarize_params diarize_default_params(void) {
+    struct diarize_params params = {
+            .max_speakers = 8,
+            .threshold    = 0.45f,
+            .chunk_frames = 150,
+            .min_frames   = 50,
+    };
+    return params;
+}
+
+struct diarizer * diarizer_init(struct diarize_params params) {
+    struct diarizer * d = calloc(1, sizeof(struct diarizer));
+    if (!d) {
+        return NULL;
+    }
+    params.max_speakers = params.max_speakers < 1 ? 1 : params.max_speakers;
+    params.max_speakers = params.max_speakers > DIARIZE_MAX_SPEAKERS ? DIARIZE_MAX_SPEAKERS : params.max_speakers;
+    params.chunk_frames = params.chunk_frames < 10 ? 10 : params.chunk_frames;
+    d->params = params;
+    return d;
+}
+
+void diarizer_free(struct diarizer * d) {
+    if (!d) {
+        return;
+    }
+    diarizer_wait(d);
+    free(d->turns);
+    free(d->emb);
+    free(d);
+}
+
+static int diarizer_add_chunk(struct diarizer * d, int i0, int i1) {
+    if (d->n_turns == d->cap_turns) {
+        const int cap = d->cap_turns > 0 ? 2*d->cap_turns : 64;
+        struct diarize_turn * turns = realloc(d->turns, sizeof(struct diarize_turn) * cap);
+        if (turns) {
+            d->turns = turns;
+        }
+        float * emb = realloc(d->emb, sizeof(float) * cap * DIARIZE_DIM);
+        if (emb) {
+            d->emb = emb;
+        }
+        if (!turns || !emb) {
+            return -1;
+        }
+        d->cap_turns = cap;
+    }
+    struct diarize_turn * turn = &d->turns[d->n_turns++];
+    turn->t0 = i0;
+    turn->t1 = i1;
+    turn->speaker = -1;
+    return 0;
+}
+
+static float diarize_distance(const float * a, const float * b) {
+    float sum = 0.0f;
+    for (int k = 0; k < DIARIZE_DIM; k++) {
+        sum += (a[k] - b[k])*(a[k] - b[k]);
+    }
+    return sqrtf(sum/DIARIZE_DIM);
+}
+
+static int diarizer_run(struct diarizer * d) {
+    const struct mel_spectrogram * mel = d->mel;
+    const struct vad_frames * vad = d->vad;
+    const struct diarize_params * p = &d->params;
+    const int n_mel = mel->n_mel;
+
+    d->n_turns = 0;
+    d->n_speakers = 0;
+    if (n_mel > DIARIZE_MAX_MEL) {
+        return -1;
+    }
+
+    if (d->dct_n_mel != n_mel) {
+        for (int k = 0; k < DIARIZE_N_CEPS; k++) {
+            for (int j = 0; j < n_mel; j++) {
+                d->dct[k*n_mel + j] = (float) cos(M_PI*(k + 1)*(j + 0.5)/n_mel);
+            }
+        }
+        d->dct_n_mel = n_mel;
+    }
+
+    // speech runs cut into chunks of about chunk_frames
+    for (int from = 0; (from = vad_next_speech(vad, from)) >= 0; ) {
+        const int end = vad_next_silence(vad, from);
+        const int len = end - from;
+        if (len >= p->min_frames) {
+            int n_chunks = len/p->chunk_frames;
+            n_chunks = n_chunks < 1 ? 1 : n_chunks;
+            for (int c = 0; c < n_chunks; c++) {
+                if (diarizer_add_chunk(d, from + (int) ((int64_t) c*len/n_chunks), from + (int) ((int64_t) (c + 1)*len/n_chunks)) != 0) {
+                    return -1;
+                }
+            }
+        }
+        from = end;
+    }
+    if (d->n_turns == 0) {
+        return 0;
+    }
+
+    // cepstral mean and spread per chunk, plus the frame-level spread of the clip
+    double g_sum[DIARIZE_N_CEPS] = {0};
+    double g_sq[DIARIZE_N_CEPS] = {0};
+    int64_t g_n = 0;
+
+    float col[DIARIZE_MAX_MEL];
+    for (int t = 0; t < d->n_turns; t++) {
+        double sum[DIARIZE_N_CEPS] = {0};
+        double sq[DIARIZE_N_CEPS] = {0};
+        const int i0 = (int) d->turns[t].t0;
+        const int i1 = (int) d->turns[t].t1;
+        for (int i = i0; i < i1; i++) {
+            for (int j = 0; j < n_mel; j++) {
+                col[j] = mel->data[(size_t) j*mel->n_len + i];
+            }
+            for (int k = 0; k < DIARIZE_N_CEPS; k++) {
+                const double c = vec_dot_f32(n_mel, d->dct + k*n_mel, col);
+                sum[k] += c;
+                sq[k] += c*c;
+            }
+        }
+        float * e = d->emb + (size_t) t*DIARIZE_DIM;
+        const int n = i1 - i0;
+        for (int k = 0; k < DIARIZE_N_CEPS; k++) {
+            const double mean = sum[k]/n;
+            e[k] = (float) mean;
+            e[DIARIZE_N_CEPS + k] = (float) sqrt(fmax(0.0, sq[k]/n - mean*mean));
+            g_sum[k] += sum[k];
+            g_sq[k] += sq[k];
+        }
+        g_n += n;
+    }
+
+    float scale[DIARIZE_N_CEPS];
+    for (int k = 0; k < DIARIZE_N_CEPS; k++) {
+        const double mean = g_sum[k]/g_n;
+        const double var = g_sq[k]/g_n - mean*mean;
+        scale[k] = var > 1e-12 ? (float) (1.0/sqrt(var)) : 0.0f;
+    }
+
+    // leader clustering in time order, centroids are running means
+    for (int t = 0; t < d->n_turns; t++) {
+        float * e = d->emb + (size_t) t*DIARIZE_DIM;
+        vec_mul_f32(DIARIZE_N_CEPS, e, e, scale);
+        vec_mul_f32(DIARIZE_N_CEPS, e + DIARIZE_N_CEPS, e + DIARIZE_N_CEPS, scale);
+
+        int best = -1;
+        float best_dist = INFINITY;
+        for (int s = 0; s < d->n_speakers; s++) {
+            const float dist = diarize_distance(e, d->centroid + s*DIARIZE_DIM);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = s;
+            }
+        }
+
+        if (best < 0 || (best_dist > p->threshold && d->n_speakers < p->max_speakers)) {
+            best = d->n_speakers++;
+            memcpy(d->centroid + best*DIARIZE_DIM, e, sizeof(float) * DIARIZE_DIM);
+            d->count[best] = 1;
+        } else {
+            float * c = d->centroid + best*DIARIZE_DIM;
+            const float w = 1.0f/(++d->count[best]);
+            for (int k = 0; k < DIARIZE_DIM; k++) {
+                c[k] += w*(e[k] - c[k]);
+            }
+        }
+        d->turns[t].speaker = best;
+    }
+
+    // adjacent chunks of the same speaker become one turn
+    int n = 0;
+    for (int t = 0; t < d->n_turns; t++) {
+        if (n > 0 && d->turns[n - 1].speaker == d->turns[t].speaker && d->turns[n - 1].t1 == d->turns[t].t0) {
+            d->turns[n - 1].t1 = d->turns[t].t1;
+        } else {
+            d->turns[n++] = d->turns[t];
+        }
+    }
+    d->n_turns = n;
+
+    return 0;
+}
+
+static void * diarizer_thread(void * arg) {
+    struct diarizer * d = arg;
+    struct timespec ts0, ts1;
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    d->rc = diarizer_run(d);
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    d->time_ms = (float) ((ts1.tv_sec - ts0.tv_sec)*1e3 + (ts1.tv_nsec - ts0.tv_nsec)/1e6);
+    return NULL;
+}
+
+int diarizer_start(struct diarizer * d, const struct mel_spectrogram * mel, const struct vad_frames * vad) {
+    diarizer_wait(d);
+    d->mel = mel;
+    d->vad = vad;
+    d->rc = -1;
+    if (pthread_create(&d->thread, NULL, diarizer_thread, d) != 0) {
+        // no thread to spare: do it inline
+        diarizer_thread(d);
+        return d->rc;
+    }
+    d->running = true;
+    return 0;
+}
+
+int diarizer_wait(struct diarizer * d) {
+    if (d->running) {
+        pthread_join(d->thread, NULL);
+        d->running = false;
+    }
+    return d->rc;
+}
+
+int diarizer_n_speakers(const struct diarizer * d) {
+    return d->n_speakers;
+}
+
+int diarizer_n_turns(const struct diarizer * d) {
+    return d->n_turns;
+}
+
+const struct diarize_turn * diarizer_get_turn(const struct diarizer * d, int i) {
+    return i >= 0 && i < d->n_turns ? &d->turns[i] : NULL;
+}
+
+int diarizer_speaker_at(const struct diarizer * d, int64_t t0, int64_t t1) {
+    // first turn ending after t0
+    int lo = 0;
+    int hi = d->n_turns;
+    while (lo < hi) {
+        const int mid = (lo + hi)/2;
+        if (d->turns[mid].t1 <= t0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int64_t overlap[DIARIZE_MAX_SPEAKERS] = {0};
+    for (int i = lo; i < d->n_turns && d->turns[i].t0 < t1; i++) {
+        const int64_t a = d->turns[i].t0 > t0 ? d->turns[i].t0 : t0;
+        const int64_t b = d->turns[i].t1 < t1 ? d->turns[i].t1 : t1;
+        overlap[d->turns[i].speaker] += b - a;
+    }
+
+    int best = -1;
+    for (int s = 0; s < d->n_speakers; s++) {
+        if (overlap[s] > 0 && (best < 0 || overlap[s] > overlap[best])) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+float diarizer_time_ms(const struct diarizer * d) {
+    return d->time_ms;
+}
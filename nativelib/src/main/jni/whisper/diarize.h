@@ -0,0 +1,59 @@
+#ifndef WHISPER_JNI_DIARIZE_H
+#define WHISPER_JNI_DIARIZE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mel_spectrogram;
+struct vad_frames;
+
+// Speaker diarization on the spectrogram the decoder already uses. VAD speech
+// runs are cut into short chunks; each chunk gets a cepstral statistics
+// embedding (mean and spread of mel cepstra, scaled by the clip's frame-level
+// spread) and is assigned in time order to the nearest speaker, or starts a
+// new one when no speaker is close enough.
+struct diarize_params {
+    int   max_speakers;
+    float threshold;     // RMS embedding distance that starts a new speaker
+    int   chunk_frames;  // embedding length (10 ms frames)
+    int   min_frames;    // shorter speech runs get no speaker
+};
+
+struct diarize_params diarize_default_params(void);
+
+struct diarize_turn {
+    int64_t t0;    // centiseconds
+    int64_t t1;
+    int speaker;   // 0-based
+};
+
+struct diarizer;
+
+struct diarizer * diarizer_init(struct diarize_params params);
+void diarizer_free(struct diarizer * d);
+
+// Starts diarization on a background thread. mel and vad are only read and
+// must stay valid until diarizer_wait returns. Returns 0 on success.
+int diarizer_start(struct diarizer * d, const struct mel_spectrogram * mel, const struct vad_frames * vad);
+
+// Joins the background thread. Returns 0 when turns are available.
+int diarizer_wait(struct diarizer * d);
+
+int diarizer_n_speakers(const struct diarizer * d);
+int diarizer_n_turns(const struct diarizer * d);
+const struct diarize_turn * diarizer_get_turn(const struct diarizer * d, int i);
+
+// speaker overlapping [t0, t1) the most, -1 if no turn overlaps it
+int diarizer_speaker_at(const struct diarizer * d, int64_t t0, int64_t t1);
+
+// time the background thread spent, in ms
+float diarizer_time_ms(const struct diarizer * d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_DIARIZE_H
@@ -0,0 +1,188 @@
+#include "fft.h"
+#include "vec.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+struct fft_plan {
+    int n;
+    int m;            // size of the dense base case
+
+    float * twiddle;  // n/2 interleaved complex values exp(-2*pi*i*k/n)
+    float * dft_cos;  // m x m, row k: cos(2*pi*j*k/m)
+    float * dft_sin;  // m x m, row k: -sin(2*pi*j*k/m)
+};
+
+struct fft_plan * fft_plan_init(int n) {
+    if (n <= 0) {
+        return NULL;
+    }
+
+    // split n = 2^k * m, then grow the dense base a little for power-of-two
+    // sizes so the recursion does not bottom out on single samples
+    int m = n;
+    while (m % 2 == 0) {
+        m /= 2;
+    }
+    while (m < 8 && n % (2*m) == 0) {
+        m *= 2;
+    }
+
+    struct fft_plan * plan = calloc(1, sizeof(struct fft_plan));
+    if (!plan) {
+        return NULL;
+    }
+    plan->n = n;
+    plan->m = m;
+    plan->twiddle = malloc(sizeof(float) * (n/2 + 1) * 2);
+    plan->dft_cos = malloc(sizeof(float) * m * m);
+    plan->dft_sin = malloc(sizeof(float) * m * m);
+    if (!plan->twiddle || !plan->dft_cos || !plan->dft_sin) {
+        fft_plan_free(plan);
+        return NULL;
+    }
+
+    for (int k = 0; k <= n/2; k++) {
+        const double theta = 2.0*M_PI*k/n;
+        plan->twiddle[2*k + 0] = (float)  cos(theta);
+        plan->twiddle[2*k + 1] = (float) -sin(theta);
+    }
+
+    for (int k = 0; k < m; k++) {
+        for (int j = 0; j < m; j++) {
+            // reduce the index first so large products keep full precision
+            const double theta = 2.0*M_PI*((long long) j*k % m)/m;
+            plan->dft_cos[k*m + j] = (float)  cos(theta);
+            plan->dft_sin[k*m + j] = (float) -sin(theta);
+        }
+    }
+
+    return plan;
+}
+
+void fft_plan_free(struct fft_plan * plan) {
+    if (!plan) {
+        return;
+    }
+    free(plan->twiddle);
+    free(plan->dft_cos);
+    free(plan->dft_sin);
+    free(plan);
+}
+
+int fft_plan_size(const struct fft_plan * plan) {
+    return plan->n;
+}
+
+int fft_plan_scratch_size(const struct fft_plan * plan) {
+    return 2*plan->m;
+}
+
+// Radix-2 butterflies over the two half-size transforms stored in out[0, s).
+static void fft_combine(const struct fft_plan * plan, int s, float * out) {
+    const int h = s/2;
+    const int step = plan->n/s;
+    const float * tw = plan->twiddle;
+
+    for (int k = 0; k < h; k++) {
+        const float wr = tw[2*k*step + 0];
+        const float wi = tw[2*k*step + 1];
+
+        const float orr = out[2*(h + k) + 0];
+        const float oi  = out[2*(h + k) + 1];
+
+        const float tr = wr*orr - wi*oi;
+        const float ti = wr*oi  + wi*orr;
+
+        const float er = out[2*k + 0];
+        const float ei = out[2*k + 1];
+
+        out[2*k + 0] = er + tr;
+        out[2*k + 1] = ei + ti;
+
+        out[2*(h + k) + 0] = er - tr;
+        out[2*(h + k) + 1] = ei - ti;
+    }
+}
+
+static void fft_rec(const struct fft_plan * plan, const float * in, int stride, int s, float * out, float * scratch) {
+    const int m = plan->m;
+
+    if (s == m) {
+        // gather the strided input once so the dense DFT rows are contiguous dot products
+        for (int j = 0; j < m; j++) {
+            scratch[j] = in[j*stride];
+        }
+        for (int k = 0; k < m; k++) {
+            out[2*k + 0] = vec_dot_f32(m, plan->dft_cos + k*m, scratch);
+            out[2*k + 1] = vec_dot_f32(m, plan->dft_sin + k*m, scratch);
+        }
+        return;
+    }
+
+    const int h = s/2;
+
+    fft_rec(plan, in,          2*stride, h, out,       scratch);
+    fft_rec(plan, in + stride, 2*stride, h, out + 2*h, scratch);
+
+    fft_combine(plan, s, out);
+}
+
+// same recursion for interleaved complex input, stride counted in complex values
+static void fft_rec_complex(const struct fft_plan * plan, const float * in, int stride, int s, float * out, float * scratch) {
+    const int m = plan->m;
+
+    if (s == m) {
+        float * re = scratch;
+        float * im = scratch + m;
+        for (int j = 0; j < m; j++) {
+            re[j] = in[2*j*stride + 0];
+            im[j] = in[2*j*stride + 1];
+        }
+        for (int k = 0; k < m; k++) {
+            const float * c = plan->dft_cos + k*m;
+            const float * si = plan->dft_sin + k*m;
+            out[2*k + 0] = vec_dot_f32(m, c, re) - vec_dot_f32(m, si, im);
+            out[2*k + 1] = vec_dot_f32(m, si, re) + vec_dot_f32(m, c, im);
+        }
+        return;
+    }
+
+    const int h = s/2;
+
+    fft_rec_complex(plan, in,              2*stride, h, out,       scratch);
+    fft_rec_complex(plan, in + 2*stride,   2*stride, h, out + 2*h, scratch);
+
+    fft_combine(plan, s, out);
+}
+
+void fft_forward_real(const struct fft_plan * plan, const float * in, float * out, float * scratch) {
+    fft_rec(plan, in, 1, plan->n, out, scratch);
+}
+
+void fft_forward_complex(const struct fft_plan * plan, const float * in, float * out, float * scratch) {
+    fft_rec_complex(plan, in, 1, plan->n, out, scratch);
+}
+
+void fft_inverse_real(const struct fft_plan * plan, const float * in, float * out, float * work, float * scratch) {
+    const int n = plan->n;
+    float * spec = work;
+    float * res = work + 2*n;
+
+    // x = conj(FFT(conj(X)))/n, with the upper half rebuilt from hermitian symmetry
+    for (int k = 0; k <= n/2; k++) {
+        spec[2*k + 0] =  in[2*k + 0];
+        spec[2*k + 1] = -in[2*k + 1];
+    }
+    for (int k = n/2 + 1; k < n; k++) {
+        spec[2*k + 0] = in[2*(n - k) + 0];
+        spec[2*k + 1] = in[2*(n - k) + 1];
+    }
+
+    fft_forward_complex(plan, spec, res, scratch);
+
+    const float scale = 1.0f/n;
+    for (int i = 0; i < n; i++) {
+        out[i] = res[2*i]*scale;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef WHISPER_JNI_FFT_H
+#define WHISPER_JNI_FFT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Precomputed real-input FFT plan for n = 2^k * m (m odd).
+// The odd base case is a dense DFT with a cached cos/sin matrix, the even
+// levels are radix-2 decimation in time with cached twiddles.
+struct fft_plan;
+
+struct fft_plan * fft_plan_init(int n);
+void fft_plan_free(struct fft_plan * plan);
+
+int fft_plan_size(const struct fft_plan * plan);
+
+// number of floats of scratch memory the transforms need
+int fft_plan_scratch_size(const struct fft_plan * plan);
+
+// out: n interleaved complex values (re, im); only bins [0, n/2] are needed by
+// the callers but the full spectrum is produced by the recursion.
+// The plan is read-only, so one plan can be shared between threads as long as
+// each thread passes its own scratch buffer.
+void fft_forward_real(const struct fft_plan * plan, const float * in, float * out, float * scratch);
+
+// in, out: n interleaved complex values
+void fft_forward_complex(const struct fft_plan * plan, const float * in, float * out, float * scratch);
+
+// in: bins [0, n/2] of the spectrum of a real signal, out: n real samples
+// (scaled by 1/n so that it inverts fft_forward_real), work: 4*n floats
+void fft_inverse_real(const struct fft_plan * plan, const float * in, float * out, float * work, float * scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_FFT_H
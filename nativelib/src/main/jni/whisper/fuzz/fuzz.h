@@ -0,0 +1,86 @@
+#ifndef WHISPER_JNI_FUZZ_H
+#define WHISPER_JNI_FUZZ_H
+
+// Helpers shared by the fuzz targets (not part of the Android library). Each
+// target defines LLVMFuzzerTestOneInput; with clang it is linked with
+// libFuzzer, otherwise with replay.c, which runs the seed corpora and
+// mutations of them.
+
+// memfd_create
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// A failed property aborts, so that the engine keeps the input.
+#define FUZZ_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: property failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+// In-memory file holding data, positioned at its start, with seals added (0
+// for none). path receives a name fopen accepts. Returns the fd, -1 on failure.
+static inline int fuzz_memfd(const uint8_t * data, size_t size, unsigned int seals, char * path, size_t path_size) {
+    const int fd = memfd_create("fuzz", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t k = write(fd, data + done, size - done);
+        if (k <= 0) {
+            close(fd);
+            return -1;
+        }
+        done += (size_t) k;
+    }
+    if (lseek(fd, 0, SEEK_SET) != 0 || (seals && fcntl(fd, F_ADD_SEALS, seals) != 0)) {
+        close(fd);
+        return -1;
+    }
+    if (path) {
+        snprintf(path, path_size, "/proc/self/fd/%d", fd);
+    }
+    return fd;
+}
+
+// Parameters a target draws from its input are taken from the end, so that
+// the front keeps the layout of the seed it was mutated from.
+struct fuzz_input {
+    const uint8_t * data;
+    size_t size;
+};
+
+static inline uint32_t fuzz_take(struct fuzz_input * in, int bytes) {
+    uint32_t v = 0;
+    for (int i = 0; i < bytes && in->size > 0; i++) {
+        v = v << 8 | in->data[--in->size];
+    }
+    return v;
+}
+
+// xorshift64*, for choices that must not depend on the input
+static inline uint64_t fuzz_rand(uint64_t * state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x*0x2545F4914F6CDD1DULL;
+}
+
+#endif // WHISPER_JNI_FUZZ_H
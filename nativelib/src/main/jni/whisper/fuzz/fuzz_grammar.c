@@ -0,0 +1,33 @@
+// Fuzz target: the GBNF parser. The input is the grammar source, the start
+// rule is "root". Checks that parsing is deterministic, that a failure
+// always says why and that a compiled grammar has its start rule.
+
+#include "fuzz.h"
+#include "../grammar.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    char * src = malloc(size + 1);
+    FUZZ_CHECK(src != NULL);
+    memcpy(src, data, size);
+    src[size] = '\0';
+
+    char err[256] = "";
+    struct grammar * g = grammar_parse(src, "root", err, sizeof(err));
+    char err2[256] = "";
+    struct grammar * g2 = grammar_parse(src, "root", err2, sizeof(err2));
+    FUZZ_CHECK((g == NULL) == (g2 == NULL));
+    if (g) {
+        FUZZ_CHECK(grammar_n_rules(g) > 0 && grammar_n_rules(g) == grammar_n_rules(g2));
+        FUZZ_CHECK(grammar_max_bytes(g) >= -1 && grammar_max_bytes(g) == grammar_max_bytes(g2));
+
+        struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+        grammar_apply(g, &params, 100.0f);
+        FUZZ_CHECK(params.n_grammar_rules == grammar_n_rules(g) && params.i_start_rule < params.n_grammar_rules);
+    } else {
+        FUZZ_CHECK(err[0] != '\0' && strcmp(err, err2) == 0);
+    }
+    grammar_free(g);
+    grammar_free(g2);
+    free(src);
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Fuzz target: the model loader callbacks. The input is a model file served
+// the way the Android loaders see it, in short reads of sizes drawn from the
+// input's last bytes (an InputStream or a streamed asset), through
+// loader_read_full into whisper_init_with_params_no_state. Checks that
+//   - loader_read_full puts the bytes back together whatever the read sizes,
+//     and zero-fills past the end,
+//   - a region model_share_create made of a model that loads opens again
+//     with model_share_open (when the last byte is odd).
+// Run with ASAN_OPTIONS=allocator_may_return_null=1, as a forged header can
+// ask for any tensor size.
+
+#include "fuzz.h"
+#include "../loader.h"
+#include "../model_share.h"
+
+struct fuzz_source {
+    struct loader_memory mem;
+    uint32_t pattern;   // read sizes, 4 bits at a time
+    int i;
+};
+
+// Returns at most 1..16 bytes times a power of two, never more than asked.
+static long fuzz_short_read(void * ctx, void * dst, size_t n) {
+    struct fuzz_source * s = (struct fuzz_source *) ctx;
+    const size_t left = s->mem.size - s->mem.offset;
+    const uint32_t bits = s->pattern >> (4*(s->i++ % 8)) & 15;
+    size_t k = (size_t) (1 + bits) << (bits & 7);
+    k = k < n ? k : n;
+    k = k < left ? k : left;
+    memcpy(dst, s->mem.data + s->mem.offset, k);
+    s->mem.offset += k;
+    return (long) k;
+}
+
+static size_t fuzz_source_read(void * ctx, void * output, size_t read_size) {
+    return loader_read_full(fuzz_short_read, ctx, output, read_size);
+}
+
+static bool fuzz_source_eof(void * ctx) {
+    const struct fuzz_source * s = (const struct fuzz_source *) ctx;
+    return s->mem.offset >= s->mem.size;
+}
+
+static void fuzz_source_close(void * ctx) {
+    (void) ctx;
+}
+
+static struct whisper_model_loader fuzz_loader(struct fuzz_source * s, const uint8_t * data, size_t size, uint32_t pattern) {
+    loader_from_memory(&s->mem, data, size);
+    s->pattern = pattern;
+    s->i = 0;
+    struct whisper_model_loader loader = {
+        .context = s,
+        .read = fuzz_source_read,
+        .eof = fuzz_source_eof,
+        .close = fuzz_source_close,
+    };
+    return loader;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    struct fuzz_input in = { data, size };
+    const uint32_t pattern = fuzz_take(&in, 4);
+    const bool share = (fuzz_take(&in, 1) & 1) != 0;
+
+    // reassembly: the whole input in reads of an odd size, and 8 bytes more
+    struct fuzz_source s;
+    struct whisper_model_loader loader = fuzz_loader(&s, in.data, in.size, pattern);
+    const size_t chunk = 1 + in.size/3;
+    uint8_t * copy = malloc(in.size + chunk + 8);
+    FUZZ_CHECK(copy != NULL);
+    size_t got = 0;
+    for (size_t k; (k = loader.read(loader.context, copy + got, chunk)) > 0; got += k) {
+        FUZZ_CHECK(k <= chunk);
+    }
+    FUZZ_CHECK(got == in.size && memcmp(copy, in.data, in.size) == 0);
+    memset(copy, 0xAA, 8);
+    FUZZ_CHECK(loader.read(loader.context, copy, 8) == 0);
+    for (int i = 0; i < 8; i++) {
+        FUZZ_CHECK(copy[i] == 0);
+    }
+    free(copy);
+
+    struct whisper_context_params params = whisper_context_default_params();
+    params.use_gpu = false;
+    loader = fuzz_loader(&s, in.data, in.size, pattern);
+    struct whisper_context * ctx = whisper_init_with_params_no_state(&loader, params);
+    if (!ctx) {
+        return 0;
+    }
+    whisper_free(ctx);
+
+    if (share) {
+        loader = fuzz_loader(&s, in.data, in.size, pattern);
+        // create may refuse a layout it cannot share; what it made must open
+        const int fd = model_share_create(&loader, NULL);
+        if (fd >= 0) {
+            ctx = model_share_open(fd, params, NULL);
+            FUZZ_CHECK(ctx != NULL);
+            whisper_free(ctx);
+            close(fd);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+// Fuzz target: model_share_open on a region from another process. The input
+// is the region, in a memfd sealed like model_share_create seals it. Checks
+// that the header and the read table are validated before anything is
+// replayed into whisper's buffers, and that an unsealed memfd, which the
+// sender could shrink under the mapping, is refused.
+
+#include "fuzz.h"
+#include "../model_share.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    struct whisper_context_params params = whisper_context_default_params();
+    params.use_gpu = false;
+
+    int fd = fuzz_memfd(data, size, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL, NULL, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct whisper_context * ctx = model_share_open(fd, params, NULL);
+    whisper_free(ctx);
+    close(fd);
+
+    fd = fuzz_memfd(data, size, 0, NULL, 0);
+    if (fd >= 0) {
+        FUZZ_CHECK(model_share_open(fd, params, NULL) == NULL);
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Fuzz target: the HTTP parsing of server.c, request line, headers and body
+// framing (Content-Length, chunked, up to the half-close). The input is what
+// the client sends, written into a socket pair that is then shut down. Checks
+// that the parsed strings are terminated within their fields, that no more
+// body arrives than was sent or than Content-Length announced, and that the
+// samples are in [-1, 1].
+
+#include "fuzz.h"
+
+#include <math.h>
+#include <sys/socket.h>
+
+// the parsers are static
+#include "../server.c"
+
+// more would block the write before anything reads the socket
+#define FUZZ_SERVER_MAX_INPUT (64*1024)
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    if (size > FUZZ_SERVER_MAX_INPUT) {
+        size = FUZZ_SERVER_MAX_INPUT;
+    }
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        return 0;
+    }
+    if (write(sv[1], data, size) != (ssize_t) size) {
+        close(sv[0]);
+        close(sv[1]);
+        return 0;
+    }
+    shutdown(sv[1], SHUT_WR);
+
+    struct server_body * b = calloc(1, sizeof(struct server_body));
+    FUZZ_CHECK(b != NULL);
+    b->fd = sv[0];
+    struct server_request req = {0};
+    if (server_read_request(b, &req) == 0) {
+        FUZZ_CHECK(memchr(req.method, '\0', sizeof(req.method)) && memchr(req.path, '\0', sizeof(req.path)) &&
+                memchr(req.lang, '\0', sizeof(req.lang)));
+        FUZZ_CHECK(req.chunk_s == 0 || (req.chunk_s >= TRANSCRIBE_FILE_MIN_CHUNK_S && req.chunk_s <= TRANSCRIBE_FILE_MAX_CHUNK_S));
+        const int64_t announced = b->chunked ? -1 : b->left;
+
+        // odd request sizes, to split samples between reads
+        float out[1031];
+        int64_t n_samples = 0;
+        for (int want = 1; ; want = want*7 % 1031 + 1) {
+            const int k = server_read_samples(b, out, want);
+            if (k <= 0) {
+                break;
+            }
+            FUZZ_CHECK(k <= want);
+            for (int i = 0; i < k; i++) {
+                FUZZ_CHECK(isfinite(out[i]) && fabsf(out[i]) <= 1.0f);
+            }
+            n_samples += k;
+        }
+        FUZZ_CHECK(2*n_samples <= (int64_t) size);
+        if (announced >= 0) {
+            FUZZ_CHECK(2*n_samples <= announced);
+        }
+    }
+    free(b);
+    close(sv[0]);
+    close(sv[1]);
+    return 0;
+}
@@ -0,0 +1,366 @@
+// Driver for the fuzz targets where libFuzzer is not available (gcc): runs
+// every input of the seed corpora, then mutations of them, through the
+// target's LLVMFuzzerTestOneInput. With the sanitizers this finds the same
+// class of bugs as a fuzzing engine, only less deep. It also reports the
+// throughput, so that a parser that became much slower shows up, and an input
+// that takes too long is treated like a crash: the usual way a fast path that
+// skips a check fails is an absurd size that is then trusted.
+//
+//   fuzz_<target> [-r rounds] [-n mutations] [-s seed] [-b min_MB/s] [-T max_ms] [-o dir] corpus_dir_or_file ...
+//
+// -r runs the corpus that many times for the throughput; -b fails (exit 2)
+// when the corpus runs below that many MB/s, -T when a single input took
+// longer. An input that crashes or exceeds -T is written to -o as
+// crash-<hash> or slow-<hash> and reproduces when given as the corpus.
+
+#include "fuzz.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// largest mutated input
+#define REPLAY_MAX_SIZE (1 << 20)
+
+struct replay_input {
+    char * name;
+    uint8_t * data;
+    size_t size;
+};
+
+static struct replay_input * g_inputs;
+static int g_n_inputs;
+static int g_cap_inputs;
+
+// the input being run, for the crash handlers
+static const uint8_t * g_current;
+static size_t g_current_size;
+static const char * g_out_dir = ".";
+
+static int64_t replay_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static uint64_t replay_hash(const uint8_t * data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i])*0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Writes data to dir/prefix-<hash>. Only async-signal-safe calls, as it also
+// runs from the crash handlers.
+static void replay_save(const char * prefix, const uint8_t * data, size_t size) {
+    char path[512];
+    size_t n = 0;
+    for (const char * s = g_out_dir; *s && n < sizeof(path) - 64; s++) {
+        path[n++] = *s;
+    }
+    path[n++] = '/';
+    for (const char * s = prefix; *s; s++) {
+        path[n++] = *s;
+    }
+    path[n++] = '-';
+    const uint64_t h = replay_hash(data, size);
+    for (int i = 60; i >= 0; i -= 4) {
+        path[n++] = "0123456789abcdef"[(h >> i) & 15];
+    }
+    path[n] = '\0';
+
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    for (size_t done = 0; done < size;) {
+        const ssize_t k = write(fd, data + done, size - done);
+        if (k <= 0) {
+            break;
+        }
+        done += (size_t) k;
+    }
+    close(fd);
+    static const char msg[] = "input saved as ";
+    write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    write(STDERR_FILENO, path, n);
+    write(STDERR_FILENO, "\n", 1);
+}
+
+static void replay_on_death(void) {
+    if (g_current) {
+        replay_save("crash", g_current, g_current_size);
+        g_current = NULL;
+    }
+}
+
+static void replay_on_signal(int sig) {
+    replay_on_death();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// ASan reports and exits without raising a signal; UBSan does not call the
+// death callback, so it is made to abort instead.
+void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+const char * __ubsan_default_options(void) {
+    return "abort_on_error=1:print_stacktrace=1";
+}
+
+static void replay_add(const char * name, uint8_t * data, size_t size) {
+    if (g_n_inputs == g_cap_inputs) {
+        g_cap_inputs = g_cap_inputs ? 2*g_cap_inputs : 64;
+        g_inputs = realloc(g_inputs, sizeof(struct replay_input) * g_cap_inputs);
+        if (!g_inputs) {
+            exit(1);
+        }
+    }
+    g_inputs[g_n_inputs++] = (struct replay_input) { strdup(name), data, size };
+}
+
+static int replay_load_file(const char * path) {
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "failed to open '%s'\n", path);
+        return -1;
+    }
+    size_t cap = 4096;
+    size_t size = 0;
+    uint8_t * data = malloc(cap);
+    for (size_t k; data && (k = fread(data + size, 1, cap - size, f)) > 0;) {
+        size += k;
+        if (size == cap) {
+            uint8_t * p = realloc(data, cap *= 2);
+            if (!p) {
+                free(data);
+            }
+            data = p;
+        }
+    }
+    fclose(f);
+    if (!data) {
+        return -1;
+    }
+    replay_add(path, data, size);
+    return 0;
+}
+
+static int replay_load(const char * path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "failed to open '%s'\n", path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return replay_load_file(path);
+    }
+    DIR * dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+    for (struct dirent * e; (e = readdir(dir)) != NULL;) {
+        char file[1024];
+        snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+        if (e->d_name[0] != '.' && stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+            replay_load_file(file);
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+struct replay_stats {
+    int64_t n;
+    double bytes;
+    int64_t us;
+    int64_t max_us;
+    uint8_t * slowest;   // copy of the slowest input
+    size_t slowest_size;
+};
+
+static void replay_run(struct replay_stats * st, const uint8_t * data, size_t size) {
+    g_current = data;
+    g_current_size = size;
+    const int64_t t0 = replay_time_us();
+    LLVMFuzzerTestOneInput(data, size);
+    const int64_t us = replay_time_us() - t0;
+    g_current = NULL;
+
+    st->n++;
+    st->bytes += size;
+    st->us += us;
+    if (us > st->max_us) {
+        st->max_us = us;
+        free(st->slowest);
+        st->slowest = malloc(size ? size : 1);
+        if (st->slowest) {
+            memcpy(st->slowest, data, size);
+        }
+        st->slowest_size = size;
+    }
+}
+
+// One to four stacked edits of the kind that break length fields: bit flips,
+// boundary values, truncation, insertion, duplication and splices.
+static size_t replay_mutate(uint8_t * buf, size_t size, uint64_t * rng) {
+    static const uint32_t interesting[] = { 0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000u, 0xFFFFFFFFu, 16000, 44100 };
+    const int n_edits = 1 + (int) (fuzz_rand(rng) % 4);
+    for (int e = 0; e < n_edits; e++) {
+        const size_t pos = size ? (size_t) (fuzz_rand(rng) % size) : 0;
+        switch (fuzz_rand(rng) % 8) {
+            case 0:
+                if (size) {
+                    buf[pos] ^= (uint8_t) (1u << (fuzz_rand(rng) % 8));
+                }
+                break;
+            case 1:
+                if (size) {
+                    buf[pos] = (uint8_t) fuzz_rand(rng);
+                }
+                break;
+            case 2: {
+                const uint32_t v = interesting[fuzz_rand(rng) % (sizeof(interesting)/sizeof(interesting[0]))];
+                const size_t w = (size_t) 1 << (fuzz_rand(rng) % 3);
+                for (size_t i = 0; i < w && pos + i < size; i++) {
+                    buf[pos + i] = (uint8_t) (v >> (8*i));
+                }
+                break;
+            }
+            case 3:
+                size = pos;
+                break;
+            case 4: {
+                const size_t n = 1 + (size_t) (fuzz_rand(rng) % 16);
+                if (size + n <= REPLAY_MAX_SIZE) {
+                    memmove(buf + pos + n, buf + pos, size - pos);
+                    for (size_t i = 0; i < n; i++) {
+                        buf[pos + i] = (uint8_t) fuzz_rand(rng);
+                    }
+                    size += n;
+                }
+                break;
+            }
+            case 5: {
+                // repeat a range, as in a duplicated chunk
+                const size_t n = size - pos < 256 ? size - pos : 256;
+                if (n && size + n <= REPLAY_MAX_SIZE) {
+                    memmove(buf + pos + n, buf + pos, size - pos);
+                    size += n;
+                }
+                break;
+            }
+            case 6: {
+                const size_t n = 1 + (size_t) (fuzz_rand(rng) % 64);
+                if (pos + n <= size) {
+                    memmove(buf + pos, buf + pos + n, size - pos - n);
+                    size -= n;
+                }
+                break;
+            }
+            default: {
+                // the tail of another input from here on
+                const struct replay_input * o = &g_inputs[fuzz_rand(rng) % g_n_inputs];
+                const size_t from = o->size ? (size_t) (fuzz_rand(rng) % o->size) : 0;
+                const size_t n = o->size - from < REPLAY_MAX_SIZE - pos ? o->size - from : REPLAY_MAX_SIZE - pos;
+                memcpy(buf + pos, o->data + from, n);
+                size = pos + n;
+                break;
+            }
+        }
+    }
+    return size;
+}
+
+static void replay_print(const char * what, const struct replay_stats * st) {
+    const double s = st->us > 0 ? st->us/1e6 : 1e-6;
+    printf("%-10s %8lld inputs %10.1f KB %9.1f ms %10.0f inputs/s %8.2f MB/s  slowest %.2f ms (%zu bytes)\n",
+            what, (long long) st->n, st->bytes/1024.0, st->us/1000.0, st->n/s, st->bytes/(1024.0*1024.0)/s,
+            st->max_us/1000.0, st->slowest_size);
+}
+
+int main(int argc, char ** argv) {
+    int rounds = 10;
+    long n_mutations = 10000;
+    uint64_t seed = 1;
+    double min_mbps = 0.0;
+    double max_ms = 0.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:n:s:b:T:o:")) != -1) {
+        switch (opt) {
+            case 'r': rounds = atoi(optarg); break;
+            case 'n': n_mutations = atol(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'b': min_mbps = atof(optarg); break;
+            case 'T': max_ms = atof(optarg); break;
+            case 'o': g_out_dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds] [-n mutations] [-s seed] [-b min_MB/s] [-T max_ms] [-o dir] corpus_dir_or_file ...\n", argv[0]);
+                return 1;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        replay_load(argv[i]);
+    }
+    if (g_n_inputs == 0) {
+        fprintf(stderr, "usage: %s [-r rounds] [-n mutations] [-s seed] [-b min_MB/s] [-T max_ms] [-o dir] corpus_dir_or_file ...\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGABRT, replay_on_signal);
+    signal(SIGSEGV, replay_on_signal);
+    signal(SIGBUS, replay_on_signal);
+    signal(SIGFPE, replay_on_signal);
+    signal(SIGILL, replay_on_signal);
+    if (__sanitizer_set_death_callback) {
+        __sanitizer_set_death_callback(replay_on_death);
+    }
+
+    // the corpus: valid inputs, the throughput that -b checks
+    struct replay_stats corpus = {0};
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < g_n_inputs; i++) {
+            replay_run(&corpus, g_inputs[i].data, g_inputs[i].size);
+        }
+    }
+
+    struct replay_stats mutated = {0};
+    uint8_t * buf = malloc(REPLAY_MAX_SIZE);
+    if (!buf) {
+        return 1;
+    }
+    uint64_t rng = seed*0x9E3779B97F4A7C15ULL + 1;
+    for (long m = 0; m < n_mutations; m++) {
+        const struct replay_input * in = &g_inputs[fuzz_rand(&rng) % g_n_inputs];
+        size_t size = in->size < REPLAY_MAX_SIZE ? in->size : REPLAY_MAX_SIZE;
+        memcpy(buf, in->data, size);
+        size = replay_mutate(buf, size, &rng);
+        replay_run(&mutated, buf, size);
+    }
+    free(buf);
+
+    printf("%s: %d corpus inputs, seed %llu\n", argv[0], g_n_inputs, (unsigned long long) seed);
+    replay_print("corpus", &corpus);
+    replay_print("mutations", &mutated);
+
+    int rc = 0;
+    const double mbps = corpus.us > 0 ? corpus.bytes/(1024.0*1024.0)/(corpus.us/1e6) : 0.0;
+    if (min_mbps > 0.0 && mbps < min_mbps) {
+        fprintf(stderr, "corpus throughput %.2f MB/s is below %.2f MB/s\n", mbps, min_mbps);
+        rc = 2;
+    }
+    const struct replay_stats * slow = corpus.max_us > mutated.max_us ? &corpus : &mutated;
+    if (max_ms > 0.0 && slow->max_us > max_ms*1000.0) {
+        fprintf(stderr, "an input took %.2f ms, more than %.2f ms\n", slow->max_us/1000.0, max_ms);
+        if (slow->slowest) {
+            replay_save("slow", slow->slowest, slow->slowest_size);
+        }
+        rc = 2;
+    }
+    free(corpus.slowest);
+    free(mutated.slowest);
+    return rc;
+}
@@ -0,0 +1,493 @@
+#include "grammar.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAMMAR_MAX_NAME 64
+
+struct grammar_buf {
+    whisper_grammar_element * v;
+    int n;
+    int cap;
+};
+
+struct grammar_rule {
+    char name[GRAMMAR_MAX_NAME];
+    struct grammar_buf elems;  // END terminated once defined
+    bool defined;
+};
+
+struct grammar {
+    struct grammar_rule * rules;
+    size_t n_rules;
+    size_t cap_rules;
+    const whisper_grammar_element ** ptrs;
+    size_t start;
+    int max_bytes;
+};
+
+struct grammar_parser {
+    struct grammar * g;
+    const char * src;
+    char * err;
+    size_t err_size;
+    bool failed;
+};
+
+static const char * grammar_error(struct grammar_parser * ps, const char * pos, const char * msg) {
+    if (!ps->failed) {
+        ps->failed = true;
+        if (ps->err && ps->err_size > 0 && pos) {
+            snprintf(ps->err, ps->err_size, "%s at offset %d", msg, (int) (pos - ps->src));
+        } else if (ps->err && ps->err_size > 0) {
+            snprintf(ps->err, ps->err_size, "%s", msg);
+        }
+    }
+    return NULL;
+}
+
+static bool grammar_buf_push(struct grammar_buf * b, enum whisper_gretype type, uint32_t value) {
+    if (b->n == b->cap) {
+        const int cap = b->cap > 0 ? 2*b->cap : 16;
+        whisper_grammar_element * v = realloc(b->v, sizeof(whisper_grammar_element) * cap);
+        if (!v) {
+            return false;
+        }
+        b->v = v;
+        b->cap = cap;
+    }
+    b->v[b->n].type = type;
+    b->v[b->n].value = value;
+    b->n++;
+    return true;
+}
+
+static bool grammar_buf_append(struct grammar_buf * b, const whisper_grammar_element * v, int n) {
+    for (int i = 0; i < n; i++) {
+        if (!grammar_buf_push(b, v[i].type, v[i].value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int grammar_new_rule(struct grammar_parser * ps, const char * name, size_t len) {
+    struct grammar * g = ps->g;
+    if (len >= GRAMMAR_MAX_NAME) {
+        grammar_error(ps, NULL, "rule name too long");
+        return -1;
+    }
+    if (g->n_rules == g->cap_rules) {
+        const size_t cap = g->cap_rules > 0 ? 2*g->cap_rules : 16;
+        struct grammar_rule * rules = realloc(g->rules, sizeof(struct grammar_rule) * cap);
+        if (!rules) {
+            grammar_error(ps, NULL, "out of memory");
+            return -1;
+        }
+        g->rules = rules;
+        g->cap_rules = cap;
+    }
+    struct grammar_rule * rule = &g->rules[g->n_rules];
+    memset(rule, 0, sizeof(*rule));
+    memcpy(rule->name, name, len);
+    return (int) g->n_rules++;
+}
+
+static int grammar_symbol_id(struct grammar_parser * ps, const char * name, size_t len) {
+    for (size_t i = 0; i < ps->g->n_rules; i++) {
+        if (strlen(ps->g->rules[i].name) == len && strncmp(ps->g->rules[i].name, name, len) == 0) {
+            return (int) i;
+        }
+    }
+    return grammar_new_rule(ps, name, len);
+}
+
+// a fresh rule for a group or repetition inside base
+static int grammar_generate_id(struct grammar_parser * ps, const char * base) {
+    char name[GRAMMAR_MAX_NAME];
+    const int len = snprintf(name, sizeof(name), "%.40s_%zu", base, ps->g->n_rules);
+    return grammar_new_rule(ps, name, (size_t) len);
+}
+
+static bool grammar_add_rule(struct grammar_parser * ps, int id, struct grammar_buf * elems, const char * pos) {
+    struct grammar_rule * rule = &ps->g->rules[id];
+    if (rule->defined) {
+        free(elems->v);
+        grammar_error(ps, pos, "rule defined twice");
+        return false;
+    }
+    rule->elems = *elems;
+    rule->defined = true;
+    return true;
+}
+
+static bool grammar_is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+}
+
+static const char * grammar_space(const char * pos, bool newline_ok) {
+    while (*pos == ' ' || *pos == '\t' || *pos == '#' || (newline_ok && (*pos == '\r' || *pos == '\n'))) {
+        if (*pos == '#') {
+            while (*pos && *pos != '\r' && *pos != '\n') {
+                pos++;
+            }
+        } else {
+            pos++;
+        }
+    }
+    return pos;
+}
+
+static const char * grammar_name(const char * pos) {
+    while (grammar_is_word_char(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+
+static int grammar_hex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static const char * grammar_utf8(const char * pos, uint32_t * out) {
+    static const int lengths[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 4 };
+    const unsigned char first = (unsigned char) *pos;
+    const int len = lengths[first >> 4];
+    uint32_t value = first & ((1u << (8 - len)) - 1);
+    if (len == 1) {
+        value = first;
+    }
+    pos++;
+    for (int i = 1; i < len && *pos; i++, pos++) {
+        value = (value << 6) | ((unsigned char) *pos & 0x3f);
+    }
+    *out = value;
+    return pos;
+}
+
+static const char * grammar_char(struct grammar_parser * ps, const char * pos, uint32_t * out) {
+    if (*pos != '\\') {
+        return grammar_utf8(pos, out);
+    }
+    int n_hex = 0;
+    switch (pos[1]) {
+        case 'x': n_hex = 2; break;
+        case 'u': n_hex = 4; break;
+        case 'U': n_hex = 8; break;
+        case 't': *out = '\t'; return pos + 2;
+        case 'r': *out = '\r'; return pos + 2;
+        case 'n': *out = '\n'; return pos + 2;
+        case '\\':
+        case '"':
+        case '[':
+        case ']': *out = (uint32_t) pos[1]; return pos + 2;
+        default: return grammar_error(ps, pos, "unknown escape");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < n_hex; i++) {
+        const int h = grammar_hex(pos[2 + i]);
+        if (h < 0) {
+            return grammar_error(ps, pos, "expecting hex digits");
+        }
+        value = (value << 4) | (uint32_t) h;
+    }
+    *out = value;
+    return pos + 2 + n_hex;
+}
+
+static const char * grammar_alternates(struct grammar_parser * ps, const char * pos, const char * rule_name, int rule_id, bool nested);
+
+static const char * grammar_sequence(struct grammar_parser * ps, const char * pos, const char * rule_name, struct grammar_buf * out, bool nested) {
+    int last_sym_start = out->n;
+    while (*pos) {
+        if (*pos == '"') {
+            pos++;
+            last_sym_start = out->n;
+            while (*pos != '"') {
+                if (!*pos) {
+                    return grammar_error(ps, pos, "unterminated string");
+                }
+                uint32_t c;
+                if (!(pos = grammar_char(ps, pos, &c)) || !grammar_buf_push(out, WHISPER_GRETYPE_CHAR, c)) {
+                    return grammar_error(ps, pos, "out of memory");
+                }
+            }
+            pos = grammar_space(pos + 1, nested);
+        } else if (*pos == '[') {
+            pos++;
+            enum whisper_gretype type = WHISPER_GRETYPE_CHAR;
+            if (*pos == '^') {
+                pos++;
+                type = WHISPER_GRETYPE_CHAR_NOT;
+            }
+            last_sym_start = out->n;
+            while (*pos != ']') {
+                if (!*pos) {
+                    return grammar_error(ps, pos, "unterminated character class");
+                }
+                uint32_t c;
+                if (!(pos = grammar_char(ps, pos, &c)) || !grammar_buf_push(out, last_sym_start < out->n ? WHISPER_GRETYPE_CHAR_ALT : type, c)) {
+                    return grammar_error(ps, pos, "out of memory");
+                }
+                if (pos[0] == '-' && pos[1] != ']' && pos[1] != '\0') {
+                    uint32_t upper;
+                    if (!(pos = grammar_char(ps, pos + 1, &upper)) || !grammar_buf_push(out, WHISPER_GRETYPE_CHAR_RNG_UPPER, upper)) {
+                        return grammar_error(ps, pos, "out of memory");
+                    }
+                }
+            }
+            pos = grammar_space(pos + 1, nested);
+        } else if (grammar_is_word_char(*pos)) {
+            const char * end = grammar_name(pos);
+            const int id = grammar_symbol_id(ps, pos, (size_t) (end - pos));
+            last_sym_start = out->n;
+            if (id < 0 || !grammar_buf_push(out, WHISPER_GRETYPE_RULE_REF, (uint32_t) id)) {
+                return grammar_error(ps, pos, "out of memory");
+            }
+            pos = grammar_space(end, nested);
+        } else if (*pos == '(') {
+            const int id = grammar_generate_id(ps, rule_name);
+            if (id < 0 || !(pos = grammar_alternates(ps, grammar_space(pos + 1, true), rule_name, id, true))) {
+                return NULL;
+            }
+            last_sym_start = out->n;
+            if (!grammar_buf_push(out, WHISPER_GRETYPE_RULE_REF, (uint32_t) id)) {
+                return grammar_error(ps, pos, "out of memory");
+            }
+            if (*pos != ')') {
+                return grammar_error(ps, pos, "expecting ')'");
+            }
+            pos = grammar_space(pos + 1, nested);
+        } else if (*pos == '*' || *pos == '+' || *pos == '?') {
+            if (last_sym_start == out->n) {
+                return grammar_error(ps, pos, "expecting an item before */+/?");
+            }
+            // S* -> S' ::= S S' |
+            // S+ -> S' ::= S S' | S
+            // S? -> S' ::= S |
+            const int id = grammar_generate_id(ps, rule_name);
+            if (id < 0) {
+                return NULL;
+            }
+            const whisper_grammar_element * sym = out->v + last_sym_start;
+            const int n_sym = out->n - last_sym_start;
+            struct grammar_buf rule = {0};
+            bool ok = grammar_buf_append(&rule, sym, n_sym);
+            if (*pos != '?') {
+                ok = ok && grammar_buf_push(&rule, WHISPER_GRETYPE_RULE_REF, (uint32_t) id);
+            }
+            ok = ok && grammar_buf_push(&rule, WHISPER_GRETYPE_ALT, 0);
+            if (*pos == '+') {
+                ok = ok && grammar_buf_append(&rule, sym, n_sym);
+            }
+            ok = ok && grammar_buf_push(&rule, WHISPER_GRETYPE_END, 0);
+            if (!ok) {
+                free(rule.v);
+                return grammar_error(ps, pos, "out of memory");
+            }
+            if (!grammar_add_rule(ps, id, &rule, pos)) {
+                return NULL;
+            }
+            out->n = last_sym_start;
+            if (!grammar_buf_push(out, WHISPER_GRETYPE_RULE_REF, (uint32_t) id)) {
+                return grammar_error(ps, pos, "out of memory");
+            }
+            pos = grammar_space(pos + 1, nested);
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+static const char * grammar_alternates(struct grammar_parser * ps, const char * pos, const char * rule_name, int rule_id, bool nested) {
+    struct grammar_buf rule = {0};
+    pos = grammar_sequence(ps, pos, rule_name, &rule, nested);
+    while (pos && *pos == '|') {
+        if (!grammar_buf_push(&rule, WHISPER_GRETYPE_ALT, 0)) {
+            pos = grammar_error(ps, pos, "out of memory");
+            break;
+        }
+        pos = grammar_sequence(ps, grammar_space(pos + 1, true), rule_name, &rule, nested);
+    }
+    if (!pos || !grammar_buf_push(&rule, WHISPER_GRETYPE_END, 0)) {
+        free(rule.v);
+        return pos ? grammar_error(ps, pos, "out of memory") : NULL;
+    }
+    return grammar_add_rule(ps, rule_id, &rule, pos) ? pos : NULL;
+}
+
+static const char * grammar_rule_def(struct grammar_parser * ps, const char * pos) {
+    const char * name_end = grammar_name(pos);
+    if (name_end == pos) {
+        return grammar_error(ps, pos, "expecting a rule name");
+    }
+    char name[GRAMMAR_MAX_NAME];
+    snprintf(name, sizeof(name), "%.*s", (int) (name_end - pos), pos);
+    const int id = grammar_symbol_id(ps, pos, (size_t) (name_end - pos));
+    if (id < 0) {
+        return NULL;
+    }
+
+    pos = grammar_space(name_end, false);
+    if (strncmp(pos, "::=", 3) != 0) {
+        return grammar_error(ps, pos, "expecting ::=");
+    }
+    if (!(pos = grammar_alternates(ps, grammar_space(pos + 3, true), name, id, false))) {
+        return NULL;
+    }
+
+    if (*pos == '\r') {
+        pos += pos[1] == '\n' ? 2 : 1;
+    } else if (*pos == '\n') {
+        pos++;
+    } else if (*pos) {
+        return grammar_error(ps, pos, "expecting newline or end");
+    }
+    return grammar_space(pos, true);
+}
+
+static int grammar_utf8_len(uint32_t c) {
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+// longest accepted text of rule id in bytes, -1 when unbounded (recursion)
+static int grammar_rule_max_bytes(const struct grammar * g, size_t id, int * memo, char * state) {
+    if (state[id] == 2) {
+        return memo[id];
+    }
+    if (state[id] == 1) {
+        return -1;
+    }
+    state[id] = 1;
+
+    int best = 0;
+    int cur = 0;
+    const whisper_grammar_element * e = g->rules[id].elems.v;
+    for (;; e++) {
+        if (e->type == WHISPER_GRETYPE_END || e->type == WHISPER_GRETYPE_ALT) {
+            best = cur > best ? cur : best;
+            cur = 0;
+            if (e->type == WHISPER_GRETYPE_END) {
+                break;
+            }
+        } else if (e->type == WHISPER_GRETYPE_RULE_REF) {
+            const int n = grammar_rule_max_bytes(g, e->value, memo, state);
+            if (n < 0) {
+                best = -1;
+                break;
+            }
+            cur += n;
+        } else if (e->type == WHISPER_GRETYPE_CHAR_NOT) {
+            cur += 4;
+        } else if (e->type == WHISPER_GRETYPE_CHAR) {
+            int len = grammar_utf8_len(e->value);
+            while (e[1].type == WHISPER_GRETYPE_CHAR_ALT || e[1].type == WHISPER_GRETYPE_CHAR_RNG_UPPER) {
+                e++;
+                len = grammar_utf8_len(e->value) > len ? grammar_utf8_len(e->value) : len;
+            }
+            cur += len;
+        }
+    }
+
+    memo[id] = best;
+    state[id] = 2;
+    return best;
+}
+
+struct grammar * grammar_parse(const char * src, const char * start_rule, char * err, size_t err_size) {
+    struct grammar * g = calloc(1, sizeof(struct grammar));
+    if (!g) {
+        return NULL;
+    }
+    struct grammar_parser ps = {
+            .g = g,
+            .src = src,
+            .err = err,
+            .err_size = err_size,
+    };
+
+    const char * pos = grammar_space(src, true);
+    while (pos && *pos) {
+        pos = grammar_rule_def(&ps, pos);
+    }
+
+    for (size_t i = 0; !ps.failed && i < g->n_rules; i++) {
+        if (!g->rules[i].defined) {
+            char msg[GRAMMAR_MAX_NAME + 32];
+            snprintf(msg, sizeof(msg), "undefined rule '%s'", g->rules[i].name);
+            grammar_error(&ps, NULL, msg);
+        }
+    }
+
+    bool found = false;
+    for (size_t i = 0; !ps.failed && i < g->n_rules; i++) {
+        if (strcmp(g->rules[i].name, start_rule) == 0) {
+            g->start = i;
+            found = true;
+        }
+    }
+    if (!ps.failed && !found) {
+        grammar_error(&ps, NULL, "start rule not found");
+    }
+
+    if (!ps.failed) {
+        g->ptrs = malloc(sizeof(whisper_grammar_element *) * g->n_rules);
+        int * memo = calloc(g->n_rules, sizeof(int));
+        char * state = calloc(g->n_rules, 1);
+        if (g->ptrs && memo && state) {
+            for (size_t i = 0; i < g->n_rules; i++) {
+                g->ptrs[i] = g->rules[i].elems.v;
+            }
+            g->max_bytes = grammar_rule_max_bytes(g, g->start, memo, state);
+        } else {
+            grammar_error(&ps, NULL, "out of memory");
+        }
+        free(memo);
+        free(state);
+    }
+
+    if (ps.failed) {
+        grammar_free(g);
+        return NULL;
+    }
+    return g;
+}
+
+void grammar_free(struct grammar * g) {
+    if (!g) {
+        return;
+    }
+    for (size_t i = 0; i < g->n_rules; i++) {
+        free(g->rules[i].elems.v);
+    }
+    free(g->rules);
+    free(g->ptrs);
+    free(g);
+}
+
+size_t grammar_n_rules(const struct grammar * g) {
+    return g->n_rules;
+}
+
+int grammar_max_bytes(const struct grammar * g) {
+    return g->max_bytes;
+}
+
+void grammar_apply(const struct grammar * g, struct whisper_full_params * params, float penalty) {
+    params->grammar_rules = g->ptrs;
+    params->n_grammar_rules = g->n_rules;
+    params->i_start_rule = g->start;
+    params->grammar_penalty = penalty;
+}
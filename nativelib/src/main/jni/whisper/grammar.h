@@ -0,0 +1,37 @@
+#ifndef WHISPER_JNI_GRAMMAR_H
+#define WHISPER_JNI_GRAMMAR_H
+
+#include <stddef.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GBNF grammars compiled to whisper's grammar rules, for constrained decoding
+// of voice commands. Supported: rules (name ::= ...), string literals with
+// \n \t \r \\ \" \xHH \uHHHH escapes, character classes [a-z] and [^...],
+// grouping, alternation and the * + ? operators; # starts a comment. A
+// compiled grammar is immutable and can be used by any number of calls.
+struct grammar;
+
+// Returns NULL on a syntax error or undefined rule; err receives the reason.
+struct grammar * grammar_parse(const char * src, const char * start_rule, char * err, size_t err_size);
+void grammar_free(struct grammar * g);
+
+size_t grammar_n_rules(const struct grammar * g);
+
+// Longest text the grammar accepts in UTF-8 bytes, -1 when it is unbounded.
+// As no token is shorter than one byte, it also bounds the decoder steps.
+int grammar_max_bytes(const struct grammar * g);
+
+// Sets grammar_rules, n_grammar_rules, i_start_rule and grammar_penalty. The
+// rules stay owned by g, which must outlive the whisper_full calls.
+void grammar_apply(const struct grammar * g, struct whisper_full_params * params, float penalty);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_GRAMMAR_H
@@ -0,0 +1,212 @@
+#include "hallucination.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define HALLUCINATION_MAX_EVENTS 64
+#define HALLUCINATION_MAX_TOKENS 512
+#define HALLUCINATION_MAX_TEXT   4096
+
+// compression is checked every this many text tokens
+#define HALLUCINATION_COMPRESS_STEP 8
+
+struct hallucination_detector {
+    struct hallucination_params params;
+
+    int window;
+    bool strict;
+
+    struct hallucination_event events[HALLUCINATION_MAX_EVENTS];
+    int n_events;
+
+    whisper_token ids[HALLUCINATION_MAX_TOKENS];
+    char text[HALLUCINATION_MAX_TEXT];
+    unsigned char packed[HALLUCINATION_MAX_TEXT + 64];
+    // set up once and reset per check, so decoding steps do not allocate
+    z_stream zs;
+};
+
+struct hallucination_params hallucination_default_params(void) {
+    struct hallucination_params params = {
+            .max_period               = 16,
+            .min_repeats              = 3,
+            .min_repeat_tokens        = 16,
+            .max_compression          = 2.4f,
+            .min_compress_bytes       = 96,
+            .no_speech_thold          = 0.6f,
+            .strict_min_repeats       = 2,
+            .strict_min_repeat_tokens = 8,
+            .strict_max_compression   = 2.2f,
+    };
+    return params;
+}
+
+struct hallucination_detector * hallucination_init(struct hallucination_params params) {
+    struct hallucination_detector * det = calloc(1, sizeof(struct hallucination_detector));
+    if (!det) {
+        return NULL;
+    }
+    det->params = params;
+    // level 1 and a window covering the whole text buffer
+    if (deflateInit2(&det->zs, 1, Z_DEFLATED, 12, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(det);
+        return NULL;
+    }
+    return det;
+}
+
+void hallucination_free(struct hallucination_detector * det) {
+    if (!det) {
+        return;
+    }
+    deflateEnd(&det->zs);
+    free(det);
+}
+
+// zlib-compressed size of text, 0 on failure
+static size_t hallucination_packed_size(struct hallucination_detector * det, const char * text, int len) {
+    z_stream * zs = &det->zs;
+    if (deflateReset(zs) != Z_OK) {
+        return 0;
+    }
+    zs->next_in = (Bytef *) text;
+    zs->avail_in = (uInt) len;
+    zs->next_out = det->packed;
+    zs->avail_out = sizeof(det->packed);
+    return deflate(zs, Z_FINISH) == Z_STREAM_END ? zs->total_out : 0;
+}
+
+void hallucination_reset(struct hallucination_detector * det) {
+    det->n_events = 0;
+    det->window = 0;
+    det->strict = false;
+}
+
+void hallucination_set_window(struct hallucination_detector * det, int window, bool non_speech) {
+    det->window = window;
+    det->strict = non_speech;
+}
+
+bool hallucination_is_strict(const struct hallucination_detector * det) {
+    return det->strict;
+}
+
+const struct hallucination_params * hallucination_get_params(const struct hallucination_detector * det) {
+    return &det->params;
+}
+
+static struct hallucination_event * hallucination_add_event(struct hallucination_detector * det, enum hallucination_reason reason) {
+    if (det->n_events++ >= HALLUCINATION_MAX_EVENTS) {
+        return NULL;
+    }
+    struct hallucination_event * ev = &det->events[det->n_events - 1];
+    memset(ev, 0, sizeof(*ev));
+    ev->window = det->window;
+    ev->reason = reason;
+    return ev;
+}
+
+// concatenated text of ids[i0, i1), truncated to size
+static int hallucination_text(struct whisper_context * ctx, const whisper_token * ids, int i0, int i1, char * out, int size) {
+    int len = 0;
+    for (int i = i0; i < i1 && len < size - 1; i++) {
+        const char * s = whisper_token_to_str(ctx, ids[i]);
+        const int n = s ? (int) strlen(s) : 0;
+        const int m = n < size - 1 - len ? n : size - 1 - len;
+        memcpy(out + len, s, m);
+        len += m;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+enum hallucination_reason hallucination_check(struct hallucination_detector * det, struct whisper_context * ctx, const whisper_token_data * tokens, int n_tokens) {
+    const struct hallucination_params * p = &det->params;
+    const int min_repeats = det->strict ? p->strict_min_repeats : p->min_repeats;
+    const int min_repeat_tokens = det->strict ? p->strict_min_repeat_tokens : p->min_repeat_tokens;
+    const float max_compression = det->strict ? p->strict_max_compression : p->max_compression;
+
+    // text tokens only: timestamps advance inside a loop and would hide it
+    const whisper_token eot = whisper_token_eot(ctx);
+    whisper_token * ids = det->ids;
+    int m = 0;
+    for (int i = 0; i < n_tokens && m < HALLUCINATION_MAX_TOKENS; i++) {
+        if (tokens[i].id < eot) {
+            ids[m++] = tokens[i].id;
+        }
+    }
+    if (m == 0 || m < min_repeat_tokens) {
+        return HALLUCINATION_NONE;
+    }
+
+    // back to back repeats of the trailing n-gram, for every period
+    for (int period = 1; period <= p->max_period && period*min_repeats <= m; period++) {
+        const whisper_token * last = ids + m - period;
+        int repeats = 1;
+        while ((repeats + 1)*period <= m && memcmp(last - repeats*period, last, sizeof(whisper_token) * period) == 0) {
+            repeats++;
+        }
+        if (repeats >= min_repeats && repeats*period >= min_repeat_tokens) {
+            struct hallucination_event * ev = hallucination_add_event(det, HALLUCINATION_REPETITION);
+            if (ev) {
+                ev->n_tokens = n_tokens;
+                ev->period = period;
+                ev->repeats = repeats;
+                hallucination_text(ctx, ids, m - period, m, ev->text, sizeof(ev->text));
+            }
+            return HALLUCINATION_REPETITION;
+        }
+    }
+
+    // longer loops with small variations still compress far better than speech
+    if (m % HALLUCINATION_COMPRESS_STEP == 0) {
+        const int len = hallucination_text(ctx, ids, 0, m, det->text, sizeof(det->text));
+        if (len >= p->min_compress_bytes) {
+            const size_t packed_len = hallucination_packed_size(det, det->text, len);
+            if (packed_len > 0) {
+                const float ratio = (float) len/packed_len;
+                if (ratio > max_compression) {
+                    struct hallucination_event * ev = hallucination_add_event(det, HALLUCINATION_COMPRESSION);
+                    if (ev) {
+                        ev->n_tokens = n_tokens;
+                        ev->compression = ratio;
+                        snprintf(ev->text, sizeof(ev->text), "%s", det->text + (len > 96 ? len - 96 : 0));
+                    }
+                    return HALLUCINATION_COMPRESSION;
+                }
+            }
+        }
+    }
+
+    return HALLUCINATION_NONE;
+}
+
+void hallucination_record(struct hallucination_detector * det, enum hallucination_reason reason, const char * text) {
+    struct hallucination_event * ev = hallucination_add_event(det, reason);
+    if (ev) {
+        snprintf(ev->text, sizeof(ev->text), "%s", text ? text : "");
+    }
+}
+
+int hallucination_n_events(const struct hallucination_detector * det) {
+    return det->n_events;
+}
+
+int hallucination_n_kept_events(const struct hallucination_detector * det) {
+    return det->n_events < HALLUCINATION_MAX_EVENTS ? det->n_events : HALLUCINATION_MAX_EVENTS;
+}
+
+const struct hallucination_event * hallucination_get_event(const struct hallucination_detector * det, int i) {
+    return i >= 0 && i < hallucination_n_kept_events(det) ? &det->events[i] : NULL;
+}
+
+const char * hallucination_reason_str(enum hallucination_reason reason) {
+    switch (reason) {
+        case HALLUCINATION_REPETITION:  return "repetition";
+        case HALLUCINATION_COMPRESSION: return "compression";
+        case HALLUCINATION_NO_SPEECH:   return "no-speech";
+        default:                        return "none";
+    }
+}
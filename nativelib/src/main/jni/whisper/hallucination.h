@@ -0,0 +1,80 @@
+#ifndef WHISPER_JNI_HALLUCINATION_H
+#define WHISPER_JNI_HALLUCINATION_H
+
+#include <stdbool.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Detects decoders that degenerated into a loop (typical on silence, noise
+// or music) while they are still decoding, so the transcriber can end the
+// sequence instead of letting it fill the text context.
+enum hallucination_reason {
+    HALLUCINATION_NONE = 0,
+    HALLUCINATION_REPETITION,   // the same n-gram repeated back to back
+    HALLUCINATION_COMPRESSION,  // text compresses too well (OpenAI's 2.4 rule)
+    HALLUCINATION_NO_SPEECH,    // segment dropped on a window without speech
+};
+
+struct hallucination_params {
+    int   max_period;          // longest repeated n-gram looked for, in text tokens
+    int   min_repeats;         // back to back occurrences of the n-gram
+    int   min_repeat_tokens;   // and at least this many tokens in the repeated run
+    float max_compression;     // zlib compression ratio of the decoded text
+    int   min_compress_bytes;  // shorter text is not checked for compression
+    float no_speech_thold;     // segments above it are dropped on non-speech windows
+
+    // on windows the VAD finds mostly non-speech: repeats and compression limit
+    int   strict_min_repeats;
+    int   strict_min_repeat_tokens;
+    float strict_max_compression;
+};
+
+struct hallucination_params hallucination_default_params(void);
+
+struct hallucination_event {
+    int   window;
+    int   n_tokens;      // sequence length when the decoder was stopped
+    enum hallucination_reason reason;
+    int   period;        // n-gram length, for repetitions
+    int   repeats;
+    float compression;
+    char  text[128];     // the repeated n-gram or the tail of the dropped text
+};
+
+struct hallucination_detector;
+
+struct hallucination_detector * hallucination_init(struct hallucination_params params);
+void hallucination_free(struct hallucination_detector * det);
+
+// forgets the recorded events, called at the start of every transcription
+void hallucination_reset(struct hallucination_detector * det);
+
+// window index and VAD verdict for the events and checks that follow
+void hallucination_set_window(struct hallucination_detector * det, int window, bool non_speech);
+
+bool hallucination_is_strict(const struct hallucination_detector * det);
+const struct hallucination_params * hallucination_get_params(const struct hallucination_detector * det);
+
+// Checks the tokens a decoder has produced so far (timestamps and special
+// tokens are ignored). A degenerate sequence is recorded as an event.
+enum hallucination_reason hallucination_check(struct hallucination_detector * det, struct whisper_context * ctx, const whisper_token_data * tokens, int n_tokens);
+
+// records a segment the transcriber dropped
+void hallucination_record(struct hallucination_detector * det, enum hallucination_reason reason, const char * text);
+
+// events recorded since the last reset; only the first few are kept
+int hallucination_n_events(const struct hallucination_detector * det);
+int hallucination_n_kept_events(const struct hallucination_detector * det);
+const struct hallucination_event * hallucination_get_event(const struct hallucination_detector * det, int i);
+
+const char * hallucination_reason_str(enum hallucination_reason reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_HALLUCINATION_H
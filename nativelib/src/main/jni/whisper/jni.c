@@ -2,11 +2,28 @@
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include <android/log.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/sysinfo.h>
 #include <string.h>
 #include "whisper.h"
 #include "ggml.h"
+#include "mel.h"
+#include "mel_stream.h"
+#include "preprocess.h"
+#include "transcribe.h"
+#include "hallucination.h"
+#include "grammar.h"
+#include "kws.h"
+#include "batch.h"
+#include "transcribe_file.h"
+#include "audio_file.h"
+#include "server.h"
+#include "model_share.h"
+#include "perf_counters.h"
+#include "power.h"
+#include "thermal.h"
+#include "loader.h"
 
 #define UNUSED(x) (void)(x)
 #define TAG "JNI"
@@ -22,51 +39,84 @@ static inline int max(int a, int b) {
     return (a > b) ? a : b;
 }
 
+// bytes copied through Java per InputStream.read call
+#define INPUT_STREAM_CHUNK (256*1024)
+
 struct input_stream_context {
     size_t offset;
     JNIEnv * env;
     jobject thiz;
     jobject input_stream;
+    jbyteArray buffer;   // INPUT_STREAM_CHUNK bytes, reused by every read
+    bool failed;         // the stream ended early or threw
 
     jmethodID mid_available;
     jmethodID mid_read;
 };
 
+// One InputStream.read into the shared buffer. available() is only a hint,
+// and read() may return fewer bytes than asked or -1 at the end; it never
+// returns more than asked, but a broken subclass could, so that is an error.
+static long input_stream_read_some(void * ctx, void * dst, size_t n) {
+    struct input_stream_context * is = (struct input_stream_context *) ctx;
+    JNIEnv * env = is->env;
+    const jint size = (jint) (n < INPUT_STREAM_CHUNK ? n : INPUT_STREAM_CHUNK);
+    const jint n_read = (*env)->CallIntMethod(env, is->input_stream, is->mid_read, is->buffer, 0, size);
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+        return -1;
+    }
+    if (n_read <= 0 || n_read > size) {
+        return n_read == -1 ? 0 : -1;
+    }
+    (*env)->GetByteArrayRegion(env, is->buffer, 0, n_read, (jbyte *) dst);
+    return n_read;
+}
+
 size_t inputStreamRead(void * ctx, void * output, size_t read_size) {
     struct input_stream_context* is = (struct input_stream_context*)ctx;
 
-    jint avail_size = (*is->env)->CallIntMethod(is->env, is->input_stream, is->mid_available);
-    jint size_to_copy = read_size < avail_size ? (jint)read_size : avail_size;
-
-    jbyteArray byte_array = (*is->env)->NewByteArray(is->env, size_to_copy);
-
-    jint n_read = (*is->env)->CallIntMethod(is->env, is->input_stream, is->mid_read, byte_array, 0, size_to_copy);
-
-    if (size_to_copy != read_size || size_to_copy != n_read) {
-        LOGI("Insufficient Read: Req=%zu, ToCopy=%d, Available=%d", read_size, size_to_copy, n_read);
+    const size_t n_read = loader_read_full(input_stream_read_some, is, output, read_size);
+    if (n_read != read_size && !is->failed) {
+        LOGW("Insufficient Read: Req=%zu, Read=%zu at offset %zu", read_size, n_read, is->offset);
+        is->failed = true;
     }
+    is->offset += n_read;
 
-    jbyte* byte_array_elements = (*is->env)->GetByteArrayElements(is->env, byte_array, NULL);
-    memcpy(output, byte_array_elements, size_to_copy);
-    (*is->env)->ReleaseByteArrayElements(is->env, byte_array, byte_array_elements, JNI_ABORT);
-
-    (*is->env)->DeleteLocalRef(is->env, byte_array);
-
-    is->offset += size_to_copy;
-
-    return size_to_copy;
+    return n_read;
 }
 bool inputStreamEof(void * ctx) {
     struct input_stream_context* is = (struct input_stream_context*)ctx;
+    if (is->failed) {
+        return true;
+    }
 
     jint result = (*is->env)->CallIntMethod(is->env, is->input_stream, is->mid_available);
+    if ((*is->env)->ExceptionCheck(is->env)) {
+        (*is->env)->ExceptionClear(is->env);
+        return true;
+    }
     return result <= 0;
 }
 void inputStreamClose(void * ctx) {
 
 }
+
+// The Kotlin side holds a transcriber, which owns the whisper context and the
+// results of the last call.
+static jlong wrap_context(struct whisper_context *context) {
+    if (context == NULL) {
+        return 0;
+    }
+    struct transcriber *tr = transcriber_init(context);
+    if (tr == NULL) {
+        whisper_free(context);
+    }
+    return (jlong) tr;
+}
+
 JNIEXPORT jlong JNICALL
-Java_com_whispercpp_whisper_WhisperLib_00024Companion_initContextFromInputStream(
+Java_com_whispercpp_whisper_WhisperLib_initContextFromInputStream(
         JNIEnv *env, jobject thiz, jobject input_stream) {
     UNUSED(thiz);
 
@@ -82,6 +132,10 @@ Java_com_whispercpp_whisper_WhisperLib_00024Companion_initContextFromInputStream
     jclass cls = (*env)->GetObjectClass(env, input_stream);
     inp_ctx.mid_available = (*env)->GetMethodID(env, cls, "available", "()I");
     inp_ctx.mid_read = (*env)->GetMethodID(env, cls, "read", "([BII)I");
+    inp_ctx.buffer = (*env)->NewByteArray(env, INPUT_STREAM_CHUNK);
+    if (!inp_ctx.mid_available || !inp_ctx.mid_read || !inp_ctx.buffer) {
+        return 0;
+    }
 
     loader.context = &inp_ctx;
     loader.read = inputStreamRead;
@@ -91,11 +145,18 @@ Java_com_whispercpp_whisper_WhisperLib_00024Companion_initContextFromInputStream
     loader.eof(loader.context);
 
     context = whisper_init(&loader);
-    return (jlong) context;
+    (*env)->DeleteLocalRef(env, inp_ctx.buffer);
+    return wrap_context(context);
+}
+
+// AAsset_read returns a negative value on error and, for compressed or
+// streamed assets, may return fewer bytes than asked.
+static long asset_read_some(void *ctx, void *dst, size_t n) {
+    return AAsset_read((AAsset *) ctx, dst, n);
 }
 
 static size_t asset_read(void *ctx, void *output, size_t read_size) {
-    return AAsset_read((AAsset *) ctx, output, read_size);
+    return loader_read_full(asset_read_some, ctx, output, read_size);
 }
 
 static bool asset_is_eof(void *ctx) {
@@ -137,7 +198,7 @@ Java_com_whispercpp_whisper_WhisperLib_initContextFromAsset(
     const char *asset_path_chars = (*env)->GetStringUTFChars(env, asset_path_str, NULL);
     context = whisper_init_from_asset(env, assetManager, asset_path_chars);
     (*env)->ReleaseStringUTFChars(env, asset_path_str, asset_path_chars);
-    return (jlong) context;
+    return wrap_context(context);
 }
 
 JNIEXPORT jlong JNICALL
@@ -148,16 +209,179 @@ Java_com_whispercpp_whisper_WhisperLib_initContext(
     const char *model_path_chars = (*env)->GetStringUTFChars(env, model_path_str, NULL);
     context = whisper_init_from_file_with_params(model_path_chars, whisper_context_default_params());
     (*env)->ReleaseStringUTFChars(env, model_path_str, model_path_chars);
-    return (jlong) context;
+    return wrap_context(context);
+}
+
+static size_t file_read(void *ctx, void *output, size_t read_size) {
+    return fread(output, 1, read_size, (FILE *) ctx);
+}
+
+static bool file_is_eof(void *ctx) {
+    return feof((FILE *) ctx) != 0;
+}
+
+static void file_close(void *ctx) {
+    fclose((FILE *) ctx);
+}
+
+static jint create_shared_model(struct whisper_model_loader *loader, const char *name) {
+    struct model_share_stats stats;
+    const int fd = model_share_create(loader, &stats);
+    if (fd < 0) {
+        LOGW("Couldn't share '%s'", name);
+    } else {
+        LOGI("Shared '%s': %.1f MB region in %.0f ms", name, stats.region_bytes / 1048576.0, stats.load_ms);
+    }
+    return fd;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_createSharedModel(
+        JNIEnv *env, jclass clazz, jstring model_path_str) {
+    UNUSED(clazz);
+    const char *model_path = (*env)->GetStringUTFChars(env, model_path_str, NULL);
+    FILE *f = fopen(model_path, "rb");
+    jint fd = -1;
+    if (f == NULL) {
+        LOGW("Failed to open '%s'\n", model_path);
+    } else {
+        struct whisper_model_loader loader = {
+                .context = f,
+                .read = &file_read,
+                .eof = &file_is_eof,
+                .close = &file_close
+        };
+        fd = create_shared_model(&loader, model_path);
+    }
+    (*env)->ReleaseStringUTFChars(env, model_path_str, model_path);
+    return fd;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_createSharedModelFromAsset(
+        JNIEnv *env, jclass clazz, jobject assetManager, jstring asset_path_str) {
+    UNUSED(clazz);
+    const char *asset_path = (*env)->GetStringUTFChars(env, asset_path_str, NULL);
+    AAssetManager *asset_manager = AAssetManager_fromJava(env, assetManager);
+    AAsset *asset = AAssetManager_open(asset_manager, asset_path, AASSET_MODE_STREAMING);
+    jint fd = -1;
+    if (asset == NULL) {
+        LOGW("Failed to open '%s'\n", asset_path);
+    } else {
+        struct whisper_model_loader loader = {
+                .context = asset,
+                .read = &asset_read,
+                .eof = &asset_is_eof,
+                .close = &asset_close
+        };
+        fd = create_shared_model(&loader, asset_path);
+    }
+    (*env)->ReleaseStringUTFChars(env, asset_path_str, asset_path);
+    return fd;
+}
+
+// fd stays owned by the caller's ParcelFileDescriptor.
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_initContextFromSharedModel(
+        JNIEnv *env, jclass clazz, jint fd) {
+    UNUSED(env);
+    UNUSED(clazz);
+    struct model_share_stats stats;
+    struct whisper_context *context = model_share_open(fd, whisper_context_default_params(), &stats);
+    if (context == NULL) {
+        LOGW("Couldn't open the shared model");
+        return 0;
+    }
+    LOGI("Opened the shared model in %.0f ms: %.1f MB mapped, %.1f MB copied", stats.load_ms,
+         stats.shared_bytes / 1048576.0, stats.copied_bytes / 1048576.0);
+    return wrap_context(context);
 }
 
 JNIEXPORT void JNICALL
-Java_com_whispercpp_whisper_WhisperLib_Companion_freeContext(
+Java_com_whispercpp_whisper_WhisperLib_freeContext(
         JNIEnv *env, jobject thiz, jlong context_ptr) {
     UNUSED(env);
     UNUSED(thiz);
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
-    whisper_free(context);
+    transcriber_free((struct transcriber *) context_ptr);
+}
+
+static struct whisper_full_params transcribe_params(const char *lang_cstr, jint num_threads, jboolean translate) {
+    // The below adapted from the Objective-C iOS sample
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.translate = (translate == JNI_TRUE);
+    params.print_realtime = false;//true;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = lang_cstr;
+    params.n_threads = num_threads;
+    params.offset_ms = 0;
+    params.no_context = true;
+    params.single_segment = false;
+    return params;
+}
+
+static void log_transcription(struct transcriber *tr) {
+    const struct transcribe_stats *stats = transcriber_stats(tr);
+    LOGI("Decoded %d windows (%d skipped, %.1f s of silence) in %.1f ms, mel %.1f ms",
+         stats->n_windows, stats->n_windows_skipped, stats->skipped_s, stats->total_ms, stats->mel_ms);
+    LOGI("Fallbacks: %d of budget %d, %.1f ms, %d windows capped",
+         stats->n_fallbacks, stats->fallback_budget, stats->fallback_ms, stats->n_windows_capped);
+    LOGI("Setup %.1f ms, encode %.1f ms, audio_ctx %d, %d windows reused the previous shape",
+         stats->setup_ms, stats->encode_ms, stats->audio_ctx, stats->n_shape_reuses);
+    if (stats->n_speculated > 0) {
+        LOGI("Pipelined encode: %d of %d windows encoded ahead were used, %.1f ms of encoding hidden",
+             stats->n_spec_hits, stats->n_speculated, stats->encode_hidden_ms);
+    }
+
+    if (stats->n_speakers > 0) {
+        LOGI("Diarization: %d speakers, %.1f ms on its thread, decoder waited %.1f ms",
+             stats->n_speakers, stats->diarize_ms, stats->diarize_wait_ms);
+    }
+
+    if (stats->n_allocs >= 0) {
+        LOGI("Heap: %d allocations (%d inside whisper_full), %d bytes of per-call data in the arena",
+             stats->n_allocs, stats->n_allocs_whisper, stats->arena_bytes);
+    }
+
+    if (transcriber_n_bias_phrases(tr) > 0) {
+        LOGI("Vocabulary bias: %d phrases, %d decoder steps biased",
+             transcriber_n_bias_phrases(tr), stats->n_biased_steps);
+    }
+
+    const struct hallucination_detector *det = transcriber_hallucinations(tr);
+    if (det != NULL && hallucination_n_events(det) > 0) {
+        LOGI("Hallucinations: %d decoders stopped (<= %d steps saved), %d segments dropped",
+             stats->n_stopped, stats->n_steps_saved, stats->n_suppressed);
+        for (int i = 0; i < hallucination_n_kept_events(det); i++) {
+            const struct hallucination_event *ev = hallucination_get_event(det, i);
+            LOGI("  window %d: %s after %d tokens: '%s'",
+                 ev->window, hallucination_reason_str(ev->reason), ev->n_tokens, ev->text);
+        }
+    }
+    const struct thermal_governor *thermal = transcriber_thermal(tr);
+    if (thermal != NULL && thermal_n_events(thermal) > 0) {
+        LOGI("Thermal: %d windows throttled, up to %.1f C",
+             thermal_n_throttled_windows(thermal), thermal_max_temp_c(thermal));
+        for (int i = 0; i < thermal_n_kept_events(thermal); i++) {
+            const struct thermal_event *ev = thermal_get_event(thermal, i);
+            LOGI("  window %d: %s at %.1f C, encode %.1f ms: %d threads on %#llx -> %d threads on %#llx",
+                 ev->window, thermal_reason_str(ev->reason), ev->temp_c, ev->encode_ms,
+                 ev->from.n_threads, (unsigned long long) ev->from.cpu_mask,
+                 ev->to.n_threads, (unsigned long long) ev->to.cpu_mask);
+        }
+    }
+    const struct transcribe_perf *perf = transcriber_perf(tr);
+    if (perf != NULL) {
+        const struct perf_sample *stages[] = { &perf->mel, &perf->encode, &perf->decode, &perf->total };
+        const char *names[] = { "mel", "encode", "decode", "total" };
+        char line[512];
+        for (int i = 0; i < 4; i++) {
+            perf_sample_format(stages[i], line, sizeof(line));
+            LOGI("perf %s: %s", names[i], line);
+        }
+    }
+    whisper_print_timings(transcriber_context(tr));
 }
 
 JNIEXPORT void JNICALL
@@ -167,71 +391,994 @@ Java_com_whispercpp_whisper_WhisperLib_fullTranscribe(
     // 実装は元と同じでOK
     UNUSED(env);
 
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
+    struct transcriber *tr = (struct transcriber *) context_ptr;
     jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
     const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
     const char *lang_cstr = (*env)->GetStringUTFChars(env, lang_str, NULL);
 
     LOGI("Language: %s", lang_cstr);
 
-    // The below adapted from the Objective-C iOS sample
-    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    params.translate = (translate == JNI_TRUE);
-    params.print_realtime = false;//true;
-    params.print_progress = false;
-    params.print_timestamps = false;
-    params.print_special = false;
-    params.language = lang_cstr;
-    params.n_threads = num_threads;
-    params.offset_ms = 0;
-    params.no_context = true;
-    params.single_segment = false;
+    struct whisper_full_params params = transcribe_params(lang_cstr, num_threads, translate);
 
-    whisper_reset_timings(context);
+    whisper_reset_timings(transcriber_context(tr));
 
+    // Native mel front-end, then one window at a time under the fallback policy
     LOGI("About to run whisper_full");
-    if (whisper_full(context, params, audio_data_arr, audio_data_length) != 0) {
+    if (transcriber_run_pcm(tr, params, audio_data_arr, audio_data_length) != 0) {
         LOGI("Failed to run the model");
     } else {
-        whisper_print_timings(context);
+        log_transcription(tr);
     }
     (*env)->ReleaseStringUTFChars(env, lang_str, lang_cstr);
     (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, JNI_ABORT);
 }
 
+// Language of a call as an id of whisper's table (see getLanguages), -1 to
+// detect it. NULL for anything else, so a bad id fails before any work.
+static const char *lang_from_id(jint lang_id) {
+    if (lang_id == -1) {
+        return "auto";
+    }
+    return lang_id >= 0 && lang_id <= whisper_lang_max_id() ? whisper_lang_str(lang_id) : NULL;
+}
+
+// Copies the first length samples of a Java array into the transcriber's
+// reusable input buffer. The critical section only spans the memcpy, so the
+// VM neither copies the array for us nor holds off the GC for the call.
+static const float *copy_audio(JNIEnv *env, struct transcriber *tr, jfloatArray audio_data, jint length) {
+    if (length <= 0 || length > (*env)->GetArrayLength(env, audio_data)) {
+        return NULL;
+    }
+    float *input = transcriber_input_buffer(tr, length);
+    if (input == NULL) {
+        return NULL;
+    }
+    void *samples = (*env)->GetPrimitiveArrayCritical(env, audio_data, NULL);
+    if (samples == NULL) {
+        return NULL;
+    }
+    memcpy(input, samples, sizeof(float) * length);
+    (*env)->ReleasePrimitiveArrayCritical(env, audio_data, samples, JNI_ABORT);
+    return input;
+}
+
+// Same as fullTranscribe without per-call marshalling: the language is an id
+// and the samples are copied into a buffer reused across calls.
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_fullTranscribeFast(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jint lang_id, jint num_threads, jboolean translate,
+        jfloatArray audio_data, jint length) {
+    UNUSED(clazz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    // getText must not return the previous call's transcript
+    const char *lang = lang_from_id(lang_id);
+    if (lang == NULL) {
+        LOGW("Unknown language id %d", lang_id);
+        transcriber_reset(tr);
+        return;
+    }
+    const float *samples = copy_audio(env, tr, audio_data, length);
+    if (samples == NULL) {
+        LOGW("No audio to transcribe");
+        transcriber_reset(tr);
+        return;
+    }
+
+    struct whisper_full_params params = transcribe_params(lang, num_threads, translate);
+
+    whisper_reset_timings(transcriber_context(tr));
+    if (transcriber_run_pcm(tr, params, samples, length) != 0) {
+        LOGI("Failed to run the model");
+    } else {
+        log_transcription(tr);
+    }
+}
+
+struct segment_listener {
+    JNIEnv *env;
+    jobject listener;
+    jmethodID on_segment;
+};
+
+static int segment_to_listener(const struct transcribe_segment *seg, void *user_data) {
+    struct segment_listener *sl = (struct segment_listener *) user_data;
+    JNIEnv *env = sl->env;
+    jstring text = (*env)->NewStringUTF(env, seg->text);
+    const jboolean more = (*env)->CallBooleanMethod(env, sl->listener, sl->on_segment, (jlong) seg->t0, (jlong) seg->t1,
+            text, (jint) seg->n_fallbacks, (jfloat) seg->fallback_ms, (jfloat) seg->no_speech_prob, (jint) seg->speaker);
+    (*env)->DeleteLocalRef(env, text);
+    return more == JNI_TRUE && !(*env)->ExceptionCheck(env) ? 0 : 1;
+}
+
+// Files of any length in bounded memory: the native side reads and resamples
+// chunk by chunk and hands every segment to the listener as it is decoded.
+// Returns the file statistics, NULL when the file cannot be transcribed.
+// Order must match WhisperFileStats.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_fullTranscribeFile(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jstring path_str, jint lang_id, jint num_threads,
+        jboolean translate, jint chunk_s, jobject listener) {
+    UNUSED(clazz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    const char *lang = lang_from_id(lang_id);
+    if (lang == NULL) {
+        LOGW("Unknown language id %d", lang_id);
+        return NULL;
+    }
+    jclass cls = (*env)->GetObjectClass(env, listener);
+    struct segment_listener sl = {
+            .env = env,
+            .listener = listener,
+            .on_segment = (*env)->GetMethodID(env, cls, "onSegment", "(JJLjava/lang/String;IFFI)Z"),
+    };
+    if (sl.on_segment == NULL) {
+        return NULL;
+    }
+
+    struct whisper_full_params params = transcribe_params(lang, num_threads, translate);
+    const char *path = (*env)->GetStringUTFChars(env, path_str, NULL);
+    struct transcribe_file_stats stats;
+    const int rc = transcribe_file(tr, params, path, chunk_s, segment_to_listener, &sl, &stats);
+    if (rc != 0) {
+        LOGW("Couldn't transcribe %s", path);
+    } else {
+        LOGI("File: %.1f s in %d chunks, %d segments, %.1f s carried over, read %.1f ms, total %.1f ms, buffer %zu bytes",
+             stats.duration_s, stats.n_chunks, stats.n_segments, stats.carried_s, stats.read_ms, stats.total_ms,
+             stats.buffer_bytes);
+    }
+    (*env)->ReleaseStringUTFChars(env, path_str, path);
+    if (rc != 0 || (*env)->ExceptionCheck(env)) {
+        return NULL;
+    }
+
+    const jfloat values[] = {
+            stats.duration_s,
+            (jfloat) stats.n_chunks,
+            (jfloat) stats.n_segments,
+            (jfloat) stats.n_windows,
+            stats.carried_s,
+            (jfloat) stats.buffer_bytes,
+            stats.read_ms,
+            stats.total_ms,
+    };
+    const jsize n = (jsize) (sizeof(values)/sizeof(values[0]));
+    jfloatArray array = (*env)->NewFloatArray(env, n);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+static jobjectArray language_table(JNIEnv *env, const char *(*name)(int)) {
+    const int n = whisper_lang_max_id() + 1;
+    jobjectArray table = (*env)->NewObjectArray(env, n, (*env)->FindClass(env, "java/lang/String"), NULL);
+    for (int id = 0; table != NULL && id < n; id++) {
+        jstring str = (*env)->NewStringUTF(env, name(id));
+        (*env)->SetObjectArrayElement(env, table, id, str);
+        (*env)->DeleteLocalRef(env, str);
+    }
+    return table;
+}
+
+// whisper's language codes indexed by id, read once by WhisperLanguages.
+JNIEXPORT jobjectArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getLanguages(
+        JNIEnv *env, jclass clazz) {
+    UNUSED(clazz);
+    return language_table(env, whisper_lang_str);
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getLanguageNames(
+        JNIEnv *env, jclass clazz) {
+    UNUSED(clazz);
+    return language_table(env, whisper_lang_str_full);
+}
+
+// Marshalling probes for WhisperContext.benchJniOverhead: the argument
+// handling of fullTranscribe and of fullTranscribeFast, without transcribing.
+JNIEXPORT jfloat JNICALL
+Java_com_whispercpp_whisper_WhisperLib_benchJniElements(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jstring lang_str, jfloatArray audio_data) {
+    UNUSED(clazz);
+    UNUSED(context_ptr);
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+    const char *lang_cstr = (*env)->GetStringUTFChars(env, lang_str, NULL);
+    const jfloat first = audio_data_length > 0 ? audio_data_arr[0] : 0.0f;
+    (*env)->ReleaseStringUTFChars(env, lang_str, lang_cstr);
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, JNI_ABORT);
+    return first;
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_whispercpp_whisper_WhisperLib_benchJniCritical(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jint lang_id, jfloatArray audio_data, jint length) {
+    UNUSED(clazz);
+    const char *lang = lang_from_id(lang_id);
+    const float *samples = copy_audio(env, (struct transcriber *) context_ptr, audio_data, length);
+    return samples != NULL && lang != NULL ? samples[0] : 0.0f;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_compileGrammar(
+        JNIEnv *env, jobject thiz, jstring grammar_str, jstring start_rule_str) {
+    UNUSED(thiz);
+    const char *grammar_cstr = (*env)->GetStringUTFChars(env, grammar_str, NULL);
+    const char *start_rule_cstr = (*env)->GetStringUTFChars(env, start_rule_str, NULL);
+    char err[128] = "";
+    struct grammar *grammar = grammar_parse(grammar_cstr, start_rule_cstr, err, sizeof(err));
+    if (grammar == NULL) {
+        LOGW("Invalid grammar: %s", err);
+    } else {
+        LOGI("Grammar: %zu rules, longest match %d bytes", grammar_n_rules(grammar), grammar_max_bytes(grammar));
+    }
+    (*env)->ReleaseStringUTFChars(env, start_rule_str, start_rule_cstr);
+    (*env)->ReleaseStringUTFChars(env, grammar_str, grammar_cstr);
+    return (jlong) grammar;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freeGrammar(
+        JNIEnv *env, jobject thiz, jlong grammar_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    grammar_free((struct grammar *) grammar_ptr);
+}
+
+// Command recognition: the decoder may only produce text the grammar accepts,
+// as one segment without timestamps and without temperature fallbacks.
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_fullTranscribeGrammar(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jlong grammar_ptr, jfloat penalty, jint lang_id,
+        jint num_threads, jfloatArray audio_data) {
+    UNUSED(clazz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    const struct grammar *grammar = (const struct grammar *) grammar_ptr;
+    const char *lang = lang_from_id(lang_id);
+    if (lang == NULL) {
+        LOGW("Unknown language id %d", lang_id);
+        return;
+    }
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+
+    struct whisper_full_params params = transcribe_params(lang, num_threads, JNI_FALSE);
+    grammar_apply(grammar, &params, penalty);
+    params.no_timestamps = true;
+    params.single_segment = true;
+    // every token is at least one byte, so a finite grammar bounds the steps
+    if (grammar_max_bytes(grammar) > 0) {
+        params.max_tokens = grammar_max_bytes(grammar) + 1;
+    }
+
+    const struct transcribe_policy policy = transcriber_get_policy(tr);
+    struct transcribe_policy command_policy = policy;
+    command_policy.max_fallbacks_per_window = 0;
+    transcriber_set_policy(tr, command_policy);
+
+    whisper_reset_timings(transcriber_context(tr));
+    if (transcriber_run_pcm(tr, params, audio_data_arr, audio_data_length) != 0) {
+        LOGI("Failed to run the model");
+    } else {
+        const struct transcribe_stats *stats = transcriber_stats(tr);
+        LOGI("Command decoded in %d steps, %.1f ms", stats->n_steps, stats->total_ms);
+    }
+
+    transcriber_set_policy(tr, policy);
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, JNI_ABORT);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_initKeywordSpotter(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jstring lang_str, jint num_threads, jint window_ms, jint hop_ms,
+        jfloat duty_cycle, jfloat threshold) {
+    UNUSED(thiz);
+    const char *lang_cstr = (*env)->GetStringUTFChars(env, lang_str, NULL);
+    struct kws_params params = kws_default_params();
+    params.language = lang_cstr;
+    params.n_threads = num_threads;
+    params.window_ms = window_ms;
+    params.hop_ms = hop_ms;
+    params.duty_cycle = duty_cycle;
+    params.threshold = threshold;
+    struct kws *kws = kws_init(transcriber_context((struct transcriber *) context_ptr), params);
+    (*env)->ReleaseStringUTFChars(env, lang_str, lang_cstr);
+    return (jlong) kws;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freeKeywordSpotter(
+        JNIEnv *env, jobject thiz, jlong kws_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    kws_free((struct kws *) kws_ptr);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_keywordSpotterAdd(
+        JNIEnv *env, jobject thiz, jlong kws_ptr, jstring keyword_str) {
+    UNUSED(thiz);
+    const char *keyword_cstr = (*env)->GetStringUTFChars(env, keyword_str, NULL);
+    const int id = kws_add_keyword((struct kws *) kws_ptr, keyword_cstr);
+    if (id < 0) {
+        LOGW("Keyword ignored: '%s'", keyword_cstr);
+    }
+    (*env)->ReleaseStringUTFChars(env, keyword_str, keyword_cstr);
+    return id;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_keywordSpotterReset(
+        JNIEnv *env, jobject thiz, jlong kws_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    kws_reset((struct kws *) kws_ptr);
+}
+
+// Detections as (keyword, score, t0_ms, t1_ms) quadruples, NULL on bad input.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_keywordSpotterAccept(
+        JNIEnv *env, jobject thiz, jlong kws_ptr, jfloatArray audio_data, jint offset, jint length) {
+    UNUSED(thiz);
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+    if (offset < 0 || length < 0 || offset > audio_data_length - length) {
+        LOGW("keywordSpotterAccept: range %d+%d outside of %d samples", offset, length, audio_data_length);
+        return NULL;
+    }
+    struct kws_detection dets[16];
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    const int n_dets = kws_push((struct kws *) kws_ptr, audio_data_arr + offset, length, dets, 16);
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, JNI_ABORT);
+    if (n_dets < 0) {
+        return NULL;
+    }
+
+    jfloat values[16*4];
+    for (int i = 0; i < n_dets; i++) {
+        values[4*i + 0] = (jfloat) dets[i].keyword;
+        values[4*i + 1] = dets[i].score;
+        values[4*i + 2] = (jfloat) dets[i].t0_ms;
+        values[4*i + 3] = (jfloat) dets[i].t1_ms;
+    }
+    jfloatArray array = (*env)->NewFloatArray(env, 4*n_dets);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, 4*n_dets, values);
+    }
+    return array;
+}
+
+// Order must match WhisperKeywordStats.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_keywordSpotterStats(
+        JNIEnv *env, jobject thiz, jlong kws_ptr) {
+    UNUSED(thiz);
+    const struct kws_stats *stats = kws_get_stats((struct kws *) kws_ptr);
+    const jfloat values[] = {
+            stats->audio_s,
+            (jfloat) stats->n_windows,
+            (jfloat) stats->n_skipped,
+            (jfloat) stats->n_steps,
+            (jfloat) stats->n_detections,
+            stats->cpu_ms,
+            stats->wall_ms,
+    };
+    const jsize n = (jsize) (sizeof(values)/sizeof(values[0]));
+    jfloatArray array = (*env)->NewFloatArray(env, n);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_initBatchDecoder(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jstring lang_str, jint num_threads, jint n_seq) {
+    UNUSED(thiz);
+    const char *lang_cstr = (*env)->GetStringUTFChars(env, lang_str, NULL);
+    struct batch_params params = batch_default_params();
+    params.language = lang_cstr;
+    params.n_threads = num_threads;
+    params.n_seq = n_seq;
+    struct batch_decoder *b = batch_init(transcriber_context((struct transcriber *) context_ptr), params);
+    (*env)->ReleaseStringUTFChars(env, lang_str, lang_cstr);
+    return (jlong) b;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freeBatchDecoder(
+        JNIEnv *env, jobject thiz, jlong batch_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    batch_free((struct batch_decoder *) batch_ptr);
+}
+
+// One string per clip, in order; NULL when decoding failed.
+JNIEXPORT jobjectArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_batchDecoderTranscribe(
+        JNIEnv *env, jobject thiz, jlong batch_ptr, jobjectArray clips) {
+    UNUSED(thiz);
+    struct batch_decoder *b = (struct batch_decoder *) batch_ptr;
+    const jsize n_clips = (*env)->GetArrayLength(env, clips);
+    jfloatArray *arrays = calloc(n_clips > 0 ? n_clips : 1, sizeof(jfloatArray));
+    jfloat **samples = calloc(n_clips > 0 ? n_clips : 1, sizeof(jfloat *));
+    jobjectArray result = NULL;
+
+    // the samples stay pinned until every window is decoded
+    batch_clear(b);
+    bool ok = arrays != NULL && samples != NULL;
+    for (jsize i = 0; ok && i < n_clips; i++) {
+        arrays[i] = (jfloatArray) (*env)->GetObjectArrayElement(env, clips, i);
+        samples[i] = (*env)->GetFloatArrayElements(env, arrays[i], NULL);
+        ok = samples[i] != NULL && batch_submit(b, samples[i], (*env)->GetArrayLength(env, arrays[i])) >= 0;
+    }
+    if (ok && batch_run(b) == 0) {
+        const struct batch_stats *stats = batch_get_stats(b);
+        LOGI("Batch: %d clips, %d windows, %d tokens in %d steps (%.1f sequences per step), encode %.1f ms, decode %.1f ms",
+             stats->n_requests, stats->n_windows, stats->n_tokens, stats->n_steps, stats->mean_active,
+             stats->encode_ms, stats->decode_ms);
+        result = (*env)->NewObjectArray(env, n_clips, (*env)->FindClass(env, "java/lang/String"), NULL);
+        for (jsize i = 0; result != NULL && i < n_clips; i++) {
+            jstring text = (*env)->NewStringUTF(env, batch_text(b, i));
+            (*env)->SetObjectArrayElement(env, result, i, text);
+            (*env)->DeleteLocalRef(env, text);
+        }
+    } else {
+        LOGW("Batch decoding failed");
+    }
+
+    for (jsize i = 0; arrays != NULL && samples != NULL && i < n_clips; i++) {
+        if (samples[i] != NULL) {
+            (*env)->ReleaseFloatArrayElements(env, arrays[i], samples[i], JNI_ABORT);
+        }
+        if (arrays[i] != NULL) {
+            (*env)->DeleteLocalRef(env, arrays[i]);
+        }
+    }
+    free(samples);
+    free(arrays);
+    return result;
+}
+
+// Order must match WhisperBatchStats.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_batchDecoderStats(
+        JNIEnv *env, jobject thiz, jlong batch_ptr) {
+    UNUSED(thiz);
+    const struct batch_stats *stats = batch_get_stats((struct batch_decoder *) batch_ptr);
+    const jfloat values[] = {
+            (jfloat) stats->n_requests,
+            (jfloat) stats->n_windows,
+            (jfloat) stats->n_tokens,
+            (jfloat) stats->n_steps,
+            stats->mean_active,
+            stats->encode_ms,
+            stats->decode_ms,
+            stats->decode_cpu_ms,
+    };
+    const jsize n = (jsize) (sizeof(values)/sizeof(values[0]));
+    jfloatArray array = (*env)->NewFloatArray(env, n);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_initMelStream(
+        JNIEnv *env, jobject thiz, jlong context_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    struct whisper_context *context = transcriber_context((struct transcriber *) context_ptr);
+    const struct mel_frontend *mel_fe = mel_frontend_get(whisper_model_n_mels(context));
+    if (mel_fe == NULL) {
+        LOGW("Unsupported mel size %d\n", whisper_model_n_mels(context));
+        return 0;
+    }
+    // keep the last 30 s (one encoder window) of frames
+    return (jlong) mel_stream_init(mel_fe, WHISPER_CHUNK_SIZE * WHISPER_SAMPLE_RATE / WHISPER_HOP_LENGTH);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freeMelStream(
+        JNIEnv *env, jobject thiz, jlong stream_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    mel_stream_free((struct mel_stream *) stream_ptr);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_melStreamReset(
+        JNIEnv *env, jobject thiz, jlong stream_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    mel_stream_reset((struct mel_stream *) stream_ptr);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_melStreamAccept(
+        JNIEnv *env, jobject thiz, jlong stream_ptr, jfloatArray audio_data, jint offset, jint length) {
+    UNUSED(thiz);
+    struct mel_stream *stream = (struct mel_stream *) stream_ptr;
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+    if (offset < 0 || length < 0 || offset > audio_data_length - length) {
+        LOGW("melStreamAccept: range %d+%d outside of %d samples", offset, length, audio_data_length);
+        return -1;
+    }
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    const int n_new = mel_stream_push(stream, audio_data_arr + offset, length);
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, JNI_ABORT);
+    return n_new;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_melStreamWindow(
+        JNIEnv *env, jobject thiz, jlong stream_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    // only the ring buffer is linearized here, no frame is recomputed; the copy
+    // lets the recording thread push while whisper decodes it
+    struct mel_spectrogram *mel = calloc(1, sizeof(struct mel_spectrogram));
+    if (mel == NULL || mel_stream_window((struct mel_stream *) stream_ptr, mel) != 0) {
+        if (mel != NULL) {
+            mel_spectrogram_free(mel);
+            free(mel);
+        }
+        return 0;
+    }
+    return (jlong) mel;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freeMel(
+        JNIEnv *env, jobject thiz, jlong mel_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    struct mel_spectrogram *mel = (struct mel_spectrogram *) mel_ptr;
+    if (mel != NULL) {
+        mel_spectrogram_free(mel);
+        free(mel);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_fullTranscribeMel(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jlong mel_ptr, jint lang_id, jint num_threads, jboolean translate) {
+    UNUSED(env);
+    UNUSED(clazz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    struct mel_spectrogram *mel = (struct mel_spectrogram *) mel_ptr;
+    const char *lang = lang_from_id(lang_id);
+    if (lang == NULL) {
+        LOGW("Unknown language id %d", lang_id);
+        return;
+    }
+
+    struct whisper_full_params params = transcribe_params(lang, num_threads, translate);
+
+    whisper_reset_timings(transcriber_context(tr));
+
+    if (mel == NULL || transcriber_run_mel(tr, params, mel) != 0) {
+        LOGW("No mel frames to transcribe");
+    } else {
+        log_transcription(tr);
+    }
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_initPreprocessor(
+        JNIEnv *env, jobject thiz, jboolean high_pass, jboolean denoise, jboolean agc) {
+    UNUSED(env);
+    UNUSED(thiz);
+    struct preprocess_params params = preprocess_default_params();
+    params.high_pass = (high_pass == JNI_TRUE);
+    params.denoise = (denoise == JNI_TRUE);
+    params.agc = (agc == JNI_TRUE);
+    return (jlong) preprocess_init(params);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_freePreprocessor(
+        JNIEnv *env, jobject thiz, jlong preprocessor_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    preprocess_free((struct preprocessor *) preprocessor_ptr);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_preprocessorReset(
+        JNIEnv *env, jobject thiz, jlong preprocessor_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    preprocess_reset((struct preprocessor *) preprocessor_ptr);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_preprocessorLatency(
+        JNIEnv *env, jobject thiz, jlong preprocessor_ptr) {
+    UNUSED(env);
+    UNUSED(thiz);
+    return preprocess_latency((struct preprocessor *) preprocessor_ptr);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_preprocessorProcess(
+        JNIEnv *env, jobject thiz, jlong preprocessor_ptr, jfloatArray audio_data, jint offset, jint length) {
+    UNUSED(thiz);
+    struct preprocessor *pp = (struct preprocessor *) preprocessor_ptr;
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+    if (offset < 0 || length < 0 || offset > audio_data_length - length) {
+        LOGW("preprocessorProcess: range %d+%d outside of %d samples", offset, length, audio_data_length);
+        return;
+    }
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    preprocess_process(pp, audio_data_arr + offset, audio_data_arr + offset, length);
+    // mode 0 copies the processed samples back
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, 0);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_preprocessorClip(
+        JNIEnv *env, jobject thiz, jlong preprocessor_ptr, jfloatArray audio_data) {
+    UNUSED(thiz);
+    struct preprocessor *pp = (struct preprocessor *) preprocessor_ptr;
+    jfloat *audio_data_arr = (*env)->GetFloatArrayElements(env, audio_data, NULL);
+    const jsize audio_data_length = (*env)->GetArrayLength(env, audio_data);
+    const int64_t t_start_us = ggml_time_us();
+    preprocess_reset(pp);
+    preprocess_clip(pp, audio_data_arr, audio_data_length);
+    LOGI("Preprocessed %d samples in %.2f ms", audio_data_length, (ggml_time_us() - t_start_us) / 1000.0);
+    (*env)->ReleaseFloatArrayElements(env, audio_data, audio_data_arr, 0);
+}
+
 JNIEXPORT jint JNICALL
 Java_com_whispercpp_whisper_WhisperLib_getTextSegmentCount(
         JNIEnv *env, jobject thiz, jlong context_ptr) {
     UNUSED(env);
     UNUSED(thiz);
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
-    return whisper_full_n_segments(context);
+    return transcriber_n_segments((struct transcriber *) context_ptr);
 }
 
 JNIEXPORT jstring JNICALL
 Java_com_whispercpp_whisper_WhisperLib_getTextSegment(
         JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
     UNUSED(thiz);
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
-    const char *text = whisper_full_get_segment_text(context, index);
-    jstring string = (*env)->NewStringUTF(env, text);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    jstring string = (*env)->NewStringUTF(env, seg ? seg->text : "");
     return string;
 }
 
+// All segments in one string: one JNI call and one JVM string per transcription
+// instead of one per segment.
+JNIEXPORT jstring JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getText(
+        JNIEnv *env, jobject thiz, jlong context_ptr) {
+    UNUSED(thiz);
+    return (*env)->NewStringUTF(env, transcriber_text((struct transcriber *) context_ptr));
+}
+
 JNIEXPORT jlong JNICALL
 Java_com_whispercpp_whisper_WhisperLib_getTextSegmentT0(
         JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
     UNUSED(thiz);
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
-    return whisper_full_get_segment_t0(context, index);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->t0 : 0;
 }
 
 JNIEXPORT jlong JNICALL
 Java_com_whispercpp_whisper_WhisperLib_getTextSegmentT1(
         JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
     UNUSED(thiz);
-    struct whisper_context *context = (struct whisper_context *) context_ptr;
-    return whisper_full_get_segment_t1(context, index);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->t1 : 0;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getTextSegmentFallbacks(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
+    UNUSED(env);
+    UNUSED(thiz);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->n_fallbacks : 0;
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getTextSegmentFallbackMs(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
+    UNUSED(env);
+    UNUSED(thiz);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->fallback_ms : 0.0f;
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getTextSegmentNoSpeechProb(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
+    UNUSED(env);
+    UNUSED(thiz);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->no_speech_prob : 0.0f;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getTextSegmentSpeaker(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jint index) {
+    UNUSED(env);
+    UNUSED(thiz);
+    const struct transcribe_segment *seg = transcriber_segment((struct transcriber *) context_ptr, index);
+    return seg ? seg->speaker : -1;
+}
+
+// Order must match WhisperTranscriptionStats.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getTranscriptionStats(
+        JNIEnv *env, jobject thiz, jlong context_ptr) {
+    UNUSED(thiz);
+    const struct transcribe_stats *stats = transcriber_stats((struct transcriber *) context_ptr);
+    const jfloat values[] = {
+            (jfloat) stats->n_windows,
+            (jfloat) stats->n_windows_skipped,
+            (jfloat) stats->n_passes,
+            (jfloat) stats->n_fallbacks,
+            (jfloat) stats->fallback_budget,
+            (jfloat) stats->n_windows_capped,
+            stats->fallback_ms,
+            stats->skipped_s,
+            stats->mel_ms,
+            stats->total_ms,
+            (jfloat) stats->n_stopped,
+            (jfloat) stats->n_steps_saved,
+            (jfloat) stats->n_suppressed,
+            (jfloat) stats->n_speakers,
+            stats->diarize_ms,
+            stats->diarize_wait_ms,
+            (jfloat) stats->n_biased_steps,
+            (jfloat) stats->n_steps,
+            (jfloat) stats->n_allocs,
+            (jfloat) stats->n_allocs_whisper,
+            (jfloat) stats->arena_bytes,
+            (jfloat) stats->audio_ctx,
+            (jfloat) stats->n_shape_reuses,
+            stats->setup_ms,
+            stats->encode_ms,
+            (jfloat) stats->n_speculated,
+            (jfloat) stats->n_spec_hits,
+            stats->encode_hidden_ms,
+    };
+    const jsize n = (jsize) (sizeof(values)/sizeof(values[0]));
+    jfloatArray array = (*env)->NewFloatArray(env, n);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setFallbackPolicy(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jint max_per_window, jfloat budget_per_minute,
+        jfloat min_speech_ratio, jfloat fallback_speech_ratio, jboolean skip_silence, jboolean fit_short_clips,
+        jboolean pipelined_encode) {
+    UNUSED(env);
+    UNUSED(thiz);
+    struct transcribe_policy policy = {
+            .max_fallbacks_per_window = max_per_window,
+            .fallback_budget_per_minute = budget_per_minute,
+            .min_speech_ratio = min_speech_ratio,
+            .fallback_speech_ratio = fallback_speech_ratio,
+            .skip_silence = (skip_silence == JNI_TRUE),
+            .fit_short_clips = (fit_short_clips == JNI_TRUE),
+            .pipelined_encode = (pipelined_encode == JNI_TRUE),
+    };
+    transcriber_set_policy((struct transcriber *) context_ptr, policy);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setHallucinationFilter(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jboolean enabled) {
+    UNUSED(env);
+    UNUSED(thiz);
+    transcriber_set_hallucination_filter((struct transcriber *) context_ptr, enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setDiarization(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jboolean enabled) {
+    UNUSED(env);
+    UNUSED(thiz);
+    transcriber_set_diarization((struct transcriber *) context_ptr, enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setThermalGovernor(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jboolean enabled) {
+    UNUSED(env);
+    UNUSED(thiz);
+    transcriber_set_thermal_governor((struct transcriber *) context_ptr, enabled == JNI_TRUE);
+}
+
+// Throttled windows, hottest zone and the number of events, then 8 values per
+// kept event; NULL while the governor is off. Order must match
+// WhisperThermalReport.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getThermalReport(
+        JNIEnv *env, jclass clazz, jlong context_ptr) {
+    UNUSED(clazz);
+    const struct thermal_governor *g = transcriber_thermal((struct transcriber *) context_ptr);
+    if (g == NULL) {
+        return NULL;
+    }
+    const int n = thermal_n_kept_events(g);
+    jfloat values[3 + 8*32];
+    values[0] = (jfloat) thermal_n_throttled_windows(g);
+    values[1] = thermal_max_temp_c(g);
+    values[2] = (jfloat) n;
+    for (int i = 0; i < n && i < 32; i++) {
+        const struct thermal_event *ev = thermal_get_event(g, i);
+        jfloat *v = values + 3 + 8*i;
+        v[0] = (jfloat) ev->window;
+        v[1] = (jfloat) ev->reason;
+        v[2] = ev->temp_c;
+        v[3] = ev->encode_ms;
+        v[4] = (jfloat) ev->from.n_threads;
+        v[5] = (jfloat) ev->from.cpu_mask;
+        v[6] = (jfloat) ev->to.n_threads;
+        v[7] = (jfloat) ev->to.cpu_mask;
+    }
+    const jsize length = 3 + 8*(n < 32 ? n : 32);
+    jfloatArray array = (*env)->NewFloatArray(env, length);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, length, values);
+    }
+    return array;
+}
+
+// false when the kernel refuses perf_event_open (see perf_counters.h).
+JNIEXPORT jboolean JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setPerfCounters(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jboolean enabled) {
+    UNUSED(env);
+    UNUSED(clazz);
+    return transcriber_set_perf_counters((struct transcriber *) context_ptr, enabled == JNI_TRUE) == 0;
+}
+
+static void put_perf_sample(jfloat *values, const struct perf_sample *s) {
+    values[0] = (jfloat) s->cycles;
+    values[1] = (jfloat) s->instructions;
+    values[2] = (jfloat) s->cache_misses;
+    values[3] = (jfloat) s->branch_misses;
+    values[4] = (jfloat) s->llc_read_misses;
+    values[5] = (jfloat) s->context_switches;
+    values[6] = (jfloat) s->task_clock_ms;
+    values[7] = (jfloat) s->wall_ms;
+}
+
+// mel, encode, decode and total, 8 values each; NULL while disabled. Order
+// must match WhisperStageCounters.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getPerfCounters(
+        JNIEnv *env, jclass clazz, jlong context_ptr) {
+    UNUSED(clazz);
+    const struct transcribe_perf *perf = transcriber_perf((struct transcriber *) context_ptr);
+    if (perf == NULL) {
+        return NULL;
+    }
+    jfloat values[32];
+    put_perf_sample(values, &perf->mel);
+    put_perf_sample(values + 8, &perf->encode);
+    put_perf_sample(values + 16, &perf->decode);
+    put_perf_sample(values + 24, &perf->total);
+    jfloatArray array = (*env)->NewFloatArray(env, 32);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, 32, values);
+    }
+    return array;
+}
+
+// Energy source of the device, as an index of WhisperPowerSource on the
+// Kotlin side: 0 none, 1 RAPL, 2 power rails, 3 battery.
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getPowerSource(
+        JNIEnv *env, jclass clazz) {
+    UNUSED(env);
+    UNUSED(clazz);
+    struct power_meter *m = power_meter_open();
+    const enum power_source source = m != NULL ? power_meter_source(m) : POWER_SOURCE_NONE;
+    power_meter_close(m);
+    return (jint) source;
+}
+
+// CPU masks of the clusters, slowest first.
+JNIEXPORT jlongArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_getCpuClusters(
+        JNIEnv *env, jclass clazz) {
+    UNUSED(clazz);
+    uint64_t masks[16];
+    const int n = power_cpu_clusters(masks, 16);
+    jlong values[16];
+    for (int i = 0; i < n; i++) {
+        values[i] = (jlong) masks[i];
+    }
+    jlongArray array = (*env)->NewLongArray(env, n);
+    if (array != NULL) {
+        (*env)->SetLongArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+// Pins the calling thread, and the compute threads it starts from then on,
+// to the CPUs of mask (0 for all of them).
+JNIEXPORT jboolean JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setThreadAffinity(
+        JNIEnv *env, jclass clazz, jlong mask) {
+    UNUSED(env);
+    UNUSED(clazz);
+    return power_set_affinity((uint64_t) mask, NULL) == 0;
+}
+
+// Transcribes audio with num_threads threads on the CPUs of cpu_mask and
+// returns latency ms, audio s, joules (-1 without a source) and CPU s; NULL
+// on failure. Order must match WhisperEnergySample.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_measureEnergy(
+        JNIEnv *env, jclass clazz, jlong context_ptr, jint lang_id, jint num_threads, jlong cpu_mask,
+        jfloatArray audio_data, jint length) {
+    UNUSED(clazz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    const char *lang = lang_from_id(lang_id);
+    const float *samples = lang != NULL ? copy_audio(env, tr, audio_data, length) : NULL;
+    struct power_meter *m = samples != NULL ? power_meter_open() : NULL;
+    if (m == NULL) {
+        return NULL;
+    }
+
+    const struct power_config config = { num_threads, (uint64_t) cpu_mask };
+    struct power_measurement out;
+    const int rc = power_measure(tr, m, transcribe_params(lang, num_threads, JNI_FALSE), samples, length, config, &out);
+    if (rc == 0) {
+        LOGI("Energy: %d threads on %#llx, %.1f ms for %.1f s of audio, %.2f J (%s), %.2f CPU s",
+             num_threads, (unsigned long long) config.cpu_mask, out.latency_ms, out.audio_s, out.joules,
+             power_source_str(power_meter_source(m)), out.cpu_s);
+    }
+    power_meter_close(m);
+    if (rc != 0) {
+        return NULL;
+    }
+
+    const jfloat values[4] = { out.latency_ms, out.audio_s, (jfloat) out.joules, (jfloat) out.cpu_s };
+    jfloatArray array = (*env)->NewFloatArray(env, 4);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, 4, values);
+    }
+    return array;
+}
+
+// Replaces the bias phrases; returns how many could be tokenized.
+JNIEXPORT jint JNICALL
+Java_com_whispercpp_whisper_WhisperLib_setBiasPhrases(
+        JNIEnv *env, jobject thiz, jlong context_ptr, jobjectArray phrases, jfloat boost) {
+    UNUSED(thiz);
+    struct transcriber *tr = (struct transcriber *) context_ptr;
+    transcriber_clear_bias(tr);
+
+    int n_added = 0;
+    const jsize n = phrases != NULL ? (*env)->GetArrayLength(env, phrases) : 0;
+    for (jsize i = 0; i < n; i++) {
+        jstring phrase = (jstring) (*env)->GetObjectArrayElement(env, phrases, i);
+        if (phrase == NULL) {
+            continue;
+        }
+        const char *text = (*env)->GetStringUTFChars(env, phrase, NULL);
+        if (text != NULL) {
+            if (transcriber_add_bias_phrase(tr, text, boost) == 0) {
+                n_added++;
+            } else {
+                LOGW("Bias phrase ignored: '%s'", text);
+            }
+            (*env)->ReleaseStringUTFChars(env, phrase, text);
+        }
+        (*env)->DeleteLocalRef(env, phrase);
+    }
+    return n_added;
 }
 
 JNIEXPORT jstring JNICALL
@@ -244,20 +1391,206 @@ Java_com_whispercpp_whisper_WhisperLib_getSystemInfo(
     return string;
 }
 
+// Runs one of whisper's benchmarks and appends the hardware counters of the
+// run to its report when perf_event_open is allowed.
+static jstring bench_with_counters(JNIEnv *env, const char *(*bench)(int), jint n_threads) {
+    struct perf_counters *pc = perf_counters_open();
+    struct perf_sample start;
+    if (pc != NULL) {
+        perf_counters_read(pc, &start);
+    }
+    const char *report = bench(n_threads);
+    if (pc == NULL) {
+        return (*env)->NewStringUTF(env, report);
+    }
+    struct perf_sample end;
+    struct perf_sample run;
+    perf_counters_read(pc, &end);
+    perf_sample_clear(&run);
+    perf_sample_add_diff(&run, &start, &end);
+
+    const size_t len = strlen(report);
+    char *buf = malloc(len + 512);
+    if (buf == NULL) {
+        perf_counters_close(pc);
+        return (*env)->NewStringUTF(env, report);
+    }
+    memcpy(buf, report, len);
+    const int n = snprintf(buf + len, 512, "\nperf%s: ", perf_counters_user_only(pc) ? " (user space)" : "");
+    perf_sample_format(&run, buf + len + n, 512 - n);
+    perf_counters_close(pc);
+    jstring string = (*env)->NewStringUTF(env, buf);
+    free(buf);
+    return string;
+}
+
 JNIEXPORT jstring JNICALL
 Java_com_whispercpp_whisper_WhisperLib_benchMemcpy(JNIEnv *env, jobject thiz,
                                                                       jint n_threads) {
     UNUSED(thiz);
-    const char *bench_ggml_memcpy = whisper_bench_memcpy_str(n_threads);
-    jstring string = (*env)->NewStringUTF(env, bench_ggml_memcpy);
-    return string;
+    return bench_with_counters(env, whisper_bench_memcpy_str, n_threads);
 }
 
 JNIEXPORT jstring JNICALL
 Java_com_whispercpp_whisper_WhisperLib_benchGgmlMulMat(JNIEnv *env, jobject thiz,
                                                                           jint n_threads) {
     UNUSED(thiz);
-    const char *bench_ggml_mul_mat = whisper_bench_ggml_mul_mat_str(n_threads);
-    jstring string = (*env)->NewStringUTF(env, bench_ggml_mul_mat);
-    return string;
+    return bench_with_counters(env, whisper_bench_ggml_mul_mat_str, n_threads);
+}
+
+// Local transcription server with n_workers copies of the model, each decoding
+// one job at a time; see server.h for the protocol. socket_path may be NULL,
+// port 0 disables TCP. Returns 0 when a model cannot be loaded or nothing can
+// listen.
+JNIEXPORT jlong JNICALL
+Java_com_whispercpp_whisper_WhisperLib_startServer(
+        JNIEnv *env, jclass clazz, jstring model_path_str, jstring socket_path_str, jintArray allowed_uids,
+        jboolean any_uid, jint port, jint n_workers, jint num_threads) {
+    UNUSED(clazz);
+    if (n_workers < 1) {
+        return 0;
+    }
+    struct transcriber **workers = calloc(n_workers, sizeof(struct transcriber *));
+    if (workers == NULL) {
+        return 0;
+    }
+    const char *model_path = (*env)->GetStringUTFChars(env, model_path_str, NULL);
+    bool loaded = true;
+    for (jint i = 0; loaded && i < n_workers; i++) {
+        workers[i] = (struct transcriber *) wrap_context(
+                whisper_init_from_file_with_params(model_path, whisper_context_default_params()));
+        loaded = workers[i] != NULL;
+    }
+    (*env)->ReleaseStringUTFChars(env, model_path_str, model_path);
+    if (!loaded) {
+        LOGW("Couldn't load the server's models");
+        for (jint i = 0; i < n_workers; i++) {
+            transcriber_free(workers[i]);
+        }
+        free(workers);
+        return 0;
+    }
+
+    struct server_params params = server_default_params();
+    params.port = port;
+    params.n_threads = num_threads;
+    const char *socket_path = socket_path_str != NULL ? (*env)->GetStringUTFChars(env, socket_path_str, NULL) : NULL;
+    params.socket_path = socket_path;
+    params.any_uid = any_uid;
+    const jsize n_uids = allowed_uids != NULL ? (*env)->GetArrayLength(env, allowed_uids) : 0;
+    uid_t *uids = n_uids > 0 ? malloc(sizeof(uid_t) * n_uids) : NULL;
+    if (uids != NULL) {
+        for (jsize i = 0; i < n_uids; i++) {
+            jint uid = 0;
+            (*env)->GetIntArrayRegion(env, allowed_uids, i, 1, &uid);
+            uids[i] = (uid_t) uid;
+        }
+        params.allowed_uids = uids;
+        params.n_allowed_uids = n_uids;
+    }
+    struct server *s = server_start(workers, n_workers, params);
+    free(uids);
+    if (s == NULL) {
+        LOGW("Couldn't listen on %s, port %d", socket_path ? socket_path : "no socket", port);
+    } else {
+        LOGI("Serving %d workers on %s, port %d", n_workers, socket_path ? socket_path : "no socket", port);
+    }
+    if (socket_path != NULL) {
+        (*env)->ReleaseStringUTFChars(env, socket_path_str, socket_path);
+    }
+    free(workers);
+    return (jlong) s;
+}
+
+JNIEXPORT void JNICALL
+Java_com_whispercpp_whisper_WhisperLib_stopServer(
+        JNIEnv *env, jclass clazz, jlong server_ptr) {
+    UNUSED(env);
+    UNUSED(clazz);
+    server_stop((struct server *) server_ptr);
+}
+
+// Order must match WhisperServerStats.fromArray on the Kotlin side.
+JNIEXPORT jfloatArray JNICALL
+Java_com_whispercpp_whisper_WhisperLib_serverStats(
+        JNIEnv *env, jclass clazz, jlong server_ptr) {
+    UNUSED(clazz);
+    const struct server_stats stats = server_get_stats((struct server *) server_ptr);
+    const jfloat values[] = {
+            (jfloat) stats.n_jobs,
+            (jfloat) stats.n_failed,
+            (jfloat) stats.n_rejected,
+            (jfloat) stats.n_active,
+            (jfloat) stats.n_waiting,
+            (jfloat) stats.n_segments,
+            stats.audio_s,
+            stats.wait_ms,
+            stats.max_wait_ms,
+            stats.busy_ms,
+    };
+    const jsize n = (jsize) (sizeof(values)/sizeof(values[0]));
+    jfloatArray array = (*env)->NewFloatArray(env, n);
+    if (array != NULL) {
+        (*env)->SetFloatArrayRegion(env, array, 0, n, values);
+    }
+    return array;
+}
+
+// status field of this process in kB, -1 when it cannot be read
+static long proc_status_kb(const char *field) {
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[256];
+    long kb = -1;
+    const size_t n = strlen(field);
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, field, n) == 0) {
+            kb = atol(line + n);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+// Decodes a file through the streaming reader without transcribing it: decode
+// throughput and how far the process's peak RSS rose above its RSS before.
+JNIEXPORT jstring JNICALL
+Java_com_whispercpp_whisper_WhisperLib_benchDecodeFile(JNIEnv *env, jclass clazz, jstring path_str) {
+    UNUSED(clazz);
+    const char *path = (*env)->GetStringUTFChars(env, path_str, NULL);
+    struct audio_file *f = audio_file_open(path);
+    (*env)->ReleaseStringUTFChars(env, path_str, path);
+    if (f == NULL) {
+        return (*env)->NewStringUTF(env, "Unsupported audio file");
+    }
+
+    // writing 5 resets VmHWM to the current RSS
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp != NULL) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+    const long rss_kb = proc_status_kb("VmRSS:");
+
+    float buf[4096];
+    int64_t n_total = 0;
+    int n;
+    const int64_t t0 = ggml_time_us();
+    while ((n = audio_file_read(f, buf, 4096)) > 0) {
+        n_total += n;
+    }
+    const double ms = (ggml_time_us() - t0)/1000.0;
+    const long hwm_kb = proc_status_kb("VmHWM:");
+
+    const struct audio_file_info *info = audio_file_get_info(f);
+    const double seconds = (double) n_total/AUDIO_FILE_RATE;
+    char result[256];
+    snprintf(result, sizeof(result), "%s %d Hz %d ch, %.1f s: decoded in %.1f ms (%.0fx realtime)%s, peak RSS +%.1f MB",
+             info->codec, info->sample_rate, info->channels, seconds, ms, seconds*1000.0/ms,
+             n < 0 ? ", stopped by an error" : "", rss_kb >= 0 && hwm_kb >= 0 ? (hwm_kb - rss_kb)/1024.0 : -1.0);
+    audio_file_close(f);
+    return (*env)->NewStringUTF(env, result);
 }
@@ -0,0 +1,358 @@
+#include "kws.h"
+#include "vec.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KWS_SAMPLE_RATE 16000
+#define KWS_MAX_TOKENS  16
+
+struct kws_node {
+    whisper_token token;
+    int first_child;
+    int next_sibling;
+    int keyword;       // keyword ending here, -1 if none
+};
+
+struct kws {
+    struct whisper_context * ctx;
+    struct kws_params params;
+    char language[16];
+
+    struct kws_node * nodes;  // nodes[0] is the root
+    int n_nodes;
+    int cap_nodes;
+    int n_keywords;
+    int max_depth;
+    int64_t * last_hit_ms;    // [n_keywords] end of the last detection
+
+    // the last window_n samples
+    float * ring;
+    float * window;
+    int window_n;
+    int ring_pos;
+    int stride_n;
+    int64_t n_pushed;
+    int64_t next_eval;
+
+    // forced decoding of the current window
+    whisper_token eot;
+    float sum;
+    int n_forced;
+    int best_keyword;
+    float best_score;
+
+    struct kws_stats stats;
+};
+
+struct kws_params kws_default_params(void) {
+    struct kws_params params = {
+            .language   = "en",
+            .n_threads  = 4,
+            .window_ms  = 2000,
+            .hop_ms     = 500,
+            .duty_cycle = 1.0f,
+            .audio_ctx  = 0,
+            .threshold  = -1.0f,
+            .min_rms    = 0.003f,
+    };
+    return params;
+}
+
+static int kws_new_node(struct kws * k, whisper_token token) {
+    if (k->n_nodes == k->cap_nodes) {
+        const int cap = k->cap_nodes > 0 ? 2*k->cap_nodes : 32;
+        struct kws_node * nodes = realloc(k->nodes, sizeof(struct kws_node) * cap);
+        if (!nodes) {
+            return -1;
+        }
+        k->nodes = nodes;
+        k->cap_nodes = cap;
+    }
+    struct kws_node * node = &k->nodes[k->n_nodes];
+    node->token = token;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->keyword = -1;
+    return k->n_nodes++;
+}
+
+static int kws_child(const struct kws * k, int node, whisper_token token) {
+    int c = k->nodes[node].first_child;
+    while (c >= 0 && k->nodes[c].token != token) {
+        c = k->nodes[c].next_sibling;
+    }
+    return c;
+}
+
+struct kws * kws_init(struct whisper_context * ctx, struct kws_params params) {
+    if (!ctx || params.window_ms < 200 || params.hop_ms <= 0) {
+        return NULL;
+    }
+    struct kws * k = calloc(1, sizeof(struct kws));
+    if (!k) {
+        return NULL;
+    }
+    params.duty_cycle = params.duty_cycle > 1.0f ? 1.0f : params.duty_cycle;
+    params.duty_cycle = params.duty_cycle < 0.01f ? 0.01f : params.duty_cycle;
+    k->ctx = ctx;
+    k->params = params;
+    snprintf(k->language, sizeof(k->language), "%s", params.language ? params.language : "en");
+    k->params.language = k->language;
+    k->eot = whisper_token_eot(ctx);
+
+    k->window_n = params.window_ms*(KWS_SAMPLE_RATE/1000);
+    k->stride_n = (int) (params.hop_ms*(KWS_SAMPLE_RATE/1000)/params.duty_cycle);
+    k->stride_n = k->stride_n > k->window_n ? k->window_n : k->stride_n;
+    k->ring = calloc(k->window_n, sizeof(float));
+    k->window = malloc(sizeof(float) * k->window_n);
+    if (!k->ring || !k->window || kws_new_node(k, -1) != 0) {
+        kws_free(k);
+        return NULL;
+    }
+    kws_reset(k);
+    return k;
+}
+
+void kws_free(struct kws * k) {
+    if (!k) {
+        return;
+    }
+    free(k->nodes);
+    free(k->last_hit_ms);
+    free(k->ring);
+    free(k->window);
+    free(k);
+}
+
+void kws_reset(struct kws * k) {
+    memset(k->ring, 0, sizeof(float) * k->window_n);
+    k->ring_pos = 0;
+    k->n_pushed = 0;
+    k->next_eval = k->window_n;
+    for (int i = 0; i < k->n_keywords; i++) {
+        k->last_hit_ms[i] = INT64_MIN;
+    }
+    memset(&k->stats, 0, sizeof(k->stats));
+}
+
+static int kws_insert(struct kws * k, const whisper_token * tokens, int n, int keyword) {
+    int cur = 0;
+    for (int i = 0; i < n; i++) {
+        int c = kws_child(k, cur, tokens[i]);
+        if (c < 0) {
+            if ((c = kws_new_node(k, tokens[i])) < 0) {
+                return -1;
+            }
+            k->nodes[c].next_sibling = k->nodes[cur].first_child;
+            k->nodes[cur].first_child = c;
+        }
+        cur = c;
+    }
+    k->nodes[cur].keyword = keyword;
+    k->max_depth = n > k->max_depth ? n : k->max_depth;
+    return 0;
+}
+
+int kws_add_keyword(struct kws * k, const char * text) {
+    while (*text == ' ') {
+        text++;
+    }
+    char spaced[256];
+    const size_t len = strlen(text);
+    if (len == 0 || len + 2 > sizeof(spaced)) {
+        return -1;
+    }
+    spaced[0] = ' ';
+    memcpy(spaced + 1, text, len + 1);
+
+    int64_t * last_hit_ms = realloc(k->last_hit_ms, sizeof(int64_t) * (k->n_keywords + 1));
+    if (!last_hit_ms) {
+        return -1;
+    }
+    k->last_hit_ms = last_hit_ms;
+
+    // whisper starts a segment with or without the space
+    const int id = k->n_keywords;
+    whisper_token tokens[KWS_MAX_TOKENS];
+    int n_added = 0;
+    for (int v = 0; v < 2; v++) {
+        const int n = whisper_tokenize(k->ctx, v == 0 ? spaced : text, tokens, KWS_MAX_TOKENS);
+        if (n > 0 && kws_insert(k, tokens, n, id) == 0) {
+            n_added++;
+        }
+    }
+    if (n_added == 0) {
+        return -1;
+    }
+    k->last_hit_ms[id] = INT64_MIN;
+    return k->n_keywords++;
+}
+
+int kws_n_keywords(const struct kws * k) {
+    return k->n_keywords;
+}
+
+const struct kws_stats * kws_get_stats(const struct kws * k) {
+    return &k->stats;
+}
+
+// Forces the decoder along the trie: the keyword token with the highest logit
+// is taken, until a keyword ends where EOT ranks above every continuation.
+static void kws_logits_filter(struct whisper_context * ctx, struct whisper_state * state, const whisper_token_data * tokens, int n_tokens, float * logits, void * user_data) {
+    (void) state;
+    struct kws * k = user_data;
+    const int n_vocab = whisper_n_vocab(ctx);
+    k->stats.n_steps++;
+
+    // the path so far; timestamps are disabled, so every token is on it
+    int node = 0;
+    for (int i = 0; i < n_tokens && node >= 0; i++) {
+        node = tokens[i].id < k->eot ? kws_child(k, node, tokens[i].id) : node;
+    }
+    if (n_tokens == 0) {
+        k->sum = 0.0f;
+        k->n_forced = 0;
+    }
+
+    whisper_token forced = k->eot;
+    if (node >= 0) {
+        int best = -1;
+        for (int c = k->nodes[node].first_child; c >= 0; c = k->nodes[c].next_sibling) {
+            if (best < 0 || logits[k->nodes[c].token] > logits[k->nodes[best].token]) {
+                best = c;
+            }
+        }
+        const bool ends = k->nodes[node].keyword >= 0 && (best < 0 || logits[k->eot] >= logits[k->nodes[best].token]);
+        if (ends && k->n_forced > 0) {
+            const float score = k->sum/k->n_forced;
+            if (score > k->best_score) {
+                k->best_score = score;
+                k->best_keyword = k->nodes[node].keyword;
+            }
+        } else if (best >= 0) {
+            // log-probability over the whole vocabulary, as free decoding would see it
+            const float max = vec_max_f32(n_vocab, logits);
+            double sum = 0.0;
+            for (int i = 0; i < n_vocab; i++) {
+                sum += expf(logits[i] - max);
+            }
+            k->sum += logits[k->nodes[best].token] - max - (float) log(sum);
+            k->n_forced++;
+            forced = k->nodes[best].token;
+        }
+    }
+
+    for (int i = 0; i < n_vocab; i++) {
+        logits[i] = -INFINITY;
+    }
+    logits[forced] = 0.0f;
+}
+
+static double kws_cpu_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+static double kws_wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+// scores the window ending at n_pushed, returns 1 on a detection
+static int kws_evaluate(struct kws * k, struct kws_detection * out) {
+    const int tail = k->window_n - k->ring_pos;
+    memcpy(k->window, k->ring + k->ring_pos, sizeof(float) * tail);
+    memcpy(k->window + tail, k->ring, sizeof(float) * k->ring_pos);
+
+    const float rms = sqrtf(vec_dot_f32(k->window_n, k->window, k->window)/k->window_n);
+    if (rms < k->params.min_rms || k->n_keywords == 0) {
+        k->stats.n_skipped++;
+        return 0;
+    }
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = k->params.language;
+    params.n_threads = k->params.n_threads;
+    params.no_context = true;
+    params.no_timestamps = true;
+    params.single_segment = true;
+    params.max_tokens = k->max_depth + 1;
+    params.temperature_inc = 0.0f;
+    params.greedy.best_of = 1;
+    // the encoder produces 50 positions per second, with some slack
+    params.audio_ctx = k->params.audio_ctx > 0 ? k->params.audio_ctx : (int) ceilf(k->params.window_ms/20.0f*1.1f);
+    params.logits_filter_callback = kws_logits_filter;
+    params.logits_filter_callback_user_data = k;
+
+    k->best_keyword = -1;
+    k->best_score = -INFINITY;
+
+    const double cpu0 = kws_cpu_ms();
+    const double wall0 = kws_wall_ms();
+    const int rc = whisper_full(k->ctx, params, k->window, k->window_n);
+    k->stats.cpu_ms += (float) (kws_cpu_ms() - cpu0);
+    k->stats.wall_ms += (float) (kws_wall_ms() - wall0);
+    k->stats.n_windows++;
+
+    if (rc != 0 || k->best_keyword < 0 || k->best_score < k->params.threshold) {
+        return 0;
+    }
+
+    // overlapping windows hear the same utterance
+    const int64_t t1_ms = k->n_pushed*1000/KWS_SAMPLE_RATE;
+    const int64_t t0_ms = t1_ms - k->params.window_ms;
+    if (t0_ms < k->last_hit_ms[k->best_keyword]) {
+        return 0;
+    }
+    k->last_hit_ms[k->best_keyword] = t1_ms;
+    k->stats.n_detections++;
+
+    out->keyword = k->best_keyword;
+    out->score = k->best_score;
+    out->t0_ms = t0_ms;
+    out->t1_ms = t1_ms;
+    return 1;
+}
+
+int kws_push(struct kws * k, const float * samples, int n_samples, struct kws_detection * out, int max_out) {
+    if (n_samples < 0) {
+        return -1;
+    }
+    const int hop_n = k->params.hop_ms*(KWS_SAMPLE_RATE/1000);
+    int n_out = 0;
+    k->stats.audio_s += (float) n_samples/KWS_SAMPLE_RATE;
+    while (n_samples > 0) {
+        int m = (int) (k->next_eval - k->n_pushed);
+        m = m < n_samples ? m : n_samples;
+        for (int done = 0; done < m; ) {
+            const int run = k->window_n - k->ring_pos < m - done ? k->window_n - k->ring_pos : m - done;
+            memcpy(k->ring + k->ring_pos, samples + done, sizeof(float) * run);
+            k->ring_pos = (k->ring_pos + run) % k->window_n;
+            done += run;
+        }
+        k->n_pushed += m;
+        samples += m;
+        n_samples -= m;
+
+        if (k->n_pushed == k->next_eval) {
+            struct kws_detection det;
+            if (kws_evaluate(k, &det) && n_out < max_out) {
+                out[n_out++] = det;
+            }
+            // hops the duty cycle passes over
+            k->stats.n_skipped += (k->stride_n + hop_n/2)/hop_n - 1;
+            k->next_eval += k->stride_n;
+        }
+    }
+    return n_out;
+}
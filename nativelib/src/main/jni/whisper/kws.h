@@ -0,0 +1,72 @@
+#ifndef WHISPER_JNI_KWS_H
+#define WHISPER_JNI_KWS_H
+
+#include <stdint.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Keyword spotting on a live stream. Short sliding windows are encoded with a
+// reduced audio_ctx, and instead of decoding free text the decoder is forced
+// along the keywords' token trie: each step takes the keyword token whisper
+// ranks highest, and the window scores the mean log-probability of the forced
+// tokens. A window costs one small encode plus as many decoder steps as the
+// longest keyword has tokens.
+struct kws_params {
+    const char * language;  // keywords' language, never detected; copied
+    int   n_threads;
+    int   window_ms;        // audio scored per evaluation
+    int   hop_ms;           // stride between evaluations at full duty cycle
+    float duty_cycle;       // (0, 1]: lower values stretch the stride to hop_ms/duty_cycle
+    int   audio_ctx;        // encoder positions, 0 = just enough for window_ms
+    float threshold;        // mean token log-probability that counts as a hit
+    float min_rms;          // quieter windows are skipped without encoding
+};
+
+struct kws_params kws_default_params(void);
+
+struct kws_detection {
+    int     keyword;   // id returned by kws_add_keyword
+    float   score;     // mean log-probability of its tokens
+    int64_t t0_ms;     // window in stream time
+    int64_t t1_ms;
+};
+
+struct kws_stats {
+    float audio_s;         // audio pushed
+    int   n_windows;       // windows scored
+    int   n_skipped;       // windows skipped by the duty cycle or the level gate
+    int   n_steps;         // decoder steps
+    int   n_detections;
+    float cpu_ms;          // process CPU time of the evaluations, all threads
+    float wall_ms;
+};
+
+struct kws;
+
+// ctx is borrowed and must outlive the spotter; nothing else may use it
+// while kws_push runs.
+struct kws * kws_init(struct whisper_context * ctx, struct kws_params params);
+void kws_free(struct kws * k);
+
+// Returns the keyword id, -1 when text cannot be tokenized.
+int kws_add_keyword(struct kws * k, const char * text);
+int kws_n_keywords(const struct kws * k);
+
+// Feeds 16 kHz mono samples and scores every window that became due. Up to
+// max_out detections are written to out; returns their number or -1.
+int kws_push(struct kws * k, const float * samples, int n_samples, struct kws_detection * out, int max_out);
+
+// drops buffered audio and statistics, keeps the keywords
+void kws_reset(struct kws * k);
+
+const struct kws_stats * kws_get_stats(const struct kws * k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_KWS_H
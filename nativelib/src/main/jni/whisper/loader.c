@@ -0,0 +1,53 @@
+#include "loader.h"
+
+#include <string.h>
+
+// largest request handed to a read callback; AAsset_read and InputStream.read
+// count in int
+#define LOADER_MAX_READ (1 << 30)
+
+size_t loader_read_full(loader_read_fn read, void * src, void * dst, size_t n) {
+    uint8_t * out = (uint8_t *) dst;
+    size_t done = 0;
+    while (done < n) {
+        const size_t want = n - done < LOADER_MAX_READ ? n - done : LOADER_MAX_READ;
+        const long got = read(src, out + done, want);
+        if (got <= 0 || (size_t) got > want) {
+            break;
+        }
+        done += (size_t) got;
+    }
+    memset(out + done, 0, n - done);
+    return done;
+}
+
+static size_t loader_memory_read(void * ctx, void * output, size_t read_size) {
+    struct loader_memory * m = (struct loader_memory *) ctx;
+    const size_t n = read_size < m->size - m->offset ? read_size : m->size - m->offset;
+    memcpy(output, m->data + m->offset, n);
+    memset((uint8_t *) output + n, 0, read_size - n);
+    m->offset += n;
+    return n;
+}
+
+static bool loader_memory_eof(void * ctx) {
+    const struct loader_memory * m = (const struct loader_memory *) ctx;
+    return m->offset >= m->size;
+}
+
+static void loader_memory_close(void * ctx) {
+    (void) ctx;
+}
+
+struct whisper_model_loader loader_from_memory(struct loader_memory * m, const void * data, size_t size) {
+    m->data = (const uint8_t *) data;
+    m->size = size;
+    m->offset = 0;
+    struct whisper_model_loader loader = {
+        .context = m,
+        .read = loader_memory_read,
+        .eof = loader_memory_eof,
+        .close = loader_memory_close,
+    };
+    return loader;
+}
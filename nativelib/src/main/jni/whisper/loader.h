@@ -0,0 +1,38 @@
+#ifndef WHISPER_JNI_LOADER_H
+#define WHISPER_JNI_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Helpers for whisper_model_loader callbacks. whisper.cpp ignores the count a
+// read returns and uses the whole buffer, so a source that can return short
+// reads (a Java InputStream, a streaming asset, a pipe) must go through
+// loader_read_full, and one that fails must not leave stale bytes behind.
+
+// Reads at most n bytes; returns the number read, 0 at the end, < 0 on error.
+typedef long (*loader_read_fn)(void * src, void * dst, size_t n);
+
+// Calls read until n bytes arrived, the source ended or it failed, and
+// zero-fills whatever is left of dst. Returns the number of bytes read.
+size_t loader_read_full(loader_read_fn read, void * src, void * dst, size_t n);
+
+// Loader over a buffer in memory; the buffer must outlive the loader.
+struct loader_memory {
+    const uint8_t * data;
+    size_t size;
+    size_t offset;
+};
+
+struct whisper_model_loader loader_from_memory(struct loader_memory * m, const void * data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_LOADER_H
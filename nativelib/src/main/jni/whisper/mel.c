@@ -0,0 +1,329 @@
+#include "mel.h"
+#include "fft.h"
+#include "vec.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEL_PAD_START   (MEL_N_FFT/2)
+#define MEL_PAD_END     (MEL_SAMPLE_RATE*30)
+#define MEL_MAX_THREADS 16
+
+struct mel_frontend {
+    int n_mel;
+
+    float hann[MEL_N_FFT];
+    struct fft_plan * fft;
+
+    // sparse filterbank: bin j covers power[start[j] .. start[j] + len[j])
+    int * start;
+    int * len;
+    int * offset;     // into weights
+    float * weights;
+};
+
+static inline int min_int(int a, int b) {
+    return (a < b) ? a : b;
+}
+
+static pthread_mutex_t g_mel_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mel_frontend * g_mel_cache[2];
+
+// librosa.filters.mel(sr=16000, n_fft=400, n_mels=n_mel) with the slaney
+// mel scale and slaney area normalization, exactly what whisper ships in
+// mel_filters.npz, kept sparse since every triangle spans only a few bins.
+static double mel_hz_to_mel(double f) {
+    const double f_sp = 200.0/3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz/f_sp;
+    const double logstep = log(6.4)/27.0;
+    return f >= min_log_hz ? min_log_mel + log(f/min_log_hz)/logstep : f/f_sp;
+}
+
+static double mel_mel_to_hz(double m) {
+    const double f_sp = 200.0/3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz/f_sp;
+    const double logstep = log(6.4)/27.0;
+    return m >= min_log_mel ? min_log_hz*exp(logstep*(m - min_log_mel)) : f_sp*m;
+}
+
+static int mel_build_filters(struct mel_frontend * fe) {
+    const int n_mel = fe->n_mel;
+
+    double * mel_f = malloc(sizeof(double) * (n_mel + 2));
+    float * dense = calloc((size_t) n_mel * MEL_N_BINS, sizeof(float));
+    fe->start  = malloc(sizeof(int) * n_mel);
+    fe->len    = malloc(sizeof(int) * n_mel);
+    fe->offset = malloc(sizeof(int) * n_mel);
+    if (!mel_f || !dense || !fe->start || !fe->len || !fe->offset) {
+        free(mel_f);
+        free(dense);
+        return -1;
+    }
+
+    const double mel_min = mel_hz_to_mel(0.0);
+    const double mel_max = mel_hz_to_mel(MEL_SAMPLE_RATE/2.0);
+    for (int i = 0; i < n_mel + 2; i++) {
+        mel_f[i] = mel_mel_to_hz(mel_min + (mel_max - mel_min)*i/(n_mel + 1));
+    }
+
+    int total = 0;
+    for (int j = 0; j < n_mel; j++) {
+        const double enorm = 2.0/(mel_f[j + 2] - mel_f[j]);
+        int first = -1;
+        int last = -1;
+        for (int k = 0; k < MEL_N_BINS; k++) {
+            const double f = (double) k*MEL_SAMPLE_RATE/MEL_N_FFT;
+            const double lower = (f - mel_f[j])/(mel_f[j + 1] - mel_f[j]);
+            const double upper = (mel_f[j + 2] - f)/(mel_f[j + 2] - mel_f[j + 1]);
+            const double w = fmax(0.0, fmin(lower, upper))*enorm;
+            dense[j*MEL_N_BINS + k] = (float) w;
+            if (w > 0.0) {
+                if (first < 0) {
+                    first = k;
+                }
+                last = k;
+            }
+        }
+        fe->start[j]  = first < 0 ? 0 : first;
+        fe->len[j]    = first < 0 ? 0 : last - first + 1;
+        fe->offset[j] = total;
+        total += fe->len[j];
+    }
+
+    fe->weights = malloc(sizeof(float) * (total > 0 ? total : 1));
+    if (!fe->weights) {
+        free(mel_f);
+        free(dense);
+        return -1;
+    }
+    for (int j = 0; j < n_mel; j++) {
+        memcpy(fe->weights + fe->offset[j], dense + j*MEL_N_BINS + fe->start[j], sizeof(float) * fe->len[j]);
+    }
+
+    free(mel_f);
+    free(dense);
+    return 0;
+}
+
+static void mel_frontend_free(struct mel_frontend * fe) {
+    if (!fe) {
+        return;
+    }
+    fft_plan_free(fe->fft);
+    free(fe->start);
+    free(fe->len);
+    free(fe->offset);
+    free(fe->weights);
+    free(fe);
+}
+
+static struct mel_frontend * mel_frontend_init(int n_mel) {
+    struct mel_frontend * fe = calloc(1, sizeof(struct mel_frontend));
+    if (!fe) {
+        return NULL;
+    }
+    fe->n_mel = n_mel;
+
+    // periodic Hann window, same as whisper's global cache
+    for (int i = 0; i < MEL_N_FFT; i++) {
+        fe->hann[i] = (float) (0.5*(1.0 - cos((2.0*M_PI*i)/MEL_N_FFT)));
+    }
+
+    fe->fft = fft_plan_init(MEL_N_FFT);
+    if (!fe->fft || fft_plan_scratch_size(fe->fft) > MEL_N_FFT || mel_build_filters(fe) != 0) {
+        mel_frontend_free(fe);
+        return NULL;
+    }
+    return fe;
+}
+
+const struct mel_frontend * mel_frontend_get(int n_mel) {
+    const int slot = n_mel == 80 ? 0 : n_mel == 128 ? 1 : -1;
+    if (slot < 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_mel_lock);
+    if (!g_mel_cache[slot]) {
+        g_mel_cache[slot] = mel_frontend_init(n_mel);
+    }
+    struct mel_frontend * fe = g_mel_cache[slot];
+    pthread_mutex_unlock(&g_mel_lock);
+
+    return fe;
+}
+
+int mel_frontend_n_mel(const struct mel_frontend * fe) {
+    return fe->n_mel;
+}
+
+float mel_frontend_frame(const struct mel_frontend * fe, const float * frame, float * out, int out_stride) {
+    float windowed[MEL_N_FFT];
+    float spectrum[2*MEL_N_FFT];
+    float power[MEL_N_BINS];
+    float scratch[MEL_N_FFT];
+
+    vec_mul_f32(MEL_N_FFT, windowed, frame, fe->hann);
+    fft_forward_real(fe->fft, windowed, spectrum, scratch);
+    vec_cplx_norm2_f32(MEL_N_BINS, power, spectrum);
+
+    float mmax = -INFINITY;
+    for (int j = 0; j < fe->n_mel; j++) {
+        const float sum = vec_dot_f32(fe->len[j], fe->weights + fe->offset[j], power + fe->start[j]);
+        const float v = log10f(fmaxf(sum, 1e-10f));
+        out[(size_t) j*out_stride] = v;
+        mmax = fmaxf(mmax, v);
+    }
+    return mmax;
+}
+
+void mel_normalize(float * data, size_t n, float mmax) {
+    const size_t chunk = 1 << 20;
+    for (size_t i = 0; i < n; i += chunk) {
+        const int m = (int) (n - i < chunk ? n - i : chunk);
+        vec_clamp_affine_f32(m, data + i, mmax - 8.0f, 4.0f, 0.25f);
+    }
+}
+
+struct mel_worker {
+    const struct mel_frontend * fe;
+    const float * samples;
+    int n_samples;
+
+    struct mel_spectrogram * mel;
+    int i0;
+    int i1;
+
+    float mmax;
+};
+
+static void * mel_worker_run(void * arg) {
+    struct mel_worker * w = (struct mel_worker *) arg;
+
+    const float * samples = w->samples;
+    const int n_samples = w->n_samples;
+    const int n_len = w->mel->n_len;
+
+    float frame[MEL_N_FFT];
+    float mmax = -INFINITY;
+
+    for (int i = w->i0; i < w->i1; i++) {
+        // offset in the virtually padded signal: [reflect pad | samples | zeros]
+        const int offset = i*MEL_HOP_LENGTH;
+        const float * src = NULL;
+
+        if (offset >= MEL_PAD_START && offset - MEL_PAD_START + MEL_N_FFT <= n_samples) {
+            src = samples + offset - MEL_PAD_START;
+        } else {
+            for (int j = 0; j < MEL_N_FFT; j++) {
+                const int p = offset + j;
+                const int idx = p < MEL_PAD_START ? MEL_PAD_START - p : p - MEL_PAD_START;
+                frame[j] = idx < n_samples ? samples[idx] : 0.0f;
+            }
+            src = frame;
+        }
+
+        mmax = fmaxf(mmax, mel_frontend_frame(w->fe, src, w->mel->data + i, n_len));
+    }
+
+    w->mmax = mmax;
+    return NULL;
+}
+
+int mel_frontend_compute(const struct mel_frontend * fe, const float * samples, int n_samples, int n_threads, struct mel_spectrogram * mel) {
+    if (!fe || !mel || n_samples < 0) {
+        return -1;
+    }
+
+    const int n_mel = fe->n_mel;
+    const int n_len = (n_samples + MEL_PAD_END)/MEL_HOP_LENGTH;
+
+    const size_t need = (size_t) n_mel*n_len;
+    if (mel->capacity < need) {
+        float * data = realloc(mel->data, sizeof(float) * need);
+        if (!data) {
+            return -1;
+        }
+        mel->data = data;
+        mel->capacity = need;
+    }
+
+    mel->n_mel = n_mel;
+    mel->n_len = n_len;
+    mel->n_len_org = 1 + (n_samples + MEL_PAD_START - MEL_N_FFT)/MEL_HOP_LENGTH;
+
+    // frames past this index only see the trailing zeros
+    int n_active = (n_samples + MEL_PAD_START + MEL_HOP_LENGTH - 1)/MEL_HOP_LENGTH;
+    if (n_active > n_len) {
+        n_active = n_len;
+    }
+
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+    if (n_threads > MEL_MAX_THREADS) {
+        n_threads = MEL_MAX_THREADS;
+    }
+    if (n_threads > n_active) {
+        n_threads = n_active > 0 ? n_active : 1;
+    }
+
+    struct mel_worker workers[MEL_MAX_THREADS];
+    pthread_t threads[MEL_MAX_THREADS];
+    int started[MEL_MAX_THREADS] = {0};
+
+    const int per_thread = (n_active + n_threads - 1)/n_threads;
+    for (int t = 0; t < n_threads; t++) {
+        workers[t] = (struct mel_worker) {
+                .fe        = fe,
+                .samples   = samples,
+                .n_samples = n_samples,
+                .mel       = mel,
+                .i0        = min_int(t*per_thread, n_active),
+                .i1        = min_int((t + 1)*per_thread, n_active),
+                .mmax      = -INFINITY,
+        };
+    }
+    for (int t = 1; t < n_threads; t++) {
+        started[t] = pthread_create(&threads[t], NULL, mel_worker_run, &workers[t]) == 0;
+        if (!started[t]) {
+            mel_worker_run(&workers[t]);
+        }
+    }
+    mel_worker_run(&workers[0]);
+
+    float mmax = workers[0].mmax;
+    for (int t = 1; t < n_threads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+        mmax = fmaxf(mmax, workers[t].mmax);
+    }
+
+    if (n_active < n_len) {
+        for (int j = 0; j < n_mel; j++) {
+            float * row = mel->data + (size_t) j*n_len;
+            for (int i = n_active; i < n_len; i++) {
+                row[i] = MEL_LOG10_FLOOR;
+            }
+        }
+        mmax = fmaxf(mmax, MEL_LOG10_FLOOR);
+    }
+
+    mel_normalize(mel->data, need, mmax);
+
+    return 0;
+}
+
+void mel_spectrogram_free(struct mel_spectrogram * mel) {
+    if (!mel) {
+        return;
+    }
+    free(mel->data);
+    mel->data = NULL;
+    mel->capacity = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef WHISPER_JNI_MEL_H
+#define WHISPER_JNI_MEL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEL_SAMPLE_RATE 16000
+#define MEL_N_FFT       400
+#define MEL_HOP_LENGTH  160
+#define MEL_N_BINS      (MEL_N_FFT/2 + 1)
+
+// log10 of the power floor used by whisper (log10(1e-10))
+#define MEL_LOG10_FLOOR (-10.0f)
+
+// Log-mel front-end with the Hann window, FFT plan and sparse slaney
+// filterbank precomputed once per mel size (80 or 128 bins).
+struct mel_frontend;
+
+// Returns the process-wide front-end for n_mel, building it on first use.
+// The front-end is immutable and safe to share between threads.
+const struct mel_frontend * mel_frontend_get(int n_mel);
+
+int mel_frontend_n_mel(const struct mel_frontend * fe);
+
+struct mel_spectrogram {
+    int n_mel;
+    int n_len;       // frames including the 30 s of trailing padding
+    int n_len_org;   // frames covering the input audio
+    float * data;    // [n_mel][n_len], ready for whisper_set_mel
+    size_t capacity; // allocated floats, reused across calls
+};
+
+// Computes the same normalized log-mel spectrogram as whisper_pcm_to_mel:
+// reflect padding at the start, 30 s of zeros at the end, global max - 8 clamp.
+// Frames that only see the zero padding are not transformed.
+// Returns 0 on success.
+int mel_frontend_compute(const struct mel_frontend * fe, const float * samples, int n_samples, int n_threads, struct mel_spectrogram * mel);
+
+void mel_spectrogram_free(struct mel_spectrogram * mel);
+
+// Single frame building block for incremental extraction.
+// frame: MEL_N_FFT raw samples, out: n_mel un-normalized log10 energies written
+// with the given stride. Returns the largest value written.
+float mel_frontend_frame(const struct mel_frontend * fe, const float * frame, float * out, int out_stride);
+
+// whisper's normalization: clamp to mmax - 8, then (x + 4)/4
+void mel_normalize(float * data, size_t n, float mmax);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_MEL_H
@@ -0,0 +1,235 @@
+#include "mel_stream.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEL_STREAM_PAD_START (MEL_N_FFT/2)
+#define MEL_STREAM_PAD_END   (MEL_SAMPLE_RATE*30/MEL_HOP_LENGTH)
+
+struct mel_stream {
+    const struct mel_frontend * fe;
+    int n_mel;
+    int n_window;
+
+    pthread_mutex_t lock;
+
+    // pending samples of the padded signal [reflect pad | samples], starting at buf_base
+    float * buf;
+    int buf_len;
+    int buf_cap;
+    int64_t buf_base;
+    int started;         // reflect pad emitted (needs MEL_STREAM_PAD_START + 1 samples)
+
+    int64_t next_frame;  // frame i starts at i*MEL_HOP_LENGTH in the padded signal
+
+    float * ring;        // [n_mel][n_window], column = frame % n_window
+    float * frame_max;   // [n_window]
+
+    // monotonic deque of frame indices for the sliding window maximum
+    int64_t * dq;
+    int dq_head;
+    int dq_len;
+};
+
+struct mel_stream * mel_stream_init(const struct mel_frontend * fe, int n_window) {
+    if (!fe || n_window <= 0) {
+        return NULL;
+    }
+
+    struct mel_stream * stream = calloc(1, sizeof(struct mel_stream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->fe = fe;
+    stream->n_mel = mel_frontend_n_mel(fe);
+    stream->n_window = n_window;
+    stream->ring = malloc(sizeof(float) * (size_t) stream->n_mel*n_window);
+    stream->frame_max = malloc(sizeof(float) * n_window);
+    stream->dq = malloc(sizeof(int64_t) * n_window);
+    if (!stream->ring || !stream->frame_max || !stream->dq) {
+        free(stream->ring);
+        free(stream->frame_max);
+        free(stream->dq);
+        free(stream);
+        return NULL;
+    }
+    pthread_mutex_init(&stream->lock, NULL);
+
+    return stream;
+}
+
+void mel_stream_free(struct mel_stream * stream) {
+    if (!stream) {
+        return;
+    }
+    pthread_mutex_destroy(&stream->lock);
+    free(stream->buf);
+    free(stream->ring);
+    free(stream->frame_max);
+    free(stream->dq);
+    free(stream);
+}
+
+void mel_stream_reset(struct mel_stream * stream) {
+    pthread_mutex_lock(&stream->lock);
+    stream->buf_len = 0;
+    stream->buf_base = 0;
+    stream->started = 0;
+    stream->next_frame = 0;
+    stream->dq_head = 0;
+    stream->dq_len = 0;
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static int mel_stream_reserve(struct mel_stream * stream, int n) {
+    if (stream->buf_cap >= n) {
+        return 0;
+    }
+    int cap = stream->buf_cap > 0 ? stream->buf_cap : 2*MEL_N_FFT;
+    while (cap < n) {
+        cap *= 2;
+    }
+    float * buf = realloc(stream->buf, sizeof(float) * cap);
+    if (!buf) {
+        return -1;
+    }
+    stream->buf = buf;
+    stream->buf_cap = cap;
+    return 0;
+}
+
+static void mel_stream_push_max(struct mel_stream * stream, int64_t frame, float value) {
+    const int n = stream->n_window;
+
+    // drop frames that left the window
+    while (stream->dq_len > 0 && stream->dq[stream->dq_head] <= frame - n) {
+        stream->dq_head = (stream->dq_head + 1) % n;
+        stream->dq_len--;
+    }
+    // drop frames that can no longer be the maximum
+    while (stream->dq_len > 0) {
+        const int64_t back = stream->dq[(stream->dq_head + stream->dq_len - 1) % n];
+        if (stream->frame_max[back % n] > value) {
+            break;
+        }
+        stream->dq_len--;
+    }
+    stream->frame_max[frame % n] = value;
+    stream->dq[(stream->dq_head + stream->dq_len) % n] = frame;
+    stream->dq_len++;
+}
+
+int mel_stream_push(struct mel_stream * stream, const float * samples, int n_samples) {
+    if (n_samples <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+
+    // drop samples no pending frame will read
+    const int64_t keep_from = stream->next_frame*MEL_HOP_LENGTH;
+    if (stream->started && keep_from > stream->buf_base) {
+        const int drop = (int) (keep_from - stream->buf_base);
+        const int n_drop = drop < stream->buf_len ? drop : stream->buf_len;
+        memmove(stream->buf, stream->buf + n_drop, sizeof(float) * (stream->buf_len - n_drop));
+        stream->buf_len -= n_drop;
+        stream->buf_base += n_drop;
+    }
+
+    if (mel_stream_reserve(stream, stream->buf_len + n_samples + MEL_STREAM_PAD_START) != 0) {
+        pthread_mutex_unlock(&stream->lock);
+        return -1;
+    }
+    memcpy(stream->buf + stream->buf_len, samples, sizeof(float) * n_samples);
+    stream->buf_len += n_samples;
+
+    // whisper reflects samples[1..200] in front of the clip, so wait until they exist
+    if (!stream->started) {
+        if (stream->buf_len <= MEL_STREAM_PAD_START) {
+            pthread_mutex_unlock(&stream->lock);
+            return 0;
+        }
+        memmove(stream->buf + MEL_STREAM_PAD_START, stream->buf, sizeof(float) * stream->buf_len);
+        for (int p = 0; p < MEL_STREAM_PAD_START; p++) {
+            stream->buf[p] = stream->buf[MEL_STREAM_PAD_START + MEL_STREAM_PAD_START - p];
+        }
+        stream->buf_len += MEL_STREAM_PAD_START;
+        stream->started = 1;
+    }
+
+    int n_new = 0;
+    const int n_window = stream->n_window;
+    while (stream->next_frame*MEL_HOP_LENGTH + MEL_N_FFT <= stream->buf_base + stream->buf_len) {
+        const int64_t frame = stream->next_frame;
+        const float * src = stream->buf + (frame*MEL_HOP_LENGTH - stream->buf_base);
+        const float value = mel_frontend_frame(stream->fe, src, stream->ring + frame % n_window, n_window);
+        mel_stream_push_max(stream, frame, value);
+        stream->next_frame++;
+        n_new++;
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+    return n_new;
+}
+
+int mel_stream_n_frames(struct mel_stream * stream) {
+    pthread_mutex_lock(&stream->lock);
+    const int n = (int) (stream->next_frame < stream->n_window ? stream->next_frame : stream->n_window);
+    pthread_mutex_unlock(&stream->lock);
+    return n;
+}
+
+int64_t mel_stream_total_frames(struct mel_stream * stream) {
+    pthread_mutex_lock(&stream->lock);
+    const int64_t n = stream->next_frame;
+    pthread_mutex_unlock(&stream->lock);
+    return n;
+}
+
+int mel_stream_window(struct mel_stream * stream, struct mel_spectrogram * out) {
+    pthread_mutex_lock(&stream->lock);
+
+    const int n_mel = stream->n_mel;
+    const int n_window = stream->n_window;
+    const int n_frames = (int) (stream->next_frame < n_window ? stream->next_frame : n_window);
+    const int n_len = n_frames + MEL_STREAM_PAD_END;
+
+    const size_t need = (size_t) n_mel*n_len;
+    if (out->capacity < need) {
+        float * data = realloc(out->data, sizeof(float) * need);
+        if (!data) {
+            pthread_mutex_unlock(&stream->lock);
+            return -1;
+        }
+        out->data = data;
+        out->capacity = need;
+    }
+    out->n_mel = n_mel;
+    out->n_len = n_len;
+    out->n_len_org = n_frames;
+
+    // the trailing padding is silence, which whisper also includes in its maximum
+    float mmax = MEL_LOG10_FLOOR;
+    if (stream->dq_len > 0) {
+        mmax = fmaxf(mmax, stream->frame_max[stream->dq[stream->dq_head] % n_window]);
+    }
+
+    const int first = (int) ((stream->next_frame - n_frames) % n_window);
+    const int n_head = n_frames < n_window - first ? n_frames : n_window - first;
+    for (int j = 0; j < n_mel; j++) {
+        const float * src = stream->ring + (size_t) j*n_window;
+        float * dst = out->data + (size_t) j*n_len;
+        memcpy(dst, src + first, sizeof(float) * n_head);
+        memcpy(dst + n_head, src, sizeof(float) * (n_frames - n_head));
+        for (int i = n_frames; i < n_len; i++) {
+            dst[i] = MEL_LOG10_FLOOR;
+        }
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+
+    mel_normalize(out->data, need, mmax);
+    return 0;
+}
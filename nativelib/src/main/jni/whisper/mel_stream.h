@@ -0,0 +1,45 @@
+#ifndef WHISPER_JNI_MEL_STREAM_H
+#define WHISPER_JNI_MEL_STREAM_H
+
+#include "mel.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremental log-mel extractor for live audio.
+// PCM chunks are framed exactly like whisper_pcm_to_mel frames a clip that
+// starts at the first pushed sample; only frames that became complete are
+// transformed. The last n_window frames are kept in a ring buffer together
+// with a sliding maximum, so an update costs O(new samples) and the 30 s
+// window is only linearized when it is handed to whisper.
+// All functions are thread-safe with respect to the same stream.
+struct mel_stream;
+
+// n_window: frames kept in the ring (3000 = 30 s)
+struct mel_stream * mel_stream_init(const struct mel_frontend * fe, int n_window);
+void mel_stream_free(struct mel_stream * stream);
+
+void mel_stream_reset(struct mel_stream * stream);
+
+// Returns the number of new frames, or -1 on allocation failure.
+int mel_stream_push(struct mel_stream * stream, const float * samples, int n_samples);
+
+// frames currently held in the ring (<= n_window)
+int mel_stream_n_frames(struct mel_stream * stream);
+
+// frames produced since init/reset
+int64_t mel_stream_total_frames(struct mel_stream * stream);
+
+// Linearizes the current window into [n_mel][n_len] with whisper's max - 8
+// normalization over the window and 30 s of trailing floor padding.
+// n_len_org is set to the number of real frames. Returns 0 on success.
+int mel_stream_window(struct mel_stream * stream, struct mel_spectrogram * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_MEL_STREAM_H
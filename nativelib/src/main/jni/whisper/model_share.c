@@ -0,0 +1,549 @@
+#include "model_share.h"
+#include "ggml.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/sharedmem.h>
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS   (1024 + 9)
+#define F_GET_SEALS   (1024 + 10)
+#define F_SEAL_SEAL   0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW   0x0004
+#define F_SEAL_WRITE  0x0008
+#endif
+
+#define MODEL_SHARE_MAGIC "WSHARE01"
+// reads up to this size keep their bytes in the record: the model's header,
+// vocabulary and mel filters, and small tensors until they are classified
+#define MODEL_SHARE_META_MAX (256*1024)
+// largest padding between two tensors of the weight buffer
+#define MODEL_SHARE_MAX_GAP  4096
+// contexts with mapped weights at once
+#define MODEL_SHARE_MAX_MAPS 16
+
+struct model_share_header {
+    char magic[8];
+    uint32_t n_reads;
+    uint32_t page_size;      // of the creating process
+    uint64_t meta_bytes;
+    uint64_t image_offset;   // page-aligned start of the weight image in the region
+    uint64_t image_lead;     // in-page offset of the first weight byte
+    uint64_t weight_bytes;   // from the first to the last weight byte
+};
+
+// one loader read; exactly one of meta and weight is >= 0
+struct model_share_read {
+    uint64_t size;     // requested
+    uint64_t got;      // returned
+    int64_t  meta;     // offset of its bytes in the metadata
+    int64_t  weight;   // offset of its destination from the first weight byte
+};
+
+struct model_share_map {
+    struct whisper_context * ctx;
+    uint8_t * addr;
+    size_t size;
+};
+
+static pthread_mutex_t g_maps_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct model_share_map g_maps[MODEL_SHARE_MAX_MAPS];
+
+static size_t model_share_page(void) {
+    return (size_t) sysconf(_SC_PAGESIZE);
+}
+
+// Recording loader of model_share_create: every read with its destination.
+struct model_share_rec {
+    struct whisper_model_loader * inner;
+    struct model_share_read * reads;
+    uint8_t ** dst;
+    int n_reads;
+    int cap_reads;
+    uint8_t * meta;
+    size_t n_meta;
+    size_t cap_meta;
+    bool failed;
+};
+
+static size_t model_share_rec_read(void * ctx, void * output, size_t read_size) {
+    struct model_share_rec * rec = ctx;
+    const size_t got = rec->inner->read(rec->inner->context, output, read_size);
+    if (rec->n_reads == rec->cap_reads) {
+        const int cap = rec->cap_reads ? 2*rec->cap_reads : 4096;
+        struct model_share_read * reads = realloc(rec->reads, sizeof(struct model_share_read) * cap);
+        uint8_t ** dst = reads ? realloc(rec->dst, sizeof(uint8_t *) * cap) : NULL;
+        if (reads) {
+            rec->reads = reads;
+        }
+        if (!dst) {
+            rec->failed = true;
+            return got;
+        }
+        rec->dst = dst;
+        rec->cap_reads = cap;
+    }
+    struct model_share_read * r = &rec->reads[rec->n_reads];
+    r->size = read_size;
+    r->got = got;
+    r->meta = -1;
+    r->weight = -1;
+    if (got <= MODEL_SHARE_META_MAX) {
+        if (rec->n_meta + got > rec->cap_meta) {
+            const size_t cap = rec->n_meta + got > 2*rec->cap_meta ? rec->n_meta + got : 2*rec->cap_meta;
+            uint8_t * meta = realloc(rec->meta, cap);
+            if (!meta) {
+                rec->failed = true;
+                return got;
+            }
+            rec->meta = meta;
+            rec->cap_meta = cap;
+        }
+        if (got > 0) {
+            memcpy(rec->meta + rec->n_meta, output, got);
+        }
+        r->meta = (int64_t) rec->n_meta;
+        rec->n_meta += got;
+    }
+    rec->dst[rec->n_reads++] = output;
+    return got;
+}
+
+static bool model_share_rec_eof(void * ctx) {
+    struct model_share_rec * rec = ctx;
+    return rec->inner->eof(rec->inner->context);
+}
+
+static void model_share_rec_close(void * ctx) {
+    struct model_share_rec * rec = ctx;
+    rec->inner->close(rec->inner->context);
+}
+
+static struct model_share_rec * g_sort_rec;
+
+static int model_share_cmp_dst(const void * a, const void * b) {
+    const uint8_t * x = g_sort_rec->dst[*(const int *) a];
+    const uint8_t * y = g_sort_rec->dst[*(const int *) b];
+    return (x > y) - (x < y);
+}
+
+// Marks the reads into the weight buffer: the contiguous run of destinations
+// around the largest read. Fails when a large read lies outside it (weights
+// split over several buffers or read through a staging buffer) or a metadata
+// read was too large to keep.
+static int model_share_classify(struct model_share_rec * rec, uint8_t ** lo, uint8_t ** hi) {
+    int * order = malloc(sizeof(int) * (rec->n_reads > 0 ? rec->n_reads : 1));
+    if (!order || rec->n_reads == 0) {
+        free(order);
+        return -1;
+    }
+    int n = 0;
+    int largest = -1;
+    for (int i = 0; i < rec->n_reads; i++) {
+        if (rec->reads[i].got == 0) {
+            continue;
+        }
+        order[n++] = i;
+        if (largest < 0 || rec->reads[i].got > rec->reads[largest].got) {
+            largest = i;
+        }
+    }
+    if (largest < 0) {
+        // nothing was read
+        free(order);
+        return -1;
+    }
+    // the sort is only reached from model_share_create, which is serialized
+    g_sort_rec = rec;
+    qsort(order, (size_t) n, sizeof(int), model_share_cmp_dst);
+
+    int p = 0;
+    while (order[p] != largest) {
+        p++;
+    }
+    int first = p;
+    int last = p;
+    #define END(i) (rec->dst[order[i]] + rec->reads[order[i]].got)
+    while (first > 0 && END(first - 1) <= rec->dst[order[first]] &&
+            rec->dst[order[first]] - END(first - 1) <= MODEL_SHARE_MAX_GAP) {
+        first--;
+    }
+    while (last + 1 < n && END(last) <= rec->dst[order[last + 1]] &&
+            rec->dst[order[last + 1]] - END(last) <= MODEL_SHARE_MAX_GAP) {
+        last++;
+    }
+    *lo = rec->dst[order[first]];
+    *hi = END(last);
+    #undef END
+
+    int rc = 0;
+    for (int i = 0; i < rec->n_reads; i++) {
+        struct model_share_read * r = &rec->reads[i];
+        const bool weight = r->got > 0 && rec->dst[i] >= *lo && rec->dst[i] + r->got <= *hi;
+        if (weight) {
+            r->weight = rec->dst[i] - *lo;
+            r->meta = -1;
+        } else if (r->meta < 0) {
+            rc = -1;
+        }
+    }
+    free(order);
+    return rc;
+}
+
+// memfd with seals; ashmem on Android kernels without memfd
+static int model_share_alloc(size_t size, bool * memfd) {
+    int fd = (int) syscall(__NR_memfd_create, "whisper-model", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    *memfd = fd >= 0;
+    if (fd >= 0 && ftruncate(fd, (off_t) size) != 0) {
+        close(fd);
+        return -1;
+    }
+#ifdef __ANDROID__
+    if (fd < 0) {
+        fd = ASharedMemory_create("whisper-model", size);
+    }
+#endif
+    return fd;
+}
+
+static int model_share_seal(int fd, bool memfd) {
+    if (memfd) {
+        return fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    }
+#ifdef __ANDROID__
+    return ASharedMemory_setProt(fd, PROT_READ);
+#else
+    return -1;
+#endif
+}
+
+static size_t model_share_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        return (size_t) st.st_size;
+    }
+#ifdef __ANDROID__
+    return ASharedMemory_getSize(fd);
+#else
+    return 0;
+#endif
+}
+
+int model_share_create(struct whisper_model_loader * loader, struct model_share_stats * stats) {
+    const int64_t t_start_us = ggml_time_us();
+    struct model_share_rec rec = { .inner = loader };
+    struct whisper_model_loader recording = {
+        .context = &rec,
+        .read    = model_share_rec_read,
+        .eof     = model_share_rec_eof,
+        .close   = model_share_rec_close,
+    };
+    static pthread_mutex_t create_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&create_lock);
+
+    int fd = -1;
+    struct whisper_context * ctx = whisper_init_with_params_no_state(&recording, whisper_context_default_params());
+    uint8_t * lo = NULL;
+    uint8_t * hi = NULL;
+    if (ctx && !rec.failed && model_share_classify(&rec, &lo, &hi) == 0) {
+        const size_t page = model_share_page();
+        const size_t lead = (uintptr_t) lo % page;
+        const size_t table = sizeof(struct model_share_header) + sizeof(struct model_share_read) * rec.n_reads + rec.n_meta;
+        const size_t image_offset = (table + page - 1)/page*page;
+        const size_t size = image_offset + (lead + (size_t) (hi - lo) + page - 1)/page*page;
+
+        bool memfd = false;
+        fd = model_share_alloc(size, &memfd);
+        uint8_t * region = fd >= 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        if (region != MAP_FAILED) {
+            struct model_share_header hdr = {
+                .n_reads      = (uint32_t) rec.n_reads,
+                .page_size    = (uint32_t) page,
+                .meta_bytes   = rec.n_meta,
+                .image_offset = image_offset,
+                .image_lead   = lead,
+                .weight_bytes = (uint64_t) (hi - lo),
+            };
+            memcpy(hdr.magic, MODEL_SHARE_MAGIC, sizeof(hdr.magic));
+            uint8_t * p = region;
+            memcpy(p, &hdr, sizeof(hdr));
+            p += sizeof(hdr);
+            memcpy(p, rec.reads, sizeof(struct model_share_read) * rec.n_reads);
+            p += sizeof(struct model_share_read) * rec.n_reads;
+            memcpy(p, rec.meta, rec.n_meta);
+            memcpy(region + image_offset + lead, lo, (size_t) (hi - lo));
+            munmap(region, size);
+        }
+        if (region == MAP_FAILED || model_share_seal(fd, memfd) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        } else if (stats) {
+            stats->region_bytes = size;
+            stats->shared_bytes = 0;
+            stats->copied_bytes = (size_t) (hi - lo);
+        }
+    }
+    whisper_free(ctx);
+    pthread_mutex_unlock(&create_lock);
+
+    free(rec.reads);
+    free(rec.dst);
+    free(rec.meta);
+    if (stats) {
+        stats->load_ms = (ggml_time_us() - t_start_us)/1000.0f;
+    }
+    return fd;
+}
+
+// Replaying loader of model_share_open: metadata from the region, weights
+// left out where their pages are mapped afterwards.
+struct model_share_replay {
+    const struct model_share_header * hdr;
+    const struct model_share_read * reads;
+    const uint8_t * meta;
+    const uint8_t * weights;   // first weight byte in the region
+    size_t page;
+    int i;
+    uint8_t * base;            // first weight byte in this process's buffer
+    uint8_t * map_lo;          // whole pages of the buffer to map
+    uint8_t * map_hi;
+    bool copy;                 // layout differs, copy every weight
+    bool failed;
+    size_t copied;
+    uint64_t weight_lo;        // extent of the weight reads replayed so far
+    uint64_t weight_hi;
+};
+
+static void model_share_copy_out(struct model_share_replay * rp, uint8_t * dst, const struct model_share_read * r) {
+    const uint8_t * src = rp->weights + r->weight;
+    uint8_t * end = dst + r->got;
+    if (rp->copy) {
+        memcpy(dst, src, r->got);
+        rp->copied += r->got;
+        return;
+    }
+    // only the parts outside the mapped pages
+    if (dst < rp->map_lo) {
+        const size_t n = (size_t) ((end < rp->map_lo ? end : rp->map_lo) - dst);
+        memcpy(dst, src, n);
+        rp->copied += n;
+    }
+    if (end > rp->map_hi) {
+        uint8_t * from = dst > rp->map_hi ? dst : rp->map_hi;
+        memcpy(from, src + (from - dst), (size_t) (end - from));
+        rp->copied += (size_t) (end - from);
+    }
+}
+
+// Copies the parts of the first n reads that fell on the pages left out for
+// mapping. Only destinations whisper handed to the loader are written.
+static void model_share_fill_skipped(struct model_share_replay * rp, int n) {
+    for (int j = 0; j < n; j++) {
+        const struct model_share_read * w = &rp->reads[j];
+        if (w->weight >= 0) {
+            const uint8_t * from = rp->base + w->weight;
+            const uint8_t * lo = from > rp->map_lo ? from : rp->map_lo;
+            const uint8_t * hi = from + w->got < rp->map_hi ? from + w->got : rp->map_hi;
+            if (lo < hi) {
+                memcpy(rp->base + w->weight + (lo - from), rp->weights + w->weight + (lo - from), (size_t) (hi - lo));
+                rp->copied += (size_t) (hi - lo);
+            }
+        }
+    }
+}
+
+static size_t model_share_replay_read(void * ctx, void * output, size_t read_size) {
+    struct model_share_replay * rp = ctx;
+    if (rp->failed || rp->i >= (int) rp->hdr->n_reads || rp->reads[rp->i].size != read_size) {
+        // another build reads another sequence
+        rp->failed = true;
+        memset(output, 0, read_size);
+        return 0;
+    }
+    const struct model_share_read * r = &rp->reads[rp->i++];
+    if (r->meta >= 0) {
+        memcpy(output, rp->meta + r->meta, r->got);
+        return r->got;
+    }
+
+    uint8_t * dst = output;
+    if (!rp->base && !rp->copy) {
+        rp->base = dst - r->weight;
+        if ((uintptr_t) rp->base % rp->page != rp->hdr->image_lead || rp->page != rp->hdr->page_size) {
+            rp->copy = true;
+        } else {
+            rp->map_lo = rp->base - rp->hdr->image_lead + (rp->hdr->image_lead ? rp->page : 0);
+            rp->map_hi = rp->base - rp->hdr->image_lead + (rp->hdr->image_lead + rp->hdr->weight_bytes)/rp->page*rp->page;
+            if (rp->map_hi < rp->map_lo) {
+                rp->map_hi = rp->map_lo;
+            }
+        }
+    }
+    if (!rp->copy && dst != rp->base + r->weight) {
+        // another layout: fill in what was left out so far
+        rp->copy = true;
+        model_share_fill_skipped(rp, rp->i - 1);
+    }
+    model_share_copy_out(rp, dst, r);
+    rp->weight_lo = (uint64_t) r->weight < rp->weight_lo ? (uint64_t) r->weight : rp->weight_lo;
+    rp->weight_hi = r->weight + r->got > rp->weight_hi ? r->weight + r->got : rp->weight_hi;
+    return r->got;
+}
+
+static bool model_share_replay_eof(void * ctx) {
+    const struct model_share_replay * rp = ctx;
+    return rp->failed || rp->i >= (int) rp->hdr->n_reads;
+}
+
+static void model_share_replay_close(void * ctx) {
+    (void) ctx;
+}
+
+// The region comes from another process: every offset the replay follows
+// must stay inside it, and no read may return more than was asked for, as
+// the replay writes that much into whisper's buffer. Sums are checked term by
+// term so that a crafted header cannot wrap them around.
+static bool model_share_valid(const uint8_t * region, size_t size) {
+    const struct model_share_header * hdr = (const struct model_share_header *) region;
+    if (memcmp(hdr->magic, MODEL_SHARE_MAGIC, sizeof(hdr->magic)) != 0 ||
+            hdr->n_reads > (size - sizeof(*hdr))/sizeof(struct model_share_read) ||
+            hdr->meta_bytes > size || hdr->image_offset > size ||
+            hdr->image_lead >= hdr->page_size || hdr->weight_bytes > size ||
+            sizeof(*hdr) + sizeof(struct model_share_read) * (size_t) hdr->n_reads + hdr->meta_bytes > hdr->image_offset ||
+            hdr->image_lead + hdr->weight_bytes > size - hdr->image_offset) {
+        return false;
+    }
+    const struct model_share_read * reads = (const struct model_share_read *) (region + sizeof(*hdr));
+    for (uint32_t i = 0; i < hdr->n_reads; i++) {
+        const struct model_share_read * r = &reads[i];
+        const bool meta = r->meta >= 0 && r->weight < 0 && (uint64_t) r->meta <= hdr->meta_bytes && r->got <= hdr->meta_bytes - r->meta;
+        const bool weight = r->weight >= 0 && r->meta < 0 && (uint64_t) r->weight <= hdr->weight_bytes && r->got <= hdr->weight_bytes - r->weight;
+        if (r->got > r->size || (!meta && !weight)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A memfd must be sealed against shrinking, or the sender could truncate it
+// under the mapping; ashmem cannot shrink.
+static bool model_share_sealed(int fd) {
+    const int seals = fcntl(fd, F_GET_SEALS);
+    return seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) == (F_SEAL_SHRINK | F_SEAL_WRITE);
+}
+
+// Puts fresh private pages at [addr, addr + n), over whatever is mapped there.
+static bool model_share_anon(void * addr, size_t n) {
+    return mmap(addr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED;
+}
+
+struct whisper_context * model_share_open(int fd, struct whisper_context_params params, struct model_share_stats * stats) {
+    const int64_t t_start_us = ggml_time_us();
+    const size_t size = model_share_size(fd);
+    uint8_t * region = size > sizeof(struct model_share_header) && model_share_sealed(fd)
+            ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    if (!model_share_valid(region, size)) {
+        munmap(region, size);
+        return NULL;
+    }
+    const struct model_share_header * hdr = (const struct model_share_header *) region;
+
+    struct model_share_replay rp = {
+        .hdr     = hdr,
+        .reads   = (const struct model_share_read *) (region + sizeof(*hdr)),
+        .meta    = region + sizeof(*hdr) + sizeof(struct model_share_read) * hdr->n_reads,
+        .weights = region + hdr->image_offset + hdr->image_lead,
+        .page    = model_share_page(),
+        .weight_lo = UINT64_MAX,
+    };
+    struct whisper_model_loader loader = {
+        .context = &rp,
+        .read    = model_share_replay_read,
+        .eof     = model_share_replay_eof,
+        .close   = model_share_replay_close,
+    };
+    struct whisper_context * ctx = whisper_init_with_params(&loader, params);
+    if (ctx && rp.failed) {
+        whisper_free(ctx);
+        ctx = NULL;
+    }
+
+    size_t shared = 0;
+    if (ctx && !rp.copy && rp.base && rp.map_hi > rp.map_lo &&
+            (rp.weight_lo != 0 || rp.weight_hi != hdr->weight_bytes)) {
+        // the reads did not span the image, so the pages past them may not
+        // belong to whisper's buffer: only fill in what the reads covered
+        model_share_fill_skipped(&rp, rp.i);
+    } else if (ctx && !rp.copy && rp.base && rp.map_hi > rp.map_lo) {
+        const size_t n = (size_t) (rp.map_hi - rp.map_lo);
+        const size_t offset = hdr->image_offset + (size_t) (rp.map_lo - (rp.base - hdr->image_lead));
+        int slot = -1;
+        pthread_mutex_lock(&g_maps_lock);
+        for (int i = 0; i < MODEL_SHARE_MAX_MAPS && slot < 0; i++) {
+            slot = g_maps[i].ctx == NULL ? i : -1;
+        }
+        if (slot >= 0 && mmap(rp.map_lo, n, PROT_READ, MAP_SHARED | MAP_FIXED, fd, (off_t) offset) != MAP_FAILED) {
+            g_maps[slot] = (struct model_share_map) { ctx, rp.map_lo, n };
+            shared = n;
+        } else if (slot < 0 || model_share_anon(rp.map_lo, n)) {
+            // the pages were left out, fill them in
+            memcpy(rp.map_lo, rp.weights + (rp.map_lo - rp.base), n);
+            rp.copied += n;
+        } else {
+            // the failed MAP_FIXED took the range with it and it could not be
+            // mapped again: whisper's buffer has a hole
+            rp.failed = true;
+        }
+        pthread_mutex_unlock(&g_maps_lock);
+    }
+    if (ctx && rp.failed) {
+        whisper_free(ctx);
+        ctx = NULL;
+    }
+    munmap(region, size);
+
+    if (stats) {
+        stats->region_bytes = size;
+        stats->shared_bytes = shared;
+        stats->copied_bytes = rp.copied;
+        stats->load_ms = (ggml_time_us() - t_start_us)/1000.0f;
+    }
+    return ctx;
+}
+
+void model_share_unmap(struct whisper_context * ctx) {
+    if (!ctx) {
+        return;
+    }
+    pthread_mutex_lock(&g_maps_lock);
+    for (int i = 0; i < MODEL_SHARE_MAX_MAPS; i++) {
+        if (g_maps[i].ctx == ctx) {
+            // fresh private pages, the allocator may hand the buffer out again
+            model_share_anon(g_maps[i].addr, g_maps[i].size);
+            g_maps[i].ctx = NULL;
+        }
+    }
+    pthread_mutex_unlock(&g_maps_lock);
+}
@@ -0,0 +1,49 @@
+#ifndef WHISPER_JNI_MODEL_SHARE_H
+#define WHISPER_JNI_MODEL_SHARE_H
+
+#include <stddef.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cross-process model sharing. The model is loaded once and its decoded
+// weight buffer is copied into a sealed memfd (ashmem where memfd is missing)
+// together with a record of the loader's reads. A process holding the fd
+// builds a context by replaying that record: whisper allocates its weight
+// buffer as usual, but the weights are not copied into it; instead the
+// region's pages are mapped read-only over the buffer, so every process shares
+// one physical copy of the weights. Only the partial pages at the buffer's ends
+// are private.
+//
+// The replay depends on whisper allocating the same layout in every process,
+// which holds for the same library build; when it does not (another page
+// alignment, another build), the weights are copied from the region instead
+// and the context still works, only without sharing.
+struct model_share_stats {
+    size_t region_bytes;   // size of the shared region
+    size_t shared_bytes;   // weights mapped from the region
+    size_t copied_bytes;   // weights copied into private memory
+    float  load_ms;
+};
+
+// Loads the model through loader (closed when done) and returns a sealed fd
+// holding its weights, -1 on failure. The caller owns the fd. stats may be NULL.
+int model_share_create(struct whisper_model_loader * loader, struct model_share_stats * stats);
+
+// Context whose weights live in the region of fd, NULL when fd does not hold a
+// region of this build. fd stays owned by the caller and may be closed once
+// this returns. stats may be NULL.
+struct whisper_context * model_share_open(int fd, struct whisper_context_params params, struct model_share_stats * stats);
+
+// Gives the weight pages of ctx back to the heap; must be called before
+// whisper_free (transcriber_free does). No-op for other contexts.
+void model_share_unmap(struct whisper_context * ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_MODEL_SHARE_H
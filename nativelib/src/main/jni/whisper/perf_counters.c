@@ -0,0 +1,179 @@
+#include "perf_counters.h"
+#include "ggml.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// bytes per LLC miss for the bandwidth estimate
+#define PERF_COUNTERS_LINE_BYTES 64
+
+enum {
+    PERF_COUNTERS_CYCLES,
+    PERF_COUNTERS_INSTRUCTIONS,
+    PERF_COUNTERS_CACHE_MISSES,
+    PERF_COUNTERS_BRANCH_MISSES,
+    PERF_COUNTERS_LLC_READ_MISSES,
+    PERF_COUNTERS_CONTEXT_SWITCHES,
+    PERF_COUNTERS_TASK_CLOCK,
+    PERF_COUNTERS_N,
+};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} k_events[PERF_COUNTERS_N] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+};
+
+struct perf_counters {
+    int fd[PERF_COUNTERS_N];   // -1 when the event is unavailable
+    int64_t t_open_us;
+    bool user_only;
+};
+
+static int perf_counters_open_event(int i, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = k_events[i].type;
+    attr.config = k_events[i].config;
+    attr.inherit = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+struct perf_counters * perf_counters_open(void) {
+    struct perf_counters * pc = calloc(1, sizeof(struct perf_counters));
+    if (!pc) {
+        return NULL;
+    }
+    int n_open = 0;
+    for (int i = 0; i < PERF_COUNTERS_N; i++) {
+        // paranoid >= 2 refuses kernel-mode counting: fall back to user space
+        pc->fd[i] = pc->user_only ? -1 : perf_counters_open_event(i, false);
+        if (pc->fd[i] < 0) {
+            pc->fd[i] = perf_counters_open_event(i, true);
+            pc->user_only = pc->user_only || pc->fd[i] >= 0;
+        }
+        n_open += pc->fd[i] >= 0;
+    }
+    if (n_open == 0) {
+        free(pc);
+        return NULL;
+    }
+    pc->t_open_us = ggml_time_us();
+    return pc;
+}
+
+void perf_counters_close(struct perf_counters * pc) {
+    if (!pc) {
+        return;
+    }
+    for (int i = 0; i < PERF_COUNTERS_N; i++) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+        }
+    }
+    free(pc);
+}
+
+bool perf_counters_user_only(const struct perf_counters * pc) {
+    return pc->user_only;
+}
+
+static int64_t perf_counters_value(int fd) {
+    uint64_t v[3];   // value, time enabled, time running
+    if (fd < 0 || read(fd, v, sizeof(v)) != (ssize_t) sizeof(v)) {
+        return -1;
+    }
+    if (v[2] == 0) {
+        return v[1] == 0 ? (int64_t) v[0] : -1;
+    }
+    return v[2] < v[1] ? (int64_t) ((double) v[0]*v[1]/v[2]) : (int64_t) v[0];
+}
+
+void perf_counters_read(const struct perf_counters * pc, struct perf_sample * now) {
+    now->cycles           = perf_counters_value(pc->fd[PERF_COUNTERS_CYCLES]);
+    now->instructions     = perf_counters_value(pc->fd[PERF_COUNTERS_INSTRUCTIONS]);
+    now->cache_misses     = perf_counters_value(pc->fd[PERF_COUNTERS_CACHE_MISSES]);
+    now->branch_misses    = perf_counters_value(pc->fd[PERF_COUNTERS_BRANCH_MISSES]);
+    now->llc_read_misses  = perf_counters_value(pc->fd[PERF_COUNTERS_LLC_READ_MISSES]);
+    now->context_switches = perf_counters_value(pc->fd[PERF_COUNTERS_CONTEXT_SWITCHES]);
+    const int64_t task_ns = perf_counters_value(pc->fd[PERF_COUNTERS_TASK_CLOCK]);
+    now->task_clock_ms = task_ns >= 0 ? task_ns/1e6 : -1.0;
+    now->wall_ms = (ggml_time_us() - pc->t_open_us)/1000.0;
+}
+
+void perf_sample_clear(struct perf_sample * s) {
+    memset(s, 0, sizeof(*s));
+}
+
+static int64_t perf_sample_diff(int64_t acc, int64_t from, int64_t to) {
+    return acc < 0 || from < 0 || to < 0 ? -1 : acc + (to - from);
+}
+
+void perf_sample_add_diff(struct perf_sample * acc, const struct perf_sample * from, const struct perf_sample * to) {
+    acc->cycles           = perf_sample_diff(acc->cycles, from->cycles, to->cycles);
+    acc->instructions     = perf_sample_diff(acc->instructions, from->instructions, to->instructions);
+    acc->cache_misses     = perf_sample_diff(acc->cache_misses, from->cache_misses, to->cache_misses);
+    acc->branch_misses    = perf_sample_diff(acc->branch_misses, from->branch_misses, to->branch_misses);
+    acc->llc_read_misses  = perf_sample_diff(acc->llc_read_misses, from->llc_read_misses, to->llc_read_misses);
+    acc->context_switches = perf_sample_diff(acc->context_switches, from->context_switches, to->context_switches);
+    acc->task_clock_ms = acc->task_clock_ms < 0.0 || from->task_clock_ms < 0.0 || to->task_clock_ms < 0.0
+            ? -1.0 : acc->task_clock_ms + (to->task_clock_ms - from->task_clock_ms);
+    acc->wall_ms += to->wall_ms - from->wall_ms;
+}
+
+float perf_sample_ipc(const struct perf_sample * s) {
+    return s->cycles > 0 && s->instructions >= 0 ? (float) s->instructions/s->cycles : -1.0f;
+}
+
+float perf_sample_ghz(const struct perf_sample * s) {
+    return s->cycles >= 0 && s->task_clock_ms > 0.0 ? (float) (s->cycles/(s->task_clock_ms*1e6)) : -1.0f;
+}
+
+float perf_sample_bandwidth_gbs(const struct perf_sample * s) {
+    return s->llc_read_misses >= 0 && s->wall_ms > 0.0
+            ? (float) (s->llc_read_misses*(double) PERF_COUNTERS_LINE_BYTES/(s->wall_ms*1e6)) : -1.0f;
+}
+
+int perf_sample_format(const struct perf_sample * s, char * buf, size_t n) {
+    // events the PMU lacks are left out
+    int len = snprintf(buf, n, "%.1f ms wall", s->wall_ms);
+#define PERF_APPEND(...) len += snprintf(buf + (len < (int) n ? len : (int) n), len < (int) n ? n - len : 0, __VA_ARGS__)
+    if (s->task_clock_ms >= 0.0) {
+        PERF_APPEND(", %.1f ms task-clock (%.2f CPUs)", s->task_clock_ms, s->wall_ms > 0.0 ? s->task_clock_ms/s->wall_ms : 0.0);
+    }
+    if (s->cycles >= 0) {
+        PERF_APPEND(", %.1f M cycles (%.2f GHz)", s->cycles/1e6, perf_sample_ghz(s));
+    }
+    if (s->instructions >= 0) {
+        PERF_APPEND(", %.1f M instructions (IPC %.2f)", s->instructions/1e6, perf_sample_ipc(s));
+    }
+    if (s->cache_misses >= 0) {
+        PERF_APPEND(", cache misses %.2f M", s->cache_misses/1e6);
+    }
+    if (s->branch_misses >= 0) {
+        PERF_APPEND(", branch misses %.2f M", s->branch_misses/1e6);
+    }
+    if (s->llc_read_misses >= 0) {
+        PERF_APPEND(", LLC read misses %.2f M (%.2f GB/s)", s->llc_read_misses/1e6, perf_sample_bandwidth_gbs(s));
+    }
+    if (s->context_switches >= 0) {
+        PERF_APPEND(", %lld context switches", (long long) s->context_switches);
+    }
+#undef PERF_APPEND
+    return len;
+}
@@ -0,0 +1,62 @@
+#ifndef WHISPER_JNI_PERF_COUNTERS_H
+#define WHISPER_JNI_PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hardware and software counters of the calling process through
+// perf_event_open, to tell a compute-bound slowdown (low IPC, many cycles)
+// from a memory-bound one (cache misses, bandwidth) or from the governor
+// (cycles per task-clock, i.e. the effective clock, dropping).
+//
+// The counters follow the thread that opened them and the threads it creates
+// afterwards (ggml's compute threads, the mel workers); a thread's counts are
+// added once it exits, so open them before the work starts. Android allows
+// perf_event_open to apps only with perf_event_paranoid lowered
+// (`adb shell setprop security.perf_harden 0`), and without kernel access the
+// counters are user-space only. Events the PMU lacks read as -1.
+struct perf_sample {
+    int64_t cycles;
+    int64_t instructions;
+    int64_t cache_misses;       // the PMU's generic cache miss event (LLC on x86, often L1D on ARM)
+    int64_t branch_misses;
+    int64_t llc_read_misses;    // last level cache read misses, for the bandwidth estimate
+    int64_t context_switches;
+    double  task_clock_ms;      // CPU time of the counted threads
+    double  wall_ms;
+};
+
+struct perf_counters;
+
+// NULL when perf_event_open is unavailable or none of the events can be counted.
+struct perf_counters * perf_counters_open(void);
+void perf_counters_close(struct perf_counters * pc);
+
+// Counts since perf_counters_open, scaled when the kernel multiplexed them.
+void perf_counters_read(const struct perf_counters * pc, struct perf_sample * now);
+
+// true when kernel-mode events were refused and only user space is counted.
+bool perf_counters_user_only(const struct perf_counters * pc);
+
+// acc += to - from, counter by counter; an event unavailable in either stays -1.
+void perf_sample_add_diff(struct perf_sample * acc, const struct perf_sample * from, const struct perf_sample * to);
+void perf_sample_clear(struct perf_sample * s);
+
+// Derived figures, -1 when an input is unavailable.
+float perf_sample_ipc(const struct perf_sample * s);
+float perf_sample_ghz(const struct perf_sample * s);            // cycles per task-clock
+float perf_sample_bandwidth_gbs(const struct perf_sample * s);  // LLC read misses x line size per wall time
+
+// One line for logs and benchmark output; returns the length like snprintf.
+int perf_sample_format(const struct perf_sample * s, char * buf, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_PERF_COUNTERS_H
@@ -0,0 +1,493 @@
+#include "pipeline.h"
+#include "mel.h"
+#include "vad.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// whisper's window in mel frames (30 s) and the remainder it ignores (1 s)
+#define PIPELINE_WINDOW     3000
+#define PIPELINE_MIN_TAIL   100
+
+// the decoder is assumed to stop in the second half of a window
+#define PIPELINE_MIN_STEP   1500
+
+// first timestamp of a window, in 20 ms steps (whisper's max_initial_ts, 1 s)
+#define PIPELINE_INITIAL_TS 50
+
+struct pipeline_slot {
+    struct pipeline * p;
+    struct whisper_state * state;
+    float * mel;       // [n_mel][PIPELINE_WINDOW] window copied out of the spectrogram
+    pthread_t thread;
+
+    int seek;          // first frame of the encoded window
+    int n_threads;
+    int rc;
+    float encode_ms;
+};
+
+struct pipeline {
+    struct whisper_context * ctx;
+    struct pipeline_slot slots[2];
+    int n_mel;
+
+    int n_vocab;
+    whisper_token eot;
+    whisper_token beg;
+
+    whisper_token * tokens;  // prompt, then the sampled tokens
+    int cap_tokens;
+
+    char * text;             // text of the open segment
+    size_t text_len;
+    size_t cap_text;
+
+    // current run
+    struct pipeline_params params;
+    const struct mel_spectrogram * mel;
+    const struct vad_frames * vad;
+    int n_frames;
+    float pad_value;         // spectrogram value of silence past the end
+
+    struct pipeline_stats stats;
+};
+
+static int64_t time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+struct pipeline * pipeline_init(struct whisper_context * ctx) {
+    if (!ctx) {
+        return NULL;
+    }
+    struct pipeline * p = calloc(1, sizeof(struct pipeline));
+    if (!p) {
+        return NULL;
+    }
+    p->ctx = ctx;
+    p->n_vocab = whisper_n_vocab(ctx);
+    p->eot = whisper_token_eot(ctx);
+    p->beg = whisper_token_beg(ctx);
+    p->cap_tokens = whisper_n_text_ctx(ctx);
+    p->tokens = malloc(sizeof(whisper_token) * p->cap_tokens);
+    if (!p->tokens) {
+        pipeline_free(p);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        p->slots[i].p = p;
+        p->slots[i].state = whisper_init_state(ctx);
+        if (!p->slots[i].state) {
+            pipeline_free(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+void pipeline_free(struct pipeline * p) {
+    if (!p) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (p->slots[i].state) {
+            whisper_free_state(p->slots[i].state);
+        }
+        free(p->slots[i].mel);
+    }
+    free(p->tokens);
+    free(p->text);
+    free(p);
+}
+
+const struct pipeline_stats * pipeline_get_stats(const struct pipeline * p) {
+    return &p->stats;
+}
+
+// Copies the window at s->seek into the slot's state and runs the encoder.
+// Runs on its own thread for speculative windows.
+static void * pipeline_encode(void * arg) {
+    struct pipeline_slot * s = arg;
+    const struct pipeline * p = s->p;
+    const struct mel_spectrogram * mel = p->mel;
+    const int64_t t0_us = time_us();
+
+    const int n_copy = mel->n_len - s->seek < PIPELINE_WINDOW ? mel->n_len - s->seek : PIPELINE_WINDOW;
+    for (int j = 0; j < mel->n_mel; j++) {
+        float * dst = s->mel + (size_t) j*PIPELINE_WINDOW;
+        memcpy(dst, mel->data + (size_t) j*mel->n_len + s->seek, sizeof(float) * n_copy);
+        for (int i = n_copy; i < PIPELINE_WINDOW; i++) {
+            dst[i] = p->pad_value;
+        }
+    }
+
+    s->rc = whisper_set_mel_with_state(p->ctx, s->state, s->mel, PIPELINE_WINDOW, mel->n_mel) == 0 &&
+            whisper_encode_with_state(p->ctx, s->state, 0, s->n_threads) == 0 ? 0 : -1;
+    s->encode_ms = (time_us() - t0_us)/1000.0f;
+    return NULL;
+}
+
+// First window to decode at or after seek, n_frames when none is left. The
+// same rules as the transcriber: silence before an onset is skipped, windows
+// with too little speech are not decoded. count updates the statistics.
+static int pipeline_next_window(struct pipeline * p, int seek, bool count) {
+    const struct vad_frames * vad = p->vad;
+    const int n_frames = p->n_frames;
+    while (seek + PIPELINE_MIN_TAIL < n_frames) {
+        if (!vad) {
+            return seek;
+        }
+        if (p->params.skip_silence) {
+            const int next = vad_next_speech(vad, seek);
+            const int start = next < 0 ? n_frames : next - p->params.onset_pad;
+            if (start > seek) {
+                p->stats.skipped_s += count ? (start - seek)/100.0f : 0.0f;
+                seek = start;
+                continue;
+            }
+        }
+        if (vad_speech_ratio(vad, seek, seek + PIPELINE_WINDOW) < p->params.min_speech_ratio) {
+            const int end = seek + PIPELINE_WINDOW < n_frames ? seek + PIPELINE_WINDOW : n_frames;
+            if (count) {
+                p->stats.skipped_s += (end - seek)/100.0f;
+                p->stats.n_windows_skipped++;
+            }
+            seek = end;
+            continue;
+        }
+        return seek;
+    }
+    return n_frames;
+}
+
+// Where the decoder will probably stop in the window at seek: the last pause
+// in its second half, or its end.
+static int pipeline_predict_end(const struct pipeline * p, int seek) {
+    const int end = seek + PIPELINE_WINDOW < p->n_frames ? seek + PIPELINE_WINDOW : p->n_frames;
+    const struct vad_frames * vad = p->vad;
+    if (!vad || end >= p->n_frames) {
+        return end;
+    }
+    for (int f = end; f > seek + PIPELINE_MIN_STEP; f--) {
+        if (f - 1 < vad->n && !vad->speech[f - 1]) {
+            return f;
+        }
+    }
+    return end;
+}
+
+// A window encoded at predicted can stand in for the one at actual when the
+// frames between the two hold no speech.
+static bool pipeline_same_window(const struct pipeline * p, int predicted, int actual) {
+    if (predicted == actual) {
+        return true;
+    }
+    const int i0 = predicted < actual ? predicted : actual;
+    const int i1 = predicted < actual ? actual : predicted;
+    return p->vad && i1 - i0 < PIPELINE_MIN_STEP && vad_speech_ratio(p->vad, i0, i1) == 0.0f;
+}
+
+static int pipeline_append(struct pipeline * p, const char * piece) {
+    const size_t n = strlen(piece);
+    if (p->text_len + n + 1 > p->cap_text) {
+        const size_t cap = p->cap_text*2 > p->text_len + n + 1 ? p->cap_text*2 : p->text_len + n + 256;
+        char * text = realloc(p->text, cap);
+        if (!text) {
+            return -1;
+        }
+        p->text = text;
+        p->cap_text = cap;
+    }
+    memcpy(p->text + p->text_len, piece, n);
+    p->text_len += n;
+    return 0;
+}
+
+static int pipeline_emit(struct pipeline * p, int seek, int ts0, int ts1, pipeline_segment_callback cb, void * user_data) {
+    if (p->text_len == 0) {
+        return 0;
+    }
+    p->text[p->text_len] = '\0';
+    p->text_len = 0;
+    const struct pipeline_segment seg = {
+            .t0 = seek + 2*ts0,
+            .t1 = seek + 2*ts1,
+            .text = p->text,
+            .window = p->stats.n_windows,
+    };
+    return cb ? cb(&seg, user_data) : 0;
+}
+
+// whisper's timestamp rules on the logits of the next token, then argmax.
+// seq holds the tokens sampled so far in this window.
+static whisper_token pipeline_sample(const struct pipeline * p, float * logits, const whisper_token * seq, int n, int max_ts) {
+    const whisper_token eot = p->eot;
+    const whisper_token beg = p->beg;
+    const int n_vocab = p->n_vocab;
+
+    // special tokens and timestamps past the audio are never sampled
+    for (whisper_token t = eot + 1; t < beg; t++) {
+        logits[t] = -INFINITY;
+    }
+    for (whisper_token t = beg + max_ts + 1; t < n_vocab; t++) {
+        logits[t] = -INFINITY;
+    }
+
+    const bool last_ts = n > 0 && seq[n - 1] >= beg;
+    const bool penult_ts = n < 2 || seq[n - 2] >= beg;
+    if (n == 0) {
+        // the window opens with a timestamp within its first second
+        for (whisper_token t = 0; t < beg; t++) {
+            logits[t] = -INFINITY;
+        }
+        for (whisper_token t = beg + PIPELINE_INITIAL_TS + 1; t < n_vocab; t++) {
+            logits[t] = -INFINITY;
+        }
+    } else if (last_ts && penult_ts) {
+        // a segment just opened: text follows
+        for (whisper_token t = beg; t < n_vocab; t++) {
+            logits[t] = -INFINITY;
+        }
+    } else if (last_ts) {
+        // a segment just closed: the next one opens or the window ends
+        for (whisper_token t = 0; t < eot; t++) {
+            logits[t] = -INFINITY;
+        }
+    }
+
+    // timestamps never go back
+    for (int i = n - 1; i >= 0; i--) {
+        if (seq[i] >= beg) {
+            for (whisper_token t = beg; t < seq[i]; t++) {
+                logits[t] = -INFINITY;
+            }
+            break;
+        }
+    }
+
+    // a timestamp when all of them together are likelier than any other token
+    float max_ts_logit = -INFINITY;
+    for (whisper_token t = beg; t < n_vocab; t++) {
+        max_ts_logit = logits[t] > max_ts_logit ? logits[t] : max_ts_logit;
+    }
+    if (max_ts_logit > -INFINITY) {
+        double sum = 0.0;
+        for (whisper_token t = beg; t < n_vocab; t++) {
+            sum += exp(logits[t] - max_ts_logit);
+        }
+        const float ts_logit = max_ts_logit + (float) log(sum);
+        float max_text = -INFINITY;
+        for (whisper_token t = 0; t < beg; t++) {
+            max_text = logits[t] > max_text ? logits[t] : max_text;
+        }
+        if (ts_logit > max_text) {
+            for (whisper_token t = 0; t < beg; t++) {
+                logits[t] = -INFINITY;
+            }
+        }
+    }
+
+    whisper_token best = 0;
+    for (whisper_token t = 1; t < n_vocab; t++) {
+        if (logits[t] > logits[best]) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// Decodes the window encoded in s. Returns the frames it consumed, -1 on
+// error, -2 when the callback stopped the run.
+static int pipeline_decode(struct pipeline * p, struct pipeline_slot * s, int lang_id, int n_threads, pipeline_segment_callback cb, void * user_data) {
+    struct whisper_context * ctx = p->ctx;
+    const int seek = s->seek;
+    const int n_window = p->n_frames - seek < PIPELINE_WINDOW ? p->n_frames - seek : PIPELINE_WINDOW;
+    const int max_ts = n_window/2;
+
+    int n_prompt = 0;
+    p->tokens[n_prompt++] = whisper_token_sot(ctx);
+    if (whisper_is_multilingual(ctx)) {
+        p->tokens[n_prompt++] = whisper_token_lang(ctx, lang_id);
+        p->tokens[n_prompt++] = p->params.translate ? whisper_token_translate(ctx) : whisper_token_transcribe(ctx);
+    }
+    const int max_tokens = n_prompt + whisper_n_text_ctx(ctx)/2;
+
+    const whisper_token * seq = p->tokens + n_prompt;
+    int n_tokens = n_prompt;
+    int n_past = 0;
+    int ts_open = -1;
+    int ts_last = -1;
+    p->text_len = 0;
+
+    while (n_tokens < max_tokens) {
+        const int n_new = n_tokens - n_past;
+        if (whisper_decode_with_state(ctx, s->state, p->tokens + n_past, n_new, n_past, n_threads) != 0) {
+            return -1;
+        }
+        n_past = n_tokens;
+
+        float * logits = whisper_get_logits_from_state(s->state) + (size_t) (n_new - 1)*p->n_vocab;
+        const whisper_token token = pipeline_sample(p, logits, seq, n_tokens - n_prompt, max_ts);
+        if (token == p->eot) {
+            break;
+        }
+        p->tokens[n_tokens++] = token;
+
+        if (token >= p->beg) {
+            const int ts = token - p->beg;
+            if (ts_open >= 0 && p->text_len > 0) {
+                if (pipeline_emit(p, seek, ts_open, ts, cb, user_data) != 0) {
+                    return -2;
+                }
+                ts_open = -1;
+            } else {
+                ts_open = ts;
+            }
+            ts_last = ts;
+        } else if (pipeline_append(p, whisper_token_to_str(ctx, token)) != 0) {
+            return -1;
+        }
+    }
+
+    // as whisper: resume after the last timestamp, text after it is decoded
+    // again with the next window; a window without one, or the last window,
+    // is consumed whole
+    if (ts_last > 0 && seek + n_window < p->n_frames) {
+        return 2*ts_last;
+    }
+    if (pipeline_emit(p, seek, ts_open >= 0 ? ts_open : 0, max_ts, cb, user_data) != 0) {
+        return -2;
+    }
+    return n_window;
+}
+
+// Spectrogram value of silence: whisper pads with zeros, which normalize to
+// the smallest value of the clip.
+static float pipeline_pad_value(const struct mel_spectrogram * mel) {
+    const size_t n = (size_t) mel->n_mel*mel->n_len;
+    float v = n > 0 ? mel->data[0] : 0.0f;
+    for (size_t i = 1; i < n; i++) {
+        v = mel->data[i] < v ? mel->data[i] : v;
+    }
+    return v;
+}
+
+int pipeline_run(struct pipeline * p, struct pipeline_params params, const struct mel_spectrogram * mel,
+        const struct vad_frames * vad, int n_frames, pipeline_segment_callback cb, void * user_data) {
+    memset(&p->stats, 0, sizeof(p->stats));
+    if (!mel || mel->n_len <= 0) {
+        return -1;
+    }
+
+    int lang_id = -1;
+    if (params.language && strcmp(params.language, "auto") != 0) {
+        lang_id = whisper_lang_id(params.language);
+        if (lang_id < 0) {
+            return -1;
+        }
+    }
+    params.language = NULL;
+    params.n_threads = params.n_threads > 0 ? params.n_threads : 1;
+
+    if (p->n_mel != mel->n_mel) {
+        for (int i = 0; i < 2; i++) {
+            free(p->slots[i].mel);
+            p->slots[i].mel = malloc(sizeof(float) * mel->n_mel * PIPELINE_WINDOW);
+            if (!p->slots[i].mel) {
+                p->n_mel = 0;
+                return -1;
+            }
+        }
+        p->n_mel = mel->n_mel;
+    }
+
+    p->params = params;
+    p->mel = mel;
+    p->vad = vad;
+    p->n_frames = n_frames < mel->n_len ? n_frames : mel->n_len;
+    p->pad_value = pipeline_pad_value(mel);
+
+    // the decoder gets the larger share while the encoder runs ahead
+    const int n_threads = params.n_threads;
+    const int n_threads_ahead = n_threads/2 > 0 ? n_threads/2 : 1;
+    const int n_threads_decode = n_threads - n_threads/2;
+
+    int cur = 0;
+    int seek = pipeline_next_window(p, 0, true);
+    int rc = 0;
+    if (seek < p->n_frames) {
+        struct pipeline_slot * s = &p->slots[cur];
+        s->seek = seek;
+        s->n_threads = n_threads;
+        pipeline_encode(s);
+        p->stats.encode_ms += s->encode_ms;
+        rc = s->rc;
+    }
+
+    while (rc == 0 && seek < p->n_frames) {
+        struct pipeline_slot * s = &p->slots[cur];
+        struct pipeline_slot * ahead = &p->slots[1 - cur];
+
+        if (lang_id < 0) {
+            lang_id = whisper_lang_auto_detect_with_state(p->ctx, s->state, 0, n_threads, NULL);
+            if (lang_id < 0) {
+                rc = -1;
+                break;
+            }
+        }
+
+        const int predicted = pipeline_next_window(p, pipeline_predict_end(p, seek), false);
+        bool speculate = predicted > seek && predicted < p->n_frames;
+        if (speculate) {
+            ahead->seek = predicted;
+            ahead->n_threads = n_threads_ahead;
+            speculate = pthread_create(&ahead->thread, NULL, pipeline_encode, ahead) == 0;
+            p->stats.n_speculated += speculate;
+        }
+
+        const int64_t t0_us = time_us();
+        const int consumed = pipeline_decode(p, s, lang_id, speculate ? n_threads_decode : n_threads, cb, user_data);
+        const int64_t t1_us = time_us();
+        p->stats.decode_ms += (t1_us - t0_us)/1000.0f;
+
+        if (speculate) {
+            pthread_join(ahead->thread, NULL);
+            const float wait_ms = (time_us() - t1_us)/1000.0f;
+            p->stats.wait_ms += wait_ms;
+            p->stats.encode_ms += ahead->encode_ms;
+            p->stats.encode_hidden_ms += ahead->encode_ms > wait_ms ? ahead->encode_ms - wait_ms : 0.0f;
+        }
+        if (consumed < 0) {
+            rc = consumed == -2 ? 0 : -1;
+            break;
+        }
+        p->stats.n_windows++;
+
+        const int next = pipeline_next_window(p, seek + consumed, true);
+        if (next >= p->n_frames) {
+            break;
+        }
+        if (speculate && ahead->rc == 0 && pipeline_same_window(p, predicted, next)) {
+            p->stats.n_hits++;
+            cur = 1 - cur;
+            seek = predicted;
+        } else {
+            s->seek = next;
+            s->n_threads = n_threads;
+            pipeline_encode(s);
+            p->stats.encode_ms += s->encode_ms;
+            rc = s->rc;
+            seek = next;
+        }
+    }
+
+    p->mel = NULL;
+    p->vad = NULL;
+    return rc;
+}
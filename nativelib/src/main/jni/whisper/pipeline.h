@@ -0,0 +1,76 @@
+#ifndef WHISPER_JNI_PIPELINE_H
+#define WHISPER_JNI_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mel_spectrogram;
+struct vad_frames;
+
+// Long-audio decoding with the encoder running ahead of the decoder. whisper
+// only knows where the next 30 s window starts once the current one is
+// decoded (its last timestamp), so encoder and decoder alternate. Here the
+// next window is predicted from the VAD (the decoder usually stops at the
+// last pause before the window's end) and encoded on spare cores, in a
+// second whisper state, while the current window decodes. When the decoder
+// stops elsewhere the prediction is still used if only silence lies between
+// the two positions; otherwise it is discarded and the right window encoded.
+//
+// Decoding is greedy with whisper's timestamp rules; there is no temperature
+// fallback and no previous-text prompt. The prompt carries the translate task
+// token when translate is set, as whisper_full does.
+struct pipeline_params {
+    const char * language;   // NULL or "auto": detected on the first window
+    bool  translate;         // decode to English, as whisper_full_params.translate
+    int   n_threads;         // split between decoder and speculative encoder
+    bool  skip_silence;      // start windows at the next VAD speech frame
+    float min_speech_ratio;  // windows with less VAD speech are not decoded
+    int   onset_pad;         // frames kept before a speech onset
+};
+
+struct pipeline_segment {
+    int64_t t0;          // centiseconds
+    int64_t t1;
+    const char * text;   // valid during the callback
+    int window;
+};
+
+// Returns 0 to continue, anything else stops the run.
+typedef int (*pipeline_segment_callback)(const struct pipeline_segment * seg, void * user_data);
+
+struct pipeline_stats {
+    int   n_windows;          // windows decoded
+    int   n_windows_skipped;  // windows skipped as non-speech
+    int   n_speculated;       // windows encoded ahead
+    int   n_hits;             // of those, used by the decoder
+    float skipped_s;
+    float encode_ms;          // all encoder runs
+    float encode_hidden_ms;   // encoder time that overlapped decoding
+    float decode_ms;
+    float wait_ms;            // decoder finished first and waited for the encoder
+};
+
+struct pipeline;
+
+// ctx is borrowed; two extra whisper states are allocated. NULL on failure.
+struct pipeline * pipeline_init(struct whisper_context * ctx);
+void pipeline_free(struct pipeline * p);
+
+// Decodes frames [0, n_frames) of mel; vad must describe the same frames.
+// Returns 0 on success.
+int pipeline_run(struct pipeline * p, struct pipeline_params params, const struct mel_spectrogram * mel,
+        const struct vad_frames * vad, int n_frames, pipeline_segment_callback cb, void * user_data);
+
+const struct pipeline_stats * pipeline_get_stats(const struct pipeline * p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_PIPELINE_H
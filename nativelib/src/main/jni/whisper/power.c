@@ -0,0 +1,369 @@
+// sched_setaffinity and the CPU_SET macros
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "power.h"
+#include "ggml.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POWER_MAX_DOMAINS    8
+#define POWER_PATH_MAX       128
+// battery sampling period; the fuel gauge updates every 100-250 ms on most devices
+#define POWER_BATTERY_PERIOD_US 50000
+
+struct power_meter {
+    enum power_source source;
+
+    // rapl: energy_uj per package and its wrap-around range; rails: energy_value files
+    char paths[POWER_MAX_DOMAINS][POWER_PATH_MAX];
+    double range_uj[POWER_MAX_DOMAINS];
+    int n_paths;
+    double start_uj[POWER_MAX_DOMAINS];
+
+    // battery
+    char current_path[POWER_PATH_MAX];
+    char voltage_path[POWER_PATH_MAX];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    double battery_j;
+};
+
+static bool power_read_double(const char * path, double * out) {
+    FILE * f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    const bool ok = fscanf(f, "%lf", out) == 1;
+    fclose(f);
+    return ok;
+}
+
+static double power_read_rapl(const struct power_meter * m, int i) {
+    double uj = 0.0;
+    return power_read_double(m->paths[i], &uj) ? uj : -1.0;
+}
+
+// Sum of the rail energies of an ODPM energy_value file, in microjoules:
+//   t=<ms>
+//   CH0(T=<ms>)[S2M_VDD_CPUCL2], <uWs>
+static double power_read_rails(const struct power_meter * m, int i) {
+    FILE * f = fopen(m->paths[i], "r");
+    if (!f) {
+        return -1.0;
+    }
+    char line[256];
+    double sum = 0.0;
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        const char * comma = strrchr(line, ',');
+        if (strncmp(line, "CH", 2) == 0 && comma) {
+            sum += atof(comma + 1);
+            n++;
+        }
+    }
+    fclose(f);
+    return n > 0 ? sum : -1.0;
+}
+
+static bool power_find_rapl(struct power_meter * m) {
+    // top-level packages only: intel-rapl:0, not the intel-rapl:0:0 subzones
+    for (int i = 0; i < POWER_MAX_DOMAINS && m->n_paths < POWER_MAX_DOMAINS; i++) {
+        char path[POWER_PATH_MAX];
+        snprintf(path, sizeof(path), "/sys/class/powercap/intel-rapl:%d/max_energy_range_uj", i);
+        double range = 0.0;
+        if (!power_read_double(path, &range)) {
+            break;
+        }
+        snprintf(m->paths[m->n_paths], POWER_PATH_MAX, "/sys/class/powercap/intel-rapl:%d/energy_uj", i);
+        m->range_uj[m->n_paths] = range;
+        if (power_read_rapl(m, m->n_paths) >= 0.0) {
+            m->n_paths++;
+        }
+    }
+    return m->n_paths > 0;
+}
+
+static bool power_find_rails(struct power_meter * m) {
+    DIR * dir = opendir("/sys/bus/iio/devices");
+    if (!dir) {
+        return false;
+    }
+    struct dirent * e;
+    while ((e = readdir(dir)) != NULL && m->n_paths < POWER_MAX_DOMAINS) {
+        if (strncmp(e->d_name, "iio:device", 10) != 0) {
+            continue;
+        }
+        snprintf(m->paths[m->n_paths], POWER_PATH_MAX, "/sys/bus/iio/devices/%.40s/energy_value", e->d_name);
+        if (power_read_rails(m, m->n_paths) >= 0.0) {
+            m->n_paths++;
+        }
+    }
+    closedir(dir);
+    return m->n_paths > 0;
+}
+
+static bool power_find_battery(struct power_meter * m) {
+    static const char * const dirs[] = { "/sys/class/power_supply/battery", "/sys/class/power_supply/BAT0", "/sys/class/power_supply/BAT1" };
+    for (size_t i = 0; i < sizeof(dirs)/sizeof(dirs[0]); i++) {
+        double v = 0.0;
+        snprintf(m->current_path, POWER_PATH_MAX, "%s/current_now", dirs[i]);
+        snprintf(m->voltage_path, POWER_PATH_MAX, "%s/voltage_now", dirs[i]);
+        if (power_read_double(m->current_path, &v) && power_read_double(m->voltage_path, &v)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct power_meter * power_meter_open(void) {
+    struct power_meter * m = calloc(1, sizeof(struct power_meter));
+    if (!m) {
+        return NULL;
+    }
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->cond, NULL);
+    if (power_find_rapl(m)) {
+        m->source = POWER_SOURCE_RAPL;
+    } else if (power_find_rails(m)) {
+        m->source = POWER_SOURCE_RAILS;
+    } else if (power_find_battery(m)) {
+        m->source = POWER_SOURCE_BATTERY;
+    }
+    return m;
+}
+
+void power_meter_close(struct power_meter * m) {
+    if (!m) {
+        return;
+    }
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->cond);
+    free(m);
+}
+
+enum power_source power_meter_source(const struct power_meter * m) {
+    return m->source;
+}
+
+const char * power_source_str(enum power_source source) {
+    switch (source) {
+        case POWER_SOURCE_RAPL:    return "rapl";
+        case POWER_SOURCE_RAILS:   return "rails";
+        case POWER_SOURCE_BATTERY: return "battery";
+        default:                   return "none";
+    }
+}
+
+// battery power in watts; current and voltage are in uA and uV, the sign of
+// the current differs between fuel gauges
+static double power_battery_w(const struct power_meter * m) {
+    double ua = 0.0;
+    double uv = 0.0;
+    if (!power_read_double(m->current_path, &ua) || !power_read_double(m->voltage_path, &uv)) {
+        return -1.0;
+    }
+    return fabs(ua)*1e-6*uv*1e-6;
+}
+
+static void * power_battery_thread(void * arg) {
+    struct power_meter * m = arg;
+    int64_t t_prev = ggml_time_us();
+    double w_prev = power_battery_w(m);
+    pthread_mutex_lock(&m->lock);
+    while (m->running) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += POWER_BATTERY_PERIOD_US*1000L;
+        until.tv_sec += until.tv_nsec/1000000000L;
+        until.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&m->cond, &m->lock, &until);
+
+        // trapezoids between samples; the last one ends at stop
+        const int64_t t = ggml_time_us();
+        const double w = power_battery_w(m);
+        if (w >= 0.0 && w_prev >= 0.0) {
+            m->battery_j += 0.5*(w + w_prev)*(t - t_prev)/1e6;
+        }
+        t_prev = t;
+        w_prev = w;
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+void power_meter_start(struct power_meter * m) {
+    switch (m->source) {
+        case POWER_SOURCE_RAPL:
+        case POWER_SOURCE_RAILS:
+            for (int i = 0; i < m->n_paths; i++) {
+                m->start_uj[i] = m->source == POWER_SOURCE_RAPL ? power_read_rapl(m, i) : power_read_rails(m, i);
+            }
+            break;
+        case POWER_SOURCE_BATTERY:
+            m->battery_j = 0.0;
+            m->running = true;
+            if (pthread_create(&m->thread, NULL, power_battery_thread, m) != 0) {
+                m->running = false;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+double power_meter_stop(struct power_meter * m) {
+    double j = -1.0;
+    switch (m->source) {
+        case POWER_SOURCE_RAPL:
+        case POWER_SOURCE_RAILS:
+            j = 0.0;
+            for (int i = 0; i < m->n_paths && j >= 0.0; i++) {
+                const double now = m->source == POWER_SOURCE_RAPL ? power_read_rapl(m, i) : power_read_rails(m, i);
+                double d = now - m->start_uj[i];
+                if (d < 0.0 && m->range_uj[i] > 0.0) {
+                    d += m->range_uj[i];   // the counter wrapped
+                }
+                j = now >= 0.0 && m->start_uj[i] >= 0.0 && d >= 0.0 ? j + d/1e6 : -1.0;
+            }
+            break;
+        case POWER_SOURCE_BATTERY:
+            if (m->running) {
+                pthread_mutex_lock(&m->lock);
+                m->running = false;
+                pthread_cond_signal(&m->cond);
+                pthread_mutex_unlock(&m->lock);
+                pthread_join(m->thread, NULL);
+                j = m->battery_j;
+            }
+            break;
+        default:
+            break;
+    }
+    return j;
+}
+
+int power_cpu_clusters(uint64_t * masks, int max_clusters) {
+    const long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    long freq[64];
+    int n = 0;
+    for (int cpu = 0; cpu < n_cpus && cpu < 64; cpu++) {
+        char path[POWER_PATH_MAX];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        double f = 0.0;
+        freq[cpu] = power_read_double(path, &f) ? (long) f : 0;
+        n = cpu + 1;
+    }
+    int n_clusters = 0;
+    long prev = -1;
+    while (n_clusters < max_clusters) {
+        // next larger frequency
+        long next = -1;
+        for (int cpu = 0; cpu < n; cpu++) {
+            if (freq[cpu] > prev && (next < 0 || freq[cpu] < next)) {
+                next = freq[cpu];
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        masks[n_clusters] = 0;
+        for (int cpu = 0; cpu < n; cpu++) {
+            if (freq[cpu] == next) {
+                masks[n_clusters] |= 1ULL << cpu;
+            }
+        }
+        n_clusters++;
+        prev = next;
+    }
+    return n_clusters;
+}
+
+int power_set_affinity(uint64_t mask, uint64_t * previous) {
+    cpu_set_t set;
+    if (previous) {
+        *previous = 0;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < 64; cpu++) {
+                *previous |= CPU_ISSET(cpu, &set) ? 1ULL << cpu : 0;
+            }
+        }
+    }
+    CPU_ZERO(&set);
+    const long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu = 0; cpu < n_cpus && cpu < CPU_SETSIZE; cpu++) {
+        if (mask == 0 || (cpu < 64 && (mask >> cpu) & 1)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static double power_cpu_time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int power_measure(struct transcriber * tr, struct power_meter * m, struct whisper_full_params params,
+        const float * samples, int n_samples, struct power_config config, struct power_measurement * out) {
+    // started first, so that the battery sampler is not held to the config's CPUs
+    power_meter_start(m);
+    // a 0 mask is set too, so a measurement does not inherit the mask an
+    // earlier config or the caller left on the thread
+    uint64_t previous = 0;
+    if (power_set_affinity(config.cpu_mask, &previous) != 0) {
+        power_meter_stop(m);
+        return -1;
+    }
+    params.n_threads = config.n_threads;
+
+    const double cpu0 = power_cpu_time_s();
+    const int64_t t0 = ggml_time_us();
+    const int rc = transcriber_run_pcm(tr, params, samples, n_samples);
+    out->joules = power_meter_stop(m);
+    out->latency_ms = (ggml_time_us() - t0)/1000.0f;
+    out->cpu_s = power_cpu_time_s() - cpu0;
+    out->audio_s = n_samples/16000.0f;
+
+    power_set_affinity(previous, NULL);
+    return rc;
+}
+
+int power_pick(const struct power_measurement * m, int n, float max_rtf) {
+    // joules when every candidate has them, CPU time otherwise
+    bool joules = true;
+    for (int i = 0; i < n; i++) {
+        joules = joules && m[i].joules >= 0.0;
+    }
+    int best = -1;
+    int fastest = -1;
+    double best_cost = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (fastest < 0 || m[i].latency_ms < m[fastest].latency_ms) {
+            fastest = i;
+        }
+        if (m[i].audio_s <= 0.0f || m[i].latency_ms > max_rtf*1000.0f*m[i].audio_s) {
+            continue;
+        }
+        const double cost = (joules ? m[i].joules : m[i].cpu_s)/m[i].audio_s;
+        if (best < 0 || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    return best >= 0 ? best : fastest;
+}
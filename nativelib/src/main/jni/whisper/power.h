@@ -0,0 +1,81 @@
+#ifndef WHISPER_JNI_POWER_H
+#define WHISPER_JNI_POWER_H
+
+#include <stdint.h>
+
+#include "transcribe.h"
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Energy per transcription and the configurations that minimize it.
+//
+// The meter reads the best source the device exposes:
+//   rapl     Linux hosts: package energy counters of /sys/class/powercap
+//            (root-readable on current kernels)
+//   rails    Android devices with on-device power monitors (Pixel ODPM,
+//            /sys/bus/iio/devices/iio:device*/energy_value), all rails summed
+//   battery  current_now x voltage_now of the battery, integrated on a
+//            sampling thread; the whole device, and meaningless while charging
+// Without any, joules read -1 and callers fall back to CPU time.
+enum power_source {
+    POWER_SOURCE_NONE,
+    POWER_SOURCE_RAPL,
+    POWER_SOURCE_RAILS,
+    POWER_SOURCE_BATTERY,
+};
+
+struct power_meter;
+
+// Never NULL unless out of memory; the source may be POWER_SOURCE_NONE.
+struct power_meter * power_meter_open(void);
+void power_meter_close(struct power_meter * m);
+
+enum power_source power_meter_source(const struct power_meter * m);
+const char * power_source_str(enum power_source source);
+
+// Energy between start and stop in joules, -1 without a source. One
+// measurement at a time per meter.
+void   power_meter_start(struct power_meter * m);
+double power_meter_stop(struct power_meter * m);
+
+// CPUs grouped by their maximum frequency, slowest cluster first, as masks of
+// CPU numbers below 64. Returns the number of clusters (1 when cpufreq is
+// missing: all online CPUs).
+int power_cpu_clusters(uint64_t * masks, int max_clusters);
+
+// Restricts the calling thread, and the threads it creates afterwards (ggml's
+// compute threads, the mel workers), to the CPUs of mask; 0 allows all CPUs.
+// *previous, if not NULL, receives the mask to restore. Returns 0 on success.
+int power_set_affinity(uint64_t mask, uint64_t * previous);
+
+// One candidate configuration of the power-efficient mode.
+struct power_config {
+    int n_threads;
+    uint64_t cpu_mask;   // 0 = any CPU
+};
+
+struct power_measurement {
+    float  latency_ms;
+    float  audio_s;
+    double joules;       // -1 without a meter source
+    double cpu_s;        // CPU time of the process during the call
+};
+
+// Transcribes samples under config, restoring the thread's affinity after.
+// Returns 0 on success.
+int power_measure(struct transcriber * tr, struct power_meter * m, struct whisper_full_params params,
+        const float * samples, int n_samples, struct power_config config, struct power_measurement * out);
+
+// Index of the measurement with the least energy per audio second (CPU time
+// when joules are unavailable) among those within max_rtf (latency / audio
+// duration); the fastest when none is. -1 when n is 0.
+int power_pick(const struct power_measurement * m, int n, float max_rtf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_POWER_H
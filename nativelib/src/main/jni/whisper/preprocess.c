@@ -0,0 +1,281 @@
+#include "preprocess.h"
+#include "fft.h"
+#include "vec.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PREPROCESS_SAMPLE_RATE 16000
+#define PREPROCESS_N_BINS      (PREPROCESS_FRAME/2 + 1)
+
+// frames used to seed the noise estimate (~160 ms)
+#define PREPROCESS_NOISE_INIT  10
+
+struct preprocessor {
+    struct preprocess_params params;
+
+    // high-pass biquad, transposed direct form II
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+
+    // block I/O: samples of the current hop in, processed samples of the previous hop out
+    float hop_in[PREPROCESS_HOP];
+    float hop_out[PREPROCESS_HOP];
+    int hop_pos;
+
+    // noise gate STFT state
+    struct fft_plan * fft;
+    float window[PREPROCESS_FRAME];  // sqrt-Hann, used for analysis and synthesis
+    float frame[PREPROCESS_FRAME];   // last two hops of input
+    float ola[PREPROCESS_FRAME];     // overlap-add accumulator
+    float noise[PREPROCESS_N_BINS];
+    float smooth[PREPROCESS_N_BINS];
+    float gain[PREPROCESS_N_BINS];
+    int n_frames;
+
+    float spectrum[2*PREPROCESS_FRAME];
+    float power[PREPROCESS_N_BINS];
+    float synth[PREPROCESS_FRAME];
+    float work[4*PREPROCESS_FRAME];
+    float * scratch;
+
+    // AGC
+    float agc_level;
+    float agc_gain;
+};
+
+struct preprocess_params preprocess_default_params(void) {
+    struct preprocess_params params = {
+            .high_pass        = true,
+            .high_pass_hz     = 80.0f,
+            .denoise          = true,
+            .denoise_strength = 1.5f,
+            .denoise_floor    = 0.1f,
+            .agc              = true,
+            .agc_target_dbfs  = -20.0f,
+            .agc_max_gain_db  = 30.0f,
+    };
+    return params;
+}
+
+struct preprocessor * preprocess_init(struct preprocess_params params) {
+    struct preprocessor * pp = calloc(1, sizeof(struct preprocessor));
+    if (!pp) {
+        return NULL;
+    }
+    pp->params = params;
+
+    pp->fft = fft_plan_init(PREPROCESS_FRAME);
+    pp->scratch = pp->fft ? malloc(sizeof(float) * fft_plan_scratch_size(pp->fft)) : NULL;
+    if (!pp->scratch) {
+        preprocess_free(pp);
+        return NULL;
+    }
+
+    // RBJ cookbook high-pass, Q = 1/sqrt(2)
+    const double w0 = 2.0*M_PI*params.high_pass_hz/PREPROCESS_SAMPLE_RATE;
+    const double alpha = sin(w0)/(2.0*M_SQRT1_2);
+    const double a0 = 1.0 + alpha;
+    pp->b0 = (float) ((1.0 + cos(w0))/2.0/a0);
+    pp->b1 = (float) (-(1.0 + cos(w0))/a0);
+    pp->b2 = pp->b0;
+    pp->a1 = (float) (-2.0*cos(w0)/a0);
+    pp->a2 = (float) ((1.0 - alpha)/a0);
+
+    // periodic sqrt-Hann: analysis * synthesis windows overlap-add to 1 at 50% overlap
+    for (int i = 0; i < PREPROCESS_FRAME; i++) {
+        pp->window[i] = (float) sqrt(0.5*(1.0 - cos(2.0*M_PI*i/PREPROCESS_FRAME)));
+    }
+
+    preprocess_reset(pp);
+    return pp;
+}
+
+void preprocess_free(struct preprocessor * pp) {
+    if (!pp) {
+        return;
+    }
+    fft_plan_free(pp->fft);
+    free(pp->scratch);
+    free(pp);
+}
+
+void preprocess_reset(struct preprocessor * pp) {
+    pp->z1 = 0.0f;
+    pp->z2 = 0.0f;
+    pp->hop_pos = 0;
+    memset(pp->hop_out, 0, sizeof(pp->hop_out));
+    memset(pp->frame, 0, sizeof(pp->frame));
+    memset(pp->ola, 0, sizeof(pp->ola));
+    memset(pp->noise, 0, sizeof(pp->noise));
+    memset(pp->smooth, 0, sizeof(pp->smooth));
+    for (int k = 0; k < PREPROCESS_N_BINS; k++) {
+        pp->gain[k] = 1.0f;
+    }
+    pp->n_frames = 0;
+    pp->agc_level = 0.0f;
+    pp->agc_gain = 1.0f;
+}
+
+int preprocess_latency(const struct preprocessor * pp) {
+    (void) pp;
+    return PREPROCESS_FRAME;
+}
+
+static void preprocess_high_pass(struct preprocessor * pp, float * x, int n) {
+    float z1 = pp->z1;
+    float z2 = pp->z2;
+    for (int i = 0; i < n; i++) {
+        const float in = x[i];
+        const float out = pp->b0*in + z1;
+        z1 = pp->b1*in - pp->a1*out + z2;
+        z2 = pp->b2*in - pp->a2*out;
+        x[i] = out;
+    }
+    pp->z1 = z1;
+    pp->z2 = z2;
+}
+
+// Spectral noise gate on the current analysis frame, overlap-added into pp->ola.
+static void preprocess_denoise(struct preprocessor * pp) {
+    const float strength = pp->params.denoise_strength;
+    const float floor2 = pp->params.denoise_floor*pp->params.denoise_floor;
+
+    vec_mul_f32(PREPROCESS_FRAME, pp->synth, pp->frame, pp->window);
+    fft_forward_real(pp->fft, pp->synth, pp->spectrum, pp->scratch);
+    vec_cplx_norm2_f32(PREPROCESS_N_BINS, pp->power, pp->spectrum);
+
+    // noise floor: seeded from the first frames, then a minimum tracker that
+    // follows drops quickly and may only rise by ~3 dB/s during speech
+    const float rise = 1.011f;
+    for (int k = 0; k < PREPROCESS_N_BINS; k++) {
+        const float p = pp->power[k];
+        if (pp->n_frames < PREPROCESS_NOISE_INIT) {
+            pp->smooth[k] = p;
+            pp->noise[k] = (pp->noise[k]*pp->n_frames + p)/(pp->n_frames + 1);
+            continue;
+        }
+        pp->smooth[k] = 0.7f*pp->smooth[k] + 0.3f*p;
+        if (pp->smooth[k] < pp->noise[k]) {
+            pp->noise[k] = 0.9f*pp->noise[k] + 0.1f*pp->smooth[k];
+        } else {
+            pp->noise[k] *= rise;
+        }
+    }
+    pp->n_frames++;
+
+    // power subtraction gain; opens immediately, closes smoothly against musical noise
+    for (int k = 0; k < PREPROCESS_N_BINS; k++) {
+        const float snr_inv = pp->noise[k]/(pp->power[k] + 1e-12f);
+        const float g = sqrtf(fmaxf(floor2, 1.0f - strength*snr_inv));
+        pp->gain[k] = g > pp->gain[k] ? g : 0.6f*pp->gain[k] + 0.4f*g;
+    }
+
+    vec_cplx_scale_f32(PREPROCESS_N_BINS, pp->spectrum, pp->gain);
+    fft_inverse_real(pp->fft, pp->spectrum, pp->synth, pp->work, pp->scratch);
+    vec_mad_f32(PREPROCESS_FRAME, pp->ola, pp->synth, pp->window);
+}
+
+static void preprocess_agc(struct preprocessor * pp, float * x, int n) {
+    const float target = powf(10.0f, pp->params.agc_target_dbfs/20.0f);
+    const float max_gain = powf(10.0f, pp->params.agc_max_gain_db/20.0f);
+    const float min_gain = 0.1f;
+
+    const float rms = sqrtf(vec_dot_f32(n, x, x)/n);
+
+    // only blocks above -60 dBFS move the level estimate, so pauses do not pump the gain up
+    if (rms > 1e-3f) {
+        pp->agc_level = rms > pp->agc_level ? 0.5f*pp->agc_level + 0.5f*rms : 0.98f*pp->agc_level + 0.02f*rms;
+    }
+
+    float desired = pp->agc_level > 0.0f ? target/pp->agc_level : 1.0f;
+    desired = fminf(fmaxf(desired, min_gain), max_gain);
+
+    const float g0 = pp->agc_gain;
+    const float g1 = g0 + 0.1f*(desired - g0);
+    pp->agc_gain = g1;
+
+    // ramp across the block, then a soft knee limiter above 0.9
+    for (int i = 0; i < n; i++) {
+        float y = x[i]*(g0 + (g1 - g0)*(i + 1)/n);
+        const float a = fabsf(y);
+        if (a > 0.9f) {
+            y = copysignf(0.9f + 0.1f*tanhf((a - 0.9f)/0.1f), y);
+        }
+        x[i] = y;
+    }
+}
+
+static void preprocess_hop(struct preprocessor * pp) {
+    const int hop = PREPROCESS_HOP;
+
+    if (pp->params.high_pass) {
+        preprocess_high_pass(pp, pp->hop_in, hop);
+    }
+
+    memmove(pp->frame, pp->frame + hop, sizeof(float) * (PREPROCESS_FRAME - hop));
+    memcpy(pp->frame + PREPROCESS_FRAME - hop, pp->hop_in, sizeof(float) * hop);
+
+    if (pp->params.denoise) {
+        preprocess_denoise(pp);
+        memcpy(pp->hop_out, pp->ola, sizeof(float) * hop);
+        memmove(pp->ola, pp->ola + hop, sizeof(float) * (PREPROCESS_FRAME - hop));
+        memset(pp->ola + PREPROCESS_FRAME - hop, 0, sizeof(float) * hop);
+    } else {
+        // keep the same latency as the gate so callers see one behavior
+        memcpy(pp->hop_out, pp->frame, sizeof(float) * hop);
+    }
+
+    if (pp->params.agc) {
+        preprocess_agc(pp, pp->hop_out, hop);
+    }
+}
+
+int preprocess_process(struct preprocessor * pp, const float * in, float * out, int n) {
+    for (int i = 0; i < n; ) {
+        const int m = n - i < PREPROCESS_HOP - pp->hop_pos ? n - i : PREPROCESS_HOP - pp->hop_pos;
+
+        // read the input before writing, in and out may alias
+        memcpy(pp->hop_in + pp->hop_pos, in + i, sizeof(float) * m);
+        memcpy(out + i, pp->hop_out + pp->hop_pos, sizeof(float) * m);
+
+        pp->hop_pos += m;
+        i += m;
+
+        if (pp->hop_pos == PREPROCESS_HOP) {
+            preprocess_hop(pp);
+            pp->hop_pos = 0;
+        }
+    }
+    return 0;
+}
+
+int preprocess_clip(struct preprocessor * pp, float * samples, int n) {
+    const int latency = preprocess_latency(pp);
+    float tmp[1024];
+
+    // output i belongs to input i - latency, so write it back latency samples earlier;
+    // those positions have always been read already
+    for (int pos = 0; pos < n + latency; ) {
+        int m = (int) (sizeof(tmp)/sizeof(tmp[0]));
+        if (pos < n) {
+            m = n - pos < m ? n - pos : m;
+            memcpy(tmp, samples + pos, sizeof(float) * m);
+        } else {
+            m = n + latency - pos < m ? n + latency - pos : m;
+            memset(tmp, 0, sizeof(float) * m);
+        }
+
+        preprocess_process(pp, tmp, tmp, m);
+
+        for (int j = 0; j < m; j++) {
+            const int dst = pos + j - latency;
+            if (dst >= 0 && dst < n) {
+                samples[dst] = tmp[j];
+            }
+        }
+        pos += m;
+    }
+    return 0;
+}
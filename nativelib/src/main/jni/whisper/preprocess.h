@@ -0,0 +1,52 @@
+#ifndef WHISPER_JNI_PREPROCESS_H
+#define WHISPER_JNI_PREPROCESS_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Optional clean-up stage for raw microphone audio (16 kHz mono) before it is
+// transcribed: high-pass filter, spectral noise gate and automatic gain control.
+// Audio is processed in streaming blocks of PREPROCESS_HOP samples; the noise
+// gate's overlap-add delays the output by preprocess_latency() samples.
+#define PREPROCESS_FRAME 512
+#define PREPROCESS_HOP   256
+
+struct preprocess_params {
+    bool  high_pass;
+    float high_pass_hz;      // 2nd order Butterworth cut-off
+
+    bool  denoise;
+    float denoise_strength;  // noise over-subtraction factor
+    float denoise_floor;     // minimum gain per bin, limits musical noise
+
+    bool  agc;
+    float agc_target_dbfs;   // RMS level of speech after AGC
+    float agc_max_gain_db;
+};
+
+struct preprocess_params preprocess_default_params(void);
+
+struct preprocessor;
+
+struct preprocessor * preprocess_init(struct preprocess_params params);
+void preprocess_free(struct preprocessor * pp);
+
+void preprocess_reset(struct preprocessor * pp);
+
+int preprocess_latency(const struct preprocessor * pp);
+
+// Streaming: consumes n samples and writes n samples delayed by preprocess_latency().
+// in and out may alias. Returns 0 on success.
+int preprocess_process(struct preprocessor * pp, const float * in, float * out, int n);
+
+// Whole clip in place, with the latency compensated so timestamps are unchanged.
+int preprocess_clip(struct preprocessor * pp, float * samples, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_PREPROCESS_H
@@ -0,0 +1,173 @@
+#include "resample.h"
+#include "vec.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// sinc zero crossings on each side of the filter, at its cut-off
+#define RESAMPLE_ZERO_CROSSINGS 16
+
+// cut-off relative to the lower of the two Nyquist frequencies
+#define RESAMPLE_CUTOFF 0.95
+
+// odd ratios (e.g. 44056 Hz in) have many phases, which then share the
+// nearest of this many filter rows
+#define RESAMPLE_MAX_PHASES 1024
+
+struct resampler {
+    int L;           // output rate / gcd
+    int M;           // input rate / gcd
+    int n_phases;
+    int half;        // filter half-width in input samples
+    int n_taps;
+    float * table;   // [n_phases][n_taps]
+
+    float * buf;     // pending input
+    int n_buf;
+    int cap_buf;
+    int pos;         // buf index of the next output's integer position
+    int phase;       // its fraction, in 1/L
+
+    int64_t n_in;    // totals, to end the output where the input ends
+    int64_t n_out;
+};
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+struct resampler * resampler_init(int rate_in, int rate_out) {
+    if (rate_in <= 0 || rate_out <= 0) {
+        return NULL;
+    }
+    struct resampler * rs = calloc(1, sizeof(struct resampler));
+    if (!rs) {
+        return NULL;
+    }
+    const int g = gcd(rate_in, rate_out);
+    rs->L = rate_out/g;
+    rs->M = rate_in/g;
+    rs->n_phases = rs->L < RESAMPLE_MAX_PHASES ? rs->L : RESAMPLE_MAX_PHASES;
+
+    const double fc = RESAMPLE_CUTOFF*(rs->L < rs->M ? (double) rs->L/rs->M : 1.0);
+    rs->half = (int) ceil(RESAMPLE_ZERO_CROSSINGS/fc);
+    rs->n_taps = 2*rs->half;
+
+    rs->table = malloc(sizeof(float) * rs->n_phases * rs->n_taps);
+    rs->cap_buf = rs->n_taps + 4096;
+    rs->buf = calloc(rs->cap_buf, sizeof(float));
+    if (!rs->table || !rs->buf) {
+        resampler_free(rs);
+        return NULL;
+    }
+
+    // tap j of phase p weighs input pos - half + 1 + j for the output at pos + p/n_phases
+    for (int p = 0; p < rs->n_phases; p++) {
+        float * h = rs->table + (size_t) p*rs->n_taps;
+        double sum = 0.0;
+        for (int j = 0; j < rs->n_taps; j++) {
+            const double t = j - rs->half + 1 - (double) p/rs->n_phases;
+            const double x = M_PI*fc*t;
+            const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(x)/x;
+            const double window = fabs(t) < rs->half ? 0.5*(1.0 + cos(M_PI*t/rs->half)) : 0.0;
+            h[j] = (float) (sinc*window);
+            sum += h[j];
+        }
+        // unit gain at DC for every phase
+        for (int j = 0; j < rs->n_taps; j++) {
+            h[j] = (float) (h[j]/sum);
+        }
+    }
+
+    // zeros before the first sample, which is the first output's position
+    rs->pos = rs->half - 1;
+    rs->n_buf = rs->half - 1;
+    return rs;
+}
+
+void resampler_free(struct resampler * rs) {
+    if (!rs) {
+        return;
+    }
+    free(rs->table);
+    free(rs->buf);
+    free(rs);
+}
+
+int resampler_max_output(const struct resampler * rs, int n_in) {
+    const int64_t pending = (int64_t) rs->n_buf - rs->pos + n_in + rs->n_taps;
+    return (int) (pending*rs->L/rs->M + 2);
+}
+
+static int resampler_run(struct resampler * rs, const float * in, int n_in, float * out, int max_out) {
+    if (rs->n_buf + n_in > rs->cap_buf) {
+        const int cap = rs->n_buf + n_in > 2*rs->cap_buf ? rs->n_buf + n_in : 2*rs->cap_buf;
+        float * buf = realloc(rs->buf, sizeof(float) * cap);
+        if (!buf) {
+            return -1;
+        }
+        rs->buf = buf;
+        rs->cap_buf = cap;
+    }
+    if (in) {
+        memcpy(rs->buf + rs->n_buf, in, sizeof(float) * n_in);
+    } else {
+        memset(rs->buf + rs->n_buf, 0, sizeof(float) * n_in);
+    }
+    rs->n_buf += n_in;
+
+    int n_out = 0;
+    while (rs->pos + rs->half < rs->n_buf) {
+        if (n_out == max_out) {
+            return -1;
+        }
+        const float * x = rs->buf + rs->pos - rs->half + 1;
+        const float * h = rs->table + (size_t) ((int64_t) rs->phase*rs->n_phases/rs->L)*rs->n_taps;
+        out[n_out++] = vec_dot_f32(rs->n_taps, x, h);
+
+        rs->phase += rs->M;
+        rs->pos += rs->phase/rs->L;
+        rs->phase %= rs->L;
+    }
+
+    // keep what the next outputs still reach
+    const int shift = rs->pos - rs->half + 1;
+    if (shift > 0) {
+        memmove(rs->buf, rs->buf + shift, sizeof(float) * (rs->n_buf - shift));
+        rs->n_buf -= shift;
+        rs->pos -= shift;
+    }
+    return n_out;
+}
+
+int resampler_process(struct resampler * rs, const float * in, int n_in, float * out, int max_out) {
+    const int n = resampler_run(rs, in, n_in, out, max_out);
+    if (n >= 0) {
+        rs->n_in += n_in;
+        rs->n_out += n;
+    }
+    return n;
+}
+
+int resampler_flush(struct resampler * rs, float * out, int max_out) {
+    const int n = resampler_run(rs, NULL, rs->n_taps, out, max_out);
+    if (n < 0) {
+        return -1;
+    }
+    // outputs past the last input position are the zero padding
+    const int64_t expected = (rs->n_in*rs->L + rs->M - 1)/rs->M - rs->n_out;
+    const int n_tail = expected < n ? (int) (expected > 0 ? expected : 0) : n;
+    rs->n_out += n_tail;
+    return n_tail;
+}
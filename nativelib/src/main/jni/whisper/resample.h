@@ -0,0 +1,35 @@
+#ifndef WHISPER_JNI_RESAMPLE_H
+#define WHISPER_JNI_RESAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming sample rate conversion of mono audio with a windowed-sinc
+// polyphase filter. The ratio is kept exact as out/in reduced to L/M; the
+// filter is low-passed below the lower of the two Nyquist frequencies, so
+// downsampling (44.1/48 kHz to 16 kHz) does not alias. Output sample k is
+// input position k*M/L, there is no delay to compensate.
+struct resampler;
+
+// NULL for non-positive rates or on allocation failure.
+struct resampler * resampler_init(int rate_in, int rate_out);
+void resampler_free(struct resampler * rs);
+
+// Upper bound of the samples resampler_process can write for n_in new
+// samples (and resampler_flush for n_in = 0).
+int resampler_max_output(const struct resampler * rs, int n_in);
+
+// Consumes n_in samples and writes the output they complete. Input near the
+// end is held back until the filter sees enough of what follows. Returns the
+// number of samples written, -1 when max_out is too small.
+int resampler_process(struct resampler * rs, const float * in, int n_in, float * out, int max_out);
+
+// End of input: writes the held-back tail.
+int resampler_flush(struct resampler * rs, float * out, int max_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_RESAMPLE_H
@@ -0,0 +1,807 @@
+// struct ucred
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "server.h"
+#include "transcribe_file.h"
+#include "vec.h"
+#include "ggml.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// request line and headers
+#define SERVER_MAX_HEADER 8192
+// body bytes received per call
+#define SERVER_BODY_BUF   16384
+// one response line: a segment with its escaped text
+#define SERVER_MAX_LINE   4096
+// request target, path and query
+#define SERVER_MAX_TARGET 256
+
+// server_read_request: the target does not fit SERVER_MAX_TARGET
+#define SERVER_URI_TOO_LONG (-2)
+
+struct server_conn {
+    struct server * s;
+    pthread_t thread;
+    int fd;
+    bool used;   // slot taken, thread not joined yet
+    bool done;   // thread finished
+};
+
+struct server {
+    struct server_params params;
+    struct transcriber ** workers;
+    bool * busy;
+    int n_workers;
+
+    int fd_unix;
+    int fd_tcp;
+    int wake[2];   // written by server_stop to end the accept loop
+    pthread_t accept_thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t next_ticket;   // jobs take workers in ticket order
+    uint64_t serving;
+    int n_free;
+    bool stopping;
+    struct server_conn * conns;   // [max_clients]
+    struct server_stats stats;
+};
+
+// Request body: Content-Length, chunked, or up to the client's half-close.
+struct server_body {
+    int fd;
+    uint8_t buf[SERVER_BODY_BUF];
+    int n;
+    int i;
+    bool chunked;
+    bool need_crlf;      // CRLF that ends the current chunk not read yet
+    int64_t left;        // bytes of the body or chunk, -1 = up to the end of the stream
+    bool end;
+    int16_t pcm[2048];   // staging for read_samples
+    int n_odd;           // byte of a sample split between reads, kept in pcm
+};
+
+struct server_request {
+    char method[8];
+    char path[SERVER_MAX_TARGET];
+    char lang[16];
+    bool translate;
+    int chunk_s;
+    bool expect_continue;
+};
+
+struct server_params server_default_params(void) {
+    struct server_params p = {
+        .socket_path = NULL,
+        .allowed_uids = NULL,
+        .n_allowed_uids = 0,
+        .any_uid     = false,
+        .port        = 0,
+        .n_threads   = 4,
+        .max_clients = 16,
+        .chunk_s     = TRANSCRIBE_FILE_DEFAULT_CHUNK_S,
+        .timeout_s   = 30,
+    };
+    return p;
+}
+
+static int server_send(int fd, const char * data, size_t n) {
+    while (n > 0) {
+        const ssize_t k = send(fd, data, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            return -1;
+        }
+        data += k;
+        n -= (size_t) k;
+    }
+    return 0;
+}
+
+// one chunk of a chunked response
+static int server_send_chunk(int fd, const char * data, int n) {
+    char head[16];
+    const int h = snprintf(head, sizeof(head), "%x\r\n", n);
+    if (server_send(fd, head, (size_t) h) != 0 || server_send(fd, data, (size_t) n) != 0) {
+        return -1;
+    }
+    return server_send(fd, "\r\n", 2);
+}
+
+static void server_respond(int fd, int code, const char * reason, const char * json) {
+    char buf[SERVER_MAX_LINE];
+    const int n = snprintf(buf, sizeof(buf),
+            "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+            code, reason, strlen(json), json);
+    server_send(fd, buf, (size_t) (n < (int) sizeof(buf) ? n : (int) sizeof(buf) - 1));
+}
+
+// Copies src as a JSON string body; stops short of cap rather than cut an escape.
+static int server_json_escape(char * dst, int cap, const char * src) {
+    int n = 0;
+    for (const unsigned char * p = (const unsigned char *) src; *p; p++) {
+        char esc[8];
+        int k;
+        if (*p == '"' || *p == '\\') {
+            k = snprintf(esc, sizeof(esc), "\\%c", *p);
+        } else if (*p < 0x20) {
+            k = snprintf(esc, sizeof(esc), "\\u%04x", *p);
+        } else {
+            esc[0] = (char) *p;
+            k = 1;
+        }
+        if (n + k >= cap) {
+            break;
+        }
+        memcpy(dst + n, esc, (size_t) k);
+        n += k;
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+static int server_body_fill(struct server_body * b) {
+    for (;;) {
+        const ssize_t k = recv(b->fd, b->buf, sizeof(b->buf), 0);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k < 0) {
+            return -1;
+        }
+        b->n = (int) k;
+        b->i = 0;
+        return (int) k;
+    }
+}
+
+// A CRLF-terminated line of the chunked framing, without the CRLF.
+static int server_body_line(struct server_body * b, char * line, int cap) {
+    int n = 0;
+    for (;;) {
+        if (b->i == b->n && server_body_fill(b) <= 0) {
+            return -1;
+        }
+        const char c = (char) b->buf[b->i++];
+        if (c == '\n') {
+            break;
+        }
+        if (c != '\r' && n < cap - 1) {
+            line[n++] = c;
+        }
+    }
+    line[n] = '\0';
+    return 0;
+}
+
+// Up to n body bytes. Returns the number read, 0 at the end, -1 on error.
+static int server_body_read(struct server_body * b, uint8_t * dst, int n) {
+    while (!b->end) {
+        if (b->chunked && b->left == 0) {
+            char line[64];
+            if (b->need_crlf && server_body_line(b, line, sizeof(line)) != 0) {
+                return -1;
+            }
+            if (server_body_line(b, line, sizeof(line)) != 0) {
+                return -1;
+            }
+            b->left = strtoll(line, NULL, 16);
+            b->need_crlf = true;
+            if (b->left <= 0) {
+                // trailers are not used
+                b->end = true;
+            }
+            continue;
+        }
+        if (b->left == 0) {
+            b->end = true;
+            break;
+        }
+        if (b->i == b->n) {
+            const int k = server_body_fill(b);
+            if (k < 0 || (k == 0 && b->left > 0)) {
+                return -1;
+            }
+            if (k == 0) {
+                b->end = true;
+                break;
+            }
+        }
+        int k = b->n - b->i < n ? b->n - b->i : n;
+        if (b->left > 0 && k > b->left) {
+            k = (int) b->left;
+        }
+        memcpy(dst, b->buf + b->i, (size_t) k);
+        b->i += k;
+        if (b->left > 0) {
+            b->left -= k;
+        }
+        return k;
+    }
+    return 0;
+}
+
+// transcribe_read_callback over the request body
+static int server_read_samples(void * reader, float * out, int n) {
+    struct server_body * b = reader;
+    int n_out = 0;
+    while (n_out < n) {
+        int want = 2*(n - n_out);
+        if (want > (int) sizeof(b->pcm)) {
+            want = (int) sizeof(b->pcm);
+        }
+        uint8_t * raw = (uint8_t *) b->pcm;
+        const int got = server_body_read(b, raw + b->n_odd, want - b->n_odd);
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        const int bytes = b->n_odd + got;
+        vec_s16_to_f32(bytes/2, out + n_out, b->pcm, 1.0f/32768.0f);
+        n_out += bytes/2;
+        b->n_odd = bytes & 1;
+        if (b->n_odd) {
+            raw[0] = raw[bytes - 1];
+        }
+    }
+    return n_out;
+}
+
+// Parses the request line and the headers the server needs. Returns 0 on
+// success, SERVER_URI_TOO_LONG or -1 otherwise; body bytes that came with the
+// headers are left in b.
+static int server_read_request(struct server_body * b, struct server_request * req) {
+    char hdr[SERVER_MAX_HEADER];
+    int n = 0;
+    char * end = NULL;
+    while (!end) {
+        const ssize_t k = recv(b->fd, hdr + n, sizeof(hdr) - 1 - n, 0);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            return -1;
+        }
+        n += (int) k;
+        hdr[n] = '\0';
+        end = strstr(hdr, "\r\n\r\n");
+        if (!end && n == (int) sizeof(hdr) - 1) {
+            return -1;
+        }
+    }
+    const int n_head = (int) (end - hdr) + 4;
+    b->n = n - n_head;
+    b->i = 0;
+    memcpy(b->buf, hdr + n_head, (size_t) b->n);
+    *end = '\0';
+
+    char target[SERVER_MAX_TARGET];
+    int at = 0;
+    if (sscanf(hdr, "%7s %n", req->method, &at) != 1 || at == 0) {
+        return -1;
+    }
+    const size_t n_target = strcspn(hdr + at, " \r\n");
+    if (n_target == 0) {
+        return -1;
+    }
+    if (n_target >= sizeof(target)) {
+        return SERVER_URI_TOO_LONG;
+    }
+    memcpy(target, hdr + at, n_target);
+    target[n_target] = '\0';
+    char * query = strchr(target, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+    snprintf(req->path, sizeof(req->path), "%s", target);
+    char * save = NULL;
+    for (char * kv = query ? strtok_r(query, "&", &save) : NULL; kv; kv = strtok_r(NULL, "&", &save)) {
+        char * v = strchr(kv, '=');
+        if (!v) {
+            continue;
+        }
+        *v++ = '\0';
+        if (strcmp(kv, "lang") == 0) {
+            snprintf(req->lang, sizeof(req->lang), "%s", v);
+        } else if (strcmp(kv, "translate") == 0) {
+            req->translate = strcmp(v, "1") == 0 || strcmp(v, "true") == 0;
+        } else if (strcmp(kv, "chunk") == 0) {
+            char * e = NULL;
+            const long chunk_s = strtol(v, &e, 10);
+            if (e == v || *e != '\0' || chunk_s < TRANSCRIBE_FILE_MIN_CHUNK_S || chunk_s > TRANSCRIBE_FILE_MAX_CHUNK_S) {
+                return -1;
+            }
+            req->chunk_s = (int) chunk_s;
+        }
+    }
+
+    b->left = -1;
+    bool has_length = false;
+    for (char * line = strstr(hdr, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        char * colon = strchr(line, ':');
+        char * eol = strstr(line, "\r\n");
+        if (!colon || (eol && colon > eol)) {
+            continue;
+        }
+        const char * v = colon + 1;
+        while (*v == ' ') {
+            v++;
+        }
+        const size_t key = (size_t) (colon - line);
+        if (key == 14 && strncasecmp(line, "Content-Length", key) == 0) {
+            // digits only: a sign or garbage would pick the framing for the client
+            char * e = NULL;
+            errno = 0;
+            const long long len = *v >= '0' && *v <= '9' ? strtoll(v, &e, 10) : -1;
+            while (e && *e == ' ') {
+                e++;
+            }
+            if (len < 0 || errno == ERANGE || has_length || (*e != '\0' && *e != '\r')) {
+                return -1;
+            }
+            b->left = len;
+            has_length = true;
+        } else if (key == 17 && strncasecmp(line, "Transfer-Encoding", key) == 0) {
+            b->chunked = strncasecmp(v, "chunked", 7) == 0;
+        } else if (key == 6 && strncasecmp(line, "Expect", key) == 0) {
+            req->expect_continue = strncasecmp(v, "100-continue", 12) == 0;
+        }
+    }
+    if (b->chunked && has_length) {
+        return -1;
+    }
+    if (b->chunked) {
+        b->left = 0;
+    }
+    return 0;
+}
+
+static int server_stats_json(struct server * s, char * buf, int cap) {
+    const struct server_stats st = server_get_stats(s);
+    return snprintf(buf, (size_t) cap,
+            "{\"workers\":%d,\"active\":%d,\"waiting\":%d,\"jobs\":%d,\"failed\":%d,\"rejected\":%d,"
+            "\"segments\":%d,\"audio_s\":%.1f,\"wait_ms\":%.1f,\"max_wait_ms\":%.1f,\"busy_ms\":%.1f}",
+            s->n_workers, st.n_active, st.n_waiting, st.n_jobs, st.n_failed, st.n_rejected,
+            st.n_segments, st.audio_s, st.wait_ms, st.max_wait_ms, st.busy_ms);
+}
+
+// Waits for a worker in ticket order. Returns its index, -1 when stopping.
+static int server_acquire(struct server * s) {
+    pthread_mutex_lock(&s->lock);
+    const uint64_t ticket = s->next_ticket++;
+    s->stats.n_waiting++;
+    while (!s->stopping && (ticket != s->serving || s->n_free == 0)) {
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+    s->stats.n_waiting--;
+    int w = -1;
+    if (!s->stopping) {
+        for (w = 0; s->busy[w]; w++) {
+        }
+        s->busy[w] = true;
+        s->n_free--;
+        s->serving++;
+        s->stats.n_active++;
+    }
+    // the next ticket may be able to go too
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return w;
+}
+
+static void server_release(struct server * s, int w) {
+    pthread_mutex_lock(&s->lock);
+    s->busy[w] = false;
+    s->n_free++;
+    s->stats.n_active--;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+struct server_job {
+    int fd;
+    int n_segments;
+    char line[SERVER_MAX_LINE];
+};
+
+static int server_send_segment(const struct transcribe_segment * seg, void * user_data) {
+    struct server_job * job = user_data;
+    int n = snprintf(job->line, sizeof(job->line), "{\"t0\":%.2f,\"t1\":%.2f,\"speaker\":%d,\"text\":\"",
+            seg->t0/100.0, seg->t1/100.0, seg->speaker);
+    n += server_json_escape(job->line + n, (int) sizeof(job->line) - n - 4, seg->text);
+    n += snprintf(job->line + n, sizeof(job->line) - n, "\"}\n");
+    job->n_segments++;
+    // a client that went away stops the job after its chunk
+    return server_send_chunk(job->fd, job->line, n) == 0 ? 0 : 1;
+}
+
+static void server_transcribe(struct server * s, struct server_body * b, const struct server_request * req) {
+    const bool auto_lang = req->lang[0] == '\0' || strcmp(req->lang, "auto") == 0;
+    if (!auto_lang && whisper_lang_id(req->lang) < 0) {
+        server_respond(b->fd, 400, "Bad Request", "{\"error\":\"unknown language\"}");
+        pthread_mutex_lock(&s->lock);
+        s->stats.n_rejected++;
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    if (req->expect_continue) {
+        server_send(b->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+    }
+
+    const int64_t t_wait_us = ggml_time_us();
+    const int w = server_acquire(s);
+    if (w < 0) {
+        server_respond(b->fd, 503, "Service Unavailable", "{\"error\":\"stopping\"}");
+        return;
+    }
+    const int64_t t_start_us = ggml_time_us();
+    const float wait_ms = (t_start_us - t_wait_us)/1000.0f;
+
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = auto_lang ? "auto" : req->lang;
+    params.translate = req->translate;
+    params.n_threads = s->params.n_threads;
+    params.no_context = true;
+
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\n"
+                               "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+    struct server_job * job = calloc(1, sizeof(struct server_job));
+    struct transcribe_file_stats st = {0};
+    int rc = -1;
+    if (job && server_send(b->fd, head, sizeof(head) - 1) == 0) {
+        job->fd = b->fd;
+        rc = transcribe_stream(s->workers[w], params, server_read_samples, b,
+                req->chunk_s > 0 ? req->chunk_s : s->params.chunk_s, server_send_segment, job, &st);
+    }
+    server_release(s, w);
+    const float busy_ms = (ggml_time_us() - t_start_us)/1000.0f;
+
+    if (job) {
+        const int n = rc == 0
+            ? snprintf(job->line, sizeof(job->line),
+                    "{\"done\":true,\"audio_s\":%.2f,\"segments\":%d,\"chunks\":%d,\"wait_ms\":%.1f,\"total_ms\":%.1f}\n",
+                    st.duration_s, job->n_segments, st.n_chunks, wait_ms, busy_ms)
+            : snprintf(job->line, sizeof(job->line), "{\"done\":false,\"error\":\"transcription failed\"}\n");
+        if (server_send_chunk(b->fd, job->line, n) == 0) {
+            server_send(b->fd, "0\r\n\r\n", 5);
+        }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    if (rc == 0) {
+        s->stats.n_jobs++;
+    } else {
+        s->stats.n_failed++;
+    }
+    s->stats.n_segments += job ? job->n_segments : 0;
+    s->stats.audio_s += st.duration_s;
+    s->stats.wait_ms += wait_ms;
+    s->stats.max_wait_ms = wait_ms > s->stats.max_wait_ms ? wait_ms : s->stats.max_wait_ms;
+    s->stats.busy_ms += busy_ms;
+    pthread_mutex_unlock(&s->lock);
+    free(job);
+}
+
+static void * server_conn_main(void * arg) {
+    struct server_conn * c = arg;
+    struct server * s = c->s;
+    struct server_body * b = calloc(1, sizeof(struct server_body));
+    struct server_request req = {0};
+    if (b) {
+        b->fd = c->fd;
+    }
+    const int rc = b ? server_read_request(b, &req) : -1;
+    if (rc != 0) {
+        if (rc == SERVER_URI_TOO_LONG) {
+            server_respond(c->fd, 414, "URI Too Long", "{\"error\":\"request target too long\"}");
+        } else {
+            server_respond(c->fd, 400, "Bad Request", "{\"error\":\"bad request\"}");
+        }
+        pthread_mutex_lock(&s->lock);
+        s->stats.n_rejected++;
+        pthread_mutex_unlock(&s->lock);
+    } else if (strcmp(req.method, "POST") == 0 && strcmp(req.path, "/transcribe") == 0) {
+        server_transcribe(s, b, &req);
+    } else if (strcmp(req.method, "GET") == 0 && strcmp(req.path, "/stats") == 0) {
+        char json[512];
+        server_stats_json(s, json, sizeof(json));
+        server_respond(c->fd, 200, "OK", json);
+    } else if (strcmp(req.method, "GET") == 0 && strcmp(req.path, "/health") == 0) {
+        server_respond(c->fd, 200, "OK", "{\"status\":\"ok\"}");
+    } else {
+        server_respond(c->fd, 404, "Not Found", "{\"error\":\"not found\"}");
+    }
+    free(b);
+
+    pthread_mutex_lock(&s->lock);
+    close(c->fd);
+    c->fd = -1;
+    c->done = true;
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// Joins finished connection threads and returns a free slot, NULL when all
+// are taken.
+static struct server_conn * server_slot(struct server * s) {
+    struct server_conn * free_slot = NULL;
+    for (int i = 0; i < s->params.max_clients; i++) {
+        struct server_conn * c = &s->conns[i];
+        pthread_mutex_lock(&s->lock);
+        const bool done = c->used && c->done;
+        pthread_mutex_unlock(&s->lock);
+        if (done) {
+            pthread_join(c->thread, NULL);
+            c->used = false;
+        }
+        if (!c->used && !free_slot) {
+            free_slot = c;
+        }
+    }
+    return free_slot;
+}
+
+// Whether the peer of a Unix socket connection may use the server.
+static bool server_peer_allowed(const struct server * s, int fd) {
+    if (s->params.any_uid) {
+        return true;
+    }
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) {
+        return false;
+    }
+    if (cred.uid == getuid()) {
+        return true;
+    }
+    for (int i = 0; i < s->params.n_allowed_uids; i++) {
+        if (cred.uid == s->params.allowed_uids[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void * server_accept_main(void * arg) {
+    struct server * s = arg;
+    struct pollfd fds[3] = {
+        { .fd = s->wake[0], .events = POLLIN },
+        { .fd = s->fd_unix, .events = POLLIN },
+        { .fd = s->fd_tcp,  .events = POLLIN },
+    };
+    for (;;) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        for (int i = 1; i < 3; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            const int fd = accept(fds[i].fd, NULL, NULL);
+            if (fd < 0) {
+                continue;
+            }
+            const struct timeval tv = { .tv_sec = s->params.timeout_s, .tv_usec = 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            if (fds[i].fd == s->fd_unix && !server_peer_allowed(s, fd)) {
+                server_respond(fd, 403, "Forbidden", "{\"error\":\"uid not allowed\"}");
+                close(fd);
+                pthread_mutex_lock(&s->lock);
+                s->stats.n_rejected++;
+                pthread_mutex_unlock(&s->lock);
+                continue;
+            }
+
+            struct server_conn * c = server_slot(s);
+            if (c) {
+                c->s = s;
+                c->fd = fd;
+                c->done = false;
+                c->used = pthread_create(&c->thread, NULL, server_conn_main, c) == 0;
+            }
+            if (!c || !c->used) {
+                server_respond(fd, 503, "Service Unavailable", "{\"error\":\"too many clients\"}");
+                close(fd);
+                pthread_mutex_lock(&s->lock);
+                s->stats.n_rejected++;
+                pthread_mutex_unlock(&s->lock);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int server_listen_unix(const char * path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    const bool abstract = path[0] == '@';
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    // abstract names start with a NUL instead of the '@'
+    memcpy(addr.sun_path + (abstract ? 1 : 0), path + (abstract ? 1 : 0), strlen(path) - (abstract ? 1 : 0));
+    const socklen_t len = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + strlen(path) + (abstract ? 0 : 1));
+    if (!abstract) {
+        unlink(path);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (const struct sockaddr *) &addr, len) != 0 || listen(fd, 64) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static int server_listen_tcp(int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const int one = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            bind(fd, (const struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+struct server * server_start(struct transcriber ** workers, int n_workers, struct server_params params) {
+    struct server * s = calloc(1, sizeof(struct server));
+    struct transcriber ** owned = malloc(sizeof(struct transcriber *) * (n_workers > 0 ? n_workers : 1));
+    if (!s || !owned || n_workers < 1) {
+        for (int i = 0; i < n_workers; i++) {
+            transcriber_free(workers[i]);
+        }
+        free(owned);
+        free(s);
+        return NULL;
+    }
+    memcpy(owned, workers, sizeof(struct transcriber *) * n_workers);
+    s->workers = owned;
+    s->n_workers = n_workers;
+    s->n_free = n_workers;
+    s->params = params;
+    s->params.max_clients = params.max_clients > 0 ? params.max_clients : 1;
+    s->params.socket_path = params.socket_path ? strdup(params.socket_path) : NULL;
+    s->params.n_allowed_uids = params.allowed_uids && params.n_allowed_uids > 0 ? params.n_allowed_uids : 0;
+    s->params.allowed_uids = NULL;
+    if (s->params.n_allowed_uids > 0) {
+        uid_t * uids = malloc(sizeof(uid_t) * s->params.n_allowed_uids);
+        if (uids) {
+            memcpy(uids, params.allowed_uids, sizeof(uid_t) * s->params.n_allowed_uids);
+        } else {
+            s->params.n_allowed_uids = 0;
+        }
+        s->params.allowed_uids = uids;
+    }
+    s->fd_unix = -1;
+    s->fd_tcp = -1;
+    s->wake[0] = -1;
+    s->wake[1] = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    s->busy = calloc((size_t) n_workers, sizeof(bool));
+    s->conns = calloc((size_t) s->params.max_clients, sizeof(struct server_conn));
+    if (s->params.socket_path) {
+        s->fd_unix = server_listen_unix(s->params.socket_path);
+    }
+    if (params.port > 0) {
+        s->fd_tcp = server_listen_tcp(params.port);
+    }
+    const bool listening = (s->fd_unix >= 0 || !s->params.socket_path) && (s->fd_tcp >= 0 || params.port <= 0) &&
+            (s->fd_unix >= 0 || s->fd_tcp >= 0);
+    if (!s->busy || !s->conns || !listening || pipe(s->wake) != 0 ||
+            pthread_create(&s->accept_thread, NULL, server_accept_main, s) != 0) {
+        if (s->wake[0] >= 0) {
+            close(s->wake[0]);
+            close(s->wake[1]);
+            s->wake[0] = -1;
+        }
+        server_stop(s);
+        return NULL;
+    }
+    return s;
+}
+
+void server_stop(struct server * s) {
+    if (!s) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->stopping = true;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    if (s->wake[0] >= 0) {
+        const char c = 0;
+        while (write(s->wake[1], &c, 1) < 0 && errno == EINTR) {
+        }
+        // the accept thread polls wake[] and uses s until it returns
+        pthread_join(s->accept_thread, NULL);
+        close(s->wake[0]);
+        close(s->wake[1]);
+    }
+
+    // unblock the clients' reads and writes, their jobs end after the chunk
+    for (int i = 0; s->conns && i < s->params.max_clients; i++) {
+        pthread_mutex_lock(&s->lock);
+        if (s->conns[i].used && !s->conns[i].done) {
+            shutdown(s->conns[i].fd, SHUT_RDWR);
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    for (int i = 0; s->conns && i < s->params.max_clients; i++) {
+        if (s->conns[i].used) {
+            pthread_join(s->conns[i].thread, NULL);
+        }
+    }
+
+    if (s->fd_unix >= 0) {
+        close(s->fd_unix);
+        if (s->params.socket_path[0] != '@') {
+            unlink(s->params.socket_path);
+        }
+    }
+    if (s->fd_tcp >= 0) {
+        close(s->fd_tcp);
+    }
+    for (int i = 0; i < s->n_workers; i++) {
+        transcriber_free(s->workers[i]);
+    }
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free((char *) s->params.socket_path);
+    free((uid_t *) s->params.allowed_uids);
+    free(s->conns);
+    free(s->busy);
+    free(s->workers);
+    free(s);
+}
+
+struct server_stats server_get_stats(struct server * s) {
+    pthread_mutex_lock(&s->lock);
+    const struct server_stats st = s->stats;
+    pthread_mutex_unlock(&s->lock);
+    return st;
+}
@@ -0,0 +1,77 @@
+#ifndef WHISPER_JNI_SERVER_H
+#define WHISPER_JNI_SERVER_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "transcribe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Local transcription server: the loaded models serve any number of clients
+// over a Unix domain socket and/or loopback TCP, both speaking HTTP/1.1, so
+// other apps and test rigs do not load a model of their own.
+//
+//   POST /transcribe?lang=en&translate=0&chunk=600
+//     chunk: seconds, TRANSCRIBE_FILE_MIN_CHUNK_S (60) to
+//     TRANSCRIBE_FILE_MAX_CHUNK_S, anything else is a 400. Segments arrive
+//     about one chunk of audio after their speech.
+//     body: 16 kHz mono s16le PCM, with Content-Length, chunked, or up to the
+//     client's half-close. Streams back application/x-ndjson, one line per
+//     segment as soon as its chunk is decoded, then {"done":true,...}.
+//   GET /health, GET /stats
+//
+// Every connection has its own thread; jobs take a worker (one transcriber,
+// i.e. one loaded model) in arrival order and keep it until their body ends,
+// PCM going from the socket into the chunk buffer of transcribe_stream.
+// Connections beyond max_clients are refused with 503.
+//
+// An abstract socket can be connected to by any app, so Unix socket peers are
+// checked with SO_PEERCRED: the server's own uid and allowed_uids are served,
+// others get 403, unless any_uid is set. Loopback TCP carries no peer uid:
+// every app that can reach the port is served, so leave it off on devices.
+struct server_params {
+    const char * socket_path;  // NULL = none; "@name" is an abstract socket (no file, reachable across apps)
+    const uid_t * allowed_uids;  // Unix socket peers served besides the server's uid
+    int n_allowed_uids;
+    bool any_uid;              // serve every Unix socket peer
+    int port;                  // loopback TCP port, 0 = none
+    int n_threads;             // per job
+    int max_clients;           // connections at once, waiting ones included
+    int chunk_s;               // default chunk of a job, see transcribe_file.h
+    int timeout_s;             // a client silent this long is dropped
+};
+
+struct server_params server_default_params(void);
+
+struct server_stats {
+    int   n_jobs;        // finished
+    int   n_failed;
+    int   n_rejected;    // refused connections and bad requests
+    int   n_active;      // jobs holding a worker
+    int   n_waiting;     // jobs queued for one
+    int   n_segments;
+    float audio_s;       // decoded, all jobs
+    float wait_ms;       // queueing, all jobs
+    float max_wait_ms;
+    float busy_ms;       // jobs holding a worker, all jobs
+};
+
+struct server;
+
+// Takes ownership of the n_workers transcribers, also on failure. Returns NULL
+// when no listener can be opened.
+struct server * server_start(struct transcriber ** workers, int n_workers, struct server_params params);
+
+// Closes the listeners, drops the clients and waits for their threads.
+void server_stop(struct server * s);
+
+struct server_stats server_get_stats(struct server * s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_SERVER_H
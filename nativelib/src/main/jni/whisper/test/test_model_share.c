@@ -0,0 +1,105 @@
+// Host test: a context opened from a shared model region transcribes exactly
+// like one loaded straight from the file. Needs a real ggml model, so ctest
+// only registers it when WHISPER_TEST_MODEL is set.
+//
+//   test_model_share model.bin [file.wav]
+//
+// Loads the model directly and through model_share_create/model_share_open,
+// transcribes the same clip (the WAV file, or 10 s of synthetic speech) with
+// both and fails unless the segments match and the weights were mapped from
+// the region rather than copied.
+
+#include "../bench/common.h"
+#include "../model_share.h"
+#include "../transcribe.h"
+#include "whisper.h"
+
+#include <unistd.h>
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+static size_t test_file_read(void * ctx, void * output, size_t read_size) {
+    return fread(output, 1, read_size, (FILE *) ctx);
+}
+
+static bool test_file_eof(void * ctx) {
+    return feof((FILE *) ctx) != 0;
+}
+
+static void test_file_close(void * ctx) {
+    fclose((FILE *) ctx);
+}
+
+static void test_transcribe(struct transcriber * tr, const float * samples, int n) {
+    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_realtime = false;
+    params.print_progress = false;
+    params.print_timestamps = false;
+    params.print_special = false;
+    params.language = "en";
+    params.n_threads = 4;
+    params.no_context = true;
+    TEST_CHECK(transcriber_run_pcm(tr, params, samples, n) == 0);
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s model.bin [file.wav]\n", argv[0]);
+        return 1;
+    }
+    const char * model = argv[1];
+
+    int n = 10*16000;
+    float * samples = argc > 2 ? bench_read_wav(argv[2], &n) : bench_synth_audio(n, 0.01f, 9);
+    TEST_CHECK(samples != NULL);
+
+    struct whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+
+    struct transcriber * direct = transcriber_init(whisper_init_from_file_with_params(model, cparams));
+    TEST_CHECK(direct != NULL);
+
+    FILE * f = fopen(model, "rb");
+    TEST_CHECK(f != NULL);
+    struct whisper_model_loader loader = {
+        .context = f,
+        .read    = test_file_read,
+        .eof     = test_file_eof,
+        .close   = test_file_close,
+    };
+    const int fd = model_share_create(&loader, NULL);
+    TEST_CHECK(fd >= 0);
+
+    struct model_share_stats stats;
+    struct transcriber * shared = transcriber_init(model_share_open(fd, cparams, &stats));
+    close(fd);
+    TEST_CHECK(shared != NULL);
+    printf("region %.1f MB: %.1f MB mapped, %.1f MB copied, opened in %.0f ms\n", stats.region_bytes/1048576.0,
+            stats.shared_bytes/1048576.0, stats.copied_bytes/1048576.0, stats.load_ms);
+    TEST_CHECK(stats.shared_bytes > 0);
+
+    test_transcribe(direct, samples, n);
+    test_transcribe(shared, samples, n);
+
+    printf("direct: %s\nshared: %s\n", transcriber_text(direct), transcriber_text(shared));
+    TEST_CHECK(transcriber_n_segments(direct) == transcriber_n_segments(shared));
+    for (int i = 0; i < transcriber_n_segments(direct); i++) {
+        const struct transcribe_segment * a = transcriber_segment(direct, i);
+        const struct transcribe_segment * b = transcriber_segment(shared, i);
+        TEST_CHECK(a->t0 == b->t0 && a->t1 == b->t1);
+        TEST_CHECK(strcmp(a->text, b->text) == 0);
+    }
+    TEST_CHECK(strcmp(transcriber_text(direct), transcriber_text(shared)) == 0);
+
+    transcriber_free(shared);
+    transcriber_free(direct);
+    free(samples);
+    printf("OK\n");
+    return 0;
+}
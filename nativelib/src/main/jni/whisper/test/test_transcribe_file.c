@@ -0,0 +1,173 @@
+// Host test: the chunk carry-over of transcribe_stream. A fake transcriber
+// (defined here, so transcribe.c is not linked) turns every run of non-zero
+// samples within a 30 s window into a segment, like whisper on clean speech
+// and silence. Every speech sample must end up in exactly one reported
+// segment, whatever the chunk size and wherever the speech falls.
+
+#include "../transcribe_file.h"
+#include "../audio_file.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define TEST_WINDOW (30*AUDIO_FILE_RATE)
+#define TEST_CS     (AUDIO_FILE_RATE/100)
+#define TEST_MAX_SEGMENTS 256
+
+// the fake transcriber
+
+static struct transcribe_segment test_segments[TEST_MAX_SEGMENTS];
+static int test_n_segments;
+static struct transcribe_stats test_stats;
+
+int transcriber_run_pcm(struct transcriber * tr, struct whisper_full_params params, const float * samples, int n_samples) {
+    (void) tr;
+    (void) params;
+    test_n_segments = 0;
+    memset(&test_stats, 0, sizeof(test_stats));
+    for (int w0 = 0; w0 < n_samples; w0 += TEST_WINDOW) {
+        const int w1 = w0 + TEST_WINDOW < n_samples ? w0 + TEST_WINDOW : n_samples;
+        for (int i = w0; i < w1;) {
+            if (samples[i] == 0.0f) {
+                i++;
+                continue;
+            }
+            const int s0 = i;
+            while (i < w1 && samples[i] != 0.0f) {
+                i++;
+            }
+            TEST_CHECK(test_n_segments < TEST_MAX_SEGMENTS);
+            test_segments[test_n_segments++] = (struct transcribe_segment) {
+                .t0 = s0/TEST_CS,
+                .t1 = (i + TEST_CS - 1)/TEST_CS,
+                .text = "",
+                .window = test_stats.n_windows,
+                .speaker = -1,
+            };
+        }
+        test_stats.n_windows++;
+    }
+    return 0;
+}
+
+int transcriber_n_segments(const struct transcriber * tr) {
+    (void) tr;
+    return test_n_segments;
+}
+
+const struct transcribe_segment * transcriber_segment(const struct transcriber * tr, int i) {
+    (void) tr;
+    return &test_segments[i];
+}
+
+const struct transcribe_stats * transcriber_stats(const struct transcriber * tr) {
+    (void) tr;
+    return &test_stats;
+}
+
+// audio: silence with bursts of speech, generated as it is read
+
+struct test_burst {
+    int64_t s0;   // samples
+    int64_t s1;
+};
+
+struct test_audio {
+    const struct test_burst * bursts;
+    int n_bursts;
+    int64_t n;
+    int64_t pos;
+};
+
+static int test_read(void * reader, float * out, int n) {
+    struct test_audio * a = reader;
+    int k = 0;
+    for (; k < n && a->pos < a->n; k++, a->pos++) {
+        out[k] = 0.0f;
+        for (int b = 0; b < a->n_bursts; b++) {
+            if (a->pos >= a->bursts[b].s0 && a->pos < a->bursts[b].s1) {
+                out[k] = 0.5f;
+            }
+        }
+    }
+    return k;
+}
+
+struct test_result {
+    int64_t t0[TEST_MAX_SEGMENTS];
+    int64_t t1[TEST_MAX_SEGMENTS];
+    int n;
+};
+
+static int test_collect(const struct transcribe_segment * seg, void * user_data) {
+    struct test_result * r = user_data;
+    TEST_CHECK(r->n < TEST_MAX_SEGMENTS);
+    r->t0[r->n] = seg->t0;
+    r->t1[r->n] = seg->t1;
+    r->n++;
+    return 0;
+}
+
+static void test_run(const char * name, const struct test_burst * bursts, int n_bursts, int64_t n, int chunk_s) {
+    struct test_audio audio = { bursts, n_bursts, n, 0 };
+    struct test_result r = { .n = 0 };
+    struct transcribe_file_stats st;
+    struct whisper_full_params params;
+    memset(&params, 0, sizeof(params));
+    TEST_CHECK(transcribe_stream(NULL, params, test_read, &audio, chunk_s, test_collect, &r, &st) == 0);
+
+    // in order and without overlaps, so nothing is reported twice
+    for (int i = 1; i < r.n; i++) {
+        TEST_CHECK(r.t0[i] >= r.t1[i - 1]);
+    }
+    // every burst covered
+    for (int b = 0; b < n_bursts; b++) {
+        for (int64_t cs = bursts[b].s0/TEST_CS; cs < (bursts[b].s1 + TEST_CS - 1)/TEST_CS; cs++) {
+            int found = 0;
+            for (int i = 0; i < r.n && !found; i++) {
+                found = cs >= r.t0[i] && cs < r.t1[i];
+            }
+            if (!found) {
+                fprintf(stderr, "%s: speech at %.2f s missing\n", name, cs/100.0);
+                exit(1);
+            }
+        }
+    }
+    printf("%-28s %2d chunks, %2d segments, %6.1f s carried\n", name, st.n_chunks, r.n, st.carried_s);
+}
+
+int main(void) {
+    const int64_t sec = AUDIO_FILE_RATE;
+
+    // speech only in the first window of a long chunk, silence to its end
+    const struct test_burst start[] = { { 1*sec, 9*sec } };
+    test_run("speech at chunk start", start, 1, 700*sec, 600);
+
+    // speech across the end of the first chunk
+    const struct test_burst cut[] = { { 3*sec, 5*sec }, { 590*sec, 610*sec } };
+    test_run("speech across chunk end", cut, 2, 700*sec, 600);
+
+    // bursts everywhere, with the smallest chunk (TRANSCRIBE_FILE_MIN_CHUNK_S)
+    struct test_burst many[40];
+    uint32_t seed = 1;
+    for (int b = 0; b < 40; b++) {
+        seed = seed*1664525u + 1013904223u;
+        many[b].s0 = (int64_t) b*20*sec + (seed >> 8) % (10*sec);
+        many[b].s1 = many[b].s0 + sec/2 + (seed >> 4) % (8*sec);
+    }
+    test_run("random bursts, 60 s chunks", many, 40, 810*sec, 60);
+    test_run("random bursts, 90 s chunks", many, 40, 810*sec, 90);
+
+    printf("OK\n");
+    return 0;
+}
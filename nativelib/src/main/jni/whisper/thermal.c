@@ -0,0 +1,344 @@
+#include "thermal.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THERMAL_MAX_EVENTS   32
+#define THERMAL_MAX_ZONES    16
+#define THERMAL_MAX_CLUSTERS 8
+#define THERMAL_MAX_LEVELS   32
+#define THERMAL_PATH_MAX     128
+
+// windows at a level before it may step down again: one for the change to
+// take effect, one to see it
+#define THERMAL_SETTLE_WINDOWS 2
+// consecutive slow windows before a slowdown counts, so one window sharing the
+// CPU with another app does not
+#define THERMAL_SLOW_WINDOWS   2
+#define THERMAL_MAX_HOLD       64
+// a cluster is capped when its maximum clock drops below this fraction
+#define THERMAL_CAP_RATIO      0.98
+
+struct thermal_governor {
+    struct thermal_params params;
+    float hot_c;
+
+    char zones[THERMAL_MAX_ZONES][THERMAL_PATH_MAX];
+    int n_zones;
+
+    uint64_t clusters[THERMAL_MAX_CLUSTERS];   // slowest first
+    long max_freq[THERMAL_MAX_CLUSTERS];       // highest scaling_max_freq seen, 0 when unreadable
+    int n_clusters;
+
+    struct power_config levels[THERMAL_MAX_LEVELS];
+    // fastest full-window encode seen at each level, the reference for the
+    // slowdown; kept across level changes and calls so that a level revisited
+    // while still throttled is recognized
+    float best_encode_ms[THERMAL_MAX_LEVELS];
+    int n_levels;
+    int n_threads;   // of the call the ladder was built for
+    int level;
+
+    int n_slow;
+    int windows_at_level;
+    int hold;
+    int last_up_window;     // -1 before the first step up
+    bool throttled;
+
+    float temp_c;
+    float max_temp_c;
+    int n_throttled_windows;
+
+    struct thermal_event events[THERMAL_MAX_EVENTS];
+    int n_events;
+};
+
+struct thermal_params thermal_default_params(void) {
+    struct thermal_params params = {
+            .hot_c        = 0.0f,
+            .hysteresis_c = 8.0f,
+            .slowdown     = 0.2f,
+            .hold_windows = 4,
+            .min_threads  = 1,
+    };
+    return params;
+}
+
+static bool thermal_read_long(const char * path, long * out) {
+    FILE * f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    const bool ok = fscanf(f, "%ld", out) == 1;
+    fclose(f);
+    return ok;
+}
+
+static bool thermal_read_word(const char * path, char * out, int n) {
+    FILE * f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    const bool ok = fgets(out, n, f) != NULL;
+    fclose(f);
+    out[ok ? strcspn(out, "\n") : 0] = '\0';
+    return ok;
+}
+
+static bool thermal_is_cpu_zone(const char * type) {
+    static const char * const names[] = { "cpu", "soc", "x86_pkg", "tsens", "apc", "big", "mid", "little" };
+    for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+        if (strstr(type, names[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Zones of the CPU (all readable zones when none is named like one) and the
+// lowest passive trip point among them, 0 without one.
+static float thermal_find_zones(struct thermal_governor * g) {
+    DIR * dir = opendir("/sys/class/thermal");
+    if (!dir) {
+        return 0.0f;
+    }
+    char all[THERMAL_MAX_ZONES][THERMAL_PATH_MAX];
+    int n_all = 0;
+    long trip = 0;
+    struct dirent * e;
+    while ((e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, "thermal_zone", 12) != 0) {
+            continue;
+        }
+        char path[THERMAL_PATH_MAX];
+        char type[64];
+        long temp;
+        snprintf(path, sizeof(path), "/sys/class/thermal/%.32s/temp", e->d_name);
+        if (!thermal_read_long(path, &temp) || temp <= 0) {
+            continue;
+        }
+        if (n_all < THERMAL_MAX_ZONES) {
+            snprintf(all[n_all++], THERMAL_PATH_MAX, "%s", path);
+        }
+        snprintf(path, sizeof(path), "/sys/class/thermal/%.32s/type", e->d_name);
+        if (!thermal_read_word(path, type, sizeof(type)) || !thermal_is_cpu_zone(type) || g->n_zones == THERMAL_MAX_ZONES) {
+            continue;
+        }
+        snprintf(g->zones[g->n_zones++], THERMAL_PATH_MAX, "/sys/class/thermal/%.32s/temp", e->d_name);
+        for (int t = 0; t < 16; t++) {
+            char kind[32];
+            long v;
+            snprintf(path, sizeof(path), "/sys/class/thermal/%.32s/trip_point_%d_type", e->d_name, t);
+            if (!thermal_read_word(path, kind, sizeof(kind))) {
+                break;
+            }
+            snprintf(path, sizeof(path), "/sys/class/thermal/%.32s/trip_point_%d_temp", e->d_name, t);
+            if (strcmp(kind, "passive") == 0 && thermal_read_long(path, &v) && v > 0 && (trip == 0 || v < trip)) {
+                trip = v;
+            }
+        }
+    }
+    closedir(dir);
+    if (g->n_zones == 0) {
+        memcpy(g->zones, all, sizeof(all));
+        g->n_zones = n_all;
+    }
+    return trip/1000.0f;
+}
+
+static long thermal_cluster_freq(uint64_t mask) {
+    char path[THERMAL_PATH_MAX];
+    long f;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_max_freq", __builtin_ctzll(mask));
+    return thermal_read_long(path, &f) ? f : 0;
+}
+
+struct thermal_governor * thermal_init(struct thermal_params params) {
+    struct thermal_governor * g = calloc(1, sizeof(struct thermal_governor));
+    if (!g) {
+        return NULL;
+    }
+    g->params = params;
+    const float trip = thermal_find_zones(g);
+    g->hot_c = params.hot_c > 0.0f ? params.hot_c : trip > 0.0f ? trip - 5.0f : 70.0f;
+    g->n_clusters = power_cpu_clusters(g->clusters, THERMAL_MAX_CLUSTERS);
+    for (int c = 0; c < g->n_clusters; c++) {
+        g->max_freq[c] = g->clusters[c] ? thermal_cluster_freq(g->clusters[c]) : 0;
+    }
+    g->temp_c = -1.0f;
+    g->max_temp_c = -1.0f;
+    return g;
+}
+
+void thermal_free(struct thermal_governor * g) {
+    free(g);
+}
+
+// From the requested configuration down: one thread less at a time to half
+// of them, then off the fastest cluster, one cluster at a time.
+static void thermal_build_ladder(struct thermal_governor * g, int n_threads) {
+    const int min_threads = g->params.min_threads > 0 ? g->params.min_threads : 1;
+    g->n_levels = 0;
+    g->levels[g->n_levels++] = (struct power_config) { n_threads, 0 };
+    for (int t = n_threads - 1; t >= (n_threads + 1)/2 && t >= min_threads && g->n_levels < THERMAL_MAX_LEVELS; t--) {
+        g->levels[g->n_levels++] = (struct power_config) { t, 0 };
+    }
+    int threads = g->levels[g->n_levels - 1].n_threads;
+    for (int c = g->n_clusters - 2; c >= 0 && g->n_levels < THERMAL_MAX_LEVELS; c--) {
+        uint64_t mask = 0;
+        for (int k = 0; k <= c; k++) {
+            mask |= g->clusters[k];
+        }
+        const int n_cpus = __builtin_popcountll(mask);
+        threads = threads < n_cpus ? threads : n_cpus;
+        threads = threads > min_threads ? threads : min_threads;
+        g->levels[g->n_levels++] = (struct power_config) { threads, mask };
+    }
+}
+
+void thermal_begin(struct thermal_governor * g, int n_threads) {
+    if (n_threads != g->n_threads || g->n_levels == 0) {
+        thermal_build_ladder(g, n_threads);
+        g->n_threads = n_threads;
+        g->level = 0;
+        g->hold = g->params.hold_windows;
+        memset(g->best_encode_ms, 0, sizeof(g->best_encode_ms));
+    }
+    g->n_slow = 0;
+    g->windows_at_level = 0;
+    g->last_up_window = -1;
+    g->throttled = false;
+    g->max_temp_c = -1.0f;
+    g->n_throttled_windows = 0;
+    g->n_events = 0;
+}
+
+struct power_config thermal_config(const struct thermal_governor * g) {
+    return g->levels[g->level];
+}
+
+static float thermal_read_temp(const struct thermal_governor * g) {
+    float hottest = -1.0f;
+    for (int i = 0; i < g->n_zones; i++) {
+        long t;
+        if (thermal_read_long(g->zones[i], &t) && t/1000.0f > hottest) {
+            hottest = t/1000.0f;
+        }
+    }
+    return hottest;
+}
+
+// true when a cluster the level runs on is clocked below its highest cap so far
+static bool thermal_is_capped(struct thermal_governor * g, uint64_t mask) {
+    bool capped = false;
+    for (int c = 0; c < g->n_clusters; c++) {
+        if (g->max_freq[c] <= 0 || (mask != 0 && (mask & g->clusters[c]) == 0)) {
+            continue;
+        }
+        const long f = thermal_cluster_freq(g->clusters[c]);
+        if (f > g->max_freq[c]) {
+            g->max_freq[c] = f;
+        } else if (f > 0 && f < g->max_freq[c]*THERMAL_CAP_RATIO) {
+            capped = true;
+        }
+    }
+    return capped;
+}
+
+static void thermal_record(struct thermal_governor * g, int window, enum thermal_reason reason, float encode_ms, int to) {
+    if (g->n_events < THERMAL_MAX_EVENTS) {
+        g->events[g->n_events] = (struct thermal_event) {
+                .window = window,
+                .reason = reason,
+                .temp_c = g->temp_c,
+                .encode_ms = encode_ms,
+                .from = g->levels[g->level],
+                .to = g->levels[to],
+        };
+    }
+    g->n_events++;
+}
+
+bool thermal_observe(struct thermal_governor * g, int window, float encode_ms) {
+    g->temp_c = thermal_read_temp(g);
+    g->max_temp_c = g->temp_c > g->max_temp_c ? g->temp_c : g->max_temp_c;
+
+    float * best = &g->best_encode_ms[g->level];
+    if (encode_ms > 0.0f) {
+        if (*best == 0.0f || encode_ms < *best) {
+            *best = encode_ms;
+            g->n_slow = 0;
+        } else {
+            g->n_slow = encode_ms > *best*(1.0f + g->params.slowdown) ? g->n_slow + 1 : 0;
+        }
+    }
+    const bool hot = g->temp_c >= g->hot_c;
+    const bool capped = thermal_is_capped(g, g->levels[g->level].cpu_mask);
+    const bool slow = g->n_slow >= THERMAL_SLOW_WINDOWS;
+    const bool throttled = hot || capped || slow;
+    const enum thermal_reason reason = hot ? THERMAL_HOT : capped ? THERMAL_FREQ_CAP : THERMAL_SLOWDOWN;
+    g->n_throttled_windows += throttled;
+    g->windows_at_level++;
+
+    int next = g->level;
+    if (throttled && g->level + 1 < g->n_levels && g->windows_at_level >= THERMAL_SETTLE_WINDOWS) {
+        next = g->level + 1;
+        // the last step up did not hold: wait longer before the next one
+        if (g->last_up_window >= 0 && window - g->last_up_window <= g->hold) {
+            g->hold = g->hold*2 < THERMAL_MAX_HOLD ? g->hold*2 : THERMAL_MAX_HOLD;
+        }
+    } else if (!throttled && g->level > 0 && g->windows_at_level >= g->hold
+            && (g->temp_c < 0.0f || g->temp_c <= g->hot_c - g->params.hysteresis_c)) {
+        next = g->level - 1;
+        g->last_up_window = window;
+    }
+
+    // one event per throttling episode, and one per step
+    if (next != g->level || (throttled && !g->throttled)) {
+        thermal_record(g, window, next < g->level ? THERMAL_COOLED : reason, encode_ms, next);
+    }
+    g->throttled = throttled;
+    if (next == g->level) {
+        return false;
+    }
+    g->level = next;
+    g->n_slow = 0;
+    g->windows_at_level = 0;
+    return true;
+}
+
+float thermal_temp_c(const struct thermal_governor * g) {
+    return g->temp_c;
+}
+
+float thermal_max_temp_c(const struct thermal_governor * g) {
+    return g->max_temp_c;
+}
+
+int thermal_n_throttled_windows(const struct thermal_governor * g) {
+    return g->n_throttled_windows;
+}
+
+int thermal_n_events(const struct thermal_governor * g) {
+    return g->n_events;
+}
+
+int thermal_n_kept_events(const struct thermal_governor * g) {
+    return g->n_events < THERMAL_MAX_EVENTS ? g->n_events : THERMAL_MAX_EVENTS;
+}
+
+const struct thermal_event * thermal_get_event(const struct thermal_governor * g, int i) {
+    return i >= 0 && i < thermal_n_kept_events(g) ? &g->events[i] : NULL;
+}
+
+const char * thermal_reason_str(enum thermal_reason reason) {
+    switch (reason) {
+        case THERMAL_HOT:       return "hot";
+        case THERMAL_FREQ_CAP:  return "frequency cap";
+        case THERMAL_SLOWDOWN:  return "slowdown";
+        case THERMAL_COOLED:    return "cooled";
+        default:                return "unknown";
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef WHISPER_JNI_THERMAL_H
+#define WHISPER_JNI_THERMAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "power.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Thermal governor for long transcriptions. Running every big core at full
+// speed heats the SoC until the kernel caps the clocks halfway through a long
+// recording, and the real-time factor collapses. Between windows the governor
+// looks at
+//   - the CPU thermal zones (/sys/class/thermal), against the lowest passive
+//     trip point or hot_c,
+//   - the clock caps of the CPU clusters (scaling_max_freq lowered below its
+//     value at the start, which is how the kernel's cooling devices throttle),
+//   - the encoder time of each window: the encoder does the same work on every
+//     full window, so it slowing down at the same configuration is throttling
+//     even where the sysfs files are unreadable (SELinux on recent Android),
+// and steps down a ladder of configurations, fewer threads first and then the
+// slower clusters, while it is hot. It steps back up once the zones cooled by
+// hysteresis_c, or after hold windows without a slowdown when no zone is
+// readable; a step up undone within hold windows doubles the hold, so the
+// configuration settles instead of oscillating.
+enum thermal_reason {
+    THERMAL_HOT,        // a zone reached hot_c
+    THERMAL_FREQ_CAP,   // a cluster's maximum clock was lowered
+    THERMAL_SLOWDOWN,   // the encoder slowed down at the same configuration
+    THERMAL_COOLED,     // stepped back up
+};
+
+struct thermal_params {
+    float hot_c;         // step down at or above this; 0 = 5 C below the lowest passive trip point (70 C without one)
+    float hysteresis_c;  // step up only this far below hot_c
+    float slowdown;      // encoder time above the best of the level by this fraction counts as throttling
+    int   hold_windows;  // windows at a level before stepping up again
+    int   min_threads;
+};
+
+struct thermal_params thermal_default_params(void);
+
+struct thermal_event {
+    int   window;
+    enum thermal_reason reason;
+    float temp_c;        // hottest CPU zone, -1 when unreadable
+    float encode_ms;     // the window's encoder time
+    struct power_config from;
+    struct power_config to;
+};
+
+struct thermal_governor;
+
+struct thermal_governor * thermal_init(struct thermal_params params);
+void thermal_free(struct thermal_governor * g);
+
+// Starts a call that asked for n_threads on any CPU. The level reached by the
+// previous call is kept while the thread count is the same, since the device
+// is still as warm; events are forgotten.
+void thermal_begin(struct thermal_governor * g, int n_threads);
+
+// Configuration for the next window.
+struct power_config thermal_config(const struct thermal_governor * g);
+
+// Reports a decoded window; encode_ms <= 0 when the window was not encoded
+// at full size (the last, short window with a fitted audio_ctx, or no encode).
+// Returns true when the configuration changed for the next window.
+bool thermal_observe(struct thermal_governor * g, int window, float encode_ms);
+
+float thermal_temp_c(const struct thermal_governor * g);   // -1 without a readable zone
+float thermal_max_temp_c(const struct thermal_governor * g);
+int   thermal_n_throttled_windows(const struct thermal_governor * g);
+
+// events recorded since thermal_begin; only the first few are kept
+int thermal_n_events(const struct thermal_governor * g);
+int thermal_n_kept_events(const struct thermal_governor * g);
+const struct thermal_event * thermal_get_event(const struct thermal_governor * g, int i);
+
+const char * thermal_reason_str(enum thermal_reason reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_THERMAL_H
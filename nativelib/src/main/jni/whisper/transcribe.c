@@ -0,0 +1,824 @@
+#include "transcribe.h"
+#include "alloc_count.h"
+#include "arena.h"
+#include "bias.h"
+#include "diarize.h"
+#include "hallucination.h"
+#include "mel.h"
+#include "model_share.h"
+#include "perf_counters.h"
+#include "pipeline.h"
+#include "power.h"
+#include "thermal.h"
+#include "vad.h"
+#include "ggml.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// whisper's window in mel frames (30 s) and the remainder it ignores (1 s)
+#define TRANSCRIBE_WINDOW    3000
+#define TRANSCRIBE_MIN_TAIL  100
+
+// speech onsets are moved this much earlier when silence is skipped (0.5 s)
+#define TRANSCRIBE_ONSET_PAD 50
+
+struct transcriber {
+    struct whisper_context * ctx;
+    struct transcribe_policy policy;
+
+    struct mel_spectrogram mel;
+    struct vad_frames vad;
+
+    struct hallucination_detector * halluc;
+    bool halluc_enabled;
+
+    struct diarizer * diar;
+    bool diar_enabled;
+
+    struct bias_trie * bias;
+
+    struct pipeline * pipeline;  // created on the first pipelined call
+
+    float * input;               // see transcriber_input_buffer
+    int cap_input;
+
+    // segment text and the joined text of the last call
+    struct arena * arena;
+    const char * text;
+
+    struct transcribe_segment * segments;
+    int n_segments;
+    int cap_segments;
+
+    int last_audio_ctx;          // encoder shape of the last window, -1 before the first
+    int64_t t_first_encode_us;   // first encoder run of the current call
+
+    // opened for each call on the calling thread while enabled
+    bool perf_enabled;
+    struct perf_counters * perf;
+    struct transcribe_perf perf_stages;
+
+    struct thermal_governor * thermal;   // created when first enabled
+    bool thermal_enabled;
+    uint64_t thermal_mask;       // placement applied for the current window, 0 = the caller's
+    uint64_t thermal_affinity;   // the caller's, restored after the call
+
+    struct transcribe_stats stats;
+};
+
+// Per-window probe installed as whisper's callbacks. With batched decoding the
+// first step of every pass runs the logits filter once, at n_tokens == 0, so
+// those calls count the passes. Later steps run the hallucination detector.
+struct window_probe {
+    int n_encodes;
+    int n_passes;
+    int n_steps;            // logits filter calls, one per decoder per step
+    int64_t t_encode_us;    // encoder start
+    int64_t t_decode_us;    // first decoder step
+    int64_t t_fallback_us;  // start of the first fallback pass
+    bool aborted;           // the caller's encoder_begin_callback returned false
+
+    struct perf_counters * perf;             // NULL without counters
+    struct perf_sample perf_encode;          // read with t_encode_us
+    struct perf_sample perf_decode;          // read with t_decode_us
+
+    struct bias_trie * bias;                 // NULL without phrases
+    int n_biased;
+
+    struct hallucination_detector * halluc;  // NULL when disabled
+    int n_stopped;
+    int n_steps_saved;
+    int n_vocab;
+    int max_len;
+    whisper_token eot;
+
+    whisper_encoder_begin_callback encoder_begin;
+    void * encoder_begin_user_data;
+    whisper_logits_filter_callback logits_filter;
+    void * logits_filter_user_data;
+};
+
+struct transcribe_policy transcribe_default_policy(void) {
+    struct transcribe_policy policy = {
+            .max_fallbacks_per_window   = 5,
+            .fallback_budget_per_minute = -1.0f,
+            .min_speech_ratio           = 0.0f,
+            .fallback_speech_ratio      = 0.0f,
+            .skip_silence               = false,
+            .fit_short_clips            = false,
+            .pipelined_encode           = false,
+    };
+    return policy;
+}
+
+struct transcribe_policy transcribe_adaptive_policy(void) {
+    struct transcribe_policy policy = transcribe_default_policy();
+    policy.fallback_budget_per_minute = 4.0f;
+    policy.min_speech_ratio           = 0.02f;
+    policy.fallback_speech_ratio      = 0.2f;
+    policy.skip_silence               = true;
+    return policy;
+}
+
+struct transcriber * transcriber_init(struct whisper_context * ctx) {
+    if (!ctx) {
+        return NULL;
+    }
+    struct transcriber * tr = calloc(1, sizeof(struct transcriber));
+    if (!tr) {
+        return NULL;
+    }
+    tr->arena = arena_init(4096);
+    if (!tr->arena) {
+        free(tr);
+        return NULL;
+    }
+    tr->ctx = ctx;
+    tr->policy = transcribe_default_policy();
+    tr->last_audio_ctx = -1;
+    tr->halluc = hallucination_init(hallucination_default_params());
+    tr->halluc_enabled = false;
+    return tr;
+}
+
+static void transcriber_clear(struct transcriber * tr) {
+    arena_reset(tr->arena);
+    tr->text = NULL;
+    tr->t_first_encode_us = 0;
+    tr->n_segments = 0;
+    memset(&tr->stats, 0, sizeof(tr->stats));
+    perf_sample_clear(&tr->perf_stages.mel);
+    perf_sample_clear(&tr->perf_stages.encode);
+    perf_sample_clear(&tr->perf_stages.decode);
+    perf_sample_clear(&tr->perf_stages.total);
+    if (tr->halluc) {
+        hallucination_reset(tr->halluc);
+    }
+}
+
+void transcriber_free(struct transcriber * tr) {
+    if (!tr) {
+        return;
+    }
+    transcriber_clear(tr);
+    free(tr->segments);
+    mel_spectrogram_free(&tr->mel);
+    vad_frames_free(&tr->vad);
+    hallucination_free(tr->halluc);
+    thermal_free(tr->thermal);
+    diarizer_free(tr->diar);
+    bias_free(tr->bias);
+    pipeline_free(tr->pipeline);
+    free(tr->input);
+    arena_free(tr->arena);
+    model_share_unmap(tr->ctx);
+    whisper_free(tr->ctx);
+    free(tr);
+}
+
+struct whisper_context * transcriber_context(struct transcriber * tr) {
+    return tr->ctx;
+}
+
+void transcriber_set_policy(struct transcriber * tr, struct transcribe_policy policy) {
+    policy.max_fallbacks_per_window = policy.max_fallbacks_per_window < 0 ? 0 : policy.max_fallbacks_per_window;
+    policy.max_fallbacks_per_window = policy.max_fallbacks_per_window > 5 ? 5 : policy.max_fallbacks_per_window;
+    tr->policy = policy;
+}
+
+struct transcribe_policy transcriber_get_policy(const struct transcriber * tr) {
+    return tr->policy;
+}
+
+void transcriber_set_hallucination_filter(struct transcriber * tr, bool enabled) {
+    tr->halluc_enabled = enabled && tr->halluc != NULL;
+}
+
+const struct hallucination_detector * transcriber_hallucinations(const struct transcriber * tr) {
+    return tr->halluc;
+}
+
+void transcriber_set_diarization(struct transcriber * tr, bool enabled) {
+    if (enabled && !tr->diar) {
+        tr->diar = diarizer_init(diarize_default_params());
+    }
+    tr->diar_enabled = enabled && tr->diar != NULL;
+}
+
+const struct diarizer * transcriber_diarizer(const struct transcriber * tr) {
+    return tr->diar_enabled ? tr->diar : NULL;
+}
+
+void transcriber_set_thermal_governor(struct transcriber * tr, bool enabled) {
+    if (enabled && !tr->thermal) {
+        tr->thermal = thermal_init(thermal_default_params());
+    }
+    tr->thermal_enabled = enabled && tr->thermal != NULL;
+}
+
+const struct thermal_governor * transcriber_thermal(const struct transcriber * tr) {
+    return tr->thermal_enabled ? tr->thermal : NULL;
+}
+
+int transcriber_set_perf_counters(struct transcriber * tr, bool enabled) {
+    if (enabled) {
+        // probe once so that the caller learns now whether the kernel allows it
+        struct perf_counters * pc = perf_counters_open();
+        if (!pc) {
+            tr->perf_enabled = false;
+            return -1;
+        }
+        perf_counters_close(pc);
+    }
+    tr->perf_enabled = enabled;
+    return 0;
+}
+
+const struct transcribe_perf * transcriber_perf(const struct transcriber * tr) {
+    return tr->perf_enabled ? &tr->perf_stages : NULL;
+}
+
+// Opens the call's counters unless an outer call already did; returns whether
+// this call owns them.
+static bool transcriber_perf_begin(struct transcriber * tr, struct perf_sample * start) {
+    const bool owner = tr->perf_enabled && !tr->perf;
+    if (owner) {
+        tr->perf = perf_counters_open();
+    }
+    if (tr->perf) {
+        perf_counters_read(tr->perf, start);
+    }
+    return owner;
+}
+
+static void transcriber_perf_end(struct transcriber * tr, const struct perf_sample * start, bool owner) {
+    if (tr->perf) {
+        struct perf_sample now;
+        perf_counters_read(tr->perf, &now);
+        perf_sample_clear(&tr->perf_stages.total);
+        perf_sample_add_diff(&tr->perf_stages.total, start, &now);
+    }
+    if (owner) {
+        perf_counters_close(tr->perf);
+        tr->perf = NULL;
+    }
+}
+
+int transcriber_add_bias_phrase(struct transcriber * tr, const char * text, float boost) {
+    if (!tr->bias) {
+        tr->bias = bias_init();
+        if (!tr->bias) {
+            return -1;
+        }
+    }
+    return bias_add_phrase(tr->bias, tr->ctx, text, boost);
+}
+
+void transcriber_clear_bias(struct transcriber * tr) {
+    if (tr->bias) {
+        bias_clear(tr->bias);
+    }
+}
+
+int transcriber_n_bias_phrases(const struct transcriber * tr) {
+    return tr->bias ? bias_n_phrases(tr->bias) : 0;
+}
+
+float * transcriber_input_buffer(struct transcriber * tr, int n_samples) {
+    if (n_samples > tr->cap_input) {
+        float * input = realloc(tr->input, sizeof(float) * n_samples);
+        if (!input) {
+            return NULL;
+        }
+        tr->input = input;
+        tr->cap_input = n_samples;
+    }
+    return tr->input;
+}
+
+void transcriber_reset(struct transcriber * tr) {
+    transcriber_clear(tr);
+}
+
+int transcriber_n_segments(const struct transcriber * tr) {
+    return tr->n_segments;
+}
+
+const struct transcribe_segment * transcriber_segment(const struct transcriber * tr, int i) {
+    return i >= 0 && i < tr->n_segments ? &tr->segments[i] : NULL;
+}
+
+const char * transcriber_text(struct transcriber * tr) {
+    if (tr->text) {
+        return tr->text;
+    }
+    size_t len = 0;
+    for (int i = 0; i < tr->n_segments; i++) {
+        len += strlen(tr->segments[i].text);
+    }
+    char * text = arena_alloc(tr->arena, len + 1);
+    if (!text) {
+        return "";
+    }
+    char * p = text;
+    for (int i = 0; i < tr->n_segments; i++) {
+        const size_t n = strlen(tr->segments[i].text);
+        memcpy(p, tr->segments[i].text, n);
+        p += n;
+    }
+    *p = '\0';
+    tr->text = text;
+    return text;
+}
+
+const struct transcribe_stats * transcriber_stats(const struct transcriber * tr) {
+    return &tr->stats;
+}
+
+static int64_t alloc_calls(void) {
+    struct alloc_counts counts;
+    alloc_count_get(&counts);
+    return (int64_t) counts.n_allocs;
+}
+
+static void transcriber_finish_stats(struct transcriber * tr, int64_t t_start_us, int64_t n_allocs_start) {
+    struct transcribe_stats * stats = &tr->stats;
+    stats->n_allocs = alloc_count_enabled() ? (int) (alloc_calls() - n_allocs_start) : -1;
+    stats->n_allocs_whisper = alloc_count_enabled() ? stats->n_allocs_whisper : -1;
+    stats->arena_bytes = (int) arena_used(tr->arena);
+    stats->setup_ms = tr->t_first_encode_us > 0 ? (tr->t_first_encode_us - t_start_us)/1000.0f : 0.0f;
+    stats->total_ms = (ggml_time_us() - t_start_us)/1000.0f;
+}
+
+static bool probe_encoder_begin(struct whisper_context * ctx, struct whisper_state * state, void * user_data) {
+    struct window_probe * probe = user_data;
+    // whisper_full would continue with the next window, stop it there
+    if (probe->n_encodes++ > 0) {
+        return false;
+    }
+    probe->t_encode_us = ggml_time_us();
+    if (probe->perf) {
+        perf_counters_read(probe->perf, &probe->perf_encode);
+    }
+    if (probe->encoder_begin && !probe->encoder_begin(ctx, state, probe->encoder_begin_user_data)) {
+        probe->aborted = true;
+        return false;
+    }
+    return true;
+}
+
+static void probe_logits_filter(struct whisper_context * ctx, struct whisper_state * state, const whisper_token_data * tokens, int n_tokens, float * logits, void * user_data) {
+    struct window_probe * probe = user_data;
+    probe->n_steps++;
+    if (probe->t_decode_us == 0) {
+        probe->t_decode_us = ggml_time_us();
+        if (probe->perf) {
+            perf_counters_read(probe->perf, &probe->perf_decode);
+        }
+    }
+    if (n_tokens == 0) {
+        if (probe->n_passes++ == 1) {
+            probe->t_fallback_us = ggml_time_us();
+        }
+    }
+    if (probe->logits_filter) {
+        probe->logits_filter(ctx, state, tokens, n_tokens, logits, probe->logits_filter_user_data);
+    }
+    if (probe->bias && bias_apply(probe->bias, tokens, n_tokens, logits, probe->eot) > 0) {
+        probe->n_biased++;
+    }
+    if (probe->halluc && n_tokens > 0 && hallucination_check(probe->halluc, ctx, tokens, n_tokens) != HALLUCINATION_NONE) {
+        // end the sequence: whisper keeps it up to its last timestamp
+        for (int i = 0; i < probe->n_vocab; i++) {
+            logits[i] = -INFINITY;
+        }
+        logits[probe->eot] = 0.0f;
+        probe->n_stopped++;
+        probe->n_steps_saved += probe->max_len > n_tokens ? probe->max_len - n_tokens : 0;
+    }
+}
+
+static int transcriber_add_segment(struct transcriber * tr, const struct transcribe_segment * seg) {
+    if (tr->n_segments == tr->cap_segments) {
+        const int cap = tr->cap_segments > 0 ? 2*tr->cap_segments : 16;
+        struct transcribe_segment * segments = realloc(tr->segments, sizeof(struct transcribe_segment) * cap);
+        if (!segments) {
+            return -1;
+        }
+        tr->segments = segments;
+        tr->cap_segments = cap;
+    }
+    tr->segments[tr->n_segments++] = *seg;
+    return 0;
+}
+
+static bool same_text(const char * a, const char * b) {
+    while (*a == ' ') {
+        a++;
+    }
+    while (*b == ' ') {
+        b++;
+    }
+    return strcmp(a, b) == 0;
+}
+
+// Segments of a window whose decoder looped repeat earlier text of the same
+// window; on a window without speech anything whisper itself doubts is dropped.
+static bool transcriber_is_hallucination(struct transcriber * tr, int first, const char * text, float no_speech_prob, bool looped) {
+    struct hallucination_detector * det = tr->halluc;
+    if (hallucination_is_strict(det) && no_speech_prob > hallucination_get_params(det)->no_speech_thold) {
+        hallucination_record(det, HALLUCINATION_NO_SPEECH, text);
+        return true;
+    }
+    if (looped) {
+        for (int i = first; i < tr->n_segments; i++) {
+            if (same_text(tr->segments[i].text, text)) {
+                hallucination_record(det, HALLUCINATION_REPETITION, text);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Smallest bucket covering n_frames of audio with a 10% margin, 0 (whisper's
+// full window) when none does.
+static int transcriber_audio_ctx(int n_frames) {
+    static const int buckets[] = TRANSCRIBE_AUDIO_CTX_BUCKETS;
+    const int need = (int) ceilf(n_frames/2.0f*1.1f);
+    for (size_t i = 0; i < sizeof(buckets)/sizeof(buckets[0]); i++) {
+        if (buckets[i] >= need) {
+            return buckets[i];
+        }
+    }
+    return 0;
+}
+
+// Threads and CPUs the thermal governor wants for the next window.
+static void transcriber_thermal_apply(struct transcriber * tr, struct whisper_full_params * wparams) {
+    const struct power_config config = thermal_config(tr->thermal);
+    wparams->n_threads = config.n_threads;
+    if (config.cpu_mask == tr->thermal_mask) {
+        return;
+    }
+    const int rc = tr->thermal_mask == 0
+            ? power_set_affinity(config.cpu_mask, &tr->thermal_affinity)
+            : power_set_affinity(config.cpu_mask != 0 ? config.cpu_mask : tr->thermal_affinity, NULL);
+    if (rc == 0) {
+        tr->thermal_mask = config.cpu_mask;
+    }
+}
+
+// Decodes [0, n_frames) of the spectrogram already set in the context.
+static int transcriber_decode_windows(struct transcriber * tr, struct whisper_full_params params, int n_frames, const struct vad_frames * vad) {
+    struct whisper_context * ctx = tr->ctx;
+    const struct transcribe_policy * policy = &tr->policy;
+    struct transcribe_stats * stats = &tr->stats;
+
+    const bool detect = params.language == NULL || strcmp(params.language, "auto") == 0;
+    const float t_start = params.temperature;
+
+    // whisper ignores calls of 1 s or less: a clip that short (a command) is
+    // decoded with the silence that follows it in the spectrogram
+    const bool short_clip = n_frames > 0 && n_frames <= TRANSCRIBE_MIN_TAIL;
+    if (short_clip) {
+        n_frames = TRANSCRIBE_MIN_TAIL + 1;
+    }
+
+    int budget = INT_MAX;
+    stats->fallback_budget = -1;
+    if (policy->fallback_budget_per_minute >= 0.0f) {
+        budget = (int) ceilf(policy->fallback_budget_per_minute*n_frames/6000.0f);
+        stats->fallback_budget = budget;
+    }
+
+    struct window_probe probe = {
+            .encoder_begin = params.encoder_begin_callback,
+            .encoder_begin_user_data = params.encoder_begin_callback_user_data,
+            .logits_filter = params.logits_filter_callback,
+            .logits_filter_user_data = params.logits_filter_callback_user_data,
+    };
+    params.encoder_begin_callback = probe_encoder_begin;
+    params.encoder_begin_callback_user_data = &probe;
+    params.logits_filter_callback = probe_logits_filter;
+    params.logits_filter_callback_user_data = &probe;
+
+    probe.bias = tr->bias && bias_n_phrases(tr->bias) > 0 && bias_compile(tr->bias) == 0 ? tr->bias : NULL;
+    probe.halluc = tr->halluc_enabled ? tr->halluc : NULL;
+    probe.perf = tr->perf;
+    probe.n_vocab = whisper_n_vocab(ctx);
+    probe.max_len = whisper_n_text_ctx(ctx)/2;
+    probe.eot = whisper_token_eot(ctx);
+
+    if (policy->fit_short_clips && params.audio_ctx == 0 && n_frames < TRANSCRIBE_WINDOW) {
+        params.audio_ctx = transcriber_audio_ctx(n_frames);
+    }
+
+    int seek = 0;
+    while (seek + TRANSCRIBE_MIN_TAIL < n_frames) {
+        float speech = 1.0f;
+        if (vad) {
+            if (policy->skip_silence && !short_clip) {
+                const int next = vad_next_speech(vad, seek);
+                const int start = next < 0 ? n_frames : next - TRANSCRIBE_ONSET_PAD;
+                if (start > seek) {
+                    stats->skipped_s += (start - seek)/100.0f;
+                    seek = start;
+                    continue;
+                }
+            }
+            speech = vad_speech_ratio(vad, seek, seek + TRANSCRIBE_WINDOW);
+            if (speech < policy->min_speech_ratio) {
+                const int end = seek + TRANSCRIBE_WINDOW < n_frames ? seek + TRANSCRIBE_WINDOW : n_frames;
+                stats->skipped_s += (end - seek)/100.0f;
+                stats->n_windows_skipped++;
+                seek = end;
+                continue;
+            }
+        }
+
+        // fallbacks this window may use: none for mostly silent windows,
+        // otherwise as many as the remaining budget allows
+        int n_allowed = speech < policy->fallback_speech_ratio ? 0 : policy->max_fallbacks_per_window;
+        if (n_allowed > budget - stats->n_fallbacks) {
+            n_allowed = budget - stats->n_fallbacks;
+            stats->n_windows_capped++;
+        }
+
+        // whisper tries temperature, temperature + inc, ... up to 1.0, so a
+        // coarser step is a shorter schedule
+        struct whisper_full_params wparams = params;
+        wparams.offset_ms = seek*10;
+        wparams.duration_ms = (n_frames - seek)*10;
+        wparams.temperature_inc = n_allowed > 0 ? (1.0f - t_start)/n_allowed : 0.0f;
+        if (wparams.temperature_inc > 0.0f && wparams.temperature_inc < 0.2f) {
+            wparams.temperature_inc = 0.2f;
+        }
+
+        probe.n_encodes = 0;
+        probe.n_passes = 0;
+        probe.n_steps = 0;
+        probe.t_encode_us = 0;
+        probe.t_decode_us = 0;
+        probe.t_fallback_us = 0;
+        probe.n_biased = 0;
+        probe.n_stopped = 0;
+        probe.n_steps_saved = 0;
+
+        if (tr->thermal_enabled) {
+            transcriber_thermal_apply(tr, &wparams);
+        }
+
+        const bool non_speech = vad && speech < policy->fallback_speech_ratio;
+        if (probe.halluc) {
+            hallucination_set_window(probe.halluc, stats->n_windows, non_speech);
+        }
+
+        const int64_t n_allocs_before = alloc_calls();
+        const int64_t t0_us = ggml_time_us();
+        if (whisper_full(ctx, wparams, NULL, 0) != 0) {
+            return -1;
+        }
+        const int64_t t1_us = ggml_time_us();
+        struct perf_sample perf_end;
+        if (probe.perf) {
+            perf_counters_read(probe.perf, &perf_end);
+        }
+        stats->n_allocs_whisper += (int) (alloc_calls() - n_allocs_before);
+
+        float encode_ms = 0.0f;
+        if (probe.n_encodes > 0) {
+            if (tr->t_first_encode_us == 0) {
+                tr->t_first_encode_us = probe.t_encode_us;
+            }
+            encode_ms = ((probe.t_decode_us > 0 ? probe.t_decode_us : t1_us) - probe.t_encode_us)/1000.0f;
+            stats->encode_ms += encode_ms;
+            if (probe.perf) {
+                perf_sample_add_diff(&tr->perf_stages.encode, &probe.perf_encode, probe.t_decode_us > 0 ? &probe.perf_decode : &perf_end);
+                if (probe.t_decode_us > 0) {
+                    perf_sample_add_diff(&tr->perf_stages.decode, &probe.perf_decode, &perf_end);
+                }
+            }
+            stats->n_shape_reuses += wparams.audio_ctx == tr->last_audio_ctx;
+            stats->audio_ctx = wparams.audio_ctx;
+            tr->last_audio_ctx = wparams.audio_ctx;
+        }
+
+        if (probe.aborted) {
+            break;
+        }
+
+        const int n_fallbacks = probe.n_passes > 1 ? probe.n_passes - 1 : 0;
+        const float fallback_ms = probe.t_fallback_us > 0 ? (t1_us - probe.t_fallback_us)/1000.0f : 0.0f;
+        const float window_ms = (t1_us - t0_us)/1000.0f;
+
+        stats->n_passes += probe.n_passes;
+        stats->n_steps += probe.n_steps;
+        stats->n_fallbacks += n_fallbacks;
+        stats->fallback_ms += fallback_ms;
+        stats->n_biased_steps += probe.n_biased;
+        stats->n_stopped += probe.n_stopped;
+        stats->n_steps_saved += probe.n_steps_saved;
+
+        int64_t t_end = seek;
+        const int n_segments = whisper_full_n_segments(ctx);
+        const int n_kept_before = tr->n_segments;
+        for (int i = 0; i < n_segments; i++) {
+            const char * text = whisper_full_get_segment_text(ctx, i);
+            t_end = whisper_full_get_segment_t1(ctx, i) > t_end ? whisper_full_get_segment_t1(ctx, i) : t_end;
+
+            if (probe.halluc && transcriber_is_hallucination(tr, n_kept_before, text, whisper_full_get_segment_no_speech_prob(ctx, i), probe.n_stopped > 0)) {
+                stats->n_suppressed++;
+                continue;
+            }
+
+            struct transcribe_segment seg = {
+                    .t0 = whisper_full_get_segment_t0(ctx, i),
+                    .t1 = whisper_full_get_segment_t1(ctx, i),
+                    .text = arena_strdup(tr->arena, text ? text : ""),
+                    .no_speech_prob = whisper_full_get_segment_no_speech_prob(ctx, i),
+                    .window = stats->n_windows,
+                    .n_fallbacks = n_fallbacks,
+                    .fallback_ms = fallback_ms,
+                    .window_ms = window_ms,
+                    .speaker = -1,
+            };
+            if (!seg.text || transcriber_add_segment(tr, &seg) != 0) {
+                return -1;
+            }
+        }
+        // only full windows encode the same amount of work
+        if (tr->thermal_enabled) {
+            thermal_observe(tr->thermal, stats->n_windows, wparams.audio_ctx == 0 ? encode_ms : 0.0f);
+        }
+        stats->n_windows++;
+
+        // the detected language holds for the rest of the call, so later
+        // windows do not pay for another detection pass
+        if (detect && whisper_full_lang_id(ctx) >= 0) {
+            params.language = whisper_lang_str(whisper_full_lang_id(ctx));
+        }
+
+        // whisper resumes after the last timestamp; a window without one is consumed whole
+        seek = t_end > seek ? (int) t_end : seek + TRANSCRIBE_WINDOW;
+    }
+
+    return 0;
+}
+
+static int transcriber_run_windows(struct transcriber * tr, struct whisper_full_params params, int n_frames, const struct vad_frames * vad) {
+    if (!tr->thermal_enabled) {
+        return transcriber_decode_windows(tr, params, n_frames, vad);
+    }
+    thermal_begin(tr->thermal, params.n_threads);
+    tr->thermal_mask = 0;
+    const int rc = transcriber_decode_windows(tr, params, n_frames, vad);
+    if (tr->thermal_mask != 0) {
+        power_set_affinity(tr->thermal_affinity, NULL);
+    }
+    return rc;
+}
+
+static int transcriber_on_pipeline_segment(const struct pipeline_segment * ps, void * user_data) {
+    struct transcriber * tr = user_data;
+    struct transcribe_segment seg = {
+            .t0 = ps->t0,
+            .t1 = ps->t1,
+            .text = arena_strdup(tr->arena, ps->text),
+            .window = ps->window,
+            .speaker = -1,
+    };
+    return seg.text && transcriber_add_segment(tr, &seg) == 0 ? 0 : -1;
+}
+
+// Decodes [0, n_frames) of mel with the encoder running ahead, see pipeline.h.
+static int transcriber_run_pipelined(struct transcriber * tr, struct whisper_full_params params, const struct mel_spectrogram * mel, int n_frames) {
+    if (!tr->pipeline) {
+        tr->pipeline = pipeline_init(tr->ctx);
+        if (!tr->pipeline) {
+            return -1;
+        }
+    }
+
+    const struct pipeline_params pparams = {
+            .language = params.language,
+            .translate = params.translate,
+            .n_threads = params.n_threads,
+            .skip_silence = tr->policy.skip_silence,
+            .min_speech_ratio = tr->policy.min_speech_ratio,
+            .onset_pad = TRANSCRIBE_ONSET_PAD,
+    };
+    const int64_t n_allocs_before = alloc_calls();
+    const int rc = pipeline_run(tr->pipeline, pparams, mel, &tr->vad, n_frames, transcriber_on_pipeline_segment, tr);
+
+    const struct pipeline_stats * ps = pipeline_get_stats(tr->pipeline);
+    struct transcribe_stats * stats = &tr->stats;
+    stats->n_allocs_whisper += (int) (alloc_calls() - n_allocs_before);
+    stats->n_windows = ps->n_windows;
+    stats->n_windows_skipped = ps->n_windows_skipped;
+    stats->n_passes = ps->n_windows;
+    stats->skipped_s = ps->skipped_s;
+    stats->encode_ms = ps->encode_ms;
+    stats->n_speculated = ps->n_speculated;
+    stats->n_spec_hits = ps->n_hits;
+    stats->encode_hidden_ms = ps->encode_hidden_ms;
+    stats->fallback_budget = 0;
+    return rc;
+}
+
+static int transcriber_run_mel_counted(struct transcriber * tr, struct whisper_full_params params, const struct mel_spectrogram * mel) {
+    const int64_t t_start_us = ggml_time_us();
+    const int64_t n_allocs_start = alloc_calls();
+    transcriber_clear(tr);
+
+    if (mel->n_len_org <= 0) {
+        return -1;
+    }
+
+    const bool has_vad = vad_from_mel(mel, VAD_DEFAULT_MARGIN, &tr->vad) == 0;
+
+    // the pipeline sets each window in its own states
+    const bool pipelined = tr->policy.pipelined_encode && has_vad && mel->n_len_org > TRANSCRIBE_WINDOW;
+    if (!pipelined && whisper_set_mel(tr->ctx, mel->data, mel->n_len, mel->n_mel) != 0) {
+        return -1;
+    }
+
+    // diarization only reads mel and the VAD, so it overlaps with the decoder
+    const bool diarize = tr->diar_enabled && has_vad && diarizer_start(tr->diar, mel, &tr->vad) == 0;
+
+    const int rc = pipelined
+            ? transcriber_run_pipelined(tr, params, mel, mel->n_len_org)
+            : transcriber_run_windows(tr, params, mel->n_len_org, has_vad ? &tr->vad : NULL);
+
+    if (diarize) {
+        const int64_t t_wait_us = ggml_time_us();
+        const int rc_diar = diarizer_wait(tr->diar);
+        tr->stats.diarize_wait_ms = (ggml_time_us() - t_wait_us)/1000.0f;
+        tr->stats.diarize_ms = diarizer_time_ms(tr->diar);
+        if (rc_diar == 0) {
+            tr->stats.n_speakers = diarizer_n_speakers(tr->diar);
+            for (int i = 0; i < tr->n_segments; i++) {
+                tr->segments[i].speaker = diarizer_speaker_at(tr->diar, tr->segments[i].t0, tr->segments[i].t1);
+            }
+        }
+    }
+
+    transcriber_finish_stats(tr, t_start_us, n_allocs_start);
+    return rc;
+}
+
+int transcriber_run_mel(struct transcriber * tr, struct whisper_full_params params, const struct mel_spectrogram * mel) {
+    struct perf_sample start;
+    const bool owner = transcriber_perf_begin(tr, &start);
+    const int rc = transcriber_run_mel_counted(tr, params, mel);
+    transcriber_perf_end(tr, &start, owner);
+    return rc;
+}
+
+static int transcriber_run_pcm_counted(struct transcriber * tr, struct whisper_full_params params, const float * samples, int n_samples,
+        const struct perf_sample * perf_start) {
+    const int64_t t_start_us = ggml_time_us();
+    const int64_t n_allocs_start = alloc_calls();
+
+    const struct mel_frontend * fe = mel_frontend_get(whisper_model_n_mels(tr->ctx));
+    if (fe && mel_frontend_compute(fe, samples, n_samples, params.n_threads, &tr->mel) == 0) {
+        const float mel_ms = (ggml_time_us() - t_start_us)/1000.0f;
+        struct perf_sample perf_mel;
+        if (tr->perf) {
+            perf_counters_read(tr->perf, &perf_mel);
+        }
+        const int rc = transcriber_run_mel(tr, params, &tr->mel);
+        tr->stats.mel_ms = mel_ms;
+        if (tr->perf) {
+            perf_sample_add_diff(&tr->perf_stages.mel, perf_start, &perf_mel);
+        }
+        transcriber_finish_stats(tr, t_start_us, n_allocs_start);
+        return rc;
+    }
+
+    // whisper's own front-end: no frames to run the VAD on
+    transcriber_clear(tr);
+    if (whisper_pcm_to_mel(tr->ctx, samples, n_samples, params.n_threads) != 0) {
+        return -1;
+    }
+    tr->stats.mel_ms = (ggml_time_us() - t_start_us)/1000.0f;
+    if (tr->perf) {
+        struct perf_sample perf_mel;
+        perf_counters_read(tr->perf, &perf_mel);
+        perf_sample_add_diff(&tr->perf_stages.mel, perf_start, &perf_mel);
+    }
+    const int rc = transcriber_run_windows(tr, params, whisper_n_len(tr->ctx), NULL);
+    transcriber_finish_stats(tr, t_start_us, n_allocs_start);
+    return rc;
+}
+
+int transcriber_run_pcm(struct transcriber * tr, struct whisper_full_params params, const float * samples, int n_samples) {
+    struct perf_sample start;
+    const bool owner = transcriber_perf_begin(tr, &start);
+    const int rc = transcriber_run_pcm_counted(tr, params, samples, n_samples, &start);
+    transcriber_perf_end(tr, &start, owner);
+    return rc;
+}
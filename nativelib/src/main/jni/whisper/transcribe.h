@@ -0,0 +1,179 @@
+#ifndef WHISPER_JNI_TRANSCRIBE_H
+#define WHISPER_JNI_TRANSCRIBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "perf_counters.h"
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mel_spectrogram;
+struct hallucination_detector;
+struct diarizer;
+struct thermal_governor;
+
+// Temperature fallback policy. whisper retries a window at higher temperatures
+// (each retry is a full decoder pass) when the output looks unreliable; the
+// transcriber sizes that schedule per window so one bad recording cannot burn
+// an unbounded number of passes.
+struct transcribe_policy {
+    int   max_fallbacks_per_window;   // 0..5, whisper's default schedule has 5
+    float fallback_budget_per_minute; // fallbacks per call per minute of audio, < 0 = unlimited
+    float min_speech_ratio;           // windows with less VAD speech are not decoded
+    float fallback_speech_ratio;      // windows with less VAD speech get no fallbacks
+    bool  skip_silence;               // start windows at the next VAD speech frame
+    bool  fit_short_clips;            // clips under 30 s encode a bucketed audio_ctx, see below
+    bool  pipelined_encode;           // audio over 30 s: encode the next window while decoding, see pipeline.h
+};
+
+// whisper plans the allocation of its compute graphs on every call and keeps
+// the plan while the graph shape stays the same. With fit_short_clips a clip
+// shorter than one window is encoded with the smallest of these audio_ctx
+// sizes that covers it instead of all 1500 positions: a short clip skips the
+// encoder work on padding, and repeated clips of similar length run graphs of
+// identical shape, so whisper reuses its plan instead of replanning.
+#define TRANSCRIBE_AUDIO_CTX_BUCKETS { 128, 256, 512, 1024 }
+
+// The default policy decodes like whisper_full: every window, the full
+// fallback schedule, no budget. The adaptive policy skips silence, gives
+// nearly silent windows no fallbacks and caps them at 4 per minute of audio;
+// callers opt in with transcriber_set_policy.
+struct transcribe_policy transcribe_default_policy(void);
+struct transcribe_policy transcribe_adaptive_policy(void);
+
+struct transcribe_segment {
+    int64_t t0;           // centiseconds
+    int64_t t1;
+    char * text;          // owned by the transcriber, valid until its next call
+    float no_speech_prob;
+    int   window;         // index of the decoded window the segment came from
+    int   n_fallbacks;    // fallback passes spent on that window
+    float fallback_ms;    // time spent in those passes
+    float window_ms;      // encode + all passes of that window
+    int   speaker;        // diarization speaker id, -1 when unknown or disabled
+};
+
+struct transcribe_stats {
+    int   n_windows;          // windows decoded
+    int   n_windows_skipped;  // windows skipped as non-speech
+    int   n_passes;           // decoder passes, first attempts included
+    int   n_steps;            // decoder steps over all passes and decoders
+    int   n_fallbacks;
+    int   fallback_budget;    // -1 = unlimited
+    int   n_windows_capped;   // windows whose schedule the budget shortened
+    float fallback_ms;
+    int   n_stopped;          // decoders ended early by the hallucination detector
+    int   n_steps_saved;      // upper bound of the decoder steps this saved
+    int   n_suppressed;       // hallucinated segments dropped from the results
+    int   n_speakers;         // diarization, 0 when disabled
+    float diarize_ms;         // diarization thread time
+    float diarize_wait_ms;    // time the decoder waited for it at the end
+    int   n_biased_steps;     // decoder steps whose logits a phrase raised
+    int   n_allocs;           // heap allocations during the call, -1 without WHISPER_COUNT_ALLOCS
+    int   n_allocs_whisper;   // the part made inside whisper_full
+    int   arena_bytes;        // per-call data held in the transcriber's arena
+    int   audio_ctx;          // encoder positions of the last window, 0 = whisper's full window
+    int   n_shape_reuses;     // windows encoded with the same shape as the window before them
+    float setup_ms;           // call start to the first encoder run: mel, VAD, whisper's own setup
+    float encode_ms;          // encoder runs up to each window's first decoder step
+    int   n_speculated;       // pipelined_encode: windows encoded ahead of the decoder
+    int   n_spec_hits;        // of those, used
+    float encode_hidden_ms;   // encoder time that overlapped decoding
+    float skipped_s;          // audio not decoded because of the VAD
+    float mel_ms;
+    float total_ms;
+};
+
+// Owns a whisper context and the results of its last call.
+struct transcriber;
+
+// Takes ownership of ctx, which is freed with the transcriber.
+struct transcriber * transcriber_init(struct whisper_context * ctx);
+void transcriber_free(struct transcriber * tr);
+
+struct whisper_context * transcriber_context(struct transcriber * tr);
+
+void transcriber_set_policy(struct transcriber * tr, struct transcribe_policy policy);
+struct transcribe_policy transcriber_get_policy(const struct transcriber * tr);
+
+// The hallucination detector (off by default) ends decoders that loop and drops
+// their repeated or no-speech segments; its events describe what was removed.
+void transcriber_set_hallucination_filter(struct transcriber * tr, bool enabled);
+const struct hallucination_detector * transcriber_hallucinations(const struct transcriber * tr);
+
+// Speaker diarization (off by default) runs on its own thread next to the
+// decoder and sets transcribe_segment.speaker. Needs the native spectrogram.
+void transcriber_set_diarization(struct transcriber * tr, bool enabled);
+const struct diarizer * transcriber_diarizer(const struct transcriber * tr);
+
+// Thermal governor (off by default, see thermal.h): between windows it lowers
+// the thread count and moves the threads to slower clusters while the device
+// throttles, and records what it saw. Its placement replaces the calling
+// thread's affinity for the windows it moves and is undone at the end of the
+// call; the level reached carries over to the next call. Not applied to the
+// pipelined path.
+void transcriber_set_thermal_governor(struct transcriber * tr, bool enabled);
+const struct thermal_governor * transcriber_thermal(const struct transcriber * tr);
+
+// Hardware counters per stage (off by default, see perf_counters.h), opened
+// for each call on the calling thread. Stages are split like the stage times
+// of transcribe_stats; the pipelined path fills mel and total only. Returns -1
+// when the kernel refuses perf_event_open.
+struct transcribe_perf {
+    struct perf_sample mel;
+    struct perf_sample encode;   // encoder runs up to each window's first decoder step
+    struct perf_sample decode;   // from there to the end of each window, fallbacks included
+    struct perf_sample total;
+};
+
+int transcriber_set_perf_counters(struct transcriber * tr, bool enabled);
+// Stages of the last call, NULL while disabled.
+const struct transcribe_perf * transcriber_perf(const struct transcriber * tr);
+
+// Vocabulary biasing: the decoder favours these phrases (names, product
+// terms) through logit boosts; boost is in logits, 2-5 is typical. Phrases
+// stay until cleared. Returns 0 on success.
+int  transcriber_add_bias_phrase(struct transcriber * tr, const char * text, float boost);
+void transcriber_clear_bias(struct transcriber * tr);
+int  transcriber_n_bias_phrases(const struct transcriber * tr);
+
+// Transcribe 16 kHz mono samples. The spectrogram is computed with the native
+// front-end (whisper_pcm_to_mel as a fallback) and decoded one 30 s window at a
+// time. offset_ms, duration_ms and temperature_inc of params are overridden,
+// callbacks set by the caller are still invoked. Returns 0 on success.
+//
+// With pipelined_encode, audio longer than one window is decoded by the
+// pipeline instead of whisper_full when the VAD is available: greedy, without
+// temperature fallback, hallucination filter or vocabulary biasing, and the
+// caller's whisper callbacks are not invoked.
+int transcriber_run_pcm(struct transcriber * tr, struct whisper_full_params params, const float * samples, int n_samples);
+
+// Same on a spectrogram computed elsewhere (e.g. a mel_stream window).
+int transcriber_run_mel(struct transcriber * tr, struct whisper_full_params params, const struct mel_spectrogram * mel);
+
+// Reusable buffer for callers that copy their samples in before a call (the
+// JNI fast path, which Kotlin only uses for clips of up to 30 s), grown to
+// the largest request. NULL when out of memory.
+float * transcriber_input_buffer(struct transcriber * tr, int n_samples);
+
+// Drops the segments, text and statistics of the last call, for callers that
+// give up before running one so that they do not read stale results.
+void transcriber_reset(struct transcriber * tr);
+
+int transcriber_n_segments(const struct transcriber * tr);
+const struct transcribe_segment * transcriber_segment(const struct transcriber * tr, int i);
+
+// Text of all segments joined, built once per call in the transcriber's arena
+// (no heap allocation once the arena has grown to the largest call).
+const char * transcriber_text(struct transcriber * tr);
+const struct transcribe_stats * transcriber_stats(const struct transcriber * tr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_TRANSCRIBE_H
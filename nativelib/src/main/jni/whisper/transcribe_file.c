@@ -0,0 +1,127 @@
+#include "transcribe_file.h"
+#include "audio_file.h"
+#include "ggml.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// samples of one whisper window and of one centisecond
+#define TRANSCRIBE_FILE_WINDOW (30*AUDIO_FILE_RATE)
+#define TRANSCRIBE_FILE_CS     (AUDIO_FILE_RATE/100)
+
+int transcribe_stream(struct transcriber * tr, struct whisper_full_params params, transcribe_read_callback read,
+        void * reader, int chunk_s, transcribe_file_callback cb, void * user_data, struct transcribe_file_stats * stats) {
+    const int64_t t_start_us = ggml_time_us();
+    struct transcribe_file_stats st;
+    memset(&st, 0, sizeof(st));
+
+    chunk_s = chunk_s > 0 ? chunk_s : TRANSCRIBE_FILE_DEFAULT_CHUNK_S;
+    if (chunk_s > TRANSCRIBE_FILE_MAX_CHUNK_S) {
+        return -1;
+    }
+    if (chunk_s < TRANSCRIBE_FILE_MIN_CHUNK_S) {
+        chunk_s = TRANSCRIBE_FILE_MIN_CHUNK_S;
+    }
+    const int cap = chunk_s*AUDIO_FILE_RATE;
+
+    float * buf = malloc(sizeof(float) * (size_t) cap);
+    if (!buf) {
+        return -1;
+    }
+    st.buffer_bytes = sizeof(float) * cap;
+
+    int64_t base = 0;   // file position of buf[0], in samples
+    int n_buf = 0;
+    bool eof = false;
+    int rc = 0;
+    bool stopped = false;
+    while (!stopped) {
+        const int64_t t_read_us = ggml_time_us();
+        while (!eof && n_buf < cap) {
+            const int n = read(reader, buf + n_buf, cap - n_buf);
+            if (n < 0) {
+                rc = -1;
+                break;
+            }
+            eof = n == 0;
+            n_buf += n;
+        }
+        st.read_ms += (ggml_time_us() - t_read_us)/1000.0f;
+        if (rc != 0 || n_buf == 0) {
+            break;
+        }
+        st.duration_s = (float) (base + n_buf)/AUDIO_FILE_RATE;
+
+        if (transcriber_run_pcm(tr, params, buf, n_buf) != 0) {
+            rc = -1;
+            break;
+        }
+
+        // segments reaching into the chunk's last window may be cut by its
+        // end: they are held back and decoded again with the next chunk, which
+        // starts where the last kept segment ends, or later when silence
+        // separates it from the first held one
+        const int n_segments = transcriber_n_segments(tr);
+        const int64_t tail = (int64_t) n_buf - TRANSCRIBE_FILE_WINDOW;
+        int n_keep = 0;
+        while (n_keep < n_segments && (eof || transcriber_segment(tr, n_keep)->t1*TRANSCRIBE_FILE_CS <= tail)) {
+            n_keep++;
+        }
+        int consumed = n_buf;
+        if (!eof) {
+            int64_t cut = tail;
+            if (n_keep < n_segments) {
+                const int64_t held = transcriber_segment(tr, n_keep)->t0*TRANSCRIBE_FILE_CS;
+                cut = held < tail ? held : tail;
+            }
+            if (n_keep > 0) {
+                const int64_t kept = transcriber_segment(tr, n_keep - 1)->t1*TRANSCRIBE_FILE_CS;
+                cut = kept > cut ? kept : cut;
+            }
+            consumed = cut > 0 ? (int) cut : (int) tail;
+            consumed -= consumed % TRANSCRIBE_FILE_CS;
+            st.carried_s += (float) (n_buf - consumed)/AUDIO_FILE_RATE;
+        }
+
+        for (int i = 0; i < n_keep; i++) {
+            struct transcribe_segment seg = *transcriber_segment(tr, i);
+            seg.t0 += base/TRANSCRIBE_FILE_CS;
+            seg.t1 += base/TRANSCRIBE_FILE_CS;
+            seg.window += st.n_windows;
+            st.n_segments++;
+            if (cb && cb(&seg, user_data) != 0) {
+                stopped = true;
+                break;
+            }
+        }
+        st.n_chunks++;
+        st.n_windows += transcriber_stats(tr)->n_windows;
+
+        memmove(buf, buf + consumed, sizeof(float) * (n_buf - consumed));
+        base += consumed;
+        n_buf -= consumed;
+    }
+
+    free(buf);
+    st.total_ms = (ggml_time_us() - t_start_us)/1000.0f;
+    if (stats) {
+        *stats = st;
+    }
+    return rc;
+}
+
+static int transcribe_file_read(void * reader, float * out, int n) {
+    return audio_file_read((struct audio_file *) reader, out, n);
+}
+
+int transcribe_file(struct transcriber * tr, struct whisper_full_params params, const char * path, int chunk_s,
+        transcribe_file_callback cb, void * user_data, struct transcribe_file_stats * stats) {
+    struct audio_file * f = audio_file_open(path);
+    if (!f) {
+        return -1;
+    }
+    const int rc = transcribe_stream(tr, params, transcribe_file_read, f, chunk_s, cb, user_data, stats);
+    audio_file_close(f);
+    return rc;
+}
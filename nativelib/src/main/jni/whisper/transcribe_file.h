@@ -0,0 +1,59 @@
+#ifndef WHISPER_JNI_TRANSCRIBE_FILE_H
+#define WHISPER_JNI_TRANSCRIBE_FILE_H
+
+#include <stddef.h>
+
+#include "transcribe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transcription of audio files of any length with bounded memory. The file is
+// read and resampled into a buffer of chunk_s seconds that the transcriber
+// decodes; segments that reach into the chunk's last window may be cut by the
+// chunk's end, so they are held back and the next chunk starts where the last
+// kept segment ended. Peak memory is the buffer and the transcriber's
+// spectrogram of one chunk, whatever the duration of the file.
+#define TRANSCRIBE_FILE_DEFAULT_CHUNK_S 600
+// shortest chunk, two windows so that one survives the cut; shorter chunks
+// are read as this long, so their segments arrive no sooner
+#define TRANSCRIBE_FILE_MIN_CHUNK_S 60
+// longest chunk accepted, 230 MB of samples
+#define TRANSCRIBE_FILE_MAX_CHUNK_S 3600
+
+struct transcribe_file_stats {
+    float duration_s;      // audio read
+    int   n_chunks;
+    int   n_segments;
+    int   n_windows;       // decoded over all chunks
+    float carried_s;       // audio carried over to the next chunk and decoded again
+    size_t buffer_bytes;   // sample buffer, independent of the duration
+    float read_ms;         // file reading, decoding, conversion and resampling
+    float total_ms;
+};
+
+// Called with every kept segment, times relative to the start of the file.
+// Returns 0 to continue, anything else stops the transcription.
+typedef int (*transcribe_file_callback)(const struct transcribe_segment * seg, void * user_data);
+
+// Returns 0 on success, also when the callback stopped it, -1 when the file
+// cannot be read, a chunk fails to decode or chunk_s is above
+// TRANSCRIBE_FILE_MAX_CHUNK_S (0 or less takes the default). stats may be NULL.
+int transcribe_file(struct transcriber * tr, struct whisper_full_params params, const char * path, int chunk_s,
+        transcribe_file_callback cb, void * user_data, struct transcribe_file_stats * stats);
+
+// Reads up to n 16 kHz mono samples. Returns the number read, 0 at the end,
+// -1 on error.
+typedef int (*transcribe_read_callback)(void * reader, float * out, int n);
+
+// Same over any sample source, e.g. a socket: chunks are decoded as soon as
+// they are full, so segments come out while the audio is still arriving.
+int transcribe_stream(struct transcriber * tr, struct whisper_full_params params, transcribe_read_callback read,
+        void * reader, int chunk_s, transcribe_file_callback cb, void * user_data, struct transcribe_file_stats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_TRANSCRIBE_FILE_H
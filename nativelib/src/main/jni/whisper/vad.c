@@ -0,0 +1,119 @@
+#include "vad.h"
+#include "mel.h"
+#include "vec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VAD_HIST_BINS 256
+
+// frames a speech decision is extended on both sides (200 ms)
+#define VAD_HANGOVER 20
+
+int vad_from_mel(const struct mel_spectrogram * mel, float margin, struct vad_frames * out) {
+    const int n = mel->n_len_org;
+    if (n <= 0 || mel->n_mel <= 0) {
+        return -1;
+    }
+
+    if (out->capacity < n) {
+        uint8_t * speech = realloc(out->speech, n);
+        if (speech) {
+            out->speech = speech;
+        }
+        float * energy = realloc(out->energy, sizeof(float) * n);
+        if (energy) {
+            out->energy = energy;
+        }
+        if (!speech || !energy) {
+            return -1;
+        }
+        out->capacity = n;
+    }
+    out->n = n;
+
+    // rows are contiguous per mel bin, so accumulate whole rows
+    float * e = out->energy;
+    memset(e, 0, sizeof(float) * n);
+    for (int j = 0; j < mel->n_mel; j++) {
+        vec_acc_f32(n, e, mel->data + (size_t) j*mel->n_len);
+    }
+    vec_scale_f32(n, e, 1.0f/mel->n_mel);
+
+    float e_min = e[0];
+    float e_max = e[0];
+    for (int i = 1; i < n; i++) {
+        e_min = e[i] < e_min ? e[i] : e_min;
+        e_max = e[i] > e_max ? e[i] : e_max;
+    }
+
+    // 10th percentile from a histogram, the range after normalization is small
+    int hist[VAD_HIST_BINS] = {0};
+    const float range = e_max - e_min;
+    const float scale = range > 0.0f ? (VAD_HIST_BINS - 1)/range : 0.0f;
+    for (int i = 0; i < n; i++) {
+        hist[(int) ((e[i] - e_min)*scale)]++;
+    }
+    int bin = 0;
+    for (int acc = 0; bin < VAD_HIST_BINS; bin++) {
+        acc += hist[bin];
+        if (acc*10 >= n) {
+            break;
+        }
+    }
+    out->floor = e_min + (scale > 0.0f ? bin/scale : 0.0f);
+    out->threshold = out->floor + margin;
+
+    // threshold decisions dilated by the hangover: one pass forward, one backward
+    uint8_t * s = out->speech;
+    for (int i = 0, last = -VAD_HANGOVER - 1; i < n; i++) {
+        if (e[i] > out->threshold) {
+            last = i;
+        }
+        s[i] = i - last <= VAD_HANGOVER;
+    }
+    for (int i = n - 1, next = n + VAD_HANGOVER; i >= 0; i--) {
+        if (e[i] > out->threshold) {
+            next = i;
+        }
+        s[i] |= next - i <= VAD_HANGOVER;
+    }
+
+    return 0;
+}
+
+void vad_frames_free(struct vad_frames * vad) {
+    free(vad->speech);
+    free(vad->energy);
+    memset(vad, 0, sizeof(*vad));
+}
+
+float vad_speech_ratio(const struct vad_frames * vad, int i0, int i1) {
+    i0 = i0 < 0 ? 0 : i0;
+    i1 = i1 > vad->n ? vad->n : i1;
+    if (i1 <= i0) {
+        return 0.0f;
+    }
+    int count = 0;
+    for (int i = i0; i < i1; i++) {
+        count += vad->speech[i];
+    }
+    return (float) count/(i1 - i0);
+}
+
+int vad_next_speech(const struct vad_frames * vad, int from) {
+    for (int i = from < 0 ? 0 : from; i < vad->n; i++) {
+        if (vad->speech[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int vad_next_silence(const struct vad_frames * vad, int from) {
+    int i = from < 0 ? 0 : from;
+    while (i < vad->n && vad->speech[i]) {
+        i++;
+    }
+    return i;
+}
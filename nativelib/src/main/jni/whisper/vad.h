@@ -0,0 +1,46 @@
+#ifndef WHISPER_JNI_VAD_H
+#define WHISPER_JNI_VAD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mel_spectrogram;
+
+// Energy voice activity detection on a normalized log-mel spectrogram, one
+// decision per 10 ms frame. The threshold adapts to the clip: a frame is
+// speech when its mean log-mel energy is margin above the noise floor
+// (10th percentile), and decisions are widened by a short hangover.
+struct vad_frames {
+    int n;             // frames analysed (mel->n_len_org)
+    uint8_t * speech;  // [n] 1 for speech
+    float * energy;    // [n] mean normalized log-mel energy
+    float floor;       // noise floor estimate
+    float threshold;
+    int capacity;
+};
+
+// default margin in normalized log-mel units (1.0 = 40 dB)
+#define VAD_DEFAULT_MARGIN 0.2f
+
+// Returns 0 on success. Buffers in out are reused across calls.
+int vad_from_mel(const struct mel_spectrogram * mel, float margin, struct vad_frames * out);
+
+void vad_frames_free(struct vad_frames * vad);
+
+// fraction of speech frames in [i0, i1)
+float vad_speech_ratio(const struct vad_frames * vad, int i0, int i1);
+
+// first speech frame at or after from, -1 if there is none
+int vad_next_speech(const struct vad_frames * vad, int from);
+
+// first non-speech frame at or after from, vad->n if speech runs to the end
+int vad_next_silence(const struct vad_frames * vad, int from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHISPER_JNI_VAD_H
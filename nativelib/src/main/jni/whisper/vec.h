@@ -0,0 +1,295 @@
+#ifndef WHISPER_JNI_VEC_H
+#define WHISPER_JNI_VEC_H
+
+// Small SIMD helpers shared by the native front-end stages.
+// NEON on arm64/armv7 (vfpv4), AVX on x86 hosts built with -mavx, scalar otherwise.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+static inline float vec_hsum_f32x4(float32x4_t v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+#elif defined(__AVX__)
+static inline float vec_hsum_f32x8(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+// sum(a[i] * b[i])
+static inline float vec_dot_f32(int n, const float * a, const float * b) {
+    int i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i),     vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    sum = vec_hsum_f32x4(vaddq_f32(acc0, acc1));
+#elif defined(__AVX__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+#if defined(__FMA__)
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+#else
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+#endif
+    }
+    sum = vec_hsum_f32x8(acc);
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// y[i] = a[i] * b[i]
+static inline void vec_mul_f32(int n, float * y, const float * a, const float * b) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(y + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = a[i] * b[i];
+    }
+}
+
+// y[i] += x[i]
+static inline void vec_acc_f32(int n, float * y, const float * x) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vld1q_f32(x + i)));
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] += x[i];
+    }
+}
+
+// y[i] *= s
+static inline void vec_scale_f32(int n, float * y, float s) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    const float32x4_t vs = vdupq_n_f32(s);
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(y + i, vmulq_f32(vld1q_f32(y + i), vs));
+    }
+#elif defined(__AVX__)
+    const __m256 vs = _mm256_set1_ps(s);
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(y + i), vs));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] *= s;
+    }
+}
+
+// y[i] = |x[i]|^2 for n interleaved complex values (re, im)
+static inline void vec_cplx_norm2_f32(int n, float * y, const float * x) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        const float32x4x2_t v = vld2q_f32(x + 2*i);
+        vst1q_f32(y + i, vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]));
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256 lo = _mm256_loadu_ps(x + 2*i);     // c0 c1 | c2 c3
+        const __m256 hi = _mm256_loadu_ps(x + 2*i + 8); // c4 c5 | c6 c7
+        const __m256 a = _mm256_permute2f128_ps(lo, hi, 0x20); // c0 c1 | c4 c5
+        const __m256 b = _mm256_permute2f128_ps(lo, hi, 0x31); // c2 c3 | c6 c7
+        // hadd pairs within 128-bit lanes: |c0|^2 .. |c3|^2 | |c4|^2 .. |c7|^2
+        _mm256_storeu_ps(y + i, _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = x[2*i + 0]*x[2*i + 0] + x[2*i + 1]*x[2*i + 1];
+    }
+}
+
+// x[i] *= g[i] for n interleaved complex values (re, im) and real gains
+static inline void vec_cplx_scale_f32(int n, float * x, const float * g) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = vld2q_f32(x + 2*i);
+        const float32x4_t vg = vld1q_f32(g + i);
+        v.val[0] = vmulq_f32(v.val[0], vg);
+        v.val[1] = vmulq_f32(v.val[1], vg);
+        vst2q_f32(x + 2*i, v);
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256 vg = _mm256_loadu_ps(g + i);
+        const __m256 lo = _mm256_unpacklo_ps(vg, vg); // g0 g0 g1 g1 | g4 g4 g5 g5
+        const __m256 hi = _mm256_unpackhi_ps(vg, vg); // g2 g2 g3 g3 | g6 g6 g7 g7
+        _mm256_storeu_ps(x + 2*i,     _mm256_mul_ps(_mm256_loadu_ps(x + 2*i),     _mm256_permute2f128_ps(lo, hi, 0x20)));
+        _mm256_storeu_ps(x + 2*i + 8, _mm256_mul_ps(_mm256_loadu_ps(x + 2*i + 8), _mm256_permute2f128_ps(lo, hi, 0x31)));
+    }
+#endif
+    for (; i < n; i++) {
+        x[2*i + 0] *= g[i];
+        x[2*i + 1] *= g[i];
+    }
+}
+
+// y[i] += a[i] * b[i]
+static inline void vec_mad_f32(int n, float * y, const float * a, const float * b) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), vld1q_f32(a + i), vld1q_f32(b + i)));
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] += a[i] * b[i];
+    }
+}
+
+// max(x[i])
+static inline float vec_max_f32(int n, const float * x) {
+    int i = 0;
+    float m = -INFINITY;
+#if defined(__ARM_NEON)
+    if (n >= 4) {
+        float32x4_t vm = vld1q_f32(x);
+        for (i = 4; i + 4 <= n; i += 4) {
+            vm = vmaxq_f32(vm, vld1q_f32(x + i));
+        }
+        float tmp[4];
+        vst1q_f32(tmp, vm);
+        m = fmaxf(fmaxf(tmp[0], tmp[1]), fmaxf(tmp[2], tmp[3]));
+    }
+#elif defined(__AVX__)
+    if (n >= 8) {
+        __m256 vm = _mm256_loadu_ps(x);
+        for (i = 8; i + 8 <= n; i += 8) {
+            vm = _mm256_max_ps(vm, _mm256_loadu_ps(x + i));
+        }
+        float tmp[8];
+        _mm256_storeu_ps(tmp, vm);
+        for (int j = 0; j < 8; j++) {
+            m = fmaxf(m, tmp[j]);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        m = fmaxf(m, x[i]);
+    }
+    return m;
+}
+
+// y[i] = (max(y[i], lo) + add) * mul
+static inline void vec_clamp_affine_f32(int n, float * y, float lo, float add, float mul) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    const float32x4_t vlo  = vdupq_n_f32(lo);
+    const float32x4_t vadd = vdupq_n_f32(add);
+    const float32x4_t vmul = vdupq_n_f32(mul);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t v = vmaxq_f32(vld1q_f32(y + i), vlo);
+        vst1q_f32(y + i, vmulq_f32(vaddq_f32(v, vadd), vmul));
+    }
+#elif defined(__AVX__)
+    const __m256 vlo  = _mm256_set1_ps(lo);
+    const __m256 vadd = _mm256_set1_ps(add);
+    const __m256 vmul = _mm256_set1_ps(mul);
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_max_ps(_mm256_loadu_ps(y + i), vlo);
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_add_ps(v, vadd), vmul));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = (fmaxf(y[i], lo) + add) * mul;
+    }
+}
+
+// y[i] = x[i] * s for 16-bit samples
+static inline void vec_s16_to_f32(int n, float * y, const int16_t * x, float s) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    const float32x4_t vs = vdupq_n_f32(s);
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(x + i);
+        vst1q_f32(y + i,     vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),  vs));
+        vst1q_f32(y + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), vs));
+    }
+#elif defined(__AVX__)
+    const __m256 vs = _mm256_set1_ps(s);
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (x + i));
+        const __m256i w = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_cvtepi16_epi32(v)), _mm_cvtepi16_epi32(_mm_srli_si128(v, 8)), 1);
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_cvtepi32_ps(w), vs));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = x[i] * s;
+    }
+}
+
+// y[i] = (x[2i] + x[2i + 1]) * s: interleaved 16-bit stereo to mono
+static inline void vec_s16x2_sum_f32(int n, float * y, const int16_t * x, float s) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    const float32x4_t vs = vdupq_n_f32(s);
+    for (; i + 8 <= n; i += 8) {
+        const int16x8x2_t v = vld2q_s16(x + 2*i);
+        const int32x4_t lo = vaddl_s16(vget_low_s16(v.val[0]),  vget_low_s16(v.val[1]));
+        const int32x4_t hi = vaddl_s16(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]));
+        vst1q_f32(y + i,     vmulq_f32(vcvtq_f32_s32(lo), vs));
+        vst1q_f32(y + i + 4, vmulq_f32(vcvtq_f32_s32(hi), vs));
+    }
+#elif defined(__AVX__)
+    const __m256 vs = _mm256_set1_ps(s);
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; i + 8 <= n; i += 8) {
+        // multiply-add of adjacent pairs with 1 is left + right
+        const __m128i lo = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (x + 2*i)),     ones);
+        const __m128i hi = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (x + 2*i + 8)), ones);
+        const __m256i w = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_cvtepi32_ps(w), vs));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = (x[2*i] + x[2*i + 1]) * s;
+    }
+}
+
+#endif // WHISPER_JNI_VEC_H